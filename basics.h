@@ -8,6 +8,39 @@
 
 #include <vector>
 
+#if !defined(_WIN32)
+// Enough of what we use from Windows for the code that doesn't touch D3D (the DXBC generator, the caches, etc.) to build elsewhere
+#include <errno.h>
+#include <signal.h>
+
+inline void OutputDebugStringA(const char* Str)
+{
+	fputs(Str, stderr);
+}
+
+inline void DebugBreak()
+{
+	raise(SIGTRAP);
+}
+
+inline int fopen_s(FILE** OutFile, const char* Filename, const char* Mode)
+{
+	*OutFile = fopen(Filename, Mode);
+	return (*OutFile != nullptr ? 0 : errno);
+}
+
+inline void* _aligned_malloc(size_t Size, size_t Alignment)
+{
+	void* Ptr = nullptr;
+	return (posix_memalign(&Ptr, Alignment, Size) == 0 ? Ptr : nullptr);
+}
+
+inline void _aligned_free(void* Ptr)
+{
+	free(Ptr);
+}
+#endif
+
 #define ASSERT(cond) do { if (!(cond)) { char output[256] = {}; snprintf(output, sizeof(output), "[%s:%d] Assertion failed '%s'\n", __FILE__, __LINE__, #cond); OutputDebugStringA(output); DebugBreak(); } } while(0)
 
 #define LOG(fmt, ...) do { char output[1024] = {}; snprintf(output, sizeof(output), fmt "\n", ## __VA_ARGS__); OutputDebugStringA(output); } while(0)
@@ -0,0 +1,272 @@
+#include "dxbc_batch.h"
+
+#include "dxbc_hash.h"
+#include "fuzz_dxbc.h"
+
+static void GenerateDxbcBatchEntryBytecode(uint64 CaseSeed, DxbcBatchEntry* OutEntry, bool WriteChecksums)
+{
+	// Same derivation as DoIterationsWithFuzzer: the DXBC generator is seeded with the first sub-seed of the case
+	FuzzBasicState CaseState;
+	CaseState.SetSeed(CaseSeed);
+
+	OutEntry->CaseSeed = CaseSeed;
+	OutEntry->DXBCSeed = CaseState.GetSubSeed();
+
+	FuzzDXBCState DXBCState;
+	DXBCState.SetSeed(OutEntry->DXBCSeed);
+
+	D3DOpcodeState VertShader;
+	D3DOpcodeState PixelShader;
+	GenerateShaderDXBCOpcodes(&DXBCState, &VertShader, &PixelShader);
+
+	OutEntry->VSMeta = DXBCState.VSMeta;
+	OutEntry->PSMeta = DXBCState.PSMeta;
+
+	WriteShaderBytecode(&VertShader, [&](uint32 Size) {
+		OutEntry->VSBytecode.resize(Size);
+		return OutEntry->VSBytecode.data();
+	}, WriteChecksums);
+
+	WriteShaderBytecode(&PixelShader, [&](uint32 Size) {
+		OutEntry->PSBytecode.resize(Size);
+		return OutEntry->PSBytecode.data();
+	}, WriteChecksums);
+}
+
+void GenerateDxbcBatchEntry(uint64 CaseSeed, DxbcBatchEntry* OutEntry)
+{
+	GenerateDxbcBatchEntryBytecode(CaseSeed, OutEntry, true);
+}
+
+void GenerateDxbcBatchEntries(const uint64* CaseSeeds, int32 Count, DxbcBatchEntry* OutEntries)
+{
+	// The checksum's the 16 bytes after the magic, and covers everything after it
+	const uint32 ChecksumOffset = 4;
+	const uint32 HashStartOffset = 20;
+
+	const void* HashedData[2 * DXBC_BATCH_CASES_PER_CLAIM];
+	uint32_t HashedSizes[2 * DXBC_BATCH_CASES_PER_CLAIM];
+	byte Digests[2 * DXBC_BATCH_CASES_PER_CLAIM][16];
+
+	for (int32 FirstEntry = 0; FirstEntry < Count; FirstEntry += DXBC_BATCH_CASES_PER_CLAIM)
+	{
+		int32 NumEntries = (Count - FirstEntry < DXBC_BATCH_CASES_PER_CLAIM ? Count - FirstEntry : DXBC_BATCH_CASES_PER_CLAIM);
+
+		int32 NumContainers = 0;
+		for (int32 i = 0; i < NumEntries; i++)
+		{
+			DxbcBatchEntry* Entry = &OutEntries[FirstEntry + i];
+			GenerateDxbcBatchEntryBytecode(CaseSeeds[FirstEntry + i], Entry, false);
+
+			std::vector<byte>* Bytecodes[2] = { &Entry->VSBytecode, &Entry->PSBytecode };
+			for (std::vector<byte>* Bytecode : Bytecodes)
+			{
+				HashedData[NumContainers] = Bytecode->data() + HashStartOffset;
+				HashedSizes[NumContainers] = (uint32_t)Bytecode->size() - HashStartOffset;
+				NumContainers++;
+			}
+		}
+
+		dxbcHashMany(HashedData, HashedSizes, NumContainers, Digests);
+
+		for (int32 i = 0; i < NumContainers; i++)
+		{
+			memcpy((byte*)HashedData[i] - HashStartOffset + ChecksumOffset, Digests[i], sizeof(Digests[i]));
+		}
+	}
+}
+
+void DxbcBatchRing::Init(uint32 Capacity)
+{
+	uint32 RoundedCapacity = 2;
+	while (RoundedCapacity < Capacity)
+	{
+		RoundedCapacity *= 2;
+	}
+
+	Cells = std::vector<DxbcBatchRingCell>(RoundedCapacity);
+	IndexMask = RoundedCapacity - 1;
+
+	for (uint32 i = 0; i < RoundedCapacity; i++)
+	{
+		Cells[i].Sequence.store(i, std::memory_order_relaxed);
+	}
+
+	EnqueuePos.store(0, std::memory_order_relaxed);
+	DequeuePos.store(0, std::memory_order_relaxed);
+}
+
+bool DxbcBatchRing::TryEnqueue(DxbcBatchEntry* InEntry)
+{
+	uint64 Pos = EnqueuePos.load(std::memory_order_relaxed);
+	DxbcBatchRingCell* Cell = nullptr;
+
+	while (true)
+	{
+		Cell = &Cells[Pos & IndexMask];
+		uint64 Sequence = Cell->Sequence.load(std::memory_order_acquire);
+		int64 Diff = (int64)Sequence - (int64)Pos;
+
+		if (Diff == 0)
+		{
+			if (EnqueuePos.compare_exchange_weak(Pos, Pos + 1, std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+		else if (Diff < 0)
+		{
+			// Full, the consumers haven't gotten to this cell from last time around
+			return false;
+		}
+		else
+		{
+			Pos = EnqueuePos.load(std::memory_order_relaxed);
+		}
+	}
+
+	Cell->Entry = std::move(*InEntry);
+	Cell->Sequence.store(Pos + 1, std::memory_order_release);
+
+	return true;
+}
+
+bool DxbcBatchRing::TryDequeue(DxbcBatchEntry* OutEntry)
+{
+	uint64 Pos = DequeuePos.load(std::memory_order_relaxed);
+	DxbcBatchRingCell* Cell = nullptr;
+
+	while (true)
+	{
+		Cell = &Cells[Pos & IndexMask];
+		uint64 Sequence = Cell->Sequence.load(std::memory_order_acquire);
+		int64 Diff = (int64)Sequence - (int64)(Pos + 1);
+
+		if (Diff == 0)
+		{
+			if (DequeuePos.compare_exchange_weak(Pos, Pos + 1, std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+		else if (Diff < 0)
+		{
+			// Empty
+			return false;
+		}
+		else
+		{
+			Pos = DequeuePos.load(std::memory_order_relaxed);
+		}
+	}
+
+	*OutEntry = std::move(Cell->Entry);
+	Cell->Sequence.store(Pos + IndexMask + 1, std::memory_order_release);
+
+	return true;
+}
+
+DxbcBatchGenerator::DxbcBatchGenerator()
+{
+	NextCaseToGenerate.store(0);
+	NextCaseToDequeue.store(0);
+	ShouldStop.store(false);
+}
+
+DxbcBatchGenerator::~DxbcBatchGenerator()
+{
+	Stop();
+}
+
+void DxbcBatchGenerator::Start(const FuzzSeedStream& InSeedStream, uint64 InCaseCount, int32 ThreadCount, uint32 RingCapacity)
+{
+	ASSERT(!IsRunning());
+	ASSERT(ThreadCount > 0);
+
+	ASSERT(InCaseCount <= (1LLU << FUZZ_CASE_ID_INDEX_BITS));
+
+	SeedStream = InSeedStream;
+	CaseCount = InCaseCount;
+	NextCaseToGenerate.store(0);
+	NextCaseToDequeue.store(0);
+	ShouldStop.store(false);
+
+	Ring.Init(RingCapacity);
+
+	for (int32 ThreadIdx = 0; ThreadIdx < ThreadCount; ThreadIdx++)
+	{
+		Threads.emplace_back([this]() {
+			DxbcBatchEntry Entries[DXBC_BATCH_CASES_PER_CLAIM];
+			uint64 CaseSeeds[DXBC_BATCH_CASES_PER_CLAIM];
+
+			while (!ShouldStop.load(std::memory_order_relaxed))
+			{
+				uint64 FirstCaseIndex = NextCaseToGenerate.fetch_add(DXBC_BATCH_CASES_PER_CLAIM);
+				if (FirstCaseIndex >= CaseCount)
+				{
+					break;
+				}
+
+				int32 NumCases = (int32)(CaseCount - FirstCaseIndex < DXBC_BATCH_CASES_PER_CLAIM ? CaseCount - FirstCaseIndex : DXBC_BATCH_CASES_PER_CLAIM);
+				for (int32 i = 0; i < NumCases; i++)
+				{
+					CaseSeeds[i] = SeedStream.GetCaseSeed(FirstCaseIndex + i);
+				}
+
+				GenerateDxbcBatchEntries(CaseSeeds, NumCases, Entries);
+
+				for (int32 i = 0; i < NumCases; i++)
+				{
+					while (!Ring.TryEnqueue(&Entries[i]))
+					{
+						if (ShouldStop.load(std::memory_order_relaxed))
+						{
+							return;
+						}
+
+						std::this_thread::yield();
+					}
+				}
+			}
+		});
+	}
+}
+
+bool DxbcBatchGenerator::Dequeue(DxbcBatchEntry* OutEntry)
+{
+	if (ShouldStop.load(std::memory_order_relaxed))
+	{
+		return false;
+	}
+
+	// Claim a case first, that way we know one is coming (or that there aren't any left) before we wait on the ring
+	uint64 CaseIndex = NextCaseToDequeue.fetch_add(1);
+	if (CaseIndex >= CaseCount)
+	{
+		return false;
+	}
+
+	while (!Ring.TryDequeue(OutEntry))
+	{
+		if (ShouldStop.load(std::memory_order_relaxed))
+		{
+			return false;
+		}
+
+		std::this_thread::yield();
+	}
+
+	return true;
+}
+
+void DxbcBatchGenerator::Stop()
+{
+	ShouldStop.store(true);
+
+	for (auto& Thread : Threads)
+	{
+		Thread.join();
+	}
+
+	Threads.clear();
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "basics.h"
+
+#include "shader_meta.h"
+#include "fuzz_seed_stream.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Generates DXBC shader pairs ahead of time on a pool of CPU threads, so the threads feeding the GPU only have to pick them up.
+// Nothing in here touches D3D, so it also works as a pure CPU throughput benchmark on machines without a device
+
+struct DxbcBatchEntry
+{
+	// The seed the case's fuzzer gets, and the sub-seed it would hand the DXBC generator (see DoIterationsWithFuzzer)
+	uint64 CaseSeed = 0;
+	uint64 DXBCSeed = 0;
+
+	std::vector<byte> VSBytecode;
+	std::vector<byte> PSBytecode;
+
+	ShaderMetadata VSMeta;
+	ShaderMetadata PSMeta;
+};
+
+// Generates the entry for a single case on the calling thread. The bytecode is identical to what GenerateShaderDXBC gives
+// for a FuzzDXBCState seeded with DXBCSeed
+void GenerateDxbcBatchEntry(uint64 CaseSeed, DxbcBatchEntry* OutEntry);
+
+// How many cases the generator threads take at a time. 8 cases is 16 containers, enough to fill dxbcHashMany's widest lanes
+#define DXBC_BATCH_CASES_PER_CLAIM 8
+
+// Same output as GenerateDxbcBatchEntry for each seed, but the containers are written without checksums,
+// and then all checksummed together with dxbcHashMany
+void GenerateDxbcBatchEntries(const uint64* CaseSeeds, int32 Count, DxbcBatchEntry* OutEntries);
+
+// Bounded multi-producer/multi-consumer ring (Vyukov's), each cell has a sequence number saying whose turn it is,
+// so neither side takes a lock
+struct DxbcBatchRingCell
+{
+	std::atomic<uint64> Sequence;
+	DxbcBatchEntry Entry;
+};
+
+struct DxbcBatchRing
+{
+	std::vector<DxbcBatchRingCell> Cells;
+	uint64 IndexMask = 0;
+
+	// Kept on separate cache lines, since producers hammer one and consumers the other
+	byte PaddingBefore[64];
+	std::atomic<uint64> EnqueuePos;
+	byte PaddingBetween[64];
+	std::atomic<uint64> DequeuePos;
+	byte PaddingAfter[64];
+
+	// Capacity gets rounded up to a power of 2. Not safe to call while anyone is using the ring
+	void Init(uint32 Capacity);
+
+	// Both return false instead of waiting (ring full/empty). Entries are moved in and out, and
+	// InEntry is left alone if TryEnqueue fails
+	bool TryEnqueue(DxbcBatchEntry* InEntry);
+	bool TryDequeue(DxbcBatchEntry* OutEntry);
+};
+
+struct DxbcBatchGenerator
+{
+	DxbcBatchRing Ring;
+	std::vector<std::thread> Threads;
+
+	FuzzSeedStream SeedStream;
+	uint64 CaseCount = 0;
+
+	// How far into the stream the producers/consumers have gotten
+	std::atomic<uint64> NextCaseToGenerate;
+	std::atomic<uint64> NextCaseToDequeue;
+
+	std::atomic<bool> ShouldStop;
+
+	DxbcBatchGenerator();
+	~DxbcBatchGenerator();
+
+	// Starts ThreadCount threads generating the cases [0, CaseCount) of the seed stream.
+	// Cases come out roughly, but not exactly, in order
+	void Start(const FuzzSeedStream& InSeedStream, uint64 InCaseCount, int32 ThreadCount, uint32 RingCapacity = 256);
+
+	// Waits for the next case. Returns false once every case has been handed out (or we were stopped)
+	bool Dequeue(DxbcBatchEntry* OutEntry);
+
+	// Stops generating early and waits for the threads. Anything left in the ring is thrown away
+	void Stop();
+
+	bool IsRunning() const { return Threads.size() > 0; }
+};
@@ -264,3 +264,564 @@ void dxbcHash(const void* _data, uint32_t _size, void* _digest)
 	bx::memCopy(_digest, hash, 16);
 }
 
+
+//
+// Everything below here is not from bgfx, it's a multi-buffer version of the above
+// that runs the same block function on several independent containers at once
+//
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define DXBC_HASH_HAS_SSE2 1
+#define DXBC_HASH_HAS_AVX2 1
+#define DXBC_HASH_HAS_AVX512 1
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+// GCC/Clang won't let us use the wider intrinsics unless the whole TU is built for them
+#if defined(__SSE2__)
+#define DXBC_HASH_HAS_SSE2 1
+#endif
+#if defined(__AVX2__)
+#define DXBC_HASH_HAS_AVX2 1
+#endif
+#if defined(__AVX512F__)
+#define DXBC_HASH_HAS_AVX512 1
+#endif
+#endif
+
+#ifndef DXBC_HASH_HAS_SSE2
+#define DXBC_HASH_HAS_SSE2 0
+#endif
+#ifndef DXBC_HASH_HAS_AVX2
+#define DXBC_HASH_HAS_AVX2 0
+#endif
+#ifndef DXBC_HASH_HAS_AVX512
+#define DXBC_HASH_HAS_AVX512 0
+#endif
+
+// The partial block at the end of a container, plus the size-dependent final block, expanded out
+// the same way dxbcHash does it. Returns how many blocks (1 or 2) were written to _tail
+static uint32_t dxbcBuildTailBlocks(const uint8_t* _tailData, uint32_t _size, uint32_t* _tail)
+{
+	bx::memSet(_tail, 0, 32 * sizeof(uint32_t));
+
+	const uint32_t remaining = _size & 0x3f;
+
+	if (remaining >= 56)
+	{
+		bx::memCopy(&_tail[0], _tailData, remaining);
+		_tail[remaining / 4] = 0x80;
+
+		_tail[16] = _size * 8;
+		_tail[31] = _size * 2 + 1;
+		return 2;
+	}
+	else
+	{
+		bx::memCopy(&_tail[1], _tailData, remaining);
+		_tail[1 + remaining / 4] = 0x80;
+
+		_tail[0] = _size * 8;
+		_tail[15] = _size * 2 + 1;
+		return 1;
+	}
+}
+
+template<typename L>
+inline typename L::Vec dxbcLaneMixF(typename L::Vec _b, typename L::Vec _c, typename L::Vec _d)
+{
+	return L::Xor(_d, L::And(_b, L::Xor(_c, _d)));
+}
+
+template<typename L>
+inline typename L::Vec dxbcLaneMixG(typename L::Vec _b, typename L::Vec _c, typename L::Vec _d)
+{
+	return dxbcLaneMixF<L>(_d, _b, _c);
+}
+
+template<typename L>
+inline typename L::Vec dxbcLaneMixH(typename L::Vec _b, typename L::Vec _c, typename L::Vec _d)
+{
+	return L::Xor(_d, L::Xor(_b, _c));
+}
+
+template<typename L>
+inline typename L::Vec dxbcLaneMixI(typename L::Vec _b, typename L::Vec _c, typename L::Vec _d)
+{
+	return L::Xor(_c, L::OrNot(_b, _d));
+}
+
+// Same steps as dxbcHashBlock, with every ror turned into the equivalent rol
+#define DXBC_LANE_STEP(a, b, mix, x, y, z, dat, k, r) \
+	a = L::Add(b, L::template Rol<r>(L::Add(L::Add(a, dxbcLaneMix##mix<L>(x, y, z)), L::Add(dat, L::Set1(k)))))
+
+// _words holds word j of lane i at [j * L::Count + i], and _hash is laid out the same way
+template<typename L>
+inline void dxbcHashBlockLanes(const uint32_t* _words, uint32_t* _hash)
+{
+	typedef typename L::Vec Vec;
+
+	const Vec d0 = L::Load(&_words[0 * L::Count]);
+	const Vec d1 = L::Load(&_words[1 * L::Count]);
+	const Vec d2 = L::Load(&_words[2 * L::Count]);
+	const Vec d3 = L::Load(&_words[3 * L::Count]);
+	const Vec d4 = L::Load(&_words[4 * L::Count]);
+	const Vec d5 = L::Load(&_words[5 * L::Count]);
+	const Vec d6 = L::Load(&_words[6 * L::Count]);
+	const Vec d7 = L::Load(&_words[7 * L::Count]);
+	const Vec d8 = L::Load(&_words[8 * L::Count]);
+	const Vec d9 = L::Load(&_words[9 * L::Count]);
+	const Vec d10 = L::Load(&_words[10 * L::Count]);
+	const Vec d11 = L::Load(&_words[11 * L::Count]);
+	const Vec d12 = L::Load(&_words[12 * L::Count]);
+	const Vec d13 = L::Load(&_words[13 * L::Count]);
+	const Vec d14 = L::Load(&_words[14 * L::Count]);
+	const Vec d15 = L::Load(&_words[15 * L::Count]);
+
+	Vec aa = L::Load(&_hash[0 * L::Count]);
+	Vec bb = L::Load(&_hash[1 * L::Count]);
+	Vec cc = L::Load(&_hash[2 * L::Count]);
+	Vec dd = L::Load(&_hash[3 * L::Count]);
+
+	const Vec oaa = aa;
+	const Vec obb = bb;
+	const Vec occ = cc;
+	const Vec odd = dd;
+
+	DXBC_LANE_STEP(aa, bb, F, bb, cc, dd, d0, 0xd76aa478, 7);
+	DXBC_LANE_STEP(dd, aa, F, aa, bb, cc, d1, 0xe8c7b756, 12);
+	DXBC_LANE_STEP(cc, dd, F, dd, aa, bb, d2, 0x242070db, 17);
+	DXBC_LANE_STEP(bb, cc, F, cc, dd, aa, d3, 0xc1bdceee, 22);
+	DXBC_LANE_STEP(aa, bb, F, bb, cc, dd, d4, 0xf57c0faf, 7);
+	DXBC_LANE_STEP(dd, aa, F, aa, bb, cc, d5, 0x4787c62a, 12);
+	DXBC_LANE_STEP(cc, dd, F, dd, aa, bb, d6, 0xa8304613, 17);
+	DXBC_LANE_STEP(bb, cc, F, cc, dd, aa, d7, 0xfd469501, 22);
+	DXBC_LANE_STEP(aa, bb, F, bb, cc, dd, d8, 0x698098d8, 7);
+	DXBC_LANE_STEP(dd, aa, F, aa, bb, cc, d9, 0x8b44f7af, 12);
+	DXBC_LANE_STEP(cc, dd, F, dd, aa, bb, d10, 0xffff5bb1, 17);
+	DXBC_LANE_STEP(bb, cc, F, cc, dd, aa, d11, 0x895cd7be, 22);
+	DXBC_LANE_STEP(aa, bb, F, bb, cc, dd, d12, 0x6b901122, 7);
+	DXBC_LANE_STEP(dd, aa, F, aa, bb, cc, d13, 0xfd987193, 12);
+	DXBC_LANE_STEP(cc, dd, F, dd, aa, bb, d14, 0xa679438e, 17);
+	DXBC_LANE_STEP(bb, cc, F, cc, dd, aa, d15, 0x49b40821, 22);
+
+	DXBC_LANE_STEP(aa, bb, G, bb, cc, dd, d1, 0xf61e2562, 5);
+	DXBC_LANE_STEP(dd, aa, G, aa, bb, cc, d6, 0xc040b340, 9);
+	DXBC_LANE_STEP(cc, dd, G, dd, aa, bb, d11, 0x265e5a51, 14);
+	DXBC_LANE_STEP(bb, cc, G, cc, dd, aa, d0, 0xe9b6c7aa, 20);
+	DXBC_LANE_STEP(aa, bb, G, bb, cc, dd, d5, 0xd62f105d, 5);
+	DXBC_LANE_STEP(dd, aa, G, aa, bb, cc, d10, 0x02441453, 9);
+	DXBC_LANE_STEP(cc, dd, G, dd, aa, bb, d15, 0xd8a1e681, 14);
+	DXBC_LANE_STEP(bb, cc, G, cc, dd, aa, d4, 0xe7d3fbc8, 20);
+	DXBC_LANE_STEP(aa, bb, G, bb, cc, dd, d9, 0x21e1cde6, 5);
+	DXBC_LANE_STEP(dd, aa, G, aa, bb, cc, d14, 0xc33707d6, 9);
+	DXBC_LANE_STEP(cc, dd, G, dd, aa, bb, d3, 0xf4d50d87, 14);
+	DXBC_LANE_STEP(bb, cc, G, cc, dd, aa, d8, 0x455a14ed, 20);
+	DXBC_LANE_STEP(aa, bb, G, bb, cc, dd, d13, 0xa9e3e905, 5);
+	DXBC_LANE_STEP(dd, aa, G, aa, bb, cc, d2, 0xfcefa3f8, 9);
+	DXBC_LANE_STEP(cc, dd, G, dd, aa, bb, d7, 0x676f02d9, 14);
+	DXBC_LANE_STEP(bb, cc, G, cc, dd, aa, d12, 0x8d2a4c8a, 20);
+
+	DXBC_LANE_STEP(aa, bb, H, bb, cc, dd, d5, 0xfffa3942, 4);
+	DXBC_LANE_STEP(dd, aa, H, aa, bb, cc, d8, 0x8771f681, 11);
+	DXBC_LANE_STEP(cc, dd, H, dd, aa, bb, d11, 0x6d9d6122, 16);
+	DXBC_LANE_STEP(bb, cc, H, cc, dd, aa, d14, 0xfde5380c, 23);
+	DXBC_LANE_STEP(aa, bb, H, bb, cc, dd, d1, 0xa4beea44, 4);
+	DXBC_LANE_STEP(dd, aa, H, aa, bb, cc, d4, 0x4bdecfa9, 11);
+	DXBC_LANE_STEP(cc, dd, H, dd, aa, bb, d7, 0xf6bb4b60, 16);
+	DXBC_LANE_STEP(bb, cc, H, cc, dd, aa, d10, 0xbebfbc70, 23);
+	DXBC_LANE_STEP(aa, bb, H, bb, cc, dd, d13, 0x289b7ec6, 4);
+	DXBC_LANE_STEP(dd, aa, H, aa, bb, cc, d0, 0xeaa127fa, 11);
+	DXBC_LANE_STEP(cc, dd, H, dd, aa, bb, d3, 0xd4ef3085, 16);
+	DXBC_LANE_STEP(bb, cc, H, cc, dd, aa, d6, 0x04881d05, 23);
+	DXBC_LANE_STEP(aa, bb, H, bb, cc, dd, d9, 0xd9d4d039, 4);
+	DXBC_LANE_STEP(dd, aa, H, aa, bb, cc, d12, 0xe6db99e5, 11);
+	DXBC_LANE_STEP(cc, dd, H, dd, aa, bb, d15, 0x1fa27cf8, 16);
+	DXBC_LANE_STEP(bb, cc, H, cc, dd, aa, d2, 0xc4ac5665, 23);
+
+	DXBC_LANE_STEP(aa, bb, I, bb, cc, dd, d0, 0xf4292244, 6);
+	DXBC_LANE_STEP(dd, aa, I, aa, bb, cc, d7, 0x432aff97, 10);
+	DXBC_LANE_STEP(cc, dd, I, dd, aa, bb, d14, 0xab9423a7, 15);
+	DXBC_LANE_STEP(bb, cc, I, cc, dd, aa, d5, 0xfc93a039, 21);
+	DXBC_LANE_STEP(aa, bb, I, bb, cc, dd, d12, 0x655b59c3, 6);
+	DXBC_LANE_STEP(dd, aa, I, aa, bb, cc, d3, 0x8f0ccc92, 10);
+	DXBC_LANE_STEP(cc, dd, I, dd, aa, bb, d10, 0xffeff47d, 15);
+	DXBC_LANE_STEP(bb, cc, I, cc, dd, aa, d1, 0x85845dd1, 21);
+	DXBC_LANE_STEP(aa, bb, I, bb, cc, dd, d8, 0x6fa87e4f, 6);
+	DXBC_LANE_STEP(dd, aa, I, aa, bb, cc, d15, 0xfe2ce6e0, 10);
+	DXBC_LANE_STEP(cc, dd, I, dd, aa, bb, d6, 0xa3014314, 15);
+	DXBC_LANE_STEP(bb, cc, I, cc, dd, aa, d13, 0x4e0811a1, 21);
+	DXBC_LANE_STEP(aa, bb, I, bb, cc, dd, d4, 0xf7537e82, 6);
+	DXBC_LANE_STEP(dd, aa, I, aa, bb, cc, d11, 0xbd3af235, 10);
+	DXBC_LANE_STEP(cc, dd, I, dd, aa, bb, d2, 0x2ad7d2bb, 15);
+	DXBC_LANE_STEP(bb, cc, I, cc, dd, aa, d9, 0xeb86d391, 21);
+
+	L::Store(&_hash[0 * L::Count], L::Add(oaa, aa));
+	L::Store(&_hash[1 * L::Count], L::Add(obb, bb));
+	L::Store(&_hash[2 * L::Count], L::Add(occ, cc));
+	L::Store(&_hash[3 * L::Count], L::Add(odd, dd));
+}
+
+#undef DXBC_LANE_STEP
+
+#if DXBC_HASH_HAS_SSE2
+struct DxbcLanesSSE2
+{
+	enum { Count = 4 };
+	typedef __m128i Vec;
+
+	static Vec Load(const uint32_t* _ptr) { return _mm_load_si128((const __m128i*)_ptr); }
+	static void Store(uint32_t* _ptr, Vec _a) { _mm_store_si128((__m128i*)_ptr, _a); }
+	static Vec Set1(uint32_t _val) { return _mm_set1_epi32((int)_val); }
+	static Vec Add(Vec _a, Vec _b) { return _mm_add_epi32(_a, _b); }
+	static Vec Xor(Vec _a, Vec _b) { return _mm_xor_si128(_a, _b); }
+	static Vec And(Vec _a, Vec _b) { return _mm_and_si128(_a, _b); }
+	static Vec OrNot(Vec _a, Vec _b) { return _mm_or_si128(_a, _mm_xor_si128(_b, _mm_set1_epi32(-1))); }
+
+	template<int Shift>
+	static Vec Rol(Vec _a) { return _mm_or_si128(_mm_slli_epi32(_a, Shift), _mm_srli_epi32(_a, 32 - Shift)); }
+};
+#endif
+
+#if DXBC_HASH_HAS_AVX2
+struct DxbcLanesAVX2
+{
+	enum { Count = 8 };
+	typedef __m256i Vec;
+
+	static Vec Load(const uint32_t* _ptr) { return _mm256_load_si256((const __m256i*)_ptr); }
+	static void Store(uint32_t* _ptr, Vec _a) { _mm256_store_si256((__m256i*)_ptr, _a); }
+	static Vec Set1(uint32_t _val) { return _mm256_set1_epi32((int)_val); }
+	static Vec Add(Vec _a, Vec _b) { return _mm256_add_epi32(_a, _b); }
+	static Vec Xor(Vec _a, Vec _b) { return _mm256_xor_si256(_a, _b); }
+	static Vec And(Vec _a, Vec _b) { return _mm256_and_si256(_a, _b); }
+	static Vec OrNot(Vec _a, Vec _b) { return _mm256_or_si256(_a, _mm256_xor_si256(_b, _mm256_set1_epi32(-1))); }
+
+	template<int Shift>
+	static Vec Rol(Vec _a) { return _mm256_or_si256(_mm256_slli_epi32(_a, Shift), _mm256_srli_epi32(_a, 32 - Shift)); }
+};
+#endif
+
+#if DXBC_HASH_HAS_AVX512
+struct DxbcLanesAVX512
+{
+	enum { Count = 16 };
+	typedef __m512i Vec;
+
+	static Vec Load(const uint32_t* _ptr) { return _mm512_load_si512((const void*)_ptr); }
+	static void Store(uint32_t* _ptr, Vec _a) { _mm512_store_si512((void*)_ptr, _a); }
+	static Vec Set1(uint32_t _val) { return _mm512_set1_epi32((int)_val); }
+	static Vec Add(Vec _a, Vec _b) { return _mm512_add_epi32(_a, _b); }
+	static Vec Xor(Vec _a, Vec _b) { return _mm512_xor_si512(_a, _b); }
+	static Vec And(Vec _a, Vec _b) { return _mm512_and_si512(_a, _b); }
+	// 0xF3 is the truth table for (a | ~b)
+	static Vec OrNot(Vec _a, Vec _b) { return _mm512_ternarylogic_epi32(_a, _b, _b, 0xF3); }
+
+	template<int Shift>
+	static Vec Rol(Vec _a) { return _mm512_rol_epi32(_a, Shift); }
+};
+#endif
+
+// Each lane works through one container at a time, and as soon as a lane finishes we hand it
+// the next container, so a mix of small and large containers still keeps every lane busy
+template<typename L>
+static void dxbcHashManyLanes(const void* const* _data, const uint32_t* _sizes, int _count, uint8_t* _digests)
+{
+	struct LaneJob
+	{
+		int ContainerIndex;
+		const uint32_t* Blocks;
+		uint32_t NumFullBlocks;
+		uint32_t NumBlocks;
+		uint32_t NextBlock;
+		uint32_t Tail[32];
+	};
+
+	alignas(64) uint32_t words[16 * L::Count];
+	alignas(64) uint32_t hash[4 * L::Count];
+
+	static const uint32_t ZeroBlock[16] = {};
+
+	LaneJob jobs[L::Count];
+	int nextContainer = 0;
+	int activeLanes = 0;
+
+	auto startNextJob = [&](int _lane)
+	{
+		LaneJob& job = jobs[_lane];
+
+		if (nextContainer >= _count)
+		{
+			job.ContainerIndex = -1;
+			return;
+		}
+
+		job.ContainerIndex = nextContainer;
+		job.Blocks = (const uint32_t*)_data[nextContainer];
+		job.NumFullBlocks = _sizes[nextContainer] / 64;
+		job.NumBlocks = job.NumFullBlocks + dxbcBuildTailBlocks((const uint8_t*)_data[nextContainer] + job.NumFullBlocks * 64, _sizes[nextContainer], job.Tail);
+		job.NextBlock = 0;
+
+		hash[0 * L::Count + _lane] = 0x67452301;
+		hash[1 * L::Count + _lane] = 0xefcdab89;
+		hash[2 * L::Count + _lane] = 0x98badcfe;
+		hash[3 * L::Count + _lane] = 0x10325476;
+
+		nextContainer++;
+		activeLanes++;
+	};
+
+	for (int lane = 0; lane < L::Count; ++lane)
+	{
+		startNextJob(lane);
+	}
+
+	while (activeLanes > 0)
+	{
+		for (int lane = 0; lane < L::Count; ++lane)
+		{
+			const LaneJob& job = jobs[lane];
+
+			const uint32_t* block = ZeroBlock;
+			if (job.ContainerIndex >= 0)
+			{
+				block = (job.NextBlock < job.NumFullBlocks)
+					? &job.Blocks[job.NextBlock * 16]
+					: &job.Tail[(job.NextBlock - job.NumFullBlocks) * 16];
+			}
+
+			for (int ii = 0; ii < 16; ++ii)
+			{
+				words[ii * L::Count + lane] = block[ii];
+			}
+		}
+
+		dxbcHashBlockLanes<L>(words, hash);
+
+		for (int lane = 0; lane < L::Count; ++lane)
+		{
+			LaneJob& job = jobs[lane];
+			if (job.ContainerIndex < 0)
+			{
+				continue;
+			}
+
+			job.NextBlock++;
+			if (job.NextBlock == job.NumBlocks)
+			{
+				uint32_t* digest = (uint32_t*)(_digests + job.ContainerIndex * 16);
+				for (int ii = 0; ii < 4; ++ii)
+				{
+					digest[ii] = hash[ii * L::Count + lane];
+				}
+
+				activeLanes--;
+				startNextJob(lane);
+			}
+		}
+	}
+}
+
+enum struct DxbcHashPath
+{
+	Scalar,
+	SSE2,
+	AVX2,
+	AVX512
+};
+
+static DxbcHashPath dxbcDetectHashPath()
+{
+	DxbcHashPath path = DxbcHashPath::Scalar;
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	int regs[4] = {};
+	__cpuid(regs, 0);
+	const int maxLeaf = regs[0];
+
+	__cpuid(regs, 1);
+	const bool hasSSE2 = (regs[3] & (1 << 26)) != 0;
+	const bool hasOSXSave = (regs[2] & (1 << 27)) != 0;
+
+	// Make sure the OS actually saves the YMM/ZMM registers before we go using them
+	const uint64_t xcr0 = hasOSXSave ? _xgetbv(0) : 0;
+	const bool osSavesYMM = (xcr0 & 0x06) == 0x06;
+	const bool osSavesZMM = (xcr0 & 0xE6) == 0xE6;
+
+	bool hasAVX2 = false;
+	bool hasAVX512 = false;
+	if (maxLeaf >= 7)
+	{
+		__cpuidex(regs, 7, 0);
+		hasAVX2 = (regs[1] & (1 << 5)) != 0;
+		hasAVX512 = (regs[1] & (1 << 16)) != 0;
+	}
+
+	if (hasSSE2)
+	{
+		path = DxbcHashPath::SSE2;
+	}
+	if (hasAVX2 && osSavesYMM)
+	{
+		path = DxbcHashPath::AVX2;
+	}
+	if (hasAVX512 && osSavesZMM)
+	{
+		path = DxbcHashPath::AVX512;
+	}
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	if (DXBC_HASH_HAS_SSE2 && __builtin_cpu_supports("sse2"))
+	{
+		path = DxbcHashPath::SSE2;
+	}
+	if (DXBC_HASH_HAS_AVX2 && __builtin_cpu_supports("avx2"))
+	{
+		path = DxbcHashPath::AVX2;
+	}
+	if (DXBC_HASH_HAS_AVX512 && __builtin_cpu_supports("avx512f"))
+	{
+		path = DxbcHashPath::AVX512;
+	}
+#endif
+
+	return path;
+}
+
+void dxbcHashMany(const void* const* _data, const uint32_t* _sizes, int _count, void* _digests)
+{
+	// Thread-safe since C++11, so it only runs once
+	static const DxbcHashPath path = dxbcDetectHashPath();
+
+	uint8_t* digests = (uint8_t*)_digests;
+
+	// Not worth shuffling a single container into lanes
+	if (_count == 1)
+	{
+		dxbcHash(_data[0], _sizes[0], digests);
+		return;
+	}
+
+	switch (path)
+	{
+#if DXBC_HASH_HAS_AVX512
+	case DxbcHashPath::AVX512:
+		dxbcHashManyLanes<DxbcLanesAVX512>(_data, _sizes, _count, digests);
+		_mm256_zeroupper();
+		return;
+#endif
+#if DXBC_HASH_HAS_AVX2
+	case DxbcHashPath::AVX2:
+		dxbcHashManyLanes<DxbcLanesAVX2>(_data, _sizes, _count, digests);
+		_mm256_zeroupper();
+		return;
+#endif
+#if DXBC_HASH_HAS_SSE2
+	case DxbcHashPath::SSE2:
+		dxbcHashManyLanes<DxbcLanesSSE2>(_data, _sizes, _count, digests);
+		return;
+#endif
+	default:
+		break;
+	}
+
+	for (int ii = 0; ii < _count; ++ii)
+	{
+		dxbcHash(_data[ii], _sizes[ii], digests + ii * 16);
+	}
+}
+
+//
+// Streaming context, this is the same as dxbcHash but the data can come in pieces
+//
+
+void dxbcHashInit(DxbcHashContext* _ctx)
+{
+	_ctx->State[0] = 0x67452301;
+	_ctx->State[1] = 0xefcdab89;
+	_ctx->State[2] = 0x98badcfe;
+	_ctx->State[3] = 0x10325476;
+	_ctx->TotalSize = 0;
+	_ctx->PendingSize = 0;
+}
+
+void dxbcHashUpdate(DxbcHashContext* _ctx, const void* _data, uint32_t _size)
+{
+	const uint8_t* data = (const uint8_t*)_data;
+	_ctx->TotalSize += _size;
+
+	// Top up whatever partial block was left over from the last update first
+	if (_ctx->PendingSize > 0)
+	{
+		const uint32_t toCopy = (_size < 64 - _ctx->PendingSize) ? _size : 64 - _ctx->PendingSize;
+		bx::memCopy(&_ctx->Pending[_ctx->PendingSize], data, toCopy);
+		_ctx->PendingSize += toCopy;
+		data += toCopy;
+		_size -= toCopy;
+
+		if (_ctx->PendingSize < 64)
+		{
+			return;
+		}
+
+		uint32_t block[16];
+		bx::memCopy(block, _ctx->Pending, 64);
+		dxbcHashBlock(block, _ctx->State);
+		_ctx->PendingSize = 0;
+	}
+
+	// Full blocks straight from the caller's memory, copying only if it isn't 4-byte aligned
+	while (_size >= 64)
+	{
+		if (((uintptr_t)data & 3) == 0)
+		{
+			dxbcHashBlock((const uint32_t*)data, _ctx->State);
+		}
+		else
+		{
+			uint32_t block[16];
+			bx::memCopy(block, data, 64);
+			dxbcHashBlock(block, _ctx->State);
+		}
+
+		data += 64;
+		_size -= 64;
+	}
+
+	if (_size > 0)
+	{
+		bx::memCopy(_ctx->Pending, data, _size);
+		_ctx->PendingSize = _size;
+	}
+}
+
+void dxbcHashFinal(DxbcHashContext* _ctx, void* _digest)
+{
+	uint32_t tail[32];
+	const uint32_t numTailBlocks = dxbcBuildTailBlocks(_ctx->Pending, _ctx->TotalSize, tail);
+
+	for (uint32_t ii = 0; ii < numTailBlocks; ++ii)
+	{
+		dxbcHashBlock(&tail[ii * 16], _ctx->State);
+	}
+
+	bx::memCopy(_digest, _ctx->State, 16);
+}
+
+bool dxbcHashSnapshot(const DxbcHashContext* _ctx, DxbcHashMidstate* _outMidstate)
+{
+	if (_ctx->PendingSize != 0)
+	{
+		return false;
+	}
+
+	bx::memCopy(_outMidstate->State, _ctx->State, sizeof(_outMidstate->State));
+	_outMidstate->TotalSize = _ctx->TotalSize;
+	return true;
+}
+
+void dxbcHashRestore(DxbcHashContext* _ctx, const DxbcHashMidstate* _midstate)
+{
+	bx::memCopy(_ctx->State, _midstate->State, sizeof(_ctx->State));
+	_ctx->TotalSize = _midstate->TotalSize;
+	_ctx->PendingSize = 0;
+}
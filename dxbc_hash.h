@@ -6,3 +6,34 @@
 void dxbcHash(const void* _data, uint32_t _size, void* _digest);
 
 
+
+// Hashes _count independent containers at once, writing 16 bytes per container to _digests.
+// Gives the same results as calling dxbcHash on each one, but uses SIMD lanes where the CPU has them
+void dxbcHashMany(const void* const* _data, const uint32_t* _sizes, int _count, void* _digests);
+
+// Streaming version of dxbcHash, for when we don't have the whole container in one buffer,
+// or want to reuse the work done on a prefix that hasn't changed
+struct DxbcHashContext
+{
+	uint32_t State[4];
+	uint32_t TotalSize;
+	uint32_t PendingSize;
+	uint8_t Pending[64];
+};
+
+// The internal state after some whole number of 64-byte blocks. Restoring one of these and
+// then feeding in the rest of the data gives the same result as hashing it all from the start
+struct DxbcHashMidstate
+{
+	uint32_t State[4];
+	uint32_t TotalSize;
+};
+
+void dxbcHashInit(DxbcHashContext* _ctx);
+void dxbcHashUpdate(DxbcHashContext* _ctx, const void* _data, uint32_t _size);
+void dxbcHashFinal(DxbcHashContext* _ctx, void* _digest);
+
+// Only valid when the amount of data passed to dxbcHashUpdate so far is a multiple of 64 bytes,
+// returns false (and leaves _outMidstate alone) otherwise
+bool dxbcHashSnapshot(const DxbcHashContext* _ctx, DxbcHashMidstate* _outMidstate);
+void dxbcHashRestore(DxbcHashContext* _ctx, const DxbcHashMidstate* _midstate);
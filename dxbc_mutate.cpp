@@ -0,0 +1,804 @@
+#include "dxbc_mutate.h"
+
+#include "dxbc_view.h"
+#include "dxbc_opcodes.h"
+
+#include <float.h>
+
+// Everything from here to the end of the container goes into the checksum
+static const uint32 DxbcHashedRegionStart = 20;
+
+// Mutants only ever grow by duplicating instructions, this keeps a long run of them from getting silly
+static const uint32 DxbcMutatorMaxInstructions = 4096;
+
+// Relative operands can nest, but not like this
+static const int32 DxbcMutatorMaxOperandDepth = 4;
+
+#define DXBC_MUTATOR_MAX_PREFIX_MIDSTATES 1024
+
+const char* GetDxbcMutationTypeName(DxbcMutationType Type)
+{
+	switch (Type)
+	{
+	case DxbcMutationType::SwapOperands: return "SwapOperands";
+	case DxbcMutationType::FlipSwizzleOrMask: return "FlipSwizzleOrMask";
+	case DxbcMutationType::ChangeOpcodeType: return "ChangeOpcodeType";
+	case DxbcMutationType::DuplicateInstruction: return "DuplicateInstruction";
+	case DxbcMutationType::DeleteInstruction: return "DeleteInstruction";
+	case DxbcMutationType::PerturbImmediateFloat: return "PerturbImmediateFloat";
+	case DxbcMutationType::ResizeDeclaration: return "ResizeDeclaration";
+	default: return "Unknown";
+	}
+}
+
+// Opcodes that take the same operands (same count, same roles), so any of them can be swapped for another in the same class
+static const D3DOpcodeType DxbcUnaryOpcodes[] = {
+	D3DOpcodeType_MOV, D3DOpcodeType_FRC, D3DOpcodeType_EXP, D3DOpcodeType_LOG, D3DOpcodeType_RSQ, D3DOpcodeType_SQRT,
+	D3DOpcodeType_ROUND_NE, D3DOpcodeType_ROUND_NI, D3DOpcodeType_ROUND_PI, D3DOpcodeType_ROUND_Z,
+	D3DOpcodeType_DERIV_RTX, D3DOpcodeType_DERIV_RTY, D3DOpcodeType_FTOI, D3DOpcodeType_FTOU, D3DOpcodeType_ITOF,
+	D3DOpcodeType_UTOF, D3DOpcodeType_INEG, D3DOpcodeType_NOT
+};
+
+static const D3DOpcodeType DxbcBinaryOpcodes[] = {
+	D3DOpcodeType_ADD, D3DOpcodeType_MUL, D3DOpcodeType_DIV, D3DOpcodeType_MIN, D3DOpcodeType_MAX,
+	D3DOpcodeType_DP2, D3DOpcodeType_DP3, D3DOpcodeType_DP4, D3DOpcodeType_EQ, D3DOpcodeType_NE, D3DOpcodeType_GE, D3DOpcodeType_LT,
+	D3DOpcodeType_IADD, D3DOpcodeType_IEQ, D3DOpcodeType_IGE, D3DOpcodeType_ILT, D3DOpcodeType_INE, D3DOpcodeType_IMAX, D3DOpcodeType_IMIN,
+	D3DOpcodeType_ISHL, D3DOpcodeType_ISHR, D3DOpcodeType_USHR, D3DOpcodeType_ULT, D3DOpcodeType_UGE, D3DOpcodeType_UMAX, D3DOpcodeType_UMIN,
+	D3DOpcodeType_AND, D3DOpcodeType_OR, D3DOpcodeType_XOR
+};
+
+static const D3DOpcodeType DxbcTernaryOpcodes[] = {
+	D3DOpcodeType_MAD, D3DOpcodeType_MOVC, D3DOpcodeType_IMAD, D3DOpcodeType_UMAD
+};
+
+// Two destinations, two sources
+static const D3DOpcodeType DxbcWideBinaryOpcodes[] = {
+	D3DOpcodeType_IMUL, D3DOpcodeType_UMUL, D3DOpcodeType_UDIV
+};
+
+// Dest, address, texture, sampler, and one more (LOD/bias/reference value)
+static const D3DOpcodeType DxbcSampleOpcodes[] = {
+	D3DOpcodeType_SAMPLE_L, D3DOpcodeType_SAMPLE_B, D3DOpcodeType_SAMPLE_C, D3DOpcodeType_SAMPLE_C_LZ
+};
+
+struct DxbcOpcodeClass
+{
+	const D3DOpcodeType* Opcodes;
+	int32 OpcodeCount;
+	uint32 OperandCount;
+};
+
+static const DxbcOpcodeClass DxbcOpcodeClasses[] = {
+	{ DxbcUnaryOpcodes, ARRAY_COUNTOF(DxbcUnaryOpcodes), 2 },
+	{ DxbcBinaryOpcodes, ARRAY_COUNTOF(DxbcBinaryOpcodes), 3 },
+	{ DxbcTernaryOpcodes, ARRAY_COUNTOF(DxbcTernaryOpcodes), 4 },
+	{ DxbcWideBinaryOpcodes, ARRAY_COUNTOF(DxbcWideBinaryOpcodes), 4 },
+	{ DxbcSampleOpcodes, ARRAY_COUNTOF(DxbcSampleOpcodes), 5 },
+};
+
+static const DxbcOpcodeClass* FindOpcodeClass(uint32 OpcodeType)
+{
+	for (uint32 ClassIdx = 0; ClassIdx < ARRAY_COUNTOF(DxbcOpcodeClasses); ClassIdx++)
+	{
+		const DxbcOpcodeClass& Class = DxbcOpcodeClasses[ClassIdx];
+		for (int32 i = 0; i < Class.OpcodeCount; i++)
+		{
+			if ((uint32)Class.Opcodes[i] == OpcodeType)
+			{
+				return &Class;
+			}
+		}
+	}
+
+	return nullptr;
+}
+
+// Both opcode and operand tokens use bit 31 to say another (extended) token follows. Returns how many there are, or -1 if they run off the end
+static int32 CountExtendedTokens(const uint32* Tokens, uint32 Available)
+{
+	int32 Count = 0;
+	while ((uint32)Count < Available && (Tokens[Count] >> 31) != 0)
+	{
+		Count++;
+		if ((uint32)Count >= Available)
+		{
+			return -1;
+		}
+	}
+
+	return Count;
+}
+
+// Length in DWORDs of the operand starting at Tokens[0], including any relative addressing operands nested inside it
+static bool DecodeOperandLength(const uint32* Tokens, uint32 Available, int32 Depth, uint32* OutLength)
+{
+	if (Available == 0 || Depth > DxbcMutatorMaxOperandDepth)
+	{
+		return false;
+	}
+
+	uint32 Header = Tokens[0];
+	int32 ExtendedCount = CountExtendedTokens(Tokens, Available);
+	if (ExtendedCount < 0)
+	{
+		return false;
+	}
+
+	uint32 Length = 1 + ExtendedCount;
+
+	uint32 NumComponents = Header & 0x3;
+	uint32 SourceType = (Header >> 12) & 0xFF;
+	uint32 Dimension = (Header >> 20) & 0x3;
+
+	if (SourceType == OperandSourceType_Immediate32 || SourceType == OperandSourceType_Immediate64)
+	{
+		uint32 ValueCount = (NumComponents == OperandNumComponents_One) ? 1 : (NumComponents == OperandNumComponents_Four) ? 4 : 0;
+		if (ValueCount == 0)
+		{
+			return false;
+		}
+
+		Length += (SourceType == OperandSourceType_Immediate64) ? ValueCount * 2 : ValueCount;
+	}
+
+	for (uint32 i = 0; i < Dimension; i++)
+	{
+		uint32 Repr = (Header >> (22 + 3 * i)) & 0x7;
+
+		if (Repr == OperandSourceIndexRepr_Imm32 || Repr == OperandSourceIndexRepr_RelativePlusImm32)
+		{
+			Length += 1;
+		}
+		else if (Repr == OperandSourceIndexRepr_Imm64 || Repr == OperandSourceIndexRepr_RelativePlusImm64)
+		{
+			Length += 2;
+		}
+		else if (Repr != OperandSourceIndexRepr_Relative)
+		{
+			return false;
+		}
+
+		if (Repr == OperandSourceIndexRepr_Relative || Repr == OperandSourceIndexRepr_RelativePlusImm32 || Repr == OperandSourceIndexRepr_RelativePlusImm64)
+		{
+			if (Length >= Available)
+			{
+				return false;
+			}
+
+			uint32 NestedLength = 0;
+			if (!DecodeOperandLength(Tokens + Length, Available - Length, Depth + 1, &NestedLength))
+			{
+				return false;
+			}
+
+			Length += NestedLength;
+		}
+	}
+
+	if (Length > Available)
+	{
+		return false;
+	}
+
+	*OutLength = Length;
+	return true;
+}
+
+static bool IsDeclarationOpcode(uint32 OpcodeType)
+{
+	return (OpcodeType >= D3DOpcodeType_DCL_RESOURCE && OpcodeType <= D3DOpcodeType_DCL_GLOBAL_FLAGS)
+		|| OpcodeType == D3D11OpcodeType_HS_DECLS
+		|| (OpcodeType >= D3D11OpcodeType_DCL_STREAM && OpcodeType <= D3D11OpcodeType_DCL_RESOURCE_STRUCTURED)
+		|| OpcodeType == D3D11OpcodeType_DCL_GS_INSTANCE_COUNT;
+}
+
+static bool IsKnownOpcode(uint32 OpcodeType)
+{
+	return OpcodeType < D3DOpcodeType_NUM && OpcodeType != D3DOpcodeType_CUSTOMDATA;
+}
+
+bool DxbcMutator::Init(const void* ByteCode, uint32 ByteCodeSize)
+{
+	Original.clear();
+	OriginalTokens.clear();
+	OriginalInstructions.clear();
+	OriginalOperands.clear();
+	PrefixMidstates.clear();
+
+	DxbcView View;
+	DxbcShaderCodeView Code;
+	if (!View.Init(ByteCode, ByteCodeSize) || !View.GetShaderCode(&Code))
+	{
+		return false;
+	}
+
+	CodeChunkOffset = (uint32)(Code.Chunk.Data - View.Data) - 8;
+	CodeChunkEnd = (uint32)(Code.Chunk.Data - View.Data) + Code.Chunk.Size;
+	CodeChunkFourCC = Code.Chunk.FourCC;
+	memcpy(&CodeVersionToken, Code.Chunk.Data, 4);
+
+	// We only move the chunks after the code chunk, so nothing else can live inside it
+	for (uint32 i = 0; i < View.ChunkCount; i++)
+	{
+		uint32 ChunkOffset = 0;
+		memcpy(&ChunkOffset, View.ChunkOffsetTable + i * 4, 4);
+		if (ChunkOffset > CodeChunkOffset && ChunkOffset < CodeChunkEnd)
+		{
+			return false;
+		}
+	}
+
+	bool HasSeenInstruction = false;
+
+	DxbcInstructionIterator Iter = Code.GetInstructions();
+	DxbcInstruction Instruction;
+	while (Iter.Next(&Instruction))
+	{
+		DxbcMutatorInstruction Parsed;
+		Parsed.TokenOffset = (uint32)OriginalTokens.size();
+		Parsed.Length = Instruction.Length;
+		Parsed.OpcodeType = Instruction.OpcodeType;
+
+		OriginalTokens.insert(OriginalTokens.end(), Instruction.Tokens, Instruction.Tokens + Instruction.Length);
+
+		if (Instruction.OpcodeType == D3DOpcodeType_CUSTOMDATA)
+		{
+			// Custom data (like the immediate constant buffer) counts as a declaration if it's up with the declarations
+			Parsed.IsDeclaration = !HasSeenInstruction;
+		}
+		else
+		{
+			// SM5 instructions we don't have in our list are still instructions, we just won't look inside of them
+			Parsed.IsDeclaration = IsDeclarationOpcode(Instruction.OpcodeType);
+			HasSeenInstruction |= !Parsed.IsDeclaration;
+		}
+
+		if (!Parsed.IsDeclaration && IsKnownOpcode(Instruction.OpcodeType))
+		{
+			int32 ExtendedCount = CountExtendedTokens(Instruction.Tokens, Instruction.Length);
+			uint32 Offset = 1 + ExtendedCount;
+			bool DecodedAll = (ExtendedCount >= 0);
+
+			Parsed.FirstOperand = (uint32)OriginalOperands.size();
+			while (DecodedAll && Offset < Instruction.Length)
+			{
+				DxbcMutatorOperand Operand;
+				Operand.Offset = Offset;
+				DecodedAll = DecodeOperandLength(Instruction.Tokens + Offset, Instruction.Length - Offset, 0, &Operand.Length);
+
+				if (DecodedAll)
+				{
+					OriginalOperands.push_back(Operand);
+					Offset += Operand.Length;
+				}
+			}
+
+			if (DecodedAll)
+			{
+				Parsed.OperandCount = (uint32)OriginalOperands.size() - Parsed.FirstOperand;
+			}
+			else
+			{
+				OriginalOperands.resize(Parsed.FirstOperand);
+			}
+		}
+
+		OriginalInstructions.push_back(Parsed);
+	}
+
+	if (Iter.HasError || OriginalInstructions.size() == 0)
+	{
+		return false;
+	}
+
+	Original.assign((const byte*)ByteCode, (const byte*)ByteCode + ByteCodeSize);
+
+	Reset();
+	return true;
+}
+
+void DxbcMutator::Reset()
+{
+	TokenPool = OriginalTokens;
+	Instructions = OriginalInstructions;
+	Operands = OriginalOperands;
+}
+
+// Gives the instruction its own copy of its tokens, so we can edit them without touching anything it was duplicated from/to
+static uint32* DetachInstructionTokens(std::vector<uint32>* TokenPool, DxbcMutatorInstruction* Instruction)
+{
+	uint32 NewOffset = (uint32)TokenPool->size();
+	TokenPool->resize(NewOffset + Instruction->Length);
+	memcpy(TokenPool->data() + NewOffset, TokenPool->data() + Instruction->TokenOffset, Instruction->Length * sizeof(uint32));
+
+	Instruction->TokenOffset = NewOffset;
+	return TokenPool->data() + NewOffset;
+}
+
+// Picks uniformly from the instructions matching Predicate, -1 if none do. Only costs one random number, since this is in the hot path
+template<typename PredicateType>
+static int32 PickInstruction(FuzzBasicState* Fuzzer, const std::vector<DxbcMutatorInstruction>& Instructions, PredicateType Predicate)
+{
+	int32 MatchCount = 0;
+	for (const auto& Instruction : Instructions)
+	{
+		MatchCount += Predicate(Instruction) ? 1 : 0;
+	}
+
+	if (MatchCount == 0)
+	{
+		return -1;
+	}
+
+	int32 Chosen = Fuzzer->GetIntInRange(0, MatchCount - 1);
+	for (int32 i = 0; i < (int32)Instructions.size(); i++)
+	{
+		if (Predicate(Instructions[i]) && Chosen-- == 0)
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+// Same idea, but over every operand of every instruction. Predicate gets the operand's tokens (which DecodeOperandLength
+// already checked are all there)
+template<typename PredicateType>
+static bool PickOperand(FuzzBasicState* Fuzzer, const DxbcMutator& Mutator, PredicateType Predicate, int32* OutInstructionIndex, uint32* OutOperandIndex)
+{
+	int32 MatchCount = 0;
+	for (const auto& Instruction : Mutator.Instructions)
+	{
+		for (uint32 i = 0; i < Instruction.OperandCount; i++)
+		{
+			const auto& Operand = Mutator.Operands[Instruction.FirstOperand + i];
+			MatchCount += Predicate(&Mutator.TokenPool[Instruction.TokenOffset + Operand.Offset]) ? 1 : 0;
+		}
+	}
+
+	if (MatchCount == 0)
+	{
+		return false;
+	}
+
+	int32 Chosen = Fuzzer->GetIntInRange(0, MatchCount - 1);
+	for (int32 InstIdx = 0; InstIdx < (int32)Mutator.Instructions.size(); InstIdx++)
+	{
+		const auto& Instruction = Mutator.Instructions[InstIdx];
+		for (uint32 i = 0; i < Instruction.OperandCount; i++)
+		{
+			const auto& Operand = Mutator.Operands[Instruction.FirstOperand + i];
+			if (Predicate(&Mutator.TokenPool[Instruction.TokenOffset + Operand.Offset]) && Chosen-- == 0)
+			{
+				*OutInstructionIndex = InstIdx;
+				*OutOperandIndex = i;
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+static bool IsFourComponentOperand(const uint32* Tokens)
+{
+	return (Tokens[0] & 0x3) == OperandNumComponents_Four;
+}
+
+// Always has its values, DecodeOperandLength won't take an immediate without any
+static bool IsImmediate32Operand(const uint32* Tokens)
+{
+	return ((Tokens[0] >> 12) & 0xFF) == OperandSourceType_Immediate32;
+}
+
+static bool MutateSwapOperands(DxbcMutator* Mutator, FuzzBasicState* Fuzzer)
+{
+	int32 InstIdx = PickInstruction(Fuzzer, Mutator->Instructions, [](const DxbcMutatorInstruction& Instruction) {
+		return Instruction.OperandCount >= 2;
+	});
+
+	if (InstIdx < 0)
+	{
+		return false;
+	}
+
+	DxbcMutatorInstruction& Instruction = Mutator->Instructions[InstIdx];
+
+	// Mostly swap sources, since that's more likely to get past validation, but sometimes the destination too
+	uint32 FirstCandidate = (Instruction.OperandCount >= 3 && Fuzzer->GetIntInRange(0, 3) != 0) ? 1 : 0;
+	uint32 A = Fuzzer->GetIntInRange(FirstCandidate, Instruction.OperandCount - 1);
+	uint32 B = Fuzzer->GetIntInRange(FirstCandidate, Instruction.OperandCount - 2);
+	if (B >= A)
+	{
+		B++;
+	}
+
+	// The operands can be different lengths, so we write the whole instruction out again in the new order.
+	// The total length doesn't change, so the opcode token is fine as-is
+	uint32 OldTokenOffset = Instruction.TokenOffset;
+	uint32 NewTokenOffset = (uint32)Mutator->TokenPool.size();
+	Mutator->TokenPool.resize(NewTokenOffset + Instruction.Length);
+
+	uint32 NewFirstOperand = (uint32)Mutator->Operands.size();
+	Mutator->Operands.resize(NewFirstOperand + Instruction.OperandCount);
+
+	uint32 OperandsStart = Mutator->Operands[Instruction.FirstOperand].Offset;
+	uint32* NewTokens = Mutator->TokenPool.data() + NewTokenOffset;
+	const uint32* OldTokens = Mutator->TokenPool.data() + OldTokenOffset;
+	memcpy(NewTokens, OldTokens, OperandsStart * sizeof(uint32));
+
+	uint32 Cursor = OperandsStart;
+	for (uint32 i = 0; i < Instruction.OperandCount; i++)
+	{
+		uint32 SourceIndex = (i == A) ? B : (i == B) ? A : i;
+		DxbcMutatorOperand Source = Mutator->Operands[Instruction.FirstOperand + SourceIndex];
+
+		memcpy(NewTokens + Cursor, OldTokens + Source.Offset, Source.Length * sizeof(uint32));
+
+		DxbcMutatorOperand& Dest = Mutator->Operands[NewFirstOperand + i];
+		Dest.Offset = Cursor;
+		Dest.Length = Source.Length;
+		Cursor += Source.Length;
+	}
+
+	ASSERT(Cursor == Instruction.Length);
+
+	Instruction.TokenOffset = NewTokenOffset;
+	Instruction.FirstOperand = NewFirstOperand;
+	return true;
+}
+
+static bool MutateFlipSwizzleOrMask(DxbcMutator* Mutator, FuzzBasicState* Fuzzer)
+{
+	int32 InstIdx = 0;
+	uint32 OperandIdx = 0;
+	if (!PickOperand(Fuzzer, *Mutator, IsFourComponentOperand, &InstIdx, &OperandIdx))
+	{
+		return false;
+	}
+
+	DxbcMutatorInstruction& Instruction = Mutator->Instructions[InstIdx];
+	uint32* Tokens = DetachInstructionTokens(&Mutator->TokenPool, &Instruction);
+	uint32* Header = &Tokens[Mutator->Operands[Instruction.FirstOperand + OperandIdx].Offset];
+
+	uint32 SelectionMode = (*Header >> 2) & 0x3;
+
+	if (Fuzzer->GetIntInRange(0, 7) == 0)
+	{
+		// Every so often switch between mask and swizzle and let the existing bits be reinterpreted
+		uint32 NewMode = (SelectionMode == Operand4CompSelection_Mask) ? Operand4CompSelection_Swizzle : Operand4CompSelection_Mask;
+		*Header = (*Header & ~(0x3u << 2)) | (NewMode << 2);
+	}
+	else
+	{
+		// Mask is bits 4-7, swizzle 4-11, select-1 4-5
+		int32 FieldBits = (SelectionMode == Operand4CompSelection_Swizzle) ? 8 : (SelectionMode == Operand4CompSelection_Select) ? 2 : 4;
+		*Header ^= 1u << (4 + Fuzzer->GetIntInRange(0, FieldBits - 1));
+	}
+
+	return true;
+}
+
+static bool MutateChangeOpcodeType(DxbcMutator* Mutator, FuzzBasicState* Fuzzer)
+{
+	int32 InstIdx = PickInstruction(Fuzzer, Mutator->Instructions, [](const DxbcMutatorInstruction& Instruction) {
+		const DxbcOpcodeClass* Class = FindOpcodeClass(Instruction.OpcodeType);
+		return Class != nullptr && Class->OperandCount == Instruction.OperandCount;
+	});
+
+	if (InstIdx < 0)
+	{
+		return false;
+	}
+
+	DxbcMutatorInstruction& Instruction = Mutator->Instructions[InstIdx];
+	const DxbcOpcodeClass* Class = FindOpcodeClass(Instruction.OpcodeType);
+
+	// Pick from everything but the current one
+	uint32 NewOpcodeType = Class->Opcodes[Fuzzer->GetIntInRange(0, Class->OpcodeCount - 2)];
+	if (NewOpcodeType == Instruction.OpcodeType)
+	{
+		NewOpcodeType = Class->Opcodes[Class->OpcodeCount - 1];
+	}
+
+	uint32* Tokens = DetachInstructionTokens(&Mutator->TokenPool, &Instruction);
+	Tokens[0] = (Tokens[0] & ~0x7FFu) | NewOpcodeType;
+	Instruction.OpcodeType = NewOpcodeType;
+
+	return true;
+}
+
+static int32 GetFirstNonDeclarationIndex(const std::vector<DxbcMutatorInstruction>& Instructions)
+{
+	for (int32 i = 0; i < (int32)Instructions.size(); i++)
+	{
+		if (!Instructions[i].IsDeclaration)
+		{
+			return i;
+		}
+	}
+
+	return (int32)Instructions.size();
+}
+
+static bool MutateDuplicateInstruction(DxbcMutator* Mutator, FuzzBasicState* Fuzzer)
+{
+	if (Mutator->Instructions.size() >= DxbcMutatorMaxInstructions)
+	{
+		return false;
+	}
+
+	int32 InstIdx = PickInstruction(Fuzzer, Mutator->Instructions, [](const DxbcMutatorInstruction& Instruction) {
+		return !Instruction.IsDeclaration;
+	});
+
+	if (InstIdx < 0)
+	{
+		return false;
+	}
+
+	// The copy shares its tokens with the original until one of them gets edited
+	DxbcMutatorInstruction Copy = Mutator->Instructions[InstIdx];
+
+	int32 InsertAt = Fuzzer->GetIntInRange(GetFirstNonDeclarationIndex(Mutator->Instructions), (int32)Mutator->Instructions.size());
+	Mutator->Instructions.insert(Mutator->Instructions.begin() + InsertAt, Copy);
+
+	return true;
+}
+
+static bool MutateDeleteInstruction(DxbcMutator* Mutator, FuzzBasicState* Fuzzer)
+{
+	if (Mutator->Instructions.size() == 0)
+	{
+		return false;
+	}
+
+	// Leave the final ret alone, a shader that just runs off the end isn't very interesting
+	const DxbcMutatorInstruction* LastInstruction = &Mutator->Instructions.back();
+	int32 InstIdx = PickInstruction(Fuzzer, Mutator->Instructions, [LastInstruction](const DxbcMutatorInstruction& Instruction) {
+		return !Instruction.IsDeclaration && !(&Instruction == LastInstruction && Instruction.OpcodeType == D3DOpcodeType_RET);
+	});
+
+	if (InstIdx < 0)
+	{
+		return false;
+	}
+
+	Mutator->Instructions.erase(Mutator->Instructions.begin() + InstIdx);
+
+	return true;
+}
+
+static bool MutatePerturbImmediateFloat(DxbcMutator* Mutator, FuzzBasicState* Fuzzer)
+{
+	int32 InstIdx = 0;
+	uint32 OperandIdx = 0;
+	if (!PickOperand(Fuzzer, *Mutator, IsImmediate32Operand, &InstIdx, &OperandIdx))
+	{
+		return false;
+	}
+
+	DxbcMutatorInstruction& Instruction = Mutator->Instructions[InstIdx];
+	const DxbcMutatorOperand& Operand = Mutator->Operands[Instruction.FirstOperand + OperandIdx];
+
+	uint32* Tokens = DetachInstructionTokens(&Mutator->TokenPool, &Instruction);
+	uint32* OperandTokens = &Tokens[Operand.Offset];
+
+	// The values come after the header and any extended operand tokens
+	uint32 ValuesStart = 1 + CountExtendedTokens(OperandTokens, Operand.Length);
+	uint32 ValueCount = Operand.Length - ValuesStart;
+	uint32* Value = &OperandTokens[ValuesStart + Fuzzer->GetIntInRange(0, ValueCount - 1)];
+
+	float FloatValue = 0.0f;
+	memcpy(&FloatValue, Value, sizeof(float));
+
+	int32 Decider = Fuzzer->GetIntInRange(0, 99);
+	if (Decider < 40)
+	{
+		FloatValue *= Fuzzer->GetFloatInRange(0.5f, 2.0f);
+	}
+	else if (Decider < 50)
+	{
+		FloatValue = -FloatValue;
+	}
+	else if (Decider < 75)
+	{
+		// The stuff drivers are most likely to get wrong
+		static const float InterestingValues[] = { 0.0f, -0.0f, 1.0f, -1.0f, 0.5f, FLT_MAX, -FLT_MAX, FLT_MIN, FLT_MIN * 0.25f, FLT_EPSILON };
+		FloatValue = InterestingValues[Fuzzer->GetIntInRange(0, ARRAY_COUNTOF(InterestingValues) - 1)];
+	}
+
+	memcpy(Value, &FloatValue, sizeof(float));
+
+	if (Decider >= 75)
+	{
+		// Flipping a bit directly gets us infs, NaNs and denormals too (and works just as well if it was an int)
+		*Value ^= 1u << Fuzzer->GetIntInRange(0, 31);
+	}
+
+	return true;
+}
+
+// Returns the index of the token holding the size a declaration declares, or 0 if it isn't one we know how to resize
+static uint32 GetDeclarationSizeTokenIndex(const DxbcMutatorInstruction& Instruction, const uint32* Tokens)
+{
+	if (Instruction.OpcodeType == D3DOpcodeType_DCL_TEMPS && Instruction.Length == 2)
+	{
+		// dcl_temps N
+		return 1;
+	}
+	else if (Instruction.OpcodeType == D3DOpcodeType_DCL_INDEXABLE_TEMP && Instruction.Length == 4)
+	{
+		// dcl_indexableTemp x[Index][N], Components
+		return 2;
+	}
+	else if (Instruction.OpcodeType == D3DOpcodeType_DCL_CONSTANT_BUFFER && Instruction.Length == 4)
+	{
+		// dcl_constantbuffer cb[Index][N], with both indices as plain immediates
+		uint32 Header = Tokens[1];
+		bool IsPlain2D = ((Header >> 31) == 0) && (((Header >> 20) & 0x3) == OperandSourceIndexDimension_2D) && (((Header >> 22) & 0x3F) == 0);
+		return IsPlain2D ? 3 : 0;
+	}
+
+	return 0;
+}
+
+static bool MutateResizeDeclaration(DxbcMutator* Mutator, FuzzBasicState* Fuzzer)
+{
+	int32 InstIdx = PickInstruction(Fuzzer, Mutator->Instructions, [Mutator](const DxbcMutatorInstruction& Instruction) {
+		return GetDeclarationSizeTokenIndex(Instruction, &Mutator->TokenPool[Instruction.TokenOffset]) != 0;
+	});
+
+	if (InstIdx < 0)
+	{
+		return false;
+	}
+
+	DxbcMutatorInstruction& Instruction = Mutator->Instructions[InstIdx];
+	uint32* Tokens = DetachInstructionTokens(&Mutator->TokenPool, &Instruction);
+	uint32* Size = &Tokens[GetDeclarationSizeTokenIndex(Instruction, Tokens)];
+
+	uint32 OldSize = *Size;
+	int32 Decider = Fuzzer->GetIntInRange(0, 9);
+	if (Decider < 6)
+	{
+		int32 Delta = Fuzzer->GetIntInRange(1, 2) * (Fuzzer->GetIntInRange(0, 1) ? 1 : -1);
+		*Size = (Delta < 0 && OldSize < (uint32)-Delta) ? 0 : OldSize + Delta;
+	}
+	else if (Decider < 8)
+	{
+		*Size = OldSize * 2;
+	}
+	else
+	{
+		*Size = Fuzzer->GetIntInRange(0, 4096);
+	}
+
+	if (*Size == OldSize)
+	{
+		*Size = OldSize + 1;
+	}
+
+	return true;
+}
+
+bool DxbcMutator::ApplyMutation(FuzzBasicState* Fuzzer, DxbcMutationType Type)
+{
+	switch (Type)
+	{
+	case DxbcMutationType::SwapOperands: return MutateSwapOperands(this, Fuzzer);
+	case DxbcMutationType::FlipSwizzleOrMask: return MutateFlipSwizzleOrMask(this, Fuzzer);
+	case DxbcMutationType::ChangeOpcodeType: return MutateChangeOpcodeType(this, Fuzzer);
+	case DxbcMutationType::DuplicateInstruction: return MutateDuplicateInstruction(this, Fuzzer);
+	case DxbcMutationType::DeleteInstruction: return MutateDeleteInstruction(this, Fuzzer);
+	case DxbcMutationType::PerturbImmediateFloat: return MutatePerturbImmediateFloat(this, Fuzzer);
+	case DxbcMutationType::ResizeDeclaration: return MutateResizeDeclaration(this, Fuzzer);
+	default: ASSERT(false); return false;
+	}
+}
+
+int32 DxbcMutator::Mutate(FuzzBasicState* Fuzzer, int32 NumMutations)
+{
+	Reset();
+
+	int32 NumApplied = 0;
+	for (int32 i = 0; i < NumMutations; i++)
+	{
+		auto Type = (DxbcMutationType)Fuzzer->GetIntInRange(0, (int32)DxbcMutationType::Count - 1);
+		if (ApplyMutation(Fuzzer, Type))
+		{
+			NumApplied++;
+		}
+	}
+
+	return NumApplied;
+}
+
+static uint32 GetCodeTokenCount(const std::vector<DxbcMutatorInstruction>& Instructions)
+{
+	uint32 Count = 0;
+	for (const auto& Instruction : Instructions)
+	{
+		Count += Instruction.Length;
+	}
+
+	return Count;
+}
+
+uint32 DxbcMutator::GetBytecodeSize() const
+{
+	// Chunk header (FourCC + size), then the version and DWORD count tokens
+	uint32 NewChunkSize = 16 + GetCodeTokenCount(Instructions) * 4;
+	return (uint32)Original.size() - (CodeChunkEnd - CodeChunkOffset) + NewChunkSize;
+}
+
+void DxbcMutator::WriteBytecode(byte* OutBuffer, uint32 BufferSize)
+{
+	uint32 CodeTokenCount = GetCodeTokenCount(Instructions);
+	uint32 NewChunkEnd = CodeChunkOffset + 16 + CodeTokenCount * 4;
+	int32 SizeDelta = (int32)NewChunkEnd - (int32)CodeChunkEnd;
+
+	ASSERT(BufferSize == GetBytecodeSize());
+
+	// Everything before the code chunk, with the file size and the offsets of anything after the code chunk moved along
+	memcpy(OutBuffer, Original.data(), CodeChunkOffset);
+	memcpy(OutBuffer + 24, &BufferSize, 4);
+
+	uint32 ChunkCount = 0;
+	memcpy(&ChunkCount, OutBuffer + 28, 4);
+	for (uint32 i = 0; i < ChunkCount; i++)
+	{
+		uint32 ChunkOffset = 0;
+		memcpy(&ChunkOffset, OutBuffer + 32 + i * 4, 4);
+		if (ChunkOffset > CodeChunkOffset)
+		{
+			ChunkOffset += SizeDelta;
+			memcpy(OutBuffer + 32 + i * 4, &ChunkOffset, 4);
+		}
+	}
+
+	// The code chunk itself
+	{
+		uint32 ChunkHeader[4] = { CodeChunkFourCC, 8 + CodeTokenCount * 4, CodeVersionToken, 2 + CodeTokenCount };
+		memcpy(OutBuffer + CodeChunkOffset, ChunkHeader, sizeof(ChunkHeader));
+
+		byte* Cursor = OutBuffer + CodeChunkOffset + sizeof(ChunkHeader);
+		for (const auto& Instruction : Instructions)
+		{
+			memcpy(Cursor, &TokenPool[Instruction.TokenOffset], Instruction.Length * sizeof(uint32));
+			Cursor += Instruction.Length * sizeof(uint32);
+		}
+
+		ASSERT(Cursor == OutBuffer + NewChunkEnd);
+	}
+
+	memcpy(OutBuffer + NewChunkEnd, Original.data() + CodeChunkEnd, Original.size() - CodeChunkEnd);
+
+	// Checksum. Whole blocks of the prefix only depend on SizeDelta, so they usually come from the cache
+	uint32 PrefixBlockBytes = ((CodeChunkOffset - DxbcHashedRegionStart) / 64) * 64;
+
+	DxbcHashContext HashContext;
+	auto Cached = PrefixMidstates.find(SizeDelta);
+	if (Cached != PrefixMidstates.end())
+	{
+		dxbcHashRestore(&HashContext, &Cached->second);
+	}
+	else
+	{
+		dxbcHashInit(&HashContext);
+		dxbcHashUpdate(&HashContext, OutBuffer + DxbcHashedRegionStart, PrefixBlockBytes);
+
+		if (PrefixMidstates.size() >= DXBC_MUTATOR_MAX_PREFIX_MIDSTATES)
+		{
+			PrefixMidstates.clear();
+		}
+
+		DxbcHashMidstate Midstate;
+		ASSERT(dxbcHashSnapshot(&HashContext, &Midstate));
+		PrefixMidstates[SizeDelta] = Midstate;
+	}
+
+	dxbcHashUpdate(&HashContext, OutBuffer + DxbcHashedRegionStart + PrefixBlockBytes, BufferSize - DxbcHashedRegionStart - PrefixBlockBytes);
+	dxbcHashFinal(&HashContext, OutBuffer + 4);
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "basics.h"
+
+#include "fuzz_basic.h"
+
+#include "dxbc_hash.h"
+
+#include <vector>
+#include <unordered_map>
+
+// Mutates existing DXBC containers (e.g. the dxbc_re/*_bytecode.bin files from SpitOutShaderInfo) at the token level,
+// instead of generating new ones from scratch. The container is parsed once, and each mutant starts from that parse,
+// applies a few mutations, and gets written back out with the instruction lengths, SHEX DWORD count, chunk sizes/offsets,
+// file size and checksum all fixed up.
+//
+// Only the shader code chunk is touched, the other chunks are copied as-is (so e.g. resizing a constant buffer
+// declaration won't update RDEF, which is sort of the point)
+
+enum struct DxbcMutationType
+{
+	SwapOperands,
+	FlipSwizzleOrMask,
+	ChangeOpcodeType,
+	DuplicateInstruction,
+	DeleteInstruction,
+	PerturbImmediateFloat,
+	ResizeDeclaration,
+	Count
+};
+
+const char* GetDxbcMutationTypeName(DxbcMutationType Type);
+
+struct DxbcMutatorOperand
+{
+	// In DWORDs, relative to the start of the instruction
+	uint32 Offset = 0;
+	uint32 Length = 0;
+};
+
+struct DxbcMutatorInstruction
+{
+	// Where its tokens are in DxbcMutator::TokenPool, in DWORDs
+	uint32 TokenOffset = 0;
+	uint32 Length = 0;
+	uint32 OpcodeType = 0;
+
+	// DxbcMutator::Operands[FirstOperand, FirstOperand + OperandCount). Empty for declarations and anything we couldn't decode
+	uint32 FirstOperand = 0;
+	uint32 OperandCount = 0;
+
+	bool IsDeclaration = false;
+};
+
+struct DxbcMutator
+{
+	// The container we're mutating, and where its shader code chunk sits in it (in bytes, chunk header included)
+	std::vector<byte> Original;
+	uint32 CodeChunkOffset = 0;
+	uint32 CodeChunkEnd = 0;
+	uint32 CodeChunkFourCC = 0;
+	uint32 CodeVersionToken = 0;
+
+	// The parse of Original, which each mutant starts from
+	std::vector<uint32> OriginalTokens;
+	std::vector<DxbcMutatorInstruction> OriginalInstructions;
+	std::vector<DxbcMutatorOperand> OriginalOperands;
+
+	// The current mutant. Instructions can share tokens (e.g. after a duplicate), so anything that edits
+	// an instruction's tokens gives it its own copy at the end of TokenPool first
+	std::vector<uint32> TokenPool;
+	std::vector<DxbcMutatorInstruction> Instructions;
+	std::vector<DxbcMutatorOperand> Operands;
+
+	// Everything in the hashed part of the container before the shader code chunk only changes with the size of that chunk,
+	// so we keep the hash midstate for it keyed by how much the chunk grew/shrank
+	std::unordered_map<int32, DxbcHashMidstate> PrefixMidstates;
+
+	// Returns false if the container is malformed or has no shader code chunk
+	bool Init(const void* ByteCode, uint32 ByteCodeSize);
+
+	// Throws away any mutations, back to the original
+	void Reset();
+
+	// Returns false (and leaves the mutant alone) if there was nothing to apply it to, e.g. no immediates to perturb
+	bool ApplyMutation(FuzzBasicState* Fuzzer, DxbcMutationType Type);
+
+	// Reset, then apply NumMutations random mutations. Returns how many actually applied
+	int32 Mutate(FuzzBasicState* Fuzzer, int32 NumMutations);
+
+	// Size in bytes of the container WriteBytecode will produce for the current mutant
+	uint32 GetBytecodeSize() const;
+
+	// BufferSize must be exactly GetBytecodeSize()
+	void WriteBytecode(byte* OutBuffer, uint32 BufferSize);
+
+	void WriteBytecode(std::vector<byte>* OutBytecode)
+	{
+		OutBytecode->resize(GetBytecodeSize());
+		WriteBytecode(OutBytecode->data(), (uint32)OutBytecode->size());
+	}
+};
@@ -0,0 +1,245 @@
+#pragma once
+
+#include "basics.h"
+
+// The token format for SM4/5 bytecode (the SHEX/SHDR chunk), shared by everything that reads or writes it
+
+// List adapted from https://github.com/tpn/winsdk-10/blob/master/Include/10.0.16299.0/um/d3d10TokenizedProgramFormat.hpp
+enum D3DOpcodeType
+{
+	D3DOpcodeType_Invalid = -1,
+	D3DOpcodeType_ADD = 0,
+	D3DOpcodeType_AND,
+	D3DOpcodeType_BREAK,
+	D3DOpcodeType_BREAKC,
+	D3DOpcodeType_CALL,
+	D3DOpcodeType_CALLC,
+	D3DOpcodeType_CASE,
+	D3DOpcodeType_CONTINUE,
+	D3DOpcodeType_CONTINUEC,
+	D3DOpcodeType_CUT,
+	D3DOpcodeType_DEFAULT,
+	D3DOpcodeType_DERIV_RTX,
+	D3DOpcodeType_DERIV_RTY,
+	D3DOpcodeType_DISCARD,
+	D3DOpcodeType_DIV,
+	D3DOpcodeType_DP2,
+	D3DOpcodeType_DP3,
+	D3DOpcodeType_DP4,
+	D3DOpcodeType_ELSE,
+	D3DOpcodeType_EMIT,
+	D3DOpcodeType_EMITTHENCUT,
+	D3DOpcodeType_ENDIF,
+	D3DOpcodeType_ENDLOOP,
+	D3DOpcodeType_ENDSWITCH,
+	D3DOpcodeType_EQ,
+	D3DOpcodeType_EXP,
+	D3DOpcodeType_FRC,
+	D3DOpcodeType_FTOI,
+	D3DOpcodeType_FTOU,
+	D3DOpcodeType_GE,
+	D3DOpcodeType_IADD,
+	D3DOpcodeType_IF,
+	D3DOpcodeType_IEQ,
+	D3DOpcodeType_IGE,
+	D3DOpcodeType_ILT,
+	D3DOpcodeType_IMAD,
+	D3DOpcodeType_IMAX,
+	D3DOpcodeType_IMIN,
+	D3DOpcodeType_IMUL,
+	D3DOpcodeType_INE,
+	D3DOpcodeType_INEG,
+	D3DOpcodeType_ISHL,
+	D3DOpcodeType_ISHR,
+	D3DOpcodeType_ITOF,
+	D3DOpcodeType_LABEL,
+	D3DOpcodeType_LD,
+	D3DOpcodeType_LD_MS,
+	D3DOpcodeType_LOG,
+	D3DOpcodeType_LOOP,
+	D3DOpcodeType_LT,
+	D3DOpcodeType_MAD,
+	D3DOpcodeType_MIN,
+	D3DOpcodeType_MAX,
+	D3DOpcodeType_CUSTOMDATA,
+	D3DOpcodeType_MOV,
+	D3DOpcodeType_MOVC,
+	D3DOpcodeType_MUL,
+	D3DOpcodeType_NE,
+	D3DOpcodeType_NOP,
+	D3DOpcodeType_NOT,
+	D3DOpcodeType_OR,
+	D3DOpcodeType_RESINFO,
+	D3DOpcodeType_RET,
+	D3DOpcodeType_RETC,
+	D3DOpcodeType_ROUND_NE,
+	D3DOpcodeType_ROUND_NI,
+	D3DOpcodeType_ROUND_PI,
+	D3DOpcodeType_ROUND_Z,
+	D3DOpcodeType_RSQ,
+	D3DOpcodeType_SAMPLE,
+	D3DOpcodeType_SAMPLE_C,
+	D3DOpcodeType_SAMPLE_C_LZ,
+	D3DOpcodeType_SAMPLE_L,
+	D3DOpcodeType_SAMPLE_D,
+	D3DOpcodeType_SAMPLE_B,
+	D3DOpcodeType_SQRT,
+	D3DOpcodeType_SWITCH,
+	D3DOpcodeType_SINCOS,
+	D3DOpcodeType_UDIV,
+	D3DOpcodeType_ULT,
+	D3DOpcodeType_UGE,
+	D3DOpcodeType_UMUL,
+	D3DOpcodeType_UMAD,
+	D3DOpcodeType_UMAX,
+	D3DOpcodeType_UMIN,
+	D3DOpcodeType_USHR,
+	D3DOpcodeType_UTOF,
+	D3DOpcodeType_XOR,
+	D3DOpcodeType_DCL_RESOURCE,
+	D3DOpcodeType_DCL_CONSTANT_BUFFER,
+	D3DOpcodeType_DCL_SAMPLER,
+	D3DOpcodeType_DCL_INDEX_RANGE,
+	D3DOpcodeType_DCL_GS_OUTPUT_PRIMITIVE_TOPOLOGY,
+	D3DOpcodeType_DCL_GS_INPUT_PRIMITIVE,
+	D3DOpcodeType_DCL_MAX_OUTPUT_VERTEX_COUNT,
+	D3DOpcodeType_DCL_INPUT,
+	D3DOpcodeType_DCL_INPUT_SGV,
+	D3DOpcodeType_DCL_INPUT_SIV,
+	D3DOpcodeType_DCL_INPUT_PS,
+	D3DOpcodeType_DCL_INPUT_PS_SGV,
+	D3DOpcodeType_DCL_INPUT_PS_SIV,
+	D3DOpcodeType_DCL_OUTPUT,
+	D3DOpcodeType_DCL_OUTPUT_SGV,
+	D3DOpcodeType_DCL_OUTPUT_SIV,
+	D3DOpcodeType_DCL_TEMPS,
+	D3DOpcodeType_DCL_INDEXABLE_TEMP,
+	D3DOpcodeType_DCL_GLOBAL_FLAGS,
+	D3DOpcodeType_RESERVED0,
+	D3DOpcodeType_NUM
+};
+
+// SM4.1/SM5 opcodes come after those. We don't generate any of them, these are just the ones the mutator needs so it can
+// tell which are declarations (from d3d11TokenizedProgramFormat.hpp)
+enum D3D11OpcodeType
+{
+	D3D11OpcodeType_HS_DECLS = 113,
+	// dcl_stream through dcl_resource_structured are all declarations, that's dcl_uav_*, dcl_thread_group, dcl_tgsm_* etc.
+	D3D11OpcodeType_DCL_STREAM = 143,
+	D3D11OpcodeType_DCL_RESOURCE_STRUCTURED = 162,
+	D3D11OpcodeType_DCL_GS_INSTANCE_COUNT = 206,
+};
+
+
+enum OperandNumComponents {
+	OperandNumComponents_Zero,
+	OperandNumComponents_One,
+	OperandNumComponents_Four,
+	OperandNumComponents_Count,
+	// There's also N, but apparently not used atm
+};
+
+enum Operand4CompSelection {
+	Operand4CompSelection_Mask,
+	Operand4CompSelection_Swizzle,
+	Operand4CompSelection_Select,
+	Operand4CompSelection_Count,
+};
+
+enum OperandSourceType
+{
+	OperandSourceType_TempRegister,
+	OperandSourceType_InputRegister,
+	OperandSourceType_OutputRegister,
+	OperandSourceType_IndexableTempRegister,
+	OperandSourceType_Immediate32,
+	OperandSourceType_Immediate64,
+	OperandSourceType_Sampler,
+	OperandSourceType_Resource,
+	OperandSourceType_ConstantBuffer,
+	OperandSourceType_ImmediateConstantBuffer,
+	OperandSourceType_Label,
+	OperandSourceType_Count
+};
+
+enum OperandSourceIndexDimension
+{
+	OperandSourceIndexDimension_0D,
+	OperandSourceIndexDimension_1D,
+	OperandSourceIndexDimension_2D,
+	OperandSourceIndexDimension_3D,
+	OperandSourceIndexDimension_Count,
+};
+
+enum OperandSourceIndexRepr
+{
+	OperandSourceIndexRepr_Imm32,
+	OperandSourceIndexRepr_Imm64,
+	OperandSourceIndexRepr_Relative,
+	OperandSourceIndexRepr_RelativePlusImm32,
+	OperandSourceIndexRepr_RelativePlusImm64,
+	OperandSourceIndexRepr_Count,
+};
+
+// TODO: There are a lot more, but we're ignoring those for now
+enum OperandSemantic
+{
+	OperandSemantic_Undefined,
+	OperandSemantic_Position,
+	OperandSemantic_Count,
+};
+
+enum SamplerMode {
+	SamplerMode_Default,
+	SamplerMode_Comparison,
+	SamplerMode_Mono
+};
+
+enum ResourceDimension {
+	ResourceDimension_Unknown,
+	ResourceDimension_Buffer,
+	ResourceDimension_Texture1D,
+	ResourceDimension_Texture2D,
+	ResourceDimension_Texture2D_MultiSample,
+	ResourceDimension_Texture3D,
+	ResourceDimension_TextureCube,
+	ResourceDimension_Texture1DArray,
+	ResourceDimension_Texture2DArray,
+	ResourceDimension_Texture2DArray_MultiSample,
+	ResourceDimension_TextureCubeArray,
+	ResourceDimension_RawBuffer,
+	ResourceDimension_StructuredBuffer,
+};
+
+enum ResourceReturnType {
+	ResourceReturnType_NA,
+	ResourceReturnType_Unorm,
+	ResourceReturnType_Snorm,
+	ResourceReturnType_SInt,
+	ResourceReturnType_UInt,
+	ResourceReturnType_Float,
+	ResourceReturnType_Mixed,
+	ResourceReturnType_Double,
+	ResourceReturnType_Continued,
+};
+
+enum OpcodeExtensionType
+{
+	OpcodeExtensionType_None,
+	OpcodeExtensionType_SampleControls,
+	OpcodeExtensionType_ResourceDim,
+	OpcodeExtensionType_ResourceReturnType
+};
+
+enum PSInputInterpolationMode
+{
+	PSInputInterpolationMode_Undefined,
+	PSInputInterpolationMode_Constant,
+	PSInputInterpolationMode_Linear,
+	PSInputInterpolationMode_LinearCentroid,
+	PSInputInterpolationMode_LinearNoPerspective,
+	PSInputInterpolationMode_LinearNoPerspectiveCentroid,
+	PSInputInterpolationMode_LinearSample,
+	PSInputInterpolationMode_LinearNoPerspectiveSample,
+	PSInputInterpolationMode_Count
+};
@@ -0,0 +1,174 @@
+#include "dxbc_reflect.h"
+
+#include "dxbc_view.h"
+
+#include <mutex>
+#include <unordered_map>
+
+// RDEF resource binding types, same values as D3D_SHADER_INPUT_TYPE
+#define DXBC_RESOURCE_TYPE_CBUFFER 0
+#define DXBC_RESOURCE_TYPE_TEXTURE 2
+#define DXBC_RESOURCE_TYPE_SAMPLER 3
+
+// A full corpus can have a lot of unique shaders, so once we hit this we just start over
+#define DXBC_REFLECT_CACHE_MAX_ENTRIES (16 * 1024)
+
+struct DXBCChecksum
+{
+	byte Bytes[16] = {};
+
+	bool operator==(const DXBCChecksum& Other) const
+	{
+		return memcmp(Bytes, Other.Bytes, sizeof(Bytes)) == 0;
+	}
+};
+
+struct DXBCChecksumHasher
+{
+	size_t operator()(const DXBCChecksum& Checksum) const
+	{
+		// It's already a hash, so any 8 bytes of it will do
+		uint64 Val = 0;
+		memcpy(&Val, Checksum.Bytes, sizeof(Val));
+		return (size_t)Val;
+	}
+};
+
+struct DXBCReflectionCache
+{
+	std::mutex Mutex;
+	std::unordered_map<DXBCChecksum, ShaderMetadata, DXBCChecksumHasher> Entries;
+};
+
+static DXBCReflectionCache* GetReflectionCache()
+{
+	static DXBCReflectionCache Cache;
+	return &Cache;
+}
+
+static bool ReflectDXBCViewIntoShaderMetadata(const DxbcView& View, ShaderMetadata* OutMetadata)
+{
+	*OutMetadata = ShaderMetadata();
+
+	DxbcSignatureView InputSignature;
+	if (View.GetInputSignature(&InputSignature))
+	{
+		if (InputSignature.ElementCount >= MAX_INPUT_PARAM_COUNT)
+		{
+			return false;
+		}
+
+		for (uint32 i = 0; i < InputSignature.ElementCount; i++)
+		{
+			DxbcSignatureElement Element;
+			if (!InputSignature.GetElement(i, &Element))
+			{
+				return false;
+			}
+
+			ShaderInputParamMetadata ParamMeta = {};
+			if (!TryGetSemanticFromSemanticName(Element.SemanticName, &ParamMeta.Semantic))
+			{
+				return false;
+			}
+			ParamMeta.ParamIndex = Element.Register;
+
+			OutMetadata->InputParamMetadata[OutMetadata->NumParams] = ParamMeta;
+			OutMetadata->NumParams++;
+		}
+	}
+
+	DxbcRDEFView RDEF;
+	if (View.GetRDEF(&RDEF))
+	{
+		if (RDEF.ResourceCount >= MAX_BOUND_RESOURCES)
+		{
+			return false;
+		}
+
+		for (uint32 i = 0; i < RDEF.ResourceCount; i++)
+		{
+			DxbcRDEFResourceBinding Binding;
+			if (!RDEF.GetResourceBinding(i, &Binding))
+			{
+				return false;
+			}
+
+			if (Binding.Type == DXBC_RESOURCE_TYPE_TEXTURE)
+			{
+				OutMetadata->NumSRVs++;
+			}
+			else if (Binding.Type == DXBC_RESOURCE_TYPE_SAMPLER)
+			{
+				OutMetadata->NumStaticSamplers++;
+			}
+			else if (Binding.Type == DXBC_RESOURCE_TYPE_CBUFFER)
+			{
+				OutMetadata->NumCBVs++;
+			}
+		}
+
+		// Same as the D3DReflect path: the number of CBVs comes from the bindings, but the sizes come from the buffer descs
+		if (OutMetadata->NumCBVs > MAX_CBV_COUNT || (uint32)OutMetadata->NumCBVs > RDEF.ConstantBufferCount)
+		{
+			return false;
+		}
+
+		for (int32 CBVIndex = 0; CBVIndex < OutMetadata->NumCBVs; CBVIndex++)
+		{
+			DxbcRDEFConstantBuffer ConstantBuffer;
+			if (!RDEF.GetConstantBuffer(CBVIndex, &ConstantBuffer))
+			{
+				return false;
+			}
+
+			OutMetadata->CBVSizes[CBVIndex] = ConstantBuffer.Size;
+		}
+	}
+
+	return true;
+}
+
+bool ReflectDXBCIntoShaderMetadata(const void* ByteCode, uint32 ByteCodeSize, ShaderMetadata* OutMetadata)
+{
+	DxbcView View;
+	if (!View.Init(ByteCode, ByteCodeSize))
+	{
+		return false;
+	}
+
+	DXBCChecksum Checksum;
+	memcpy(Checksum.Bytes, View.GetChecksum(), sizeof(Checksum.Bytes));
+
+	DXBCReflectionCache* Cache = GetReflectionCache();
+
+	{
+		std::lock_guard<std::mutex> Lock(Cache->Mutex);
+		auto Iter = Cache->Entries.find(Checksum);
+		if (Iter != Cache->Entries.end())
+		{
+			*OutMetadata = Iter->second;
+			return true;
+		}
+	}
+
+	// Do the actual parsing outside the lock, worst case two threads both reflect the same shader
+	ShaderMetadata Metadata;
+	if (!ReflectDXBCViewIntoShaderMetadata(View, &Metadata))
+	{
+		return false;
+	}
+
+	{
+		std::lock_guard<std::mutex> Lock(Cache->Mutex);
+		if (Cache->Entries.size() >= DXBC_REFLECT_CACHE_MAX_ENTRIES)
+		{
+			Cache->Entries.clear();
+		}
+
+		Cache->Entries[Checksum] = Metadata;
+	}
+
+	*OutMetadata = Metadata;
+	return true;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "basics.h"
+
+#include "shader_meta.h"
+
+// Fills in ShaderMetadata straight from the RDEF and ISGN chunks, without going through D3DReflect,
+// so it works anywhere. Gives the same results as ReflectShaderIntoShaderMetadata for valid bytecode,
+// returns false if the container is malformed or uses semantics we don't know about.
+//
+// Results are memoized by the checksum stored in the container header, so it's meant for
+// bytecode whose checksum is valid (anything D3D would accept anyway)
+bool ReflectDXBCIntoShaderMetadata(const void* ByteCode, uint32 ByteCodeSize, ShaderMetadata* OutMetadata);
@@ -0,0 +1,453 @@
+#include "dxbc_view.h"
+
+// Same layout as DXBCFileHeader in fuzz_dxbc.cpp
+static const uint32 DxbcHeaderSize = 32;
+static const uint32 DxbcCustomDataOpcode = 53;
+
+static bool ReadU32(const byte* Base, uint32 Size, uint32 Offset, uint32* OutValue)
+{
+	if (Offset > Size || Size - Offset < 4)
+	{
+		return false;
+	}
+
+	memcpy(OutValue, Base + Offset, 4);
+	return true;
+}
+
+static bool ReadU32(const DxbcChunk& Chunk, uint32 Offset, uint32* OutValue)
+{
+	return ReadU32(Chunk.Data, Chunk.Size, Offset, OutValue);
+}
+
+// Strings are stored as offsets from the start of the chunk data, only hand one back
+// if it's actually null-terminated before the chunk ends
+static const char* ReadString(const DxbcChunk& Chunk, uint32 Offset)
+{
+	if (Offset >= Chunk.Size)
+	{
+		return nullptr;
+	}
+
+	const void* Terminator = memchr(Chunk.Data + Offset, '\0', Chunk.Size - Offset);
+	return (Terminator != nullptr) ? (const char*)(Chunk.Data + Offset) : nullptr;
+}
+
+// Checks there's room for Count entries of Stride bytes, starting at Offset
+static bool IsArrayInBounds(const DxbcChunk& Chunk, uint32 Offset, uint32 Count, uint32 Stride)
+{
+	if (Offset > Chunk.Size)
+	{
+		return false;
+	}
+
+	return (uint64)Count * Stride <= (uint64)(Chunk.Size - Offset);
+}
+
+static int32 GetKnownChunkIndex(uint32 FourCC)
+{
+	switch (FourCC)
+	{
+	case DXBC_FOURCC('R', 'D', 'E', 'F'): return (int32)DxbcChunkKind::RDEF;
+	case DXBC_FOURCC('I', 'S', 'G', 'N'): return (int32)DxbcChunkKind::ISGN;
+	case DXBC_FOURCC('O', 'S', 'G', 'N'): return (int32)DxbcChunkKind::OSGN;
+	// SM4 uses SHDR, SM5 uses SHEX, but they're the same format
+	case DXBC_FOURCC('S', 'H', 'E', 'X'): return (int32)DxbcChunkKind::SHEX;
+	case DXBC_FOURCC('S', 'H', 'D', 'R'): return (int32)DxbcChunkKind::SHEX;
+	case DXBC_FOURCC('S', 'T', 'A', 'T'): return (int32)DxbcChunkKind::STAT;
+	default: return -1;
+	}
+}
+
+bool DxbcInstructionIterator::Next(DxbcInstruction* OutInstruction)
+{
+	if (HasError || Cursor >= End)
+	{
+		return false;
+	}
+
+	uint32 Remaining = (uint32)(End - Cursor) / 4;
+	if (Remaining == 0)
+	{
+		HasError = true;
+		return false;
+	}
+
+	uint32 OpcodeToken = 0;
+	memcpy(&OpcodeToken, Cursor, 4);
+
+	uint32 OpcodeType = OpcodeToken & 0x7FF;
+	uint32 Length = (OpcodeToken >> 24) & 0x7F;
+
+	// Custom data blocks (e.g. immediate constant buffers) keep their length in the next DWORD instead
+	if (OpcodeType == DxbcCustomDataOpcode)
+	{
+		if (Remaining < 2)
+		{
+			HasError = true;
+			return false;
+		}
+
+		memcpy(&Length, Cursor + 4, 4);
+	}
+
+	if (Length == 0 || Length > Remaining)
+	{
+		HasError = true;
+		return false;
+	}
+
+	OutInstruction->Tokens = (const uint32*)Cursor;
+	OutInstruction->Length = Length;
+	OutInstruction->OpcodeType = OpcodeType;
+
+	Cursor += Length * 4;
+	return true;
+}
+
+bool DxbcRDEFView::GetConstantBuffer(uint32 Index, DxbcRDEFConstantBuffer* OutBuffer) const
+{
+	if (Index >= ConstantBufferCount)
+	{
+		return false;
+	}
+
+	uint32 Offset = ConstantBufferOffset + Index * 24;
+
+	uint32 NameOffset = 0;
+	bool Success = ReadU32(Chunk, Offset + 0, &NameOffset)
+		&& ReadU32(Chunk, Offset + 4, &OutBuffer->VariableCount)
+		&& ReadU32(Chunk, Offset + 8, &OutBuffer->VariableDescOffset)
+		&& ReadU32(Chunk, Offset + 12, &OutBuffer->Size)
+		&& ReadU32(Chunk, Offset + 16, &OutBuffer->Flags)
+		&& ReadU32(Chunk, Offset + 20, &OutBuffer->Type);
+
+	if (!Success || !IsArrayInBounds(Chunk, OutBuffer->VariableDescOffset, OutBuffer->VariableCount, VariableDescStride))
+	{
+		return false;
+	}
+
+	OutBuffer->Name = ReadString(Chunk, NameOffset);
+	return OutBuffer->Name != nullptr;
+}
+
+bool DxbcRDEFView::GetVariable(const DxbcRDEFConstantBuffer& Buffer, uint32 Index, DxbcRDEFVariable* OutVariable) const
+{
+	if (Index >= Buffer.VariableCount)
+	{
+		return false;
+	}
+
+	uint32 Offset = Buffer.VariableDescOffset + Index * VariableDescStride;
+
+	uint32 NameOffset = 0;
+	bool Success = ReadU32(Chunk, Offset + 0, &NameOffset)
+		&& ReadU32(Chunk, Offset + 4, &OutVariable->StartOffset)
+		&& ReadU32(Chunk, Offset + 8, &OutVariable->Size)
+		&& ReadU32(Chunk, Offset + 12, &OutVariable->Flags)
+		&& ReadU32(Chunk, Offset + 16, &OutVariable->TypeOffset);
+
+	if (!Success)
+	{
+		return false;
+	}
+
+	OutVariable->Name = ReadString(Chunk, NameOffset);
+	return OutVariable->Name != nullptr;
+}
+
+bool DxbcRDEFView::GetResourceBinding(uint32 Index, DxbcRDEFResourceBinding* OutBinding) const
+{
+	if (Index >= ResourceCount)
+	{
+		return false;
+	}
+
+	uint32 Offset = ResourceOffset + Index * 32;
+
+	uint32 NameOffset = 0;
+	bool Success = ReadU32(Chunk, Offset + 0, &NameOffset)
+		&& ReadU32(Chunk, Offset + 4, &OutBinding->Type)
+		&& ReadU32(Chunk, Offset + 8, &OutBinding->ReturnType)
+		&& ReadU32(Chunk, Offset + 12, &OutBinding->ViewDimension)
+		&& ReadU32(Chunk, Offset + 16, &OutBinding->NumSamples)
+		&& ReadU32(Chunk, Offset + 20, &OutBinding->BindPoint)
+		&& ReadU32(Chunk, Offset + 24, &OutBinding->BindCount)
+		&& ReadU32(Chunk, Offset + 28, &OutBinding->Flags);
+
+	if (!Success)
+	{
+		return false;
+	}
+
+	OutBinding->Name = ReadString(Chunk, NameOffset);
+	return OutBinding->Name != nullptr;
+}
+
+bool DxbcSignatureView::GetElement(uint32 Index, DxbcSignatureElement* OutElement) const
+{
+	if (Index >= ElementCount)
+	{
+		return false;
+	}
+
+	// 8 bytes of header (count + unknown), then 24 bytes per element
+	uint32 Offset = 8 + Index * 24;
+
+	uint32 NameOffset = 0;
+	uint32 MaskDWORD = 0;
+	bool Success = ReadU32(Chunk, Offset + 0, &NameOffset)
+		&& ReadU32(Chunk, Offset + 4, &OutElement->SemanticIndex)
+		&& ReadU32(Chunk, Offset + 8, &OutElement->SystemValueType)
+		&& ReadU32(Chunk, Offset + 12, &OutElement->ComponentType)
+		&& ReadU32(Chunk, Offset + 16, &OutElement->Register)
+		&& ReadU32(Chunk, Offset + 20, &MaskDWORD);
+
+	if (!Success)
+	{
+		return false;
+	}
+
+	OutElement->Mask = (byte)(MaskDWORD & 0xFF);
+	OutElement->RWMask = (byte)((MaskDWORD >> 8) & 0xFF);
+
+	OutElement->SemanticName = ReadString(Chunk, NameOffset);
+	return OutElement->SemanticName != nullptr;
+}
+
+DxbcInstructionIterator DxbcShaderCodeView::GetInstructions() const
+{
+	DxbcInstructionIterator Iter;
+	// The version/type DWORD and the length DWORD count towards NumDWORDs, Init already checked it fits
+	Iter.Cursor = Chunk.Data + 8;
+	Iter.End = Chunk.Data + NumDWORDs * 4;
+	return Iter;
+}
+
+bool DxbcView::Init(const void* InData, uint32 InLength)
+{
+	*this = DxbcView();
+
+	if (InData == nullptr || InLength < DxbcHeaderSize)
+	{
+		return false;
+	}
+
+	const byte* Bytes = (const byte*)InData;
+	if (memcmp(Bytes, "DXBC", 4) != 0)
+	{
+		return false;
+	}
+
+	uint32 FileSize = 0;
+	uint32 NumChunks = 0;
+	ReadU32(Bytes, InLength, 24, &FileSize);
+	ReadU32(Bytes, InLength, 28, &NumChunks);
+
+	if (FileSize != InLength)
+	{
+		return false;
+	}
+
+	if ((uint64)NumChunks * 4 > InLength - DxbcHeaderSize)
+	{
+		return false;
+	}
+
+	Data = Bytes;
+	Length = InLength;
+	ChunkCount = NumChunks;
+	ChunkOffsetTable = Bytes + DxbcHeaderSize;
+
+	for (uint32 i = 0; i < ChunkCount; i++)
+	{
+		DxbcChunk Chunk;
+		if (!GetChunk(i, &Chunk))
+		{
+			*this = DxbcView();
+			return false;
+		}
+
+		// If there's more than one of a kind, the first one wins (same as FindChunk)
+		int32 KnownIndex = GetKnownChunkIndex(Chunk.FourCC);
+		if (KnownIndex >= 0 && !KnownChunks[KnownIndex].IsValid())
+		{
+			KnownChunks[KnownIndex] = Chunk;
+		}
+	}
+
+	return true;
+}
+
+bool DxbcView::GetChunk(uint32 Index, DxbcChunk* OutChunk) const
+{
+	if (Index >= ChunkCount)
+	{
+		return false;
+	}
+
+	uint32 ChunkOffset = 0;
+	memcpy(&ChunkOffset, ChunkOffsetTable + Index * 4, 4);
+
+	// Checked up front so ChunkOffset + 8 can't wrap around
+	if (ChunkOffset > Length - 8)
+	{
+		return false;
+	}
+
+	uint32 FourCC = 0;
+	uint32 ChunkSize = 0;
+	ReadU32(Data, Length, ChunkOffset, &FourCC);
+	ReadU32(Data, Length, ChunkOffset + 4, &ChunkSize);
+
+	uint32 DataOffset = ChunkOffset + 8;
+	if (ChunkSize > Length - DataOffset)
+	{
+		return false;
+	}
+
+	OutChunk->FourCC = FourCC;
+	OutChunk->Data = Data + DataOffset;
+	OutChunk->Size = ChunkSize;
+	return true;
+}
+
+DxbcChunk DxbcView::FindChunk(uint32 FourCC) const
+{
+	int32 KnownIndex = GetKnownChunkIndex(FourCC);
+	if (KnownIndex >= 0)
+	{
+		return KnownChunks[KnownIndex];
+	}
+
+	for (uint32 i = 0; i < ChunkCount; i++)
+	{
+		DxbcChunk Chunk;
+		if (GetChunk(i, &Chunk) && Chunk.FourCC == FourCC)
+		{
+			return Chunk;
+		}
+	}
+
+	return DxbcChunk();
+}
+
+bool DxbcView::GetRDEF(DxbcRDEFView* OutView) const
+{
+	const DxbcChunk& Chunk = KnownChunks[(int32)DxbcChunkKind::RDEF];
+	if (!Chunk.IsValid())
+	{
+		return false;
+	}
+
+	DxbcRDEFView View;
+	View.Chunk = Chunk;
+
+	uint32 VersionDWORD = 0;
+	uint32 CreatorOffset = 0;
+	bool Success = ReadU32(Chunk, 0, &View.ConstantBufferCount)
+		&& ReadU32(Chunk, 4, &View.ConstantBufferOffset)
+		&& ReadU32(Chunk, 8, &View.ResourceCount)
+		&& ReadU32(Chunk, 12, &View.ResourceOffset)
+		&& ReadU32(Chunk, 16, &VersionDWORD)
+		&& ReadU32(Chunk, 20, &View.Flags)
+		&& ReadU32(Chunk, 24, &CreatorOffset);
+
+	if (!Success)
+	{
+		return false;
+	}
+
+	View.MinorVersion = VersionDWORD & 0xFF;
+	View.MajorVersion = (VersionDWORD >> 8) & 0xFF;
+	View.ProgramType = VersionDWORD >> 16;
+
+	uint32 RD11Magic = 0;
+	if (ReadU32(Chunk, 28, &RD11Magic) && RD11Magic == DXBC_FOURCC('R', 'D', '1', '1'))
+	{
+		View.VariableDescStride = 40;
+	}
+
+	if (!IsArrayInBounds(Chunk, View.ConstantBufferOffset, View.ConstantBufferCount, 24)
+		|| !IsArrayInBounds(Chunk, View.ResourceOffset, View.ResourceCount, 32))
+	{
+		return false;
+	}
+
+	// Not having a creator string is odd, but not worth failing over
+	View.Creator = ReadString(Chunk, CreatorOffset);
+
+	*OutView = View;
+	return true;
+}
+
+static bool GetSignatureFromChunk(const DxbcChunk& Chunk, DxbcSignatureView* OutView)
+{
+	if (!Chunk.IsValid())
+	{
+		return false;
+	}
+
+	DxbcSignatureView View;
+	View.Chunk = Chunk;
+
+	if (!ReadU32(Chunk, 0, &View.ElementCount) || !IsArrayInBounds(Chunk, 8, View.ElementCount, 24))
+	{
+		return false;
+	}
+
+	*OutView = View;
+	return true;
+}
+
+bool DxbcView::GetInputSignature(DxbcSignatureView* OutView) const
+{
+	return GetSignatureFromChunk(KnownChunks[(int32)DxbcChunkKind::ISGN], OutView);
+}
+
+bool DxbcView::GetOutputSignature(DxbcSignatureView* OutView) const
+{
+	return GetSignatureFromChunk(KnownChunks[(int32)DxbcChunkKind::OSGN], OutView);
+}
+
+bool DxbcView::GetShaderCode(DxbcShaderCodeView* OutView) const
+{
+	const DxbcChunk& Chunk = KnownChunks[(int32)DxbcChunkKind::SHEX];
+	if (!Chunk.IsValid())
+	{
+		return false;
+	}
+
+	DxbcShaderCodeView View;
+	View.Chunk = Chunk;
+
+	uint32 VersionDWORD = 0;
+	if (!ReadU32(Chunk, 0, &VersionDWORD) || !ReadU32(Chunk, 4, &View.NumDWORDs))
+	{
+		return false;
+	}
+
+	View.MinorVersion = VersionDWORD & 0xF;
+	View.MajorVersion = (VersionDWORD >> 4) & 0xF;
+	View.ProgramType = VersionDWORD >> 16;
+
+	if (View.NumDWORDs < 2 || (uint64)View.NumDWORDs * 4 > Chunk.Size)
+	{
+		return false;
+	}
+
+	*OutView = View;
+	return true;
+}
+
+bool DxbcView::GetStats(DxbcChunk* OutChunk) const
+{
+	const DxbcChunk& Chunk = KnownChunks[(int32)DxbcChunkKind::STAT];
+	if (!Chunk.IsValid())
+	{
+		return false;
+	}
+
+	*OutChunk = Chunk;
+	return true;
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "basics.h"
+
+// A read-only view over a DXBC container. Nothing is copied, and every read is checked
+// against the length we were given, so it's safe to point at fuzzed/corrupted data:
+// anything malformed just makes the relevant call return false.
+
+#define DXBC_FOURCC(a, b, c, d) ((uint32)(a) | ((uint32)(b) << 8) | ((uint32)(c) << 16) | ((uint32)(d) << 24))
+
+enum struct DxbcChunkKind
+{
+	RDEF,
+	ISGN,
+	OSGN,
+	SHEX,
+	STAT,
+	Count
+};
+
+struct DxbcChunk
+{
+	uint32 FourCC = 0;
+	const byte* Data = nullptr;
+	uint32 Size = 0;
+
+	bool IsValid() const { return Data != nullptr; }
+};
+
+struct DxbcInstruction
+{
+	const uint32* Tokens = nullptr;
+	// In DWORDs, including the opcode token itself
+	uint32 Length = 0;
+	uint32 OpcodeType = 0;
+};
+
+struct DxbcInstructionIterator
+{
+	const byte* Cursor = nullptr;
+	const byte* End = nullptr;
+	bool HasError = false;
+
+	// Returns false once we run out of instructions, or hit one that doesn't fit
+	// (in which case HasError is set)
+	bool Next(DxbcInstruction* OutInstruction);
+};
+
+struct DxbcRDEFConstantBuffer
+{
+	const char* Name = nullptr;
+	uint32 VariableCount = 0;
+	uint32 VariableDescOffset = 0;
+	uint32 Size = 0;
+	uint32 Flags = 0;
+	uint32 Type = 0;
+};
+
+struct DxbcRDEFVariable
+{
+	const char* Name = nullptr;
+	uint32 StartOffset = 0;
+	uint32 Size = 0;
+	uint32 Flags = 0;
+	uint32 TypeOffset = 0;
+};
+
+struct DxbcRDEFResourceBinding
+{
+	const char* Name = nullptr;
+	// 0 = cbuffer, 2 = texture, 3 = sampler
+	uint32 Type = 0;
+	uint32 ReturnType = 0;
+	uint32 ViewDimension = 0;
+	uint32 NumSamples = 0;
+	uint32 BindPoint = 0;
+	uint32 BindCount = 0;
+	uint32 Flags = 0;
+};
+
+struct DxbcRDEFView
+{
+	DxbcChunk Chunk;
+	uint32 ConstantBufferCount = 0;
+	uint32 ConstantBufferOffset = 0;
+	uint32 ResourceCount = 0;
+	uint32 ResourceOffset = 0;
+	uint32 MinorVersion = 0;
+	uint32 MajorVersion = 0;
+	uint32 ProgramType = 0;
+	uint32 Flags = 0;
+	const char* Creator = nullptr;
+	// 40 bytes for RD11 (SM5), 24 before that
+	uint32 VariableDescStride = 24;
+
+	bool GetConstantBuffer(uint32 Index, DxbcRDEFConstantBuffer* OutBuffer) const;
+	bool GetVariable(const DxbcRDEFConstantBuffer& Buffer, uint32 Index, DxbcRDEFVariable* OutVariable) const;
+	bool GetResourceBinding(uint32 Index, DxbcRDEFResourceBinding* OutBinding) const;
+};
+
+struct DxbcSignatureElement
+{
+	const char* SemanticName = nullptr;
+	uint32 SemanticIndex = 0;
+	uint32 SystemValueType = 0;
+	uint32 ComponentType = 0;
+	uint32 Register = 0;
+	byte Mask = 0;
+	byte RWMask = 0;
+};
+
+struct DxbcSignatureView
+{
+	DxbcChunk Chunk;
+	uint32 ElementCount = 0;
+
+	bool GetElement(uint32 Index, DxbcSignatureElement* OutElement) const;
+};
+
+struct DxbcShaderCodeView
+{
+	DxbcChunk Chunk;
+	uint32 MajorVersion = 0;
+	uint32 MinorVersion = 0;
+	uint32 ProgramType = 0;
+	uint32 NumDWORDs = 0;
+
+	DxbcInstructionIterator GetInstructions() const;
+};
+
+struct DxbcView
+{
+	const byte* Data = nullptr;
+	uint32 Length = 0;
+	uint32 ChunkCount = 0;
+	const byte* ChunkOffsetTable = nullptr;
+
+	// Filled in by Init, so looking up one of the common chunks doesn't walk the table
+	DxbcChunk KnownChunks[(int32)DxbcChunkKind::Count];
+
+	// Checks the header and chunk table, returns false if they don't make sense
+	bool Init(const void* InData, uint32 InLength);
+
+	bool GetChunk(uint32 Index, DxbcChunk* OutChunk) const;
+	DxbcChunk FindChunk(uint32 FourCC) const;
+	DxbcChunk GetChunk(DxbcChunkKind Kind) const { return KnownChunks[(int32)Kind]; }
+
+	const byte* GetChecksum() const { return Data + 4; }
+
+	// These only decode the chunk header when called, the rest is read on demand through the views
+	bool GetRDEF(DxbcRDEFView* OutView) const;
+	bool GetInputSignature(DxbcSignatureView* OutView) const;
+	bool GetOutputSignature(DxbcSignatureView* OutView) const;
+	bool GetShaderCode(DxbcShaderCodeView* OutView) const;
+	bool GetStats(DxbcChunk* OutChunk) const;
+};
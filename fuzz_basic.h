@@ -1,29 +1,104 @@
-
 #pragma once
 
 #include <random>
 
 #include "basics.h"
 
+// Set to 1 to go back to std::mt19937_64 + the std distributions, which is what we used before.
+// Seeds logged from builds before that changed only reproduce with this on
+#ifndef FUZZ_RNG_LEGACY_MT19937
+#define FUZZ_RNG_LEGACY_MT19937 0
+#endif
+
+// xoshiro256** (Blackman/Vigna). 32 bytes of state, and seeding is just four splitmix64 steps,
+// vs. ~2.5KB of state and a few hundred steps to seed for mt19937_64. We seed a new fuzzer for every case, so that adds up
+struct FuzzRNGXoshiro256
+{
+	using result_type = uint64;
+
+	uint64 State[4] = { 0x9E3779B97F4A7C15LLU, 0xBF58476D1CE4E5B9LLU, 0x94D049BB133111EBLLU, 0x2545F4914F6CDD1DLLU };
+
+	static uint64 SplitMix64(uint64* InOutState)
+	{
+		uint64 Z = (*InOutState += 0x9E3779B97F4A7C15LLU);
+		Z = (Z ^ (Z >> 30)) * 0xBF58476D1CE4E5B9LLU;
+		Z = (Z ^ (Z >> 27)) * 0x94D049BB133111EBLLU;
+		return Z ^ (Z >> 31);
+	}
+
+	static uint64 RotateLeft(uint64 X, int32 K)
+	{
+		return (X << K) | (X >> (64 - K));
+	}
+
+	// Every seed gives a different (and never all zero) state
+	void seed(uint64 Seed)
+	{
+		uint64 SplitMixState = Seed;
+		State[0] = SplitMix64(&SplitMixState);
+		State[1] = SplitMix64(&SplitMixState);
+		State[2] = SplitMix64(&SplitMixState);
+		State[3] = SplitMix64(&SplitMixState);
+	}
+
+	uint64 operator()()
+	{
+		const uint64 Result = RotateLeft(State[1] * 5, 7) * 9;
+		const uint64 T = State[1] << 17;
+
+		State[2] ^= State[0];
+		State[3] ^= State[1];
+		State[1] ^= State[2];
+		State[0] ^= State[3];
+
+		State[2] ^= T;
+		State[3] = RotateLeft(State[3], 45);
+
+		return Result;
+	}
+
+	// So it can be used with the std distributions/algorithms too
+	static constexpr uint64 min() { return 0; }
+	static constexpr uint64 max() { return ~0LLU; }
+};
+
+#if FUZZ_RNG_LEGACY_MT19937
+using FuzzRNGEngine = std::mt19937_64;
+#else
+using FuzzRNGEngine = FuzzRNGXoshiro256;
+#endif
+
+struct FuzzDecisionTape;
 
 struct FuzzBasicState {
-	std::mt19937_64 RNGState;
+	FuzzRNGEngine RNGState;
 
 	uint64 InitialFuzzSeed = 0;
 
+	// Both normally null. If RecordTape is set, every draw gets added to it, and if ReplayTape is set the draws come
+	// from it instead of RNGState (see fuzz_decision_tape.h)
+	FuzzDecisionTape* RecordTape = nullptr;
+	FuzzDecisionTape* ReplayTape = nullptr;
+
 	// NOTE: It's inclusive
 	int GetIntInRange(int min, int max)
 	{
-		std::uniform_int_distribution<int> Dist(min, max);
+		if (RecordTape != nullptr || ReplayTape != nullptr)
+		{
+			return GetIntInRangeWithTape(min, max);
+		}
 
-		return Dist(RNGState);
+		return DrawIntInRange(min, max);
 	}
 
 	float GetFloatInRange(float min, float max)
 	{
-		std::uniform_real_distribution<float> Dist(min, max);
+		if (RecordTape != nullptr || ReplayTape != nullptr)
+		{
+			return GetFloatInRangeWithTape(min, max);
+		}
 
-		return Dist(RNGState);
+		return DrawFloatInRange(min, max);
 	}
 
 	float GetFloat01()
@@ -39,19 +114,248 @@ struct FuzzBasicState {
 
 	uint64 GetSubSeed()
 	{
+		if (RecordTape != nullptr || ReplayTape != nullptr)
+		{
+			return GetSubSeedWithTape();
+		}
+
 		return RNGState();
 	}
+
+	// Straight from RNGState, no tapes
+	int DrawIntInRange(int min, int max)
+	{
+#if FUZZ_RNG_LEGACY_MT19937
+		std::uniform_int_distribution<int> Dist(min, max);
+
+		return Dist(RNGState);
+#else
+		// Lemire's multiply-shift, with the rejection so it's unbiased. The rejection is rare (at most Range/2^32 of the time),
+		// and the modulo only happens when the cheap check says it might need to
+		const uint64 Range = (uint64)(uint32)(max - min) + 1;
+		uint64 Product = (RNGState() >> 32) * Range;
+		uint32 Low = (uint32)Product;
+		if (Low < Range)
+		{
+			const uint32 Threshold = (uint32)((0x100000000LLU - Range) % Range);
+			while (Low < Threshold)
+			{
+				Product = (RNGState() >> 32) * Range;
+				Low = (uint32)Product;
+			}
+		}
+
+		return (int)((uint32)min + (uint32)(Product >> 32));
+#endif
+	}
+
+	float DrawFloatInRange(float min, float max)
+	{
+#if FUZZ_RNG_LEGACY_MT19937
+		std::uniform_real_distribution<float> Dist(min, max);
+
+		return Dist(RNGState);
+#else
+		// Top 24 bits -> [0, 1), exactly representable as a float
+		const float Unit = (float)(RNGState() >> 40) * (1.0f / 16777216.0f);
+		const float Result = min + Unit * (max - min);
+
+		// Rounding can land us on max, which uniform_real_distribution never returns
+		return (Result < max) ? Result : min;
+#endif
+	}
+
+	// In fuzz_decision_tape.cpp, kept out of line since they're only for recording/replaying
+	int GetIntInRangeWithTape(int min, int max);
+	float GetFloatInRangeWithTape(float min, float max);
+	uint64 GetSubSeedWithTape();
+	bool IsReplayTapeUsedUp() const;
+
+	// Whether we're replaying and have used up the tape, so every draw from here on is its smallest choice.
+	// Generators that recurse on small choices can check this so they don't end up as big as they can go
+	bool IsPastEndOfReplayTape() const
+	{
+		return ReplayTape != nullptr && IsReplayTapeUsedUp();
+	}
 };
 
 
-inline void SetRandomBytes(FuzzBasicState* Fuzzer, void* Buffer, int32 Size)
+// Two xoshiro256** streams interleaved, for filling big buffers. It's plain scalar code, not SIMD: the lanes just
+// don't depend on each other, so the CPU can overlap their dependency chains where a single stream would stall on its own
+struct FuzzBulkRNG
+{
+	enum { NumLanes = 2 };
+
+	uint64 S0[NumLanes];
+	uint64 S1[NumLanes];
+	uint64 S2[NumLanes];
+	uint64 S3[NumLanes];
+
+	void Seed(uint64 Seed)
+	{
+		uint64 SplitMixState = Seed;
+		for (int32 Lane = 0; Lane < NumLanes; Lane++)
+		{
+			S0[Lane] = FuzzRNGXoshiro256::SplitMix64(&SplitMixState);
+			S1[Lane] = FuzzRNGXoshiro256::SplitMix64(&SplitMixState);
+			S2[Lane] = FuzzRNGXoshiro256::SplitMix64(&SplitMixState);
+			S3[Lane] = FuzzRNGXoshiro256::SplitMix64(&SplitMixState);
+		}
+	}
+
+	// The next word from each lane
+	void Next(uint64* OutWords)
+	{
+		for (int32 Lane = 0; Lane < NumLanes; Lane++)
+		{
+			OutWords[Lane] = FuzzRNGXoshiro256::RotateLeft(S1[Lane] * 5, 7) * 9;
+			const uint64 T = S1[Lane] << 17;
+
+			S2[Lane] ^= S0[Lane];
+			S3[Lane] ^= S1[Lane];
+			S1[Lane] ^= S2[Lane];
+			S0[Lane] ^= S3[Lane];
+
+			S2[Lane] ^= T;
+			S3[Lane] = FuzzRNGXoshiro256::RotateLeft(S3[Lane], 45);
+		}
+	}
+};
+
+// 24 bits -> [0, 1)
+inline float FuzzBitsToUnitFloat(uint32 Bits)
+{
+	return (float)(Bits >> 8) * (1.0f / 16777216.0f);
+}
+
+inline float FuzzUnitFloatToRange(float Unit, float Min, float Max)
+{
+	const float Value = Min + Unit * (Max - Min);
+	return (Value < Max) ? Value : Min;
+}
+
+// The bulk fills take one sub-seed from the fuzzer and fill the whole buffer from that, so what comes after doesn't
+// depend on how big the buffer was. They write the buffer front to back in whole chunks, which is what we want for
+// mapped upload heaps (write-combined, so never read from them).
+//
+// With FUZZ_RNG_LEGACY_MT19937 they draw each element from the fuzzer one at a time like we used to, so old seeds still reproduce
+
+inline void FillBytes(FuzzBasicState* Fuzzer, void* Buffer, int64 Size)
 {
 	byte* ByteBuffer = (byte*)Buffer;
 
-	for (int32 i = 0; i < Size; i++)
+#if FUZZ_RNG_LEGACY_MT19937
+	for (int64 i = 0; i < Size; i++)
 	{
 		ByteBuffer[i] = (byte)Fuzzer->GetIntInRange(0, 255);
 	}
+#else
+	FuzzBulkRNG Bulk;
+	Bulk.Seed(Fuzzer->GetSubSeed());
+
+	uint64 Words[FuzzBulkRNG::NumLanes];
+	while (Size >= (int64)sizeof(Words))
+	{
+		Bulk.Next(Words);
+		memcpy(ByteBuffer, Words, sizeof(Words));
+		ByteBuffer += sizeof(Words);
+		Size -= sizeof(Words);
+	}
+
+	if (Size > 0)
+	{
+		Bulk.Next(Words);
+		memcpy(ByteBuffer, Words, Size);
+	}
+#endif
+}
+
+// Each one in [Min, Max), same as GetFloatInRange
+inline void FillFloatsUniform(FuzzBasicState* Fuzzer, float* Buffer, int64 Count, float Min, float Max)
+{
+#if FUZZ_RNG_LEGACY_MT19937
+	for (int64 i = 0; i < Count; i++)
+	{
+		Buffer[i] = Fuzzer->GetFloatInRange(Min, Max);
+	}
+#else
+	FuzzBulkRNG Bulk;
+	Bulk.Seed(Fuzzer->GetSubSeed());
+
+	// Two floats per word
+	uint64 Words[FuzzBulkRNG::NumLanes];
+	float Floats[FuzzBulkRNG::NumLanes * 2];
+	auto GenerateFloats = [&](float* OutFloats) {
+		Bulk.Next(Words);
+		for (int32 Lane = 0; Lane < FuzzBulkRNG::NumLanes; Lane++)
+		{
+			OutFloats[Lane * 2 + 0] = FuzzUnitFloatToRange(FuzzBitsToUnitFloat((uint32)Words[Lane]), Min, Max);
+			OutFloats[Lane * 2 + 1] = FuzzUnitFloatToRange(FuzzBitsToUnitFloat((uint32)(Words[Lane] >> 32)), Min, Max);
+		}
+	};
+
+	// Straight into the buffer, going through a scratch array was hitting store forwarding stalls
+	while (Count >= (int64)ARRAY_COUNTOF(Floats))
+	{
+		GenerateFloats(Buffer);
+		Buffer += ARRAY_COUNTOF(Floats);
+		Count -= ARRAY_COUNTOF(Floats);
+	}
+
+	if (Count > 0)
+	{
+		GenerateFloats(Floats);
+		memcpy(Buffer, Floats, Count * sizeof(float));
+	}
+#endif
+}
+
+// VertexCount float4's, with xy in [-1, 1) and zw in [0, 1), so they're (mostly) on screen
+inline void FillPositionsClipSpace(FuzzBasicState* Fuzzer, float* Buffer, int64 VertexCount)
+{
+#if FUZZ_RNG_LEGACY_MT19937
+	for (int64 i = 0; i < 4 * VertexCount; i += 4)
+	{
+		Buffer[i + 0] = Fuzzer->GetFloatInRange(-1.0f, 1.0f);
+		Buffer[i + 1] = Fuzzer->GetFloatInRange(-1.0f, 1.0f);
+		Buffer[i + 2] = Fuzzer->GetFloat01();
+		Buffer[i + 3] = Fuzzer->GetFloat01();
+	}
+#else
+	FuzzBulkRNG Bulk;
+	Bulk.Seed(Fuzzer->GetSubSeed());
+
+	// Two words per vertex
+	const int32 VerticesPerStep = FuzzBulkRNG::NumLanes / 2;
+
+	uint64 Words[FuzzBulkRNG::NumLanes];
+	float Floats[VerticesPerStep * 4];
+	auto GenerateVertices = [&](float* OutFloats) {
+		Bulk.Next(Words);
+		for (int32 Vert = 0; Vert < VerticesPerStep; Vert++)
+		{
+			const uint64 XY = Words[Vert * 2 + 0];
+			const uint64 ZW = Words[Vert * 2 + 1];
+			OutFloats[Vert * 4 + 0] = FuzzUnitFloatToRange(FuzzBitsToUnitFloat((uint32)XY), -1.0f, 1.0f);
+			OutFloats[Vert * 4 + 1] = FuzzUnitFloatToRange(FuzzBitsToUnitFloat((uint32)(XY >> 32)), -1.0f, 1.0f);
+			OutFloats[Vert * 4 + 2] = FuzzBitsToUnitFloat((uint32)ZW);
+			OutFloats[Vert * 4 + 3] = FuzzBitsToUnitFloat((uint32)(ZW >> 32));
+		}
+	};
+
+	while (VertexCount >= VerticesPerStep)
+	{
+		GenerateVertices(Buffer);
+		Buffer += ARRAY_COUNTOF(Floats);
+		VertexCount -= VerticesPerStep;
+	}
+
+	if (VertexCount > 0)
+	{
+		GenerateVertices(Floats);
+		memcpy(Buffer, Floats, VertexCount * 4 * sizeof(float));
+	}
+#endif
 }
 
 
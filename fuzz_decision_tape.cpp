@@ -0,0 +1,255 @@
+#include "fuzz_decision_tape.h"
+
+#include <stdio.h>
+
+#define FUZZ_DECISION_TAPE_MAGIC 0x50544446 // 'FDTP'
+#define FUZZ_DECISION_TAPE_VERSION 1
+
+static uint32 GetFloatBits(float Value)
+{
+	uint32 Bits = 0;
+	memcpy(&Bits, &Value, sizeof(Bits));
+	return Bits;
+}
+
+static float GetFloatFromBits(uint32 Bits)
+{
+	float Value = 0.0f;
+	memcpy(&Value, &Bits, sizeof(Value));
+	return Value;
+}
+
+const FuzzDecisionTapeEntry* FuzzDecisionTape::ReadNext(FuzzDrawKind Kind)
+{
+	int32 Position = ReplayPosition;
+	ReplayPosition++;
+
+	if (Position >= (int32)Entries.size() || Entries[Position].Kind != Kind)
+	{
+		return nullptr;
+	}
+
+	return &Entries[Position];
+}
+
+void FuzzDecisionTape::Add(FuzzDrawKind Kind, uint32 MinBits, uint32 MaxBits, uint64 Value)
+{
+	FuzzDecisionTapeEntry Entry;
+	Entry.Kind = Kind;
+	Entry.MinBits = MinBits;
+	Entry.MaxBits = MaxBits;
+	Entry.Value = Value;
+	Entries.push_back(Entry);
+}
+
+int FuzzBasicState::GetIntInRangeWithTape(int min, int max)
+{
+	int Result = 0;
+	if (ReplayTape != nullptr)
+	{
+		const FuzzDecisionTapeEntry* Entry = ReplayTape->ReadNext(FuzzDrawKind::Int);
+		Result = (Entry != nullptr ? (int32)(uint32)Entry->Value : min);
+		Result = (Result < min ? min : (Result > max ? max : Result));
+	}
+	else
+	{
+		Result = DrawIntInRange(min, max);
+	}
+
+	if (RecordTape != nullptr)
+	{
+		RecordTape->Add(FuzzDrawKind::Int, (uint32)min, (uint32)max, (uint32)Result);
+	}
+
+	return Result;
+}
+
+float FuzzBasicState::GetFloatInRangeWithTape(float min, float max)
+{
+	float Result = 0.0f;
+	if (ReplayTape != nullptr)
+	{
+		const FuzzDecisionTapeEntry* Entry = ReplayTape->ReadNext(FuzzDrawKind::Float);
+		Result = (Entry != nullptr ? GetFloatFromBits((uint32)Entry->Value) : min);
+
+		// Same [min, max) as drawing it would give (and this catches NaNs too)
+		if (!(Result >= min && Result < max))
+		{
+			Result = min;
+		}
+	}
+	else
+	{
+		Result = DrawFloatInRange(min, max);
+	}
+
+	if (RecordTape != nullptr)
+	{
+		RecordTape->Add(FuzzDrawKind::Float, GetFloatBits(min), GetFloatBits(max), GetFloatBits(Result));
+	}
+
+	return Result;
+}
+
+uint64 FuzzBasicState::GetSubSeedWithTape()
+{
+	uint64 Result = 0;
+	if (ReplayTape != nullptr)
+	{
+		const FuzzDecisionTapeEntry* Entry = ReplayTape->ReadNext(FuzzDrawKind::SubSeed);
+		Result = (Entry != nullptr ? Entry->Value : 0);
+	}
+	else
+	{
+		Result = RNGState();
+	}
+
+	if (RecordTape != nullptr)
+	{
+		RecordTape->Add(FuzzDrawKind::SubSeed, 0, 0, Result);
+	}
+
+	return Result;
+}
+
+bool FuzzBasicState::IsReplayTapeUsedUp() const
+{
+	return ReplayTape->ReplayPosition >= (int32)ReplayTape->Entries.size();
+}
+
+uint64 GetMinimalTapeValue(const FuzzDecisionTapeEntry& Entry)
+{
+	return (Entry.Kind == FuzzDrawKind::SubSeed ? 0 : Entry.MinBits);
+}
+
+uint64 GetHalfwayTapeValue(const FuzzDecisionTapeEntry& Entry)
+{
+	if (Entry.Kind == FuzzDrawKind::Int)
+	{
+		int64 Min = (int32)Entry.MinBits;
+		int64 Value = (int32)(uint32)Entry.Value;
+		return (uint32)(int32)(Min + (Value - Min) / 2);
+	}
+	else if (Entry.Kind == FuzzDrawKind::Float)
+	{
+		float Min = GetFloatFromBits(Entry.MinBits);
+		float Value = GetFloatFromBits((uint32)Entry.Value);
+		return GetFloatBits(Min + (Value - Min) * 0.5f);
+	}
+	else
+	{
+		return Entry.Value / 2;
+	}
+}
+
+struct FuzzDecisionTapeFileHeader
+{
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	uint64 CaseSeed = 0;
+	uint32 NumEntries = 0;
+	uint32 Padding = 0;
+};
+
+// Everything but the kind, those go in their own array first so neither has any padding
+struct FuzzDecisionTapeFileEntry
+{
+	uint64 Value;
+	uint32 MinBits;
+	uint32 MaxBits;
+};
+
+bool FuzzDecisionTape::Save(const char* Filename) const
+{
+	FILE* File = nullptr;
+	fopen_s(&File, Filename, "wb");
+	if (File == nullptr)
+	{
+		LOG("Could not open decision tape '%s' for writing", Filename);
+		return false;
+	}
+
+	FuzzDecisionTapeFileHeader Header;
+	Header.Magic = FUZZ_DECISION_TAPE_MAGIC;
+	Header.Version = FUZZ_DECISION_TAPE_VERSION;
+	Header.CaseSeed = CaseSeed;
+	Header.NumEntries = (uint32)Entries.size();
+
+	bool Succeeded = (fwrite(&Header, sizeof(Header), 1, File) == 1);
+
+	for (uint32 i = 0; Succeeded && i < Header.NumEntries; i++)
+	{
+		byte Kind = (byte)Entries[i].Kind;
+		Succeeded = (fwrite(&Kind, 1, 1, File) == 1);
+	}
+
+	for (uint32 i = 0; Succeeded && i < Header.NumEntries; i++)
+	{
+		FuzzDecisionTapeFileEntry FileEntry;
+		FileEntry.Value = Entries[i].Value;
+		FileEntry.MinBits = Entries[i].MinBits;
+		FileEntry.MaxBits = Entries[i].MaxBits;
+		Succeeded = (fwrite(&FileEntry, sizeof(FileEntry), 1, File) == 1);
+	}
+
+	fclose(File);
+
+	if (!Succeeded)
+	{
+		LOG("Could not write decision tape '%s'", Filename);
+	}
+
+	return Succeeded;
+}
+
+bool FuzzDecisionTape::Load(const char* Filename)
+{
+	FILE* File = nullptr;
+	fopen_s(&File, Filename, "rb");
+	if (File == nullptr)
+	{
+		return false;
+	}
+
+	FuzzDecisionTapeFileHeader Header;
+	if (fread(&Header, sizeof(Header), 1, File) != 1 || Header.Magic != FUZZ_DECISION_TAPE_MAGIC || Header.Version != FUZZ_DECISION_TAPE_VERSION
+		|| Header.NumEntries > (1U << 28))
+	{
+		LOG("Decision tape '%s' isn't one we can read, ignoring it", Filename);
+		fclose(File);
+		return false;
+	}
+
+	std::vector<FuzzDecisionTapeEntry> NewEntries(Header.NumEntries);
+
+	bool Succeeded = true;
+	for (uint32 i = 0; Succeeded && i < Header.NumEntries; i++)
+	{
+		byte Kind = 0;
+		Succeeded = (fread(&Kind, 1, 1, File) == 1 && Kind <= (byte)FuzzDrawKind::SubSeed);
+		NewEntries[i].Kind = (FuzzDrawKind)Kind;
+	}
+
+	for (uint32 i = 0; Succeeded && i < Header.NumEntries; i++)
+	{
+		FuzzDecisionTapeFileEntry FileEntry;
+		Succeeded = (fread(&FileEntry, sizeof(FileEntry), 1, File) == 1);
+		NewEntries[i].Value = FileEntry.Value;
+		NewEntries[i].MinBits = FileEntry.MinBits;
+		NewEntries[i].MaxBits = FileEntry.MaxBits;
+	}
+
+	fclose(File);
+
+	if (!Succeeded)
+	{
+		LOG("Decision tape '%s' is cut short, ignoring it", Filename);
+		return false;
+	}
+
+	CaseSeed = Header.CaseSeed;
+	Entries = std::move(NewEntries);
+	ReplayPosition = 0;
+
+	return true;
+}
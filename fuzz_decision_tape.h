@@ -0,0 +1,197 @@
+#pragma once
+
+#include "basics.h"
+
+#include "fuzz_basic.h"
+
+#include <vector>
+
+// Every choice the generators make goes through a FuzzBasicState draw, so recording the draws (what kind, the bounds,
+// and what came out) is enough to get the same case again without the RNG. Replaying doesn't have to be from the exact
+// tape that was recorded either: a value outside the bounds it's asked for now gets clamped, and anything past the end
+// of the tape (or of the wrong kind, if entries got removed) comes out as the smallest choice. Generators tend to make
+// smaller/simpler things with smaller choices (fewer statements, lower depth, the first option), so cutting the tape
+// down gives smaller cases that are still valid, which is what ShrinkDecisionTape does. (The ones where the smallest
+// choice means recursing, like the HLSL expressions, check FuzzBasicState::IsPastEndOfReplayTape to stop.)
+//
+// Sub-fuzzers (like the DXBC generator's) only end up on the tape if they're given the same tapes
+
+enum struct FuzzDrawKind : uint8
+{
+	Int,
+	Float,
+	SubSeed,
+};
+
+struct FuzzDecisionTapeEntry
+{
+	// The int for Int, the float's bits for Float, and the seed for SubSeed
+	uint64 Value = 0;
+
+	// What it was drawn with, the float's bits for Float. Unused for SubSeed
+	uint32 MinBits = 0;
+	uint32 MaxBits = 0;
+
+	FuzzDrawKind Kind = FuzzDrawKind::Int;
+};
+
+struct FuzzDecisionTape
+{
+	// The seed of the case it was recorded from, just to know where it came from
+	uint64 CaseSeed = 0;
+
+	std::vector<FuzzDecisionTapeEntry> Entries;
+
+	// How many entries replaying has gone through, including any it asked for past the end
+	int32 ReplayPosition = 0;
+
+	void Clear()
+	{
+		Entries.clear();
+		ReplayPosition = 0;
+	}
+
+	void Rewind()
+	{
+		ReplayPosition = 0;
+	}
+
+	// Null if we're past the end or the entry is the wrong kind (which still counts as going past it)
+	const FuzzDecisionTapeEntry* ReadNext(FuzzDrawKind Kind);
+
+	void Add(FuzzDrawKind Kind, uint32 MinBits, uint32 MaxBits, uint64 Value);
+
+	bool Save(const char* Filename) const;
+
+	// Returns false (and leaves it alone) if it's not there or isn't a tape
+	bool Load(const char* Filename);
+};
+
+// Where replaying from Tape goes: RNGState isn't used while there's a ReplayTape, so the seed is only for logging/filenames
+inline void StartReplayingDecisionTape(FuzzBasicState* Fuzzer, FuzzDecisionTape* Tape)
+{
+	Tape->Rewind();
+	Fuzzer->SetSeed(Tape->CaseSeed);
+	Fuzzer->ReplayTape = Tape;
+}
+
+// The entry's smallest choice: the min it was drawn with, or 0 for sub-seeds
+uint64 GetMinimalTapeValue(const FuzzDecisionTapeEntry& Entry);
+
+// A value between the minimal one and the entry's, about half way, or the entry's own value if there isn't one in between
+uint64 GetHalfwayTapeValue(const FuzzDecisionTapeEntry& Entry);
+
+// Tries smaller versions of Tape (cutting off the end, removing runs of entries, then making each entry's value smaller)
+// and keeps each one IsInteresting still returns true for, until none of them work or it's used up MaxAttempts.
+// Returns how many it tried.
+//
+// IsInteresting(FuzzDecisionTape* Candidate) has to replay the case from Candidate (see StartReplayingDecisionTape) and
+// say whether it still does the thing we're after (crashes, fails to compile, whatever). Afterwards Tape only has the
+// entries the last successful replay actually read
+template<typename PredicateType>
+int32 ShrinkDecisionTape(FuzzDecisionTape* Tape, PredicateType IsInteresting, int32 MaxAttempts = 10000)
+{
+	int32 NumAttempts = 0;
+	FuzzDecisionTape Candidate;
+
+	auto TryCandidate = [&]() {
+		if (NumAttempts >= MaxAttempts)
+		{
+			return false;
+		}
+
+		NumAttempts++;
+		Candidate.CaseSeed = Tape->CaseSeed;
+		Candidate.Rewind();
+		if (!IsInteresting(&Candidate))
+		{
+			return false;
+		}
+
+		if (Candidate.ReplayPosition < (int32)Candidate.Entries.size())
+		{
+			Candidate.Entries.resize(Candidate.ReplayPosition);
+		}
+
+		Tape->Entries = Candidate.Entries;
+		return true;
+	};
+
+	bool bMadeProgress = true;
+	while (bMadeProgress && NumAttempts < MaxAttempts)
+	{
+		bMadeProgress = false;
+
+		// Cutting off the end, biggest chunks first
+		for (int32 ChunkSize = (int32)Tape->Entries.size() / 2; ChunkSize >= 1; ChunkSize /= 2)
+		{
+			while ((int32)Tape->Entries.size() > ChunkSize)
+			{
+				Candidate.Entries.assign(Tape->Entries.begin(), Tape->Entries.end() - ChunkSize);
+				if (!TryCandidate())
+				{
+					break;
+				}
+
+				bMadeProgress = true;
+			}
+		}
+
+		// Removing runs of entries, from the back since those are less likely to change everything after them
+		for (int32 ChunkSize = 8; ChunkSize >= 1; ChunkSize /= 2)
+		{
+			for (int32 Start = (int32)Tape->Entries.size() - ChunkSize; Start >= 0 && NumAttempts < MaxAttempts; Start--)
+			{
+				if (Start + ChunkSize > (int32)Tape->Entries.size())
+				{
+					continue;
+				}
+
+				Candidate.Entries.assign(Tape->Entries.begin(), Tape->Entries.begin() + Start);
+				Candidate.Entries.insert(Candidate.Entries.end(), Tape->Entries.begin() + Start + ChunkSize, Tape->Entries.end());
+				if (TryCandidate())
+				{
+					bMadeProgress = true;
+				}
+			}
+		}
+
+		// Making each value smaller: straight to the smallest choice if that works, otherwise halving the distance to it while that works
+		for (int32 Index = 0; Index < (int32)Tape->Entries.size() && NumAttempts < MaxAttempts; Index++)
+		{
+			const uint64 MinimalValue = GetMinimalTapeValue(Tape->Entries[Index]);
+			if (Tape->Entries[Index].Value == MinimalValue)
+			{
+				continue;
+			}
+
+			Candidate.Entries = Tape->Entries;
+			Candidate.Entries[Index].Value = MinimalValue;
+			if (TryCandidate())
+			{
+				bMadeProgress = true;
+				continue;
+			}
+
+			while (Index < (int32)Tape->Entries.size())
+			{
+				const uint64 HalfwayValue = GetHalfwayTapeValue(Tape->Entries[Index]);
+				if (HalfwayValue == Tape->Entries[Index].Value)
+				{
+					break;
+				}
+
+				Candidate.Entries = Tape->Entries;
+				Candidate.Entries[Index].Value = HalfwayValue;
+				if (!TryCandidate())
+				{
+					break;
+				}
+
+				bMadeProgress = true;
+			}
+		}
+	}
+
+	return NumAttempts;
+}
@@ -4,10 +4,14 @@
 #include "shader_meta.h"
 
 #include "dxbc_hash.h"
+#include "dxbc_view.h"
+#include "dxbc_opcodes.h"
 
 #include "string_stack_buffer.h"
 
 #include <vector>
+#include <mutex>
+#include <unordered_map>
 
 #pragma pack(push)
 #pragma pack(1)
@@ -29,180 +33,6 @@ static_assert(sizeof(DXBCFileHeader) == 32, "Check DXBCFileHeader alignment/size
 // Substantial parts of this code were guided by reverse engineering, and using the code at https://github.com/tgjones/slimshader
 // as reference. The code at https://github.com/tgjones/slimshader is from Tim Jones, released under the MIT License
 
-// List adapted from https://github.com/tpn/winsdk-10/blob/master/Include/10.0.16299.0/um/d3d10TokenizedProgramFormat.hpp
-enum D3DOpcodeType
-{
-	D3DOpcodeType_Invalid = -1,
-	D3DOpcodeType_ADD = 0,
-	D3DOpcodeType_AND,
-	D3DOpcodeType_BREAK,
-	D3DOpcodeType_BREAKC,
-	D3DOpcodeType_CALL,
-	D3DOpcodeType_CALLC,
-	D3DOpcodeType_CASE,
-	D3DOpcodeType_CONTINUE,
-	D3DOpcodeType_CONTINUEC,
-	D3DOpcodeType_CUT,
-	D3DOpcodeType_DEFAULT,
-	D3DOpcodeType_DERIV_RTX,
-	D3DOpcodeType_DERIV_RTY,
-	D3DOpcodeType_DISCARD,
-	D3DOpcodeType_DIV,
-	D3DOpcodeType_DP2,
-	D3DOpcodeType_DP3,
-	D3DOpcodeType_DP4,
-	D3DOpcodeType_ELSE,
-	D3DOpcodeType_EMIT,
-	D3DOpcodeType_EMITTHENCUT,
-	D3DOpcodeType_ENDIF,
-	D3DOpcodeType_ENDLOOP,
-	D3DOpcodeType_ENDSWITCH,
-	D3DOpcodeType_EQ,
-	D3DOpcodeType_EXP,
-	D3DOpcodeType_FRC,
-	D3DOpcodeType_FTOI,
-	D3DOpcodeType_FTOU,
-	D3DOpcodeType_GE,
-	D3DOpcodeType_IADD,
-	D3DOpcodeType_IF,
-	D3DOpcodeType_IEQ,
-	D3DOpcodeType_IGE,
-	D3DOpcodeType_ILT,
-	D3DOpcodeType_IMAD,
-	D3DOpcodeType_IMAX,
-	D3DOpcodeType_IMIN,
-	D3DOpcodeType_IMUL,
-	D3DOpcodeType_INE,
-	D3DOpcodeType_INEG,
-	D3DOpcodeType_ISHL,
-	D3DOpcodeType_ISHR,
-	D3DOpcodeType_ITOF,
-	D3DOpcodeType_LABEL,
-	D3DOpcodeType_LD,
-	D3DOpcodeType_LD_MS,
-	D3DOpcodeType_LOG,
-	D3DOpcodeType_LOOP,
-	D3DOpcodeType_LT,
-	D3DOpcodeType_MAD,
-	D3DOpcodeType_MIN,
-	D3DOpcodeType_MAX,
-	D3DOpcodeType_CUSTOMDATA,
-	D3DOpcodeType_MOV,
-	D3DOpcodeType_MOVC,
-	D3DOpcodeType_MUL,
-	D3DOpcodeType_NE,
-	D3DOpcodeType_NOP,
-	D3DOpcodeType_NOT,
-	D3DOpcodeType_OR,
-	D3DOpcodeType_RESINFO,
-	D3DOpcodeType_RET,
-	D3DOpcodeType_RETC,
-	D3DOpcodeType_ROUND_NE,
-	D3DOpcodeType_ROUND_NI,
-	D3DOpcodeType_ROUND_PI,
-	D3DOpcodeType_ROUND_Z,
-	D3DOpcodeType_RSQ,
-	D3DOpcodeType_SAMPLE,
-	D3DOpcodeType_SAMPLE_C,
-	D3DOpcodeType_SAMPLE_C_LZ,
-	D3DOpcodeType_SAMPLE_L,
-	D3DOpcodeType_SAMPLE_D,
-	D3DOpcodeType_SAMPLE_B,
-	D3DOpcodeType_SQRT,
-	D3DOpcodeType_SWITCH,
-	D3DOpcodeType_SINCOS,
-	D3DOpcodeType_UDIV,
-	D3DOpcodeType_ULT,
-	D3DOpcodeType_UGE,
-	D3DOpcodeType_UMUL,
-	D3DOpcodeType_UMAD,
-	D3DOpcodeType_UMAX,
-	D3DOpcodeType_UMIN,
-	D3DOpcodeType_USHR,
-	D3DOpcodeType_UTOF,
-	D3DOpcodeType_XOR,
-	D3DOpcodeType_DCL_RESOURCE,
-	D3DOpcodeType_DCL_CONSTANT_BUFFER,
-	D3DOpcodeType_DCL_SAMPLER,
-	D3DOpcodeType_DCL_INDEX_RANGE,
-	D3DOpcodeType_DCL_GS_OUTPUT_PRIMITIVE_TOPOLOGY,
-	D3DOpcodeType_DCL_GS_INPUT_PRIMITIVE,
-	D3DOpcodeType_DCL_MAX_OUTPUT_VERTEX_COUNT,
-	D3DOpcodeType_DCL_INPUT,
-	D3DOpcodeType_DCL_INPUT_SGV,
-	D3DOpcodeType_DCL_INPUT_SIV,
-	D3DOpcodeType_DCL_INPUT_PS,
-	D3DOpcodeType_DCL_INPUT_PS_SGV,
-	D3DOpcodeType_DCL_INPUT_PS_SIV,
-	D3DOpcodeType_DCL_OUTPUT,
-	D3DOpcodeType_DCL_OUTPUT_SGV,
-	D3DOpcodeType_DCL_OUTPUT_SIV,
-	D3DOpcodeType_DCL_TEMPS,
-	D3DOpcodeType_DCL_INDEXABLE_TEMP,
-	D3DOpcodeType_DCL_GLOBAL_FLAGS,
-	D3DOpcodeType_RESERVED0,
-	D3DOpcodeType_NUM
-};
-
-
-enum OperandNumComponents {
-	OperandNumComponents_Zero,
-	OperandNumComponents_One,
-	OperandNumComponents_Four,
-	OperandNumComponents_Count,
-	// There's also N, but apparently not used atm
-};
-
-enum Operand4CompSelection {
-	Operand4CompSelection_Mask,
-	Operand4CompSelection_Swizzle,
-	Operand4CompSelection_Select,
-	Operand4CompSelection_Count,
-};
-
-enum OperandSourceType
-{
-	OperandSourceType_TempRegister,
-	OperandSourceType_InputRegister,
-	OperandSourceType_OutputRegister,
-	OperandSourceType_IndexableTempRegister,
-	OperandSourceType_Immediate32,
-	OperandSourceType_Immediate64,
-	OperandSourceType_Sampler,
-	OperandSourceType_Resource,
-	OperandSourceType_ConstantBuffer,
-	OperandSourceType_ImmediateConstantBuffer,
-	OperandSourceType_Label,
-	OperandSourceType_Count
-};
-
-enum OperandSourceIndexDimension
-{
-	OperandSourceIndexDimension_0D,
-	OperandSourceIndexDimension_1D,
-	OperandSourceIndexDimension_2D,
-	OperandSourceIndexDimension_3D,
-	OperandSourceIndexDimension_Count,
-};
-
-enum OperandSourceIndexRepr
-{
-	OperandSourceIndexRepr_Imm32,
-	OperandSourceIndexRepr_Imm64,
-	OperandSourceIndexRepr_Relative,
-	OperandSourceIndexRepr_RelativePlusImm32,
-	OperandSourceIndexRepr_RelativePlusImm64,
-	OperandSourceIndexRepr_Count,
-};
-
-// TODO: There are a lot more, but we're ignoring those for now
-enum OperandSemantic
-{
-	OperandSemantic_Undefined,
-	OperandSemantic_Position,
-	OperandSemantic_Count,
-};
-
 inline OperandSemantic ShaderSemanticToOperandSemantic(ShaderSemantic Sementic)
 {
 	if (Sementic == ShaderSemantic::SV_POSITION)
@@ -215,61 +45,6 @@ inline OperandSemantic ShaderSemanticToOperandSemantic(ShaderSemantic Sementic)
 	}
 }
 
-enum SamplerMode {
-	SamplerMode_Default,
-	SamplerMode_Comparison,
-	SamplerMode_Mono
-};
-
-enum ResourceDimension {
-	ResourceDimension_Unknown,
-	ResourceDimension_Buffer,
-	ResourceDimension_Texture1D,
-	ResourceDimension_Texture2D,
-	ResourceDimension_Texture2D_MultiSample,
-	ResourceDimension_Texture3D,
-	ResourceDimension_TextureCube,
-	ResourceDimension_Texture1DArray,
-	ResourceDimension_Texture2DArray,
-	ResourceDimension_Texture2DArray_MultiSample,
-	ResourceDimension_TextureCubeArray,
-	ResourceDimension_RawBuffer,
-	ResourceDimension_StructuredBuffer,
-};
-
-enum ResourceReturnType {
-	ResourceReturnType_NA,
-	ResourceReturnType_Unorm,
-	ResourceReturnType_Snorm,
-	ResourceReturnType_SInt,
-	ResourceReturnType_UInt,
-	ResourceReturnType_Float,
-	ResourceReturnType_Mixed,
-	ResourceReturnType_Double,
-	ResourceReturnType_Continued,
-};
-
-enum OpcodeExtensionType
-{
-	OpcodeExtensionType_None,
-	OpcodeExtensionType_SampleControls,
-	OpcodeExtensionType_ResourceDim,
-	OpcodeExtensionType_ResourceReturnType
-};
-
-enum PSInputInterpolationMode
-{
-	PSInputInterpolationMode_Undefined,
-	PSInputInterpolationMode_Constant,
-	PSInputInterpolationMode_Linear,
-	PSInputInterpolationMode_LinearCentroid,
-	PSInputInterpolationMode_LinearNoPerspective,
-	PSInputInterpolationMode_LinearNoPerspectiveCentroid,
-	PSInputInterpolationMode_LinearSample,
-	PSInputInterpolationMode_LinearNoPerspectiveSample,
-	PSInputInterpolationMode_Count
-};
-
 struct D3DOpcode
 {
 	struct IODecl
@@ -329,7 +104,7 @@ struct D3DOpcode
 
 		struct {
 			int32 SamplerRegister;
-			SamplerMode SamplerMode;
+			enum SamplerMode SamplerMode;
 		} SamplerDeclaration;
 
 		struct {
@@ -391,13 +166,29 @@ inline bool IsOpcodeGenericUnaryOp(D3DOpcodeType OpcodeType)
 
 static_assert(sizeof(DXBCFileHeader) == 32, "Check packing on DXBCFileHeader");
 
-template<typename T>
-inline T GetValueFromCursor(byte** Cursor)
+// Reads the tokens of one instruction, bounded by its span (see DxbcInstructionIterator). Reading past the end of it,
+// or hitting anything we can't decode, sets Failed, and every read after that just gives 0
+struct DXBCTokenCursor
 {
-	T Val = *(T*)*Cursor;
-	(*Cursor) += sizeof(T);
-	return Val;
-}
+	const byte* Cursor = nullptr;
+	const byte* End = nullptr;
+	bool Failed = false;
+
+	template<typename T>
+	T Read()
+	{
+		T Val = {};
+		if (Failed || (size_t)(End - Cursor) < sizeof(T))
+		{
+			Failed = true;
+			return Val;
+		}
+
+		memcpy(&Val, Cursor, sizeof(T));
+		Cursor += sizeof(T);
+		return Val;
+	}
+};
 
 template<int Lo, int Hi, typename T = uint32>
 inline T GetBitsFromWord(uint32 Val)
@@ -451,9 +242,9 @@ inline void SetBitsFromWord(uint32* Val, int32 Lo, int32 Hi, T Bits)
 	*Val = ((*Val) & ~Mask) | ((Bits << Lo) & Mask);
 }
 
-D3DOpcode::IODecl ParseIODeclFromCursor(byte** Cursor)
+D3DOpcode::IODecl ParseIODeclFromCursor(DXBCTokenCursor* Cursor)
 {
-	uint32 SecondDWORD = GetValueFromCursor<uint32>(Cursor);
+	uint32 SecondDWORD = Cursor->Read<uint32>();
 
 	D3DOpcode::IODecl Decl;
 
@@ -483,11 +274,18 @@ D3DOpcode::IODecl ParseIODeclFromCursor(byte** Cursor)
 		}
 		else
 		{
-			ASSERT(false);
+			Cursor->Failed = true;
 		}
 	}
 
-	Decl.SrcType = GetBitsFromWord<12, 19, OperandSourceType>(SecondDWORD);
+	uint32 SrcType = GetBitsFromWord<12, 19>(SecondDWORD);
+	if (SrcType >= OperandSourceType_Count)
+	{
+		Cursor->Failed = true;
+		return Decl;
+	}
+
+	Decl.SrcType = (OperandSourceType)SrcType;
 	Decl.SrcDimension = GetBitsFromWord<20, 21, OperandSourceIndexDimension>(SecondDWORD);
 	for (int32 i = 0; i < (int32)Decl.SrcDimension; i++)
 	{
@@ -495,15 +293,16 @@ D3DOpcode::IODecl ParseIODeclFromCursor(byte** Cursor)
 
 		if (Decl.SrcIndicesRepr[i] == OperandSourceIndexRepr_Imm32)
 		{
-			Decl.SrcIndicesValues[i] = GetValueFromCursor<uint32>(Cursor);
+			Decl.SrcIndicesValues[i] = Cursor->Read<uint32>();
 		}
 		else if (Decl.SrcIndicesRepr[i] == OperandSourceIndexRepr_Imm64)
 		{
-			Decl.SrcIndicesValues[i] = GetValueFromCursor<uint64>(Cursor);
+			Decl.SrcIndicesValues[i] = Cursor->Read<uint64>();
 		}
 		else
 		{
-			ASSERT(false);
+			// Relative addressing, which we don't generate or decode yet
+			Cursor->Failed = true;
 		}
 	}
 
@@ -522,21 +321,21 @@ D3DOpcode::IODecl ParseIODeclFromCursor(byte** Cursor)
 	}
 	else
 	{
-		ASSERT(false);
+		Cursor->Failed = true;
 	}
 
 	if (Decl.SrcType == OperandSourceType_Immediate32)
 	{
 		for (int32 CompIdx = 0; CompIdx < NumComps; CompIdx++)
 		{
-			Decl.ImmediateValues[CompIdx] = GetValueFromCursor<float>(Cursor);
+			Decl.ImmediateValues[CompIdx] = Cursor->Read<float>();
 		}
 	}
 	else if (Decl.SrcType == OperandSourceType_Immediate64)
 	{
 		for (int32 CompIdx = 0; CompIdx < NumComps; CompIdx++)
 		{
-			Decl.ImmediateValues[CompIdx] = GetValueFromCursor<double>(Cursor);
+			Decl.ImmediateValues[CompIdx] = Cursor->Read<double>();
 		}
 	}
 
@@ -546,29 +345,35 @@ D3DOpcode::IODecl ParseIODeclFromCursor(byte** Cursor)
 	if (IsExtendedOperand)
 	{
 		// TODO:
-		GetValueFromCursor<uint32>(Cursor);
-		ASSERT(false);
+		Cursor->Read<uint32>();
+		Cursor->Failed = true;
 	}
 
 	return Decl;
 }
 
-D3DOpcode GetD3DOpcodeFromCursor(byte** Cursor)
+D3DOpcode GetD3DOpcodeFromCursor(DXBCTokenCursor* Cursor)
 {
 	D3DOpcode OpCode;
 
-	byte* OrigCursor = *Cursor;
+	const byte* OrigCursor = Cursor->Cursor;
 
-	uint32 OpcodeStartDWORD = GetValueFromCursor<uint32>(Cursor);
+	uint32 OpcodeStartDWORD = Cursor->Read<uint32>();
 	uint32 OpCodeType = GetBitsFromWord<0, 10>(OpcodeStartDWORD);
 	uint32 OpCodeLength = GetBitsFromWord<24, 30>(OpcodeStartDWORD);
 	bool IsExtended = GetBitsFromWord<31, 31>(OpcodeStartDWORD) != 0;
 
+	if (OpCodeType >= D3DOpcodeType_NUM)
+	{
+		Cursor->Failed = true;
+		return OpCode;
+	}
+
 	OpCode.Type = (D3DOpcodeType)OpCodeType;
 
-	if (OpCode.Type != D3DOpcodeType_SAMPLE_L)
+	if (OpCode.Type != D3DOpcodeType_SAMPLE_L && IsExtended)
 	{
-		ASSERT(!IsExtended);
+		Cursor->Failed = true;
 	}
 
 	if (OpCode.Type == D3DOpcodeType_DCL_GLOBAL_FLAGS)
@@ -587,13 +392,13 @@ D3DOpcode GetD3DOpcodeFromCursor(byte** Cursor)
 	else if (OpCode.Type == D3DOpcodeType_DCL_OUTPUT_SIV)
 	{
 		OpCode.OutputDeclarationSIV.Decl = ParseIODeclFromCursor(Cursor);
-		uint32 SemanticDWORD = GetValueFromCursor<uint32>(Cursor);
+		uint32 SemanticDWORD = Cursor->Read<uint32>();
 		OpCode.OutputDeclarationSIV.Semantic = GetBitsFromWord<0, 15, OperandSemantic>(SemanticDWORD);
 	}
 	else if (OpCode.Type == D3DOpcodeType_DCL_INPUT_PS_SIV)
 	{
 		OpCode.PSInputDeclarationSIV.Decl = ParseIODeclFromCursor(Cursor);
-		uint32 SemanticDWORD = GetValueFromCursor<uint32>(Cursor);
+		uint32 SemanticDWORD = Cursor->Read<uint32>();
 		OpCode.PSInputDeclarationSIV.Semantic = GetBitsFromWord<0, 15, OperandSemantic>(SemanticDWORD);
 		OpCode.PSInputDeclarationSIV.InterpolationMode = GetBitsFromWord<11, 14, PSInputInterpolationMode>(OpcodeStartDWORD);
 	}
@@ -604,13 +409,13 @@ D3DOpcode GetD3DOpcodeFromCursor(byte** Cursor)
 	}
 	else if (OpCode.Type == D3DOpcodeType_DCL_TEMPS)
 	{
-		OpCode.TempRegistersDeclaration.NumTemps = GetValueFromCursor<uint32>(Cursor);
+		OpCode.TempRegistersDeclaration.NumTemps = Cursor->Read<uint32>();
 	}
 	else if (OpCode.Type == D3DOpcodeType_DCL_CONSTANT_BUFFER)
 	{
 		OpCode.CBVDeclaration.IsDynamicIndexed = GetBitsFromWord<11, 11>(OpcodeStartDWORD) != 0;
 		auto Decl = ParseIODeclFromCursor(Cursor);
-		ASSERT(Decl.SrcDimension == OperandSourceIndexDimension_2D);
+		Cursor->Failed |= (Decl.SrcDimension != OperandSourceIndexDimension_2D);
 		OpCode.CBVDeclaration.CBVRegIndex = (uint32)Decl.SrcIndicesValues[0];
 		OpCode.CBVDeclaration.CBVSize = (uint32)Decl.SrcIndicesValues[1];
 	}
@@ -618,23 +423,23 @@ D3DOpcode GetD3DOpcodeFromCursor(byte** Cursor)
 	{
 		OpCode.SamplerDeclaration.SamplerMode = GetBitsFromWord<11, 14, SamplerMode>(OpcodeStartDWORD);
 		auto Decl = ParseIODeclFromCursor(Cursor);
-		ASSERT(Decl.SrcDimension == OperandSourceIndexDimension_1D);
+		Cursor->Failed |= (Decl.SrcDimension != OperandSourceIndexDimension_1D);
 		OpCode.SamplerDeclaration.SamplerRegister = (uint32)Decl.SrcIndicesValues[0];
 	}
 	else if (OpCode.Type == D3DOpcodeType_DCL_RESOURCE)
 	{
 		ResourceDimension ResDim = GetBitsFromWord<11, 15, ResourceDimension>(OpcodeStartDWORD);
 		uint32 SampleCount = GetBitsFromWord<16, 22>(OpcodeStartDWORD);
-		ASSERT(SampleCount == 0 || SampleCount == 1);
+		Cursor->Failed |= (SampleCount > 1);
 
 		auto Decl = ParseIODeclFromCursor(Cursor);
-		ASSERT(Decl.SrcDimension == OperandSourceIndexDimension_1D);
+		Cursor->Failed |= (Decl.SrcDimension != OperandSourceIndexDimension_1D);
 
 		OpCode.ResourceDeclaration.TextureRegIndex = (uint32)Decl.SrcIndicesValues[0];
 		OpCode.ResourceDeclaration.Dimension = ResDim;
 		OpCode.ResourceDeclaration.SampleCount = SampleCount;
 
-		uint32 ReturnTypeDWORD = GetValueFromCursor<uint32>(Cursor);
+		uint32 ReturnTypeDWORD = Cursor->Read<uint32>();
 		for (int32 i = 0; i < 4; i++)
 		{
 			OpCode.ResourceDeclaration.ReturnType[i] = GetBitsFromWord<ResourceReturnType>(ReturnTypeDWORD, 4 * i, 4 * i + 3);
@@ -665,18 +470,18 @@ D3DOpcode GetD3DOpcodeFromCursor(byte** Cursor)
 	}
 	else if (OpCode.Type == D3DOpcodeType_SAMPLE_L)
 	{
-		uint32 SecondDWORD = GetValueFromCursor<uint32>(Cursor);
-		uint32 ThirdDWORD = GetValueFromCursor<uint32>(Cursor);
+		uint32 SecondDWORD = Cursor->Read<uint32>();
+		uint32 ThirdDWORD = Cursor->Read<uint32>();
 
-		ASSERT(IsExtended);
-		ASSERT((GetBitsFromWord<31, 31>(SecondDWORD) != 0));
-		ASSERT((GetBitsFromWord<31, 31>(ThirdDWORD) == 0));
+		Cursor->Failed |= !IsExtended;
+		Cursor->Failed |= (GetBitsFromWord<31, 31>(SecondDWORD) == 0);
+		Cursor->Failed |= (GetBitsFromWord<31, 31>(ThirdDWORD) != 0);
 
 		auto SecondExtensionType = GetBitsFromWord<0, 5, OpcodeExtensionType>(SecondDWORD);
 		auto ThirdExtensionType = GetBitsFromWord<0, 5, OpcodeExtensionType>(ThirdDWORD);
 
-		ASSERT(SecondExtensionType == OpcodeExtensionType_ResourceDim);
-		ASSERT(ThirdExtensionType == OpcodeExtensionType_ResourceReturnType);
+		Cursor->Failed |= (SecondExtensionType != OpcodeExtensionType_ResourceDim);
+		Cursor->Failed |= (ThirdExtensionType != OpcodeExtensionType_ResourceReturnType);
 
 		OpCode.SampleLOp.Dimension = GetBitsFromWord<6, 10, ResourceDimension>(SecondDWORD);
 		OpCode.SampleLOp.ResourceStride = GetBitsFromWord<11, 15>(SecondDWORD);
@@ -700,207 +505,109 @@ D3DOpcode GetD3DOpcodeFromCursor(byte** Cursor)
 	}
 	else
 	{
-		ASSERT(false);
+		// Anything the generator doesn't make
+		Cursor->Failed = true;
 	}
 
-	ASSERT(*Cursor == OrigCursor + OpCodeLength * 4);
+	// Has to have used up exactly what the length in the opcode token says
+	Cursor->Failed |= (Cursor->Cursor != OrigCursor + OpCodeLength * 4);
 
 	return OpCode;
 }
 
-void ParseDXBCCode(byte* Code, int32 Length)
+bool ParseDXBCCode(const byte* Code, int32 Length)
 {
-	ASSERT(Length >= sizeof(DXBCFileHeader));
+	if (Length < (int32)sizeof(DXBCFileHeader))
+	{
+		return false;
+	}
 
+	DxbcView View;
+	if (!View.Init(Code, Length))
+	{
+		return false;
+	}
 
 	byte OurHash[16] = {};
 	dxbcHash(Code + 20, Length - 20, OurHash);
 
-	byte TheirHash[16] = {};
-	memcpy(TheirHash, Code + 4, 16);
-
-	ASSERT(memcmp(OurHash, TheirHash, 16) == 0);
-
-	byte* Cursor = Code;
-
-	DXBCFileHeader Header = GetValueFromCursor<DXBCFileHeader>(&Cursor);
-
-	ASSERT(Header.MagicNumbers[0] == 'D');
-	ASSERT(Header.MagicNumbers[1] == 'X');
-	ASSERT(Header.MagicNumbers[2] == 'B');
-	ASSERT(Header.MagicNumbers[3] == 'C');
-	ASSERT(Header.FileSizeInBytes == Length);
-
-	std::vector<uint32> ChunkOffsets;
-
-	for (int32 i = 0; i < Header.ChunkCount; i++)
+	if (memcmp(OurHash, View.GetChecksum(), 16) != 0)
 	{
-		ChunkOffsets.push_back(GetValueFromCursor<uint32>(&Cursor));
+		return false;
 	}
 
-	for (uint32 ChunkOffset : ChunkOffsets)
+	DxbcRDEFView RDEF;
+	if (View.GetRDEF(&RDEF))
 	{
-		byte* ChunkData = Code + ChunkOffset;
-		byte* ChunkCursor = ChunkData;
-
-		char ChunkHeaderType[5] = {};
-		memcpy(ChunkHeaderType, ChunkCursor, 4);
-		ChunkCursor += 4;
-		ChunkHeaderType[4] = '\0';
-
-		uint32 ChunkLength = GetValueFromCursor<uint32>(&ChunkCursor);
-
-		byte* ChunkDataAfterHeader = ChunkCursor;
-
-		LOG("Chunk of type '%s' with length %d", ChunkHeaderType, ChunkLength);
-
-		if (memcmp(ChunkHeaderType, "RDEF", 4) == 0)
+		for (uint32 CBIdx = 0; CBIdx < RDEF.ConstantBufferCount; CBIdx++)
 		{
-			uint32 CBCount = GetValueFromCursor<uint32>(&ChunkCursor);
-			uint32 CBByteOffset = GetValueFromCursor<uint32>(&ChunkCursor);
-
-			uint32 ResourceCount = GetValueFromCursor<uint32>(&ChunkCursor);
-			uint32 ResourceByteOffset = GetValueFromCursor<uint32>(&ChunkCursor);
-
-			uint32 MinorVersion = GetValueFromCursor<byte>(&ChunkCursor);
-			uint32 MajorVersion = GetValueFromCursor<byte>(&ChunkCursor);
-
-			uint16 ProgramType = GetValueFromCursor<uint16>(&ChunkCursor);
-			uint32 ProgramFlags = GetValueFromCursor<uint32>(&ChunkCursor);
-
-			uint32 OffsetToCreatorString = GetValueFromCursor<uint32>(&ChunkCursor);
-
-			byte* CreatorStringData = ChunkDataAfterHeader + OffsetToCreatorString;
-
-			byte* ConstantBufferData = ChunkDataAfterHeader + CBByteOffset;
-			byte* CBCursor = ConstantBufferData;
-			for (int32 CBIdx = 0; CBIdx < CBCount; CBIdx++)
+			DxbcRDEFConstantBuffer ConstantBuffer;
+			if (!RDEF.GetConstantBuffer(CBIdx, &ConstantBuffer))
 			{
+				return false;
+			}
 
-				uint32 CBNameOffset = GetValueFromCursor<uint32>(&CBCursor);
-				uint32 CBVarCount = GetValueFromCursor<uint32>(&CBCursor);
-				uint32 CBVarDescOffset = GetValueFromCursor<uint32>(&CBCursor);
-				uint32 CBSize = GetValueFromCursor<uint32>(&CBCursor);
-				uint32 CBFlags = GetValueFromCursor<uint32>(&CBCursor);
-				uint32 CBType = GetValueFromCursor<uint32>(&CBCursor);
-
-				byte* CBNameValue = ChunkDataAfterHeader + CBNameOffset;
-
-				byte* VarData = ChunkDataAfterHeader + CBVarDescOffset;
-				byte* VarCursor = VarData;
-				for (int32 VarIdx = 0; VarIdx < CBVarCount; VarIdx++)
+			for (uint32 VarIdx = 0; VarIdx < ConstantBuffer.VariableCount; VarIdx++)
+			{
+				DxbcRDEFVariable Variable;
+				if (!RDEF.GetVariable(ConstantBuffer, VarIdx, &Variable))
 				{
-					uint32 VarNameOffset = GetValueFromCursor<uint32>(&VarCursor);
-					uint32 OffsetInCBBuffer = GetValueFromCursor<uint32>(&VarCursor);
-					uint32 VariableSize = GetValueFromCursor<uint32>(&VarCursor);
-					uint32 VariableFlags = GetValueFromCursor<uint32>(&VarCursor);
-					uint32 VarTypeOffset = GetValueFromCursor<uint32>(&VarCursor);
-					uint32 VarDefaultValueOffset = GetValueFromCursor<uint32>(&VarCursor);
-
-					uint32 Unknown[4] = {};
-					for (int32 i = 0; i < 4; i++)
-					{
-						Unknown[i] = GetValueFromCursor<uint32>(&VarCursor);
-					}
-
-					byte* VarNameCursor = ChunkDataAfterHeader + VarNameOffset;
-
-					byte* VarTypeCursor = ChunkDataAfterHeader + VarTypeOffset;
-					uint16 VarClass = GetValueFromCursor<uint16>(&VarTypeCursor);
-					uint16 VarType = GetValueFromCursor<uint16>(&VarTypeCursor);
-					uint16 VarRowCount = GetValueFromCursor<uint16>(&VarTypeCursor);
-					uint16 VarColCount = GetValueFromCursor<uint16>(&VarTypeCursor);
-					uint16 VarArrayCount = GetValueFromCursor<uint16>(&VarTypeCursor);
-					uint16 VarMemberCount = GetValueFromCursor<uint16>(&VarTypeCursor);
-					uint16 VarMemberOffset = GetValueFromCursor<uint16>(&VarTypeCursor);
-
-					uint16 UnknownStuff1 = GetValueFromCursor<uint16>(&VarTypeCursor);
-					uint32 UnknownStuff2 = GetValueFromCursor<uint32>(&VarTypeCursor);
-					uint32 UnknownStuff3 = GetValueFromCursor<uint32>(&VarTypeCursor);
-					uint32 UnknownStuff4 = GetValueFromCursor<uint32>(&VarTypeCursor);
-					uint32 UnknownStuff5 = GetValueFromCursor<uint32>(&VarTypeCursor);
-					uint32 VarTypeNameOffset = GetValueFromCursor<uint32>(&VarTypeCursor);
-					byte* VarTypeNameCursor = ChunkDataAfterHeader + VarTypeNameOffset;
-
-					int xc = 0;
-					xc++;
-					(void)xc;
+					return false;
 				}
-
 			}
+		}
 
-
-			byte* ResourceBindingData = ChunkDataAfterHeader + ResourceByteOffset;
-			byte* RBCursor = ResourceBindingData;
-			for (int32 ResourceIdx = 0; ResourceIdx < ResourceCount; ResourceIdx++)
+		for (uint32 ResourceIdx = 0; ResourceIdx < RDEF.ResourceCount; ResourceIdx++)
+		{
+			DxbcRDEFResourceBinding Binding;
+			if (!RDEF.GetResourceBinding(ResourceIdx, &Binding))
 			{
-				uint32 ResourceNameOffset = GetValueFromCursor<uint32>(&RBCursor);
-
-				// 0 = cbuffer
-				// 2 = texture
-				// 3 = sampler
-				uint32 ResourceType = GetValueFromCursor<uint32>(&RBCursor);
-				uint32 ResourceReturnType = GetValueFromCursor<uint32>(&RBCursor);
-				uint32 ResourceViewDimension = GetValueFromCursor<uint32>(&RBCursor);
-				uint32 ResourceNumSamples = GetValueFromCursor<uint32>(&RBCursor);
-				uint32 ResourceBindPoint = GetValueFromCursor<uint32>(&RBCursor);
-				uint32 ResourceBindCount = GetValueFromCursor<uint32>(&RBCursor);
-				uint32 ResourceFlags = GetValueFromCursor<uint32>(&RBCursor);
-
-				byte* ResourceNameCursor = ChunkDataAfterHeader + ResourceNameOffset;
-
-				int xc = 0;
-				xc++;
-				(void)xc;
+				return false;
 			}
 		}
-		// TODO: Same of OSGN, except for...output not input
-		else if (memcmp(ChunkHeaderType, "ISGN", 4) == 0)
-		{
-			uint32 ElementCount = GetValueFromCursor<uint32>(&ChunkCursor);
-			uint32 Unknown = GetValueFromCursor<uint32>(&ChunkCursor);
+	}
 
-			for (int32 ElementIdx = 0; ElementIdx < ElementCount; ElementIdx++)
+	DxbcSignatureView Signatures[2];
+	bool HasSignature[2] = { View.GetInputSignature(&Signatures[0]), View.GetOutputSignature(&Signatures[1]) };
+	for (int32 SigIdx = 0; SigIdx < 2; SigIdx++)
+	{
+		for (uint32 ElementIdx = 0; HasSignature[SigIdx] && ElementIdx < Signatures[SigIdx].ElementCount; ElementIdx++)
+		{
+			DxbcSignatureElement Element;
+			if (!Signatures[SigIdx].GetElement(ElementIdx, &Element))
 			{
-				uint32 ElementNameOffset = GetValueFromCursor<uint32>(&ChunkCursor);
-				uint32 ElementSemanticIndex = GetValueFromCursor<uint32>(&ChunkCursor);
-				uint32 ElementValueType = GetValueFromCursor<uint32>(&ChunkCursor);
-				uint32 ElementComponentType = GetValueFromCursor<uint32>(&ChunkCursor);
-				uint32 ElementRegister = GetValueFromCursor<uint32>(&ChunkCursor);
-				byte ElementMask = GetValueFromCursor<byte>(&ChunkCursor);
-				byte ElementRWMask = GetValueFromCursor<byte>(&ChunkCursor);
-
-				uint16 Unknown = GetValueFromCursor<uint16>(&ChunkCursor);
-
-				byte* ElementName = ChunkDataAfterHeader + ElementNameOffset;
-
-				int xc = 0;
-				xc++;
-				(void)xc;
+				return false;
 			}
 		}
-		else if (memcmp(ChunkHeaderType, "SHEX", 4) == 0)
-		{
-			byte Version = GetValueFromCursor<byte>(&ChunkCursor);
-			byte Padding = GetValueFromCursor<byte>(&ChunkCursor);
-			uint16 ProgramType = GetValueFromCursor<uint16>(&ChunkCursor);
-			uint32 NumberDWORDs = GetValueFromCursor<uint32>(&ChunkCursor);
+	}
 
-			byte* OpcodesStart = ChunkCursor;
+	DxbcShaderCodeView ShaderCode;
+	if (View.GetShaderCode(&ShaderCode))
+	{
+		DxbcInstructionIterator Instructions = ShaderCode.GetInstructions();
+		DxbcInstruction Instruction;
+		while (Instructions.Next(&Instruction))
+		{
+			// Full decode, but it can't go outside the instruction's own tokens
+			DXBCTokenCursor Cursor;
+			Cursor.Cursor = (const byte*)Instruction.Tokens;
+			Cursor.End = Cursor.Cursor + Instruction.Length * 4;
 
-			while (ChunkCursor < ChunkDataAfterHeader + (NumberDWORDs * 4))
+			D3DOpcode OpCode = GetD3DOpcodeFromCursor(&Cursor);
+			if (Cursor.Failed || OpCode.Type != (D3DOpcodeType)Instruction.OpcodeType)
 			{
-				D3DOpcode OpCode = GetD3DOpcodeFromCursor(&ChunkCursor);
-				(void)OpCode;
+				return false;
 			}
+		}
 
-			int xc = 0;
-			xc++;
-			(void)xc;
+		if (Instructions.HasError)
+		{
+			return false;
 		}
 	}
-}
 
+	return true;
+}
 
 //
 // --------------------------------------
@@ -1097,222 +804,276 @@ struct BytecodeOperand {
 	}
 };
 
-void ShaderDeclareGlobalFlags(D3DOpcodeState* Bytecode, bool isRefactoringAllowed)
+// Opcode tokens: type in bits 0-10, opcode-specific controls in 11-23, length (in DWORDs, including this one) in 24-30
+constexpr uint32 MakeOpcodeToken(D3DOpcodeType OpcodeType, uint32 Length, uint32 Controls = 0)
 {
-	uint32 OpcodeDWORD = 0;
-	SetBitsFromWord<0, 10, D3DOpcodeType>(&OpcodeDWORD, D3DOpcodeType_DCL_GLOBAL_FLAGS);
-	SetBitsFromWord<24, 30>(&OpcodeDWORD, 1); // Set length to 1 DWORD (including this one)
-	SetBitsFromWord<11, 11>(&OpcodeDWORD, isRefactoringAllowed ? 1 : 0); // Set refactoring allowed
-
-	Bytecode->Opcodes.push_back(OpcodeDWORD);
+	return ((uint32)OpcodeType & 0x7FF) | ((Controls & 0x1FFF) << 11) | ((Length & 0x7F) << 24);
 }
 
-OperandSourceType OperandSourceTypeFromRegisterType(BytecodeRegisterType RegisterType)
+// What we actually need to know to encode an operand. The register ones line up with BytecodeRegisterType
+enum BytecodeOperandKind
 {
-	OperandSourceType SourceType = OperandSourceType_Count;
-	if (RegisterType == BytecodeRegisterType::Temp)
-	{
-		SourceType = OperandSourceType_TempRegister;
-	}
-	else if (RegisterType == BytecodeRegisterType::Input)
-	{
-		SourceType = OperandSourceType_InputRegister;
-	}
-	else if (RegisterType == BytecodeRegisterType::Output)
+	BytecodeOperandKind_Temp,
+	BytecodeOperandKind_Input,
+	BytecodeOperandKind_Output,
+	BytecodeOperandKind_Sampler,
+	BytecodeOperandKind_Texture,
+	BytecodeOperandKind_ConstantBuffer,
+	BytecodeOperandKind_ImmediateFloat1,
+	BytecodeOperandKind_ImmediateFloat4,
+	BytecodeOperandKind_Count
+};
+
+static_assert((int32)BytecodeOperandKind_ConstantBuffer == (int32)BytecodeRegisterType::ConstantBuffer, "Register kinds need to line up with BytecodeRegisterType");
+static_assert((int32)BytecodeOperandKind_ImmediateFloat1 == (int32)BytecodeRegisterType::Count, "Register kinds need to line up with BytecodeRegisterType");
+
+constexpr OperandSourceType OperandSourceTypeFromKind(BytecodeOperandKind Kind)
+{
+	switch (Kind)
 	{
-		SourceType = OperandSourceType_OutputRegister;
+	case BytecodeOperandKind_Temp: return OperandSourceType_TempRegister;
+	case BytecodeOperandKind_Input: return OperandSourceType_InputRegister;
+	case BytecodeOperandKind_Output: return OperandSourceType_OutputRegister;
+	case BytecodeOperandKind_Sampler: return OperandSourceType_Sampler;
+	case BytecodeOperandKind_Texture: return OperandSourceType_Resource;
+	case BytecodeOperandKind_ConstantBuffer: return OperandSourceType_ConstantBuffer;
+	default: return OperandSourceType_Immediate32;
 	}
-	else if (RegisterType == BytecodeRegisterType::Texture)
+}
+
+constexpr OperandSourceIndexDimension OperandIndexDimensionFromKind(BytecodeOperandKind Kind)
+{
+	switch (Kind)
 	{
-		SourceType = OperandSourceType_Resource;
+	case BytecodeOperandKind_ConstantBuffer: return OperandSourceIndexDimension_2D;
+	case BytecodeOperandKind_ImmediateFloat1: return OperandSourceIndexDimension_0D;
+	case BytecodeOperandKind_ImmediateFloat4: return OperandSourceIndexDimension_0D;
+	default: return OperandSourceIndexDimension_1D;
 	}
-	else if (RegisterType == BytecodeRegisterType::Sampler)
+}
+
+constexpr OperandNumComponents OperandNumComponentsFromKind(BytecodeOperandKind Kind, bool IsDeclaration)
+{
+	switch (Kind)
 	{
-		SourceType = OperandSourceType_Sampler;
+	case BytecodeOperandKind_Sampler: return OperandNumComponents_Zero;
+	case BytecodeOperandKind_Texture: return IsDeclaration ? OperandNumComponents_Zero : OperandNumComponents_Four;
+	case BytecodeOperandKind_ImmediateFloat1: return OperandNumComponents_One;
+	default: return OperandNumComponents_Four;
 	}
-	else if (RegisterType == BytecodeRegisterType::ConstantBuffer)
+}
+
+// In DWORDs, header included
+constexpr uint32 GetOperandTokenCount(BytecodeOperandKind Kind)
+{
+	switch (Kind)
 	{
-		SourceType = OperandSourceType_ConstantBuffer;
+	case BytecodeOperandKind_ConstantBuffer: return 3;
+	case BytecodeOperandKind_ImmediateFloat1: return 2;
+	case BytecodeOperandKind_ImmediateFloat4: return 5;
+	default: return 2;
 	}
-	else
+}
+
+// I'm not sure if it's a restriction with dxilconv, or with the graphics drivers, but if we're sampling from a texture, the operand needs
+// to explicitly state the swizzle, using a mask isn't sufficient
+constexpr bool OperandKindForcesSwizzle(BytecodeOperandKind Kind)
+{
+	return Kind == BytecodeOperandKind_Texture;
+}
+
+// Every operand header, indexed by [IsDeclaration][Kind][Operand4CompSelection (mask or swizzle)]. The only per-operand bits left
+// are the mask (bits 4-7) or swizzle (bits 4-11), and SelectionBits says which of those the header actually has room for
+struct BytecodeOperandHeaderTable
+{
+	uint32 Headers[2][BytecodeOperandKind_Count][2] = {};
+	uint32 SelectionBits[2][BytecodeOperandKind_Count][2] = {};
+
+	constexpr BytecodeOperandHeaderTable()
 	{
-		ASSERT(false);
+		for (int32 Decl = 0; Decl < 2; Decl++)
+		{
+			for (int32 Kind = 0; Kind < BytecodeOperandKind_Count; Kind++)
+			{
+				for (int32 Select = 0; Select < 2; Select++)
+				{
+					auto NumComponents = OperandNumComponentsFromKind((BytecodeOperandKind)Kind, Decl != 0);
+					uint32 Header = (uint32)NumComponents;
+					uint32 Bits = 0;
+					if (NumComponents == OperandNumComponents_Four)
+					{
+						Header |= (uint32)Select << 2;
+						Bits = (Select == Operand4CompSelection_Swizzle) ? 0xFF0 : 0xF0;
+					}
+
+					Header |= (uint32)OperandSourceTypeFromKind((BytecodeOperandKind)Kind) << 12;
+					Header |= (uint32)OperandIndexDimensionFromKind((BytecodeOperandKind)Kind) << 20;
+					Header |= (uint32)OperandSourceIndexRepr_Imm32 << 22;
+
+					Headers[Decl][Kind][Select] = Header;
+					SelectionBits[Decl][Kind][Select] = Bits;
+				}
+			}
+		}
 	}
+};
 
-	return SourceType;
-}
+static constexpr BytecodeOperandHeaderTable OperandHeaderTable;
+
+static_assert(OperandHeaderTable.Headers[0][BytecodeOperandKind_Temp][Operand4CompSelection_Mask] == 0x00100002, "Operand header table test");
+static_assert(OperandHeaderTable.Headers[0][BytecodeOperandKind_ConstantBuffer][Operand4CompSelection_Swizzle] == 0x00208006, "Operand header table test");
+static_assert(OperandHeaderTable.Headers[1][BytecodeOperandKind_Texture][Operand4CompSelection_Swizzle] == 0x00107000, "Operand header table test");
+static_assert(OperandHeaderTable.Headers[0][BytecodeOperandKind_ImmediateFloat1][Operand4CompSelection_Mask] == 0x00004001, "Operand header table test");
 
-OperandNumComponents NumComponentsInOperand(const BytecodeOperand& Op, bool IsDeclaration)
+inline BytecodeOperandKind GetOperandKind(const BytecodeOperand& Op)
 {
-	if (Op.Type == BytecodeOperandType::ImmediateFloat1)
+	if (Op.Type == BytecodeOperandType::Register)
 	{
-		return OperandNumComponents_One;
+		ASSERT(Op.Register.RegType < BytecodeRegisterType::Count);
+		return (BytecodeOperandKind)Op.Register.RegType;
 	}
-	else if (Op.Type == BytecodeOperandType::ImmediateFloat4)
+	else if (Op.Type == BytecodeOperandType::ImmediateFloat1)
 	{
-		return OperandNumComponents_Four;
+		return BytecodeOperandKind_ImmediateFloat1;
 	}
-	else if (Op.Type == BytecodeOperandType::Register)
+	else if (Op.Type == BytecodeOperandType::ImmediateFloat4)
 	{
-		if (Op.Register.RegType == BytecodeRegisterType::Sampler)
-		{
-			return OperandNumComponents_Zero;
-		}
-		else if (Op.Register.RegType == BytecodeRegisterType::Texture)
-		{
-			return IsDeclaration ? OperandNumComponents_Zero : OperandNumComponents_Four;
-		}
-		else
-		{
-			return OperandNumComponents_Four;
-		}
+		return BytecodeOperandKind_ImmediateFloat4;
 	}
 	else
 	{
 		ASSERT(false);
-		return OperandNumComponents_Zero;
+		return BytecodeOperandKind_ImmediateFloat4;
 	}
 }
 
-void ShaderWriteOperand(D3DOpcodeState* Bytecode, const BytecodeOperand& Op, bool IsDeclaration)
+inline uint32 GetOperandTokenCount(const BytecodeOperand& Op)
+{
+	return GetOperandTokenCount(GetOperandKind(Op));
+}
+
+// Grows the opcode stream by Count DWORDs and hands back where they go, so each instruction is one resize instead of a push_back per token
+inline uint32* AppendOpcodeTokens(D3DOpcodeState* Bytecode, uint32 Count)
 {
-	uint32 HeaderDWORD = 0;
-	auto NumComponents = NumComponentsInOperand(Op, IsDeclaration);
-	if (NumComponents == OperandNumComponents_Four)
+	size_t Start = Bytecode->Opcodes.size();
+	Bytecode->Opcodes.resize(Start + Count);
+	return Bytecode->Opcodes.data() + Start;
+}
+
+// Writes GetOperandTokenCount(Op) DWORDs, returns the DWORD after them
+uint32* ShaderWriteOperand(uint32* Tokens, const BytecodeOperand& Op, bool IsDeclaration)
+{
+	auto Kind = GetOperandKind(Op);
+
+	int32 Select = Operand4CompSelection_Mask;
+	uint32 SelectionPayload = ((uint32)Op.Mask & 0x0F) << 4;
+	if (OperandKindForcesSwizzle(Kind) || !Op.Swizzling.IsDefault())
 	{
-		// I'm not sure if it's a restriction with dxilconv, or with the graphics drivers, but if we're sampling from a texture, the operand needs
-		// to explicitly state the swizzle, using a mask isn't sufficient
-		bool ShouldForceSwizzle = (Op.Type == BytecodeOperandType::Register) && (Op.Register.RegType == BytecodeRegisterType::Texture);
-		if (!Op.Swizzling.IsDefault() || ShouldForceSwizzle)
-		{
-			SetBitsFromWord<2, 3>(&HeaderDWORD, Operand4CompSelection_Swizzle);
-			for (int32 i = 0; i < 4; i++)
-			{
-				SetBitsFromWord(&HeaderDWORD, 4 + 2 * i, 5 + 2 * i, Op.Swizzling.Swizzling[i]);
-			}
-		}
-		else
+		Select = Operand4CompSelection_Swizzle;
+		SelectionPayload = 0;
+		for (int32 i = 0; i < 4; i++)
 		{
-			SetBitsFromWord<4, 7>(&HeaderDWORD, Op.Mask);
+			SelectionPayload |= ((uint32)Op.Swizzling.Swizzling[i] & 0x03) << (4 + 2 * i);
 		}
 	}
 
-	SetBitsFromWord<0, 1>(&HeaderDWORD, NumComponents);
+	Tokens[0] = OperandHeaderTable.Headers[IsDeclaration][Kind][Select] | (SelectionPayload & OperandHeaderTable.SelectionBits[IsDeclaration][Kind][Select]);
 
-	if (Op.Type == BytecodeOperandType::Register)
+	if (Kind == BytecodeOperandKind_ImmediateFloat4)
 	{
-		if (Op.Register.RegType == BytecodeRegisterType::ConstantBuffer)
-		{
-			SetBitsFromWord<12, 19>(&HeaderDWORD, OperandSourceTypeFromRegisterType(Op.Register.RegType));
-			SetBitsFromWord<20, 21>(&HeaderDWORD, OperandSourceIndexDimension_2D);
-			SetBitsFromWord<22, 24>(&HeaderDWORD, OperandSourceIndexRepr_Imm32);
-
-			Bytecode->Opcodes.push_back(HeaderDWORD);
-			Bytecode->Opcodes.push_back(Op.Register.RegIndex);
-			Bytecode->Opcodes.push_back(Op.CBVAccessIndex);
-		}
-		else
-		{
-			SetBitsFromWord<12, 19>(&HeaderDWORD, OperandSourceTypeFromRegisterType(Op.Register.RegType));
-			SetBitsFromWord<20, 21>(&HeaderDWORD, OperandSourceIndexDimension_1D);
-			SetBitsFromWord<22, 24>(&HeaderDWORD, OperandSourceIndexRepr_Imm32);
-
-			Bytecode->Opcodes.push_back(HeaderDWORD);
-			Bytecode->Opcodes.push_back(Op.Register.RegIndex);
-		}
+		memcpy(&Tokens[1], Op.Float4.Values, sizeof(uint32) * 4);
+		return Tokens + 5;
 	}
-	else if (Op.Type == BytecodeOperandType::ImmediateFloat4)
+	else if (Kind == BytecodeOperandKind_ImmediateFloat1)
 	{
-		SetBitsFromWord<12, 19>(&HeaderDWORD, OperandSourceType_Immediate32);
-		Bytecode->Opcodes.push_back(HeaderDWORD);
-
-		for (int32 i = 0; i < 4; i++)
-		{
-			Bytecode->Opcodes.push_back(*(uint32*)&Op.Float4.Values[i]);
-		}
+		memcpy(&Tokens[1], &Op.Float1, sizeof(uint32));
+		return Tokens + 2;
 	}
-	else if (Op.Type == BytecodeOperandType::ImmediateFloat1)
+	else if (Kind == BytecodeOperandKind_ConstantBuffer)
 	{
-		SetBitsFromWord<12, 19>(&HeaderDWORD, OperandSourceType_Immediate32);
-		Bytecode->Opcodes.push_back(HeaderDWORD);
-
-		Bytecode->Opcodes.push_back(*(uint32*)&Op.Float1);
+		Tokens[1] = Op.Register.RegIndex;
+		Tokens[2] = Op.CBVAccessIndex;
+		return Tokens + 3;
 	}
 	else
 	{
-		ASSERT(false);
+		Tokens[1] = Op.Register.RegIndex;
+		return Tokens + 2;
 	}
 }
 
+// Declarations only ever take one kind of operand, so their lengths are known up front
+constexpr uint32 DclGlobalFlagsLength = 1;
+constexpr uint32 DclInputLength = 1 + GetOperandTokenCount(BytecodeOperandKind_Input);
+constexpr uint32 DclOutputLength = 1 + GetOperandTokenCount(BytecodeOperandKind_Output);
+constexpr uint32 DclOutputSIVLength = DclOutputLength + 1;
+constexpr uint32 DclInputSIVLength = DclInputLength + 1;
+constexpr uint32 DclResourceLength = 1 + GetOperandTokenCount(BytecodeOperandKind_Texture) + 1;
+constexpr uint32 DclSamplerLength = 1 + GetOperandTokenCount(BytecodeOperandKind_Sampler);
+constexpr uint32 DclTempsLength = 2;
+constexpr uint32 DclConstantBufferLength = 1 + GetOperandTokenCount(BytecodeOperandKind_ConstantBuffer);
+
+static_assert(DclInputLength == 3 && DclOutputSIVLength == 4 && DclResourceLength == 4 && DclConstantBufferLength == 4, "Declaration length test");
+
+// Float return type for all 4 components
+constexpr uint32 ResourceReturnTypeFloat4 = ResourceReturnType_Float | (ResourceReturnType_Float << 4) | (ResourceReturnType_Float << 8) | (ResourceReturnType_Float << 12);
+
+void ShaderDeclareGlobalFlags(D3DOpcodeState* Bytecode, bool isRefactoringAllowed)
+{
+	uint32* Tokens = AppendOpcodeTokens(Bytecode, DclGlobalFlagsLength);
+	Tokens[0] = MakeOpcodeToken(D3DOpcodeType_DCL_GLOBAL_FLAGS, DclGlobalFlagsLength, isRefactoringAllowed ? 1 : 0);
+}
+
 void ShaderDeclareInput(D3DOpcodeState* Bytecode, int32 RegisterIndex, byte InputMask = 0x0F)
 {
-	uint32 OpcodeDWORD = 0;
-	SetBitsFromWord<0, 10>(&OpcodeDWORD, D3DOpcodeType_DCL_INPUT);
-	SetBitsFromWord<24, 30>(&OpcodeDWORD, 3); // Set length to 3 DWORDs (including this one)
-	Bytecode->Opcodes.push_back(OpcodeDWORD);
-	
+	uint32* Tokens = AppendOpcodeTokens(Bytecode, DclInputLength);
+	Tokens[0] = MakeOpcodeToken(D3DOpcodeType_DCL_INPUT, DclInputLength);
+
 	auto Operand = BytecodeOperand::OpRegister(BytecodeRegisterRef::Input(RegisterIndex), BytecodeOperandSwizzling(), InputMask);
-	ShaderWriteOperand(Bytecode, Operand, true);
+	ShaderWriteOperand(Tokens + 1, Operand, true);
 }
 
 void ShaderDeclareOutput(D3DOpcodeState* Bytecode, int32 RegisterIndex, byte OutputMask = 0x0F)
 {
-	uint32 OpcodeDWORD = 0;
-	SetBitsFromWord<0, 10>(&OpcodeDWORD, D3DOpcodeType_DCL_OUTPUT);
-	SetBitsFromWord<24, 30>(&OpcodeDWORD, 3); // Set length to 3 DWORDs (including this one)
-	Bytecode->Opcodes.push_back(OpcodeDWORD);
+	uint32* Tokens = AppendOpcodeTokens(Bytecode, DclOutputLength);
+	Tokens[0] = MakeOpcodeToken(D3DOpcodeType_DCL_OUTPUT, DclOutputLength);
 
 	auto Operand = BytecodeOperand::OpRegister(BytecodeRegisterRef::Output(RegisterIndex), BytecodeOperandSwizzling(), OutputMask);
-	ShaderWriteOperand(Bytecode, Operand, true);
+	ShaderWriteOperand(Tokens + 1, Operand, true);
 }
 
 void ShaderDeclareOutput_SIV(D3DOpcodeState* Bytecode, int32 RegisterIndex, OperandSemantic Semantic, byte OutputMask = 0x0F)
 {
-	uint32 OpcodeDWORD = 0;
-	SetBitsFromWord<0, 10>(&OpcodeDWORD, D3DOpcodeType_DCL_OUTPUT_SIV);
-	SetBitsFromWord<24, 30>(&OpcodeDWORD, 4); // Set length to 4 DWORDs (including this one)
-	Bytecode->Opcodes.push_back(OpcodeDWORD);
+	uint32* Tokens = AppendOpcodeTokens(Bytecode, DclOutputSIVLength);
+	Tokens[0] = MakeOpcodeToken(D3DOpcodeType_DCL_OUTPUT_SIV, DclOutputSIVLength);
 
 	auto Operand = BytecodeOperand::OpRegister(BytecodeRegisterRef::Output(RegisterIndex), BytecodeOperandSwizzling(), OutputMask);
-	ShaderWriteOperand(Bytecode, Operand, true);
-
-	{
-		uint32 SemanticDWORD = 0;
-		SetBitsFromWord<0, 15>(&OpcodeDWORD, Semantic);
-	}
+	uint32* SemanticToken = ShaderWriteOperand(Tokens + 1, Operand, true);
 
-	Bytecode->Opcodes.push_back(OpcodeDWORD);
+	// The semantic token has always been the opcode token with its low 16 bits swapped for the semantic,
+	// so the length is still sitting in the top bits. Nothing seems to mind, and changing it would change every shader we've generated
+	*SemanticToken = (Tokens[0] & 0xFFFF0000) | (uint32)Semantic;
 }
 
 void ShaderDeclareInputPS(D3DOpcodeState* Bytecode, int32 RegisterIndex, PSInputInterpolationMode InterpolationMode, byte InputMask = 0x0F)
 {
-	uint32 OpcodeDWORD = 0;
-	SetBitsFromWord<0, 10>(&OpcodeDWORD, D3DOpcodeType_DCL_INPUT_PS);
-	SetBitsFromWord<24, 30>(&OpcodeDWORD, 3); // Set length to 3 DWORDs (including this one)
-	SetBitsFromWord<11, 14>(&OpcodeDWORD, InterpolationMode);
-	Bytecode->Opcodes.push_back(OpcodeDWORD);
+	uint32* Tokens = AppendOpcodeTokens(Bytecode, DclInputLength);
+	Tokens[0] = MakeOpcodeToken(D3DOpcodeType_DCL_INPUT_PS, DclInputLength, InterpolationMode & 0x0F);
 
 	auto Operand = BytecodeOperand::OpRegister(BytecodeRegisterRef::Input(RegisterIndex), BytecodeOperandSwizzling(), InputMask);
-	ShaderWriteOperand(Bytecode, Operand, true);
+	ShaderWriteOperand(Tokens + 1, Operand, true);
 }
 
 void ShaderDeclareInputPS_SIV(D3DOpcodeState* Bytecode, int32 RegisterIndex, OperandSemantic Semantic, PSInputInterpolationMode InterpolationMode, byte OutputMask = 0x0F)
 {
-	uint32 OpcodeDWORD = 0;
-	SetBitsFromWord<0, 10>(&OpcodeDWORD, D3DOpcodeType_DCL_INPUT_PS_SIV);
-	SetBitsFromWord<24, 30>(&OpcodeDWORD, 4); // Set length to 4 DWORDs (including this one)
-	SetBitsFromWord<11, 14>(&OpcodeDWORD, InterpolationMode);
-	Bytecode->Opcodes.push_back(OpcodeDWORD);
+	uint32* Tokens = AppendOpcodeTokens(Bytecode, DclInputSIVLength);
+	Tokens[0] = MakeOpcodeToken(D3DOpcodeType_DCL_INPUT_PS_SIV, DclInputSIVLength, InterpolationMode & 0x0F);
 
 	auto Operand = BytecodeOperand::OpRegister(BytecodeRegisterRef::Input(RegisterIndex), BytecodeOperandSwizzling(), OutputMask);
-	ShaderWriteOperand(Bytecode, Operand, true);
+	uint32* SemanticToken = ShaderWriteOperand(Tokens + 1, Operand, true);
 
-	{
-		uint32 SemanticDWORD = 0;
-		SetBitsFromWord<0, 15>(&OpcodeDWORD, Semantic);
-	}
-
-	Bytecode->Opcodes.push_back(OpcodeDWORD);
+	// Same as ShaderDeclareOutput_SIV (which also means the interpolation mode bits get dropped here)
+	*SemanticToken = (Tokens[0] & 0xFFFF0000) | (uint32)Semantic;
 }
 
 void ShaderDeclareCBVImm(D3DOpcodeState* Bytecode, int32 RegisterIndex, int32 SizeInBytes)
@@ -1322,98 +1083,71 @@ void ShaderDeclareCBVImm(D3DOpcodeState* Bytecode, int32 RegisterIndex, int32 Si
 
 void ShaderDeclareTexture2DResource(D3DOpcodeState* Bytecode, int32 RegisterIndex)
 {
-	uint32 OpcodeDWORD = 0;
-	SetBitsFromWord<0, 10>(&OpcodeDWORD, D3DOpcodeType_DCL_RESOURCE);
-	SetBitsFromWord<24, 30>(&OpcodeDWORD, 4); // Set length to 3 DWORDs (including this one)
-
-	SetBitsFromWord<11, 15>(&OpcodeDWORD, ResourceDimension_Texture2D);
-	int32 SampleCount = 0;
-	SetBitsFromWord<16, 22>(&OpcodeDWORD, SampleCount);
-
-	Bytecode->Opcodes.push_back(OpcodeDWORD);
+	// Bits 11-15 are the dimension, 16-22 the sample count (0)
+	uint32* Tokens = AppendOpcodeTokens(Bytecode, DclResourceLength);
+	Tokens[0] = MakeOpcodeToken(D3DOpcodeType_DCL_RESOURCE, DclResourceLength, ResourceDimension_Texture2D);
 
 	auto Operand = BytecodeOperand::OpRegister(BytecodeRegisterRef::Texture(RegisterIndex));
-	ShaderWriteOperand(Bytecode, Operand, true);
-
-	uint32 ReturnTypeDWORD = 0;
-	for (int32 i = 0; i < 4; i++)
-	{
-		SetBitsFromWord(&ReturnTypeDWORD, 4 * i, 4 * i + 3, ResourceReturnType_Float);
-	}
+	uint32* ReturnTypeToken = ShaderWriteOperand(Tokens + 1, Operand, true);
 
-	Bytecode->Opcodes.push_back(ReturnTypeDWORD);
+	*ReturnTypeToken = ResourceReturnTypeFloat4;
 }
 
 void ShaderDeclareSampler(D3DOpcodeState* Bytecode, int32 RegisterIndex /*TODO: Mode?*/)
 {
-	uint32 OpcodeDWORD = 0;
-	SetBitsFromWord<0, 10>(&OpcodeDWORD, D3DOpcodeType_DCL_SAMPLER);
-	SetBitsFromWord<24, 30>(&OpcodeDWORD, 3); // Set length to 3 DWORDs (including this one)
-	SetBitsFromWord<11, 14>(&OpcodeDWORD, SamplerMode_Default);
-
-	Bytecode->Opcodes.push_back(OpcodeDWORD);
+	uint32* Tokens = AppendOpcodeTokens(Bytecode, DclSamplerLength);
+	Tokens[0] = MakeOpcodeToken(D3DOpcodeType_DCL_SAMPLER, DclSamplerLength, SamplerMode_Default);
 
 	auto Operand = BytecodeOperand::OpRegister(BytecodeRegisterRef::Sampler(RegisterIndex));
-	ShaderWriteOperand(Bytecode, Operand, true);
+	ShaderWriteOperand(Tokens + 1, Operand, true);
 }
 
 void ShaderDeclareNumTempRegisters(D3DOpcodeState* Bytecode, int32 NumTempRegs)
 {
-	uint32 OpcodeDWORD = 0;
-	SetBitsFromWord<0, 10>(&OpcodeDWORD, D3DOpcodeType_DCL_TEMPS);
-	SetBitsFromWord<24, 30>(&OpcodeDWORD, 2); // Set length to 2 DWORDs (including this one)
-	Bytecode->Opcodes.push_back(OpcodeDWORD);
-
-	Bytecode->Opcodes.push_back(NumTempRegs);
+	uint32* Tokens = AppendOpcodeTokens(Bytecode, DclTempsLength);
+	Tokens[0] = MakeOpcodeToken(D3DOpcodeType_DCL_TEMPS, DclTempsLength);
+	Tokens[1] = NumTempRegs;
 }
 
 void ShaderDeclareConstantBuffer(D3DOpcodeState* Bytecode, int32 CBVRegister, int32 CBVSize)
 {
-	uint32 OpcodeDWORD = 0;
-	SetBitsFromWord<0, 10>(&OpcodeDWORD, D3DOpcodeType_DCL_CONSTANT_BUFFER);
-	SetBitsFromWord<24, 30>(&OpcodeDWORD, 4); // Set length to 2 DWORDs (including this one)
-	Bytecode->Opcodes.push_back(OpcodeDWORD);
+	uint32* Tokens = AppendOpcodeTokens(Bytecode, DclConstantBufferLength);
+	Tokens[0] = MakeOpcodeToken(D3DOpcodeType_DCL_CONSTANT_BUFFER, DclConstantBufferLength);
 
 	auto Operand = BytecodeOperand::OpCBV(BytecodeRegisterRef::ConstantBuffer(CBVRegister), CBVSize);
-	ShaderWriteOperand(Bytecode, Operand, true);
+	ShaderWriteOperand(Tokens + 1, Operand, true);
 }
 
-void ShaderDoMov(D3DOpcodeState* Bytecode, BytecodeOperand Src, BytecodeOperand Dst)
+void ShaderDoMov(D3DOpcodeState* Bytecode, const BytecodeOperand& Src, const BytecodeOperand& Dst)
 {
-	uint32 OpcodeDWORD = 0;
-	SetBitsFromWord<0, 10>(&OpcodeDWORD, D3DOpcodeType_MOV);
-
-	int32 OpcodeFirstWordIndex = Bytecode->Opcodes.size();
-	Bytecode->Opcodes.push_back(OpcodeDWORD);
-
 	ASSERT(Dst.Type == BytecodeOperandType::Register);
 
-	ShaderWriteOperand(Bytecode, Dst, false);
-	ShaderWriteOperand(Bytecode, Src, false);
+	uint32 Length = 1 + GetOperandTokenCount(Dst) + GetOperandTokenCount(Src);
+	uint32* Tokens = AppendOpcodeTokens(Bytecode, Length);
+	Tokens[0] = MakeOpcodeToken(D3DOpcodeType_MOV, Length);
 
-	// Set op code length
-	SetBitsFromWord<24, 30>(&Bytecode->Opcodes[OpcodeFirstWordIndex], Bytecode->Opcodes.size() - OpcodeFirstWordIndex);
+	uint32* Cursor = Tokens + 1;
+	Cursor = ShaderWriteOperand(Cursor, Dst, false);
+	Cursor = ShaderWriteOperand(Cursor, Src, false);
+	ASSERT(Cursor == Tokens + Length);
 }
 
-void ShaderPerformBinaryOp(D3DOpcodeState* Bytecode, D3DOpcodeType OpcodeType, BytecodeOperand Src1, BytecodeOperand Src2, BytecodeOperand Dst)
+void ShaderPerformBinaryOp(D3DOpcodeState* Bytecode, D3DOpcodeType OpcodeType, const BytecodeOperand& Src1, const BytecodeOperand& Src2, const BytecodeOperand& Dst)
 {
-	uint32 OpcodeDWORD = 0;
-	SetBitsFromWord<0, 10>(&OpcodeDWORD, OpcodeType);
-	
-	int32 OpcodeFirstWordIndex = Bytecode->Opcodes.size();
-	Bytecode->Opcodes.push_back(OpcodeDWORD);
-
 	ASSERT(Dst.Type == BytecodeOperandType::Register);
 
-	ShaderWriteOperand(Bytecode, Dst, false);
-	ShaderWriteOperand(Bytecode, Src1, false);
-	ShaderWriteOperand(Bytecode, Src2, false);
+	uint32 Length = 1 + GetOperandTokenCount(Dst) + GetOperandTokenCount(Src1) + GetOperandTokenCount(Src2);
+	uint32* Tokens = AppendOpcodeTokens(Bytecode, Length);
+	Tokens[0] = MakeOpcodeToken(OpcodeType, Length);
 
-	// Set op code length
-	SetBitsFromWord<24, 30>(&Bytecode->Opcodes[OpcodeFirstWordIndex], Bytecode->Opcodes.size() - OpcodeFirstWordIndex);
+	uint32* Cursor = Tokens + 1;
+	Cursor = ShaderWriteOperand(Cursor, Dst, false);
+	Cursor = ShaderWriteOperand(Cursor, Src1, false);
+	Cursor = ShaderWriteOperand(Cursor, Src2, false);
+	ASSERT(Cursor == Tokens + Length);
 }
 
-void ShaderAdd(D3DOpcodeState* Bytecode, BytecodeOperand Src1, BytecodeOperand Src2, BytecodeOperand Dst)
+void ShaderAdd(D3DOpcodeState* Bytecode, const BytecodeOperand& Src1, const BytecodeOperand& Src2, const BytecodeOperand& Dst)
 {
 	ShaderPerformBinaryOp(Bytecode, D3DOpcodeType_ADD, Src1, Src2, Dst);
 }
@@ -1423,12 +1157,17 @@ void ShaderFmad(D3DOpcodeState* Bytecode, BytecodeOperand AddSrc, BytecodeOperan
 
 }
 
-void ShaderMul(D3DOpcodeState* Bytecode, BytecodeOperand Src1, BytecodeOperand Src2, BytecodeOperand Dst)
+void ShaderMul(D3DOpcodeState* Bytecode, const BytecodeOperand& Src1, const BytecodeOperand& Src2, const BytecodeOperand& Dst)
 {
 	ShaderPerformBinaryOp(Bytecode, D3DOpcodeType_MUL, Src1, Src2, Dst);
 }
 
-void ShaderSampleTextureLevel(D3DOpcodeState* Bytecode, BytecodeOperand Tex, BytecodeOperand Sampler, BytecodeOperand UVs, BytecodeOperand Dst, BytecodeOperand MipsLevel)
+// Resource dim extension (Texture2D, stride 0), with bit 31 saying another extension follows
+constexpr uint32 SampleResourceDimExtensionToken = OpcodeExtensionType_ResourceDim | (ResourceDimension_Texture2D << 6) | (1u << 31);
+// Return type extension (float for all 4 components), the last one
+constexpr uint32 SampleReturnTypeExtensionToken = OpcodeExtensionType_ResourceReturnType | (ResourceReturnTypeFloat4 << 6);
+
+void ShaderSampleTextureLevel(D3DOpcodeState* Bytecode, const BytecodeOperand& Tex, const BytecodeOperand& Sampler, const BytecodeOperand& UVs, const BytecodeOperand& Dst, const BytecodeOperand& MipsLevel)
 {
 	ASSERT(Dst.Type == BytecodeOperandType::Register);
 	ASSERT(Tex.Type == BytecodeOperandType::Register);
@@ -1437,56 +1176,28 @@ void ShaderSampleTextureLevel(D3DOpcodeState* Bytecode, BytecodeOperand Tex, Byt
 	ASSERT(Sampler.Register.RegType == BytecodeRegisterType::Sampler);
 	ASSERT(MipsLevel.Type == BytecodeOperandType::ImmediateFloat1);
 
-	uint32 OpcodeDWORD = 0;
-	SetBitsFromWord<0, 10>(&OpcodeDWORD, D3DOpcodeType_SAMPLE_L);
-	SetBitsFromWord<31, 31>(&OpcodeDWORD, 1);
-	
-	int32 OpcodeFirstWordIndex = Bytecode->Opcodes.size();
-	
-	//SetBitsFromWord<24, 30>(&OpcodeDWORD, 5);
-	Bytecode->Opcodes.push_back(OpcodeDWORD);
-
-	{
-		uint32 OpcodeHeaderExtension = 0;
-		SetBitsFromWord<0, 5>(&OpcodeHeaderExtension, OpcodeExtensionType_ResourceDim);
-		SetBitsFromWord<6, 10>(&OpcodeHeaderExtension, ResourceDimension_Texture2D);
-		uint32 ResourceStride = 0;
-		SetBitsFromWord<11, 15>(&OpcodeHeaderExtension, ResourceStride);
-		SetBitsFromWord<31, 31>(&OpcodeHeaderExtension, 1);
-
-		Bytecode->Opcodes.push_back(OpcodeHeaderExtension);
-	}
-
-	{
-		uint32 OpcodeHeaderExtension = 0;
-		SetBitsFromWord<0, 5>(&OpcodeHeaderExtension, OpcodeExtensionType_ResourceReturnType);
-
-		for (int32 i = 0; i < 4; i++)
-		{
-			SetBitsFromWord(&OpcodeHeaderExtension, 6 + 4 * i, 9 + 4 * i, ResourceReturnType_Float);
-		}
-
-		SetBitsFromWord<31, 31>(&OpcodeHeaderExtension, 0);
-
-		Bytecode->Opcodes.push_back(OpcodeHeaderExtension);
-	}
-
-	ShaderWriteOperand(Bytecode, Dst, false);
-	ShaderWriteOperand(Bytecode, UVs, false);
-	ShaderWriteOperand(Bytecode, Tex, false);
-	ShaderWriteOperand(Bytecode, Sampler, false);
-	ShaderWriteOperand(Bytecode, MipsLevel, false);
-
-
-	SetBitsFromWord<24, 30>(&Bytecode->Opcodes[OpcodeFirstWordIndex], Bytecode->Opcodes.size() - OpcodeFirstWordIndex);
+	// Only the destination and UVs can vary in size, the rest are fixed
+	constexpr uint32 FixedLength = 3 + GetOperandTokenCount(BytecodeOperandKind_Texture) + GetOperandTokenCount(BytecodeOperandKind_Sampler) + GetOperandTokenCount(BytecodeOperandKind_ImmediateFloat1);
+	uint32 Length = FixedLength + GetOperandTokenCount(Dst) + GetOperandTokenCount(UVs);
+
+	uint32* Tokens = AppendOpcodeTokens(Bytecode, Length);
+	Tokens[0] = MakeOpcodeToken(D3DOpcodeType_SAMPLE_L, Length) | (1u << 31); // Extended
+	Tokens[1] = SampleResourceDimExtensionToken;
+	Tokens[2] = SampleReturnTypeExtensionToken;
+
+	uint32* Cursor = Tokens + 3;
+	Cursor = ShaderWriteOperand(Cursor, Dst, false);
+	Cursor = ShaderWriteOperand(Cursor, UVs, false);
+	Cursor = ShaderWriteOperand(Cursor, Tex, false);
+	Cursor = ShaderWriteOperand(Cursor, Sampler, false);
+	Cursor = ShaderWriteOperand(Cursor, MipsLevel, false);
+	ASSERT(Cursor == Tokens + Length);
 }
 
 void ShaderReturn(D3DOpcodeState* Bytecode)
 {
-	uint32 OpcodeDWORD = 0;
-	SetBitsFromWord<0, 10>(&OpcodeDWORD, D3DOpcodeType_RET);
-	SetBitsFromWord<24, 30>(&OpcodeDWORD, 1);
-	Bytecode->Opcodes.push_back(OpcodeDWORD);
+	uint32* Tokens = AppendOpcodeTokens(Bytecode, 1);
+	Tokens[0] = MakeOpcodeToken(D3DOpcodeType_RET, 1);
 }
 
 
@@ -1845,97 +1556,241 @@ void RandomiseShaderBytecodeParams(FuzzDXBCState* DXBCState, D3DOpcodeState* VSO
 	}
 }
 
-// Little-endian, as god intended
-void WriteU32ToUCharVectorLE(std::vector<byte>* OutData, uint32 Val, int32 Index = -1)
+// Writes straight into a buffer that's already the right size. We work out the size of every chunk
+// up front (see the Compute*Layout functions), so there's nothing to grow or patch afterwards
+struct DXBCByteWriter
 {
-	if (Index == -1)
+	byte* Data = nullptr;
+	uint32 Capacity = 0;
+	uint32 Cursor = 0;
+
+	// Little-endian, as god intended (and as every platform we run D3D on is)
+	void WriteU32(uint32 Val)
 	{
-		for (int32 i = 0; i < 4; i++)
+		ASSERT(Capacity - Cursor >= 4);
+		memcpy(Data + Cursor, &Val, 4);
+		Cursor += 4;
+	}
+
+	void WriteU16(uint16 Val)
+	{
+		ASSERT(Capacity - Cursor >= 2);
+		memcpy(Data + Cursor, &Val, 2);
+		Cursor += 2;
+	}
+
+	void WriteByte(byte Val)
+	{
+		ASSERT(Capacity - Cursor >= 1);
+		Data[Cursor] = Val;
+		Cursor++;
+	}
+
+	void WriteBytes(const void* Src, uint32 Size)
+	{
+		ASSERT(Capacity - Cursor >= Size);
+		memcpy(Data + Cursor, Src, Size);
+		Cursor += Size;
+	}
+
+	void WriteZeros(uint32 Size)
+	{
+		ASSERT(Capacity - Cursor >= Size);
+		memset(Data + Cursor, 0, Size);
+		Cursor += Size;
+	}
+
+	// Includes the null byte
+	void WriteString(const char* Str)
+	{
+		WriteBytes(Str, strlen(Str) + 1);
+	}
+
+	// Writes e.g. "res_12", same as snprintf'ing "res_%d" but without the format parsing
+	void WriteIndexedName(const char* Prefix, int32 Index)
+	{
+		ASSERT(Index >= 0);
+
+		WriteBytes(Prefix, strlen(Prefix));
+
+		char Digits[16];
+		int32 NumDigits = 0;
+		do
 		{
-			OutData->push_back((byte)((Val >> (i * 8)) & 0xFF));
+			Digits[NumDigits] = '0' + (Index % 10);
+			NumDigits++;
+			Index /= 10;
+		} while (Index > 0);
+
+		for (int32 i = NumDigits - 1; i >= 0; i--)
+		{
+			WriteByte(Digits[i]);
 		}
+
+		WriteByte('\0');
 	}
-	else
+
+	// Uhhh...padding? The compiler pads some strings out to 4 bytes with 0xAB
+	void PadToFourBytes()
 	{
-		ASSERT(Index >= 0 && Index <= OutData->size() - 4);
-		for (int32 i = 0; i < 4; i++)
+		while (Cursor % 4 != 0)
 		{
-			(*OutData)[Index + i] = ((byte)((Val >> (i * 8)) & 0xFF));
+			WriteByte(0xAB);
 		}
 	}
+};
+
+inline uint32 AlignToFourBytes(uint32 Offset)
+{
+	return (Offset + 3) & ~3u;
 }
 
-void WriteU16ToUCharVectorLE(std::vector<byte>* OutData, uint16 Val, int32 Index = -1)
+// Length of what WriteIndexedName would write, including the null byte
+inline uint32 GetIndexedNameLength(const char* Prefix, int32 Index)
 {
-	if (Index == -1)
+	uint32 NumDigits = 1;
+	while (Index >= 10)
 	{
-		for (int32 i = 0; i < 2; i++)
-		{
-			OutData->push_back((byte)((Val >> (i * 8)) & 0xFF));
-		}
+		NumDigits++;
+		Index /= 10;
 	}
-	else
+
+	return strlen(Prefix) + NumDigits + 1;
+}
+
+static const char* const DXBCCreatorString = "Microsoft (R) HLSL Shader Compiler 10.1";
+
+// Size of the STAT chunk's data, which we leave zeroed
+#define DXBC_STAT_CHUNK_SIZE 148
+
+#define DXBC_CHUNK_COUNT 5
+
+// All offsets are from the start of the chunk data (i.e. after the magic + size), which is what RDEF's own offsets are relative to
+struct DXBCRDEFLayout
+{
+	int32 NumResources = 0;
+	int32 NumVariables = 0;
+
+	uint32 ConstantBufferDescsOffset = 0;
+	uint32 ResourceBindingsOffset = 0;
+	uint32 ConstantBufferNamesOffset = 0;
+	uint32 VariableDescsOffset = 0;
+	uint32 VariableNamesOffset = 0;
+	uint32 VariableTypesOffset = 0;
+	uint32 TypeNameOffset = 0;
+	uint32 ResourceNamesOffset = 0;
+	uint32 CreatorOffset = 0;
+	uint32 Size = 0;
+};
+
+// NOTE: The padding of the strings depends on where they land, so this has to walk through in the same order
+// that WriteRDEFChunk writes things. That works because the chunk data always starts 4-byte aligned
+static void ComputeRDEFLayout(const D3DOpcodeState* Opcodes, DXBCRDEFLayout* OutLayout)
+{
+	const int32 NumCBVs = Opcodes->CBVSizes.size();
+
+	OutLayout->NumResources = NumCBVs + Opcodes->NumSamplers + Opcodes->NumTextures;
+	OutLayout->NumVariables = 0;
+	for (int32 CBVSize : Opcodes->CBVSizes)
 	{
-		ASSERT(Index >= 0 && Index < OutData->size() - 2);
-		for (int32 i = 0; i < 2; i++)
-		{
-			(*OutData)[Index + i] = ((byte)((Val >> (i * 8)) & 0xFF));
-		}
+		OutLayout->NumVariables += CBVSize;
+	}
+
+	// 28 bytes of header, then the RD11 block (magic, 6 unknown values, interface slot count)
+	uint32 Offset = 28 + 32;
+
+	OutLayout->ConstantBufferDescsOffset = Offset;
+	Offset += 24 * NumCBVs;
+
+	OutLayout->ResourceBindingsOffset = Offset;
+	Offset += 32 * OutLayout->NumResources;
+
+	// These ones don't get padded
+	OutLayout->ConstantBufferNamesOffset = Offset;
+	for (int32 CBVIndex = 0; CBVIndex < NumCBVs; CBVIndex++)
+	{
+		Offset += GetIndexedNameLength("res_", CBVIndex);
 	}
+
+	OutLayout->VariableDescsOffset = Offset;
+	Offset += 40 * OutLayout->NumVariables;
+
+	OutLayout->VariableNamesOffset = Offset;
+	for (int32 VarIndex = 0; VarIndex < OutLayout->NumVariables; VarIndex++)
+	{
+		Offset = AlignToFourBytes(Offset + GetIndexedNameLength("cb_var_", VarIndex));
+	}
+
+	OutLayout->VariableTypesOffset = Offset;
+	Offset += 36 * OutLayout->NumVariables;
+
+	OutLayout->TypeNameOffset = Offset;
+	if (OutLayout->NumVariables > 0)
+	{
+		Offset = AlignToFourBytes(Offset + sizeof("float4"));
+	}
+
+	OutLayout->ResourceNamesOffset = Offset;
+	for (int32 ResIndex = 0; ResIndex < OutLayout->NumResources; ResIndex++)
+	{
+		Offset = AlignToFourBytes(Offset + GetIndexedNameLength("res_", ResIndex));
+	}
+
+	OutLayout->CreatorOffset = Offset;
+	Offset = AlignToFourBytes(Offset + strlen(DXBCCreatorString) + 1);
+
+	OutLayout->Size = Offset;
 }
 
-void WriteStringtoUCharVector(std::vector<byte>* OutData, const char* Str)
+static uint32 GetIOSignatureChunkSize(const D3DOpcodeState* Opcodes, bool IsInput)
 {
-	// Include the null byte in this
-	int32 Len = strlen(Str) + 1;
-	int32 CurrentDataSize = OutData->size();
-	OutData->resize(CurrentDataSize + Len);
-	memcpy(OutData->data() + CurrentDataSize, Str, Len);
+	const auto& Semantics = IsInput ? Opcodes->InputSemantics : Opcodes->OutputSemantics;
+
+	// Element count + unknown flags, then 24 bytes per element, then the padded names
+	uint32 Offset = 8 + 24 * Semantics.size();
+	for (ShaderSemantic Semantic : Semantics)
+	{
+		Offset = AlignToFourBytes(Offset + strlen(GetSemanticNameFromSemantic(Semantic)) + 1);
+	}
+
+	return Offset;
 }
 
-void GenerateRDEFChunk(D3DOpcodeState* Opcodes, std::vector<byte>* OutData)
+static uint32 GetSHEXChunkSize(const D3DOpcodeState* Opcodes)
 {
-	const uint32 ChunkMagic = 0x46454452;
-	WriteU32ToUCharVectorLE(OutData, ChunkMagic);
-
-	int32 ChunkSizeIndex = OutData->size();
-	// Placeholder for size, we will fix up later
-	WriteU32ToUCharVectorLE(OutData, 0);
+	// Version/type + DWORD count, then the opcodes
+	return 8 + Opcodes->Opcodes.size() * 4;
+}
 
-	int32 ChunkDataStartIndex = OutData->size();
+void WriteRDEFChunk(const D3DOpcodeState* Opcodes, const DXBCRDEFLayout& Layout, DXBCByteWriter* Writer)
+{
+	const uint32 ChunkMagic = 0x46454452;
+	Writer->WriteU32(ChunkMagic);
+	Writer->WriteU32(Layout.Size);
 
-	WriteU32ToUCharVectorLE(OutData, Opcodes->CBVSizes.size());
+	const uint32 ChunkDataStart = Writer->Cursor;
+	ASSERT(ChunkDataStart % 4 == 0);
 
-	int32 CBVOffsetIndex = OutData->size();
-	// Placeholder for CBV offset, we will fix up later
-	WriteU32ToUCharVectorLE(OutData, 0);
+	const int32 NumCBVs = Opcodes->CBVSizes.size();
 
-	int32 NumResources = Opcodes->CBVSizes.size() + Opcodes->NumSamplers + Opcodes->NumTextures;
-	//int32 NumResources = Opcodes->CBVSizes.size() + Opcodes->NumSamplers;
-	//int32 NumResources = Opcodes->NumSamplers;
-	//int32 NumResources = Opcodes->NumSamplers + Opcodes->NumTextures;
-	//int32 NumResources = Opcodes->CBVSizes.size() + Opcodes->NumTextures;
-	//int32 NumResources = Opcodes->CBVSizes.size();
-	WriteU32ToUCharVectorLE(OutData, NumResources);
+	Writer->WriteU32(NumCBVs);
+	Writer->WriteU32((NumCBVs > 0) ? Layout.ConstantBufferDescsOffset : 0);
 
-	int32 RDefOffsetIndex = OutData->size();
-	// Placeholder for resource definitions offset, we will fix up later
-	WriteU32ToUCharVectorLE(OutData, 0);
+	Writer->WriteU32(Layout.NumResources);
+	Writer->WriteU32(Layout.ResourceBindingsOffset);
 
 	// Minor version number, major version number
-	OutData->push_back(0);
-	OutData->push_back(5);
+	Writer->WriteByte(0);
+	Writer->WriteByte(5);
 
 	// Shader type
 	if (Opcodes->ShaderType == D3DShaderType::Vertex)
 	{
-		OutData->push_back(0xFE);
-		OutData->push_back(0xFF);
+		Writer->WriteU16(0xFFFE);
 	}
 	else if (Opcodes->ShaderType == D3DShaderType::Pixel)
 	{
-		OutData->push_back(0xFF);
-		OutData->push_back(0xFF);
+		Writer->WriteU16(0xFFFF);
 	}
 	else
 	{
@@ -1944,506 +1799,727 @@ void GenerateRDEFChunk(D3DOpcodeState* Opcodes, std::vector<byte>* OutData)
 
 	// NoPreShader...not sure if we should put other stuff in here
 	uint32 MiscFlags = 0x100;
-	WriteU32ToUCharVectorLE(OutData, MiscFlags);
+	Writer->WriteU32(MiscFlags);
 
-	int32 CreatorNameOffsetIndex = OutData->size();
-	// Placeholder for offset to creator string
-	WriteU32ToUCharVectorLE(OutData, 0);
+	Writer->WriteU32(Layout.CreatorOffset);
 
 	const uint32 RD114CC = 0x31314452;
-	WriteU32ToUCharVectorLE(OutData, RD114CC);
+	Writer->WriteU32(RD114CC);
 
 	// Unknown, going off of what's produced by D3DCompile
-	WriteU32ToUCharVectorLE(OutData, 0x3C);
-	WriteU32ToUCharVectorLE(OutData, 0x18);
-	WriteU32ToUCharVectorLE(OutData, 0x20);
-	WriteU32ToUCharVectorLE(OutData, 0x28);
-	WriteU32ToUCharVectorLE(OutData, 0x24);
-	WriteU32ToUCharVectorLE(OutData, 0x0C);
+	Writer->WriteU32(0x3C);
+	Writer->WriteU32(0x18);
+	Writer->WriteU32(0x20);
+	Writer->WriteU32(0x28);
+	Writer->WriteU32(0x24);
+	Writer->WriteU32(0x0C);
 
 	uint32 InterfaceSlotCount = 0;
-	WriteU32ToUCharVectorLE(OutData, InterfaceSlotCount);
+	Writer->WriteU32(InterfaceSlotCount);
 
-	std::vector<int32> CBVNameOffsetIndices;
-	CBVNameOffsetIndices.reserve(Opcodes->CBVSizes.size());
+	ASSERT(Writer->Cursor - ChunkDataStart == Layout.ConstantBufferDescsOffset);
 
-	std::vector<int32> CBVVariableDescOffsetIndices;
-	CBVVariableDescOffsetIndices.reserve(Opcodes->CBVSizes.size());
-
-	if (Opcodes->CBVSizes.size() > 0)
-	{
-		WriteU32ToUCharVectorLE(OutData, OutData->size() - ChunkDataStartIndex, CBVOffsetIndex);
-	}
-	else
 	{
-		WriteU32ToUCharVectorLE(OutData, 0, CBVOffsetIndex);
-	}
+		uint32 NameOffset = Layout.ConstantBufferNamesOffset;
+		uint32 VariableDescOffset = Layout.VariableDescsOffset;
+		for (int32 CBVIndex = 0; CBVIndex < NumCBVs; CBVIndex++)
+		{
+			int32 CBVSize = Opcodes->CBVSizes[CBVIndex];
 
-	for (int32 CBVSize : Opcodes->CBVSizes)
-	{
-		CBVNameOffsetIndices.push_back(OutData->size());
-		// Placeholder for CBV name offset, we will fix up later
-		WriteU32ToUCharVectorLE(OutData, 0);
+			Writer->WriteU32(NameOffset);
+			NameOffset += GetIndexedNameLength("res_", CBVIndex);
 
-		// Number of variables
-		WriteU32ToUCharVectorLE(OutData, CBVSize);
+			// Number of variables
+			Writer->WriteU32(CBVSize);
 
-		CBVVariableDescOffsetIndices.push_back(OutData->size());
-		// Placeholder for CBV variable descriptions offset, we will fix up later
-		WriteU32ToUCharVectorLE(OutData, 0);
+			Writer->WriteU32(VariableDescOffset);
+			VariableDescOffset += 40 * CBVSize;
 
-		// CBV size in bytes, not numbers of float4 registers
-		WriteU32ToUCharVectorLE(OutData, CBVSize * 16);
+			// CBV size in bytes, not numbers of float4 registers
+			Writer->WriteU32(CBVSize * 16);
 
-		// Flags, which are none
-		WriteU32ToUCharVectorLE(OutData, 0);
+			// Flags, which are none
+			Writer->WriteU32(0);
 
-		// D3D11_CT_CBUFFER type
-		WriteU32ToUCharVectorLE(OutData, 0);
+			// D3D11_CT_CBUFFER type
+			Writer->WriteU32(0);
+		}
 	}
 
-	std::vector<int32> ResourceBindingNameOffsetIndices;
-	ResourceBindingNameOffsetIndices.reserve(NumResources);
+	ASSERT(Writer->Cursor - ChunkDataStart == Layout.ResourceBindingsOffset);
 
-	auto AddResource = [&](uint32 ResourceType, int32 BindIndex) {
-		ResourceBindingNameOffsetIndices.push_back(OutData->size());
-		// Placeholder for resource name offset, we will fix up later
-		WriteU32ToUCharVectorLE(OutData, 0);
+	{
+		uint32 NameOffset = Layout.ResourceNamesOffset;
+		int32 ResIndex = 0;
 
-		// Resource type (0 = cbv, 2 = texture, 3 = sampler)
-		WriteU32ToUCharVectorLE(OutData, ResourceType);
+		auto AddResource = [&](uint32 ResourceType, int32 BindIndex) {
+			Writer->WriteU32(NameOffset);
+			NameOffset = AlignToFourBytes(NameOffset + GetIndexedNameLength("res_", ResIndex));
+			ResIndex++;
 
-		// Resource return type
-		WriteU32ToUCharVectorLE(OutData, (ResourceType == 2) ? 5 : 0);
+			// Resource type (0 = cbv, 2 = texture, 3 = sampler)
+			Writer->WriteU32(ResourceType);
 
-		// Resource view dimension
-		// TODO: Other texture dimensions
-		// 0 - N/A
-		// 1 - buff
-		// 2 - 1d
-		// 3 - 1darray
-		// 4 - 2d
-		// 5 - 2darray
-		// 6 - 2d MS
-		// 7 - 2darray MS
-		// 8 - 3d
-		WriteU32ToUCharVectorLE(OutData, (ResourceType == 2) ? 4 : 0);
+			// Resource return type
+			Writer->WriteU32((ResourceType == 2) ? 5 : 0);
 
-		// Number of samples
-		WriteU32ToUCharVectorLE(OutData, (ResourceType == 2) ? -1 : 0);
+			// Resource view dimension
+			// TODO: Other texture dimensions
+			// 0 - N/A
+			// 1 - buff
+			// 2 - 1d
+			// 3 - 1darray
+			// 4 - 2d
+			// 5 - 2darray
+			// 6 - 2d MS
+			// 7 - 2darray MS
+			// 8 - 3d
+			Writer->WriteU32((ResourceType == 2) ? 4 : 0);
 
-		// Bind point
-		WriteU32ToUCharVectorLE(OutData, BindIndex);
+			// Number of samples
+			Writer->WriteU32((ResourceType == 2) ? -1 : 0);
 
-		// Bind count
-		WriteU32ToUCharVectorLE(OutData, 1);
+			// Bind point
+			Writer->WriteU32(BindIndex);
 
-		// Shader flags
-		WriteU32ToUCharVectorLE(OutData, (ResourceType == 2) ? 0x0C : 0);
-	};
+			// Bind count
+			Writer->WriteU32(1);
 
-	WriteU32ToUCharVectorLE(OutData, OutData->size() - ChunkDataStartIndex, RDefOffsetIndex);
+			// Shader flags
+			Writer->WriteU32((ResourceType == 2) ? 0x0C : 0);
+		};
 
-	for (int32 CBVIndex = 0; CBVIndex < Opcodes->CBVSizes.size(); CBVIndex++)
-	{
-		AddResource(0, CBVIndex);
-	}
+		for (int32 CBVIndex = 0; CBVIndex < NumCBVs; CBVIndex++)
+		{
+			AddResource(0, CBVIndex);
+		}
 
-	for (int32 SamplerIndex = 0; SamplerIndex < Opcodes->NumSamplers; SamplerIndex++)
-	{
-		AddResource(3, SamplerIndex);
+		for (int32 SamplerIndex = 0; SamplerIndex < Opcodes->NumSamplers; SamplerIndex++)
+		{
+			AddResource(3, SamplerIndex);
+		}
+
+		for (int32 TextureIndex = 0; TextureIndex < Opcodes->NumTextures; TextureIndex++)
+		{
+			AddResource(2, TextureIndex);
+		}
 	}
 
-	for (int32 TextureIndex = 0; TextureIndex < Opcodes->NumTextures; TextureIndex++)
+	ASSERT(Writer->Cursor - ChunkDataStart == Layout.ConstantBufferNamesOffset);
+
+	for (int32 CBVIndex = 0; CBVIndex < NumCBVs; CBVIndex++)
 	{
-		AddResource(2, TextureIndex);
+		Writer->WriteIndexedName("res_", CBVIndex);
 	}
 
-	for (int32 CBVIndex = 0; CBVIndex < CBVNameOffsetIndices.size(); CBVIndex++)
+	ASSERT(Writer->Cursor - ChunkDataStart == Layout.VariableDescsOffset);
+
 	{
-		int32 CBVNameOffsetIndex = CBVNameOffsetIndices[CBVIndex];
-		WriteU32ToUCharVectorLE(OutData, OutData->size() - ChunkDataStartIndex, CBVNameOffsetIndex);
+		// The variable names/types are numbered across all CBVs, each variable is a float4
+		uint32 NameOffset = Layout.VariableNamesOffset;
+		int32 VarIndex = 0;
+		for (int32 CBVSize : Opcodes->CBVSizes)
+		{
+			for (int32 VarIdxInCBV = 0; VarIdxInCBV < CBVSize; VarIdxInCBV++)
+			{
+				Writer->WriteU32(NameOffset);
+				NameOffset = AlignToFourBytes(NameOffset + GetIndexedNameLength("cb_var_", VarIndex));
 
-		WriteStringtoUCharVector(OutData, StringStackBuffer<256>("res_%d", CBVIndex).buffer);
-	}
+				// Offset of variable w/in CBV in bytes
+				Writer->WriteU32(16 * VarIdxInCBV);
+				// Size of variable in bytes
+				Writer->WriteU32(16);
 
-	std::vector<int32> CBVVarNameOffsetIndices;
-	std::vector<int32> CBVVarTypeOffsetIndices;
-	for (int32 CBVIndex = 0; CBVIndex < CBVVariableDescOffsetIndices.size(); CBVIndex++)
-	{
-		int32 CBVVariableDescOffsetIndex = CBVVariableDescOffsetIndices[CBVIndex];
-		WriteU32ToUCharVectorLE(OutData, OutData->size() - ChunkDataStartIndex, CBVVariableDescOffsetIndex);
+				// Flags (0x02 means it's used in the shader...which might not be true?)
+				Writer->WriteU32(0x02);
 
-		int32 VarCount = Opcodes->CBVSizes[CBVIndex];
-		for (int32 VarIdx = 0; VarIdx < VarCount; VarIdx++)
-		{
-			CBVVarNameOffsetIndices.push_back(OutData->size());
-			// Placeholder for CBV name offset, we will fix up later
-			WriteU32ToUCharVectorLE(OutData, 0);
-
-			// Offset of variable w/in CBV in bytes
-			WriteU32ToUCharVectorLE(OutData, 16 * VarIdx);
-			// Size of variable in bytes
-			WriteU32ToUCharVectorLE(OutData, 16);
-			
-			// Flags (0x02 means it's used in the shader...which might not be true?)
-			WriteU32ToUCharVectorLE(OutData, 0x02);
+				Writer->WriteU32(Layout.VariableTypesOffset + 36 * VarIndex);
 
-			CBVVarTypeOffsetIndices.push_back(OutData->size());
-			// Placeholder for CBV type offset, we will fix up later
-			WriteU32ToUCharVectorLE(OutData, 0);
+				// Offset to default value, we can just put this as 0 and it won't try to read it
+				Writer->WriteU32(0);
 
-			// Offset to default value, we can just put this as 0 and it won't try to read it
-			WriteU32ToUCharVectorLE(OutData, 0);
-			
-			// Unknown, something to do with textures/samplers maybe
-			WriteU32ToUCharVectorLE(OutData, -1);
-			WriteU32ToUCharVectorLE(OutData, 0);
-			WriteU32ToUCharVectorLE(OutData, -1);
-			WriteU32ToUCharVectorLE(OutData, 0);
+				// Unknown, something to do with textures/samplers maybe
+				Writer->WriteU32(-1);
+				Writer->WriteU32(0);
+				Writer->WriteU32(-1);
+				Writer->WriteU32(0);
+
+				VarIndex++;
+			}
 		}
 	}
 
-	ASSERT(CBVVarNameOffsetIndices.size() == CBVVarTypeOffsetIndices.size());
+	ASSERT(Writer->Cursor - ChunkDataStart == Layout.VariableNamesOffset);
 
-	for (int32 CBVVarIndex = 0; CBVVarIndex < CBVVarNameOffsetIndices.size(); CBVVarIndex++)
+	for (int32 VarIndex = 0; VarIndex < Layout.NumVariables; VarIndex++)
 	{
-		int32 CBVVarNameOffsetIndex = CBVVarNameOffsetIndices[CBVVarIndex];
-		WriteU32ToUCharVectorLE(OutData, OutData->size() - ChunkDataStartIndex, CBVVarNameOffsetIndex);
-
-		WriteStringtoUCharVector(OutData, StringStackBuffer<256>("cb_var_%d", CBVVarIndex).buffer);
-		// Uhhh...padding?
-		while (OutData->size() % 4 != 0)
-		{
-			OutData->push_back(0xAB);
-		}
+		Writer->WriteIndexedName("cb_var_", VarIndex);
+		Writer->PadToFourBytes();
 	}
 
-	std::vector<int32> CBVVarTypeNameOffsetIndices;
-	for (int32 CBVVarIndex = 0; CBVVarIndex < CBVVarTypeOffsetIndices.size(); CBVVarIndex++)
-	{
-		int32 CBVVarTypeOffsetIndex = CBVVarTypeOffsetIndices[CBVVarIndex];
-		WriteU32ToUCharVectorLE(OutData, OutData->size() - ChunkDataStartIndex, CBVVarTypeOffsetIndex);
+	ASSERT(Writer->Cursor - ChunkDataStart == Layout.VariableTypesOffset);
 
+	for (int32 VarIndex = 0; VarIndex < Layout.NumVariables; VarIndex++)
+	{
 		// Variable class (D3D_SVC_VECTOR)
-		WriteU16ToUCharVectorLE(OutData, 0x01);
+		Writer->WriteU16(0x01);
 
 		// Variable type (D3D_SVT_FLOAT)
-		WriteU16ToUCharVectorLE(OutData, 0x03);
+		Writer->WriteU16(0x03);
 
 		// Number of rows
-		WriteU16ToUCharVectorLE(OutData, 1);
+		Writer->WriteU16(1);
 		// Number of columns
-		WriteU16ToUCharVectorLE(OutData, 4);
+		Writer->WriteU16(4);
 
 		// Array size (irrelevant for vectors)
-		WriteU16ToUCharVectorLE(OutData, 0);
+		Writer->WriteU16(0);
 
 		// Number of members ina  struct (irrelevant for vectors)
-		WriteU16ToUCharVectorLE(OutData, 0);
+		Writer->WriteU16(0);
 
 		// Offset from chunk data start to first member (irrelevant for vectors)
-		WriteU16ToUCharVectorLE(OutData, 0);
-		
+		Writer->WriteU16(0);
+
 		// Unkown, maybe some flags
-		WriteU16ToUCharVectorLE(OutData, 0);
-		
+		Writer->WriteU16(0);
+
 		// Maybe some texture/sampler data? Idk, seems to only be in SM5.0 or higher
-		WriteU32ToUCharVectorLE(OutData, 0);
-		WriteU32ToUCharVectorLE(OutData, 0);
-		WriteU32ToUCharVectorLE(OutData, 0);
-		WriteU32ToUCharVectorLE(OutData, 0);
+		Writer->WriteZeros(16);
 
-		CBVVarTypeNameOffsetIndices.push_back(OutData->size());
-		// Placeholder for CBV type name offset, we will fix up later
-		WriteU32ToUCharVectorLE(OutData, 0);
+		Writer->WriteU32(Layout.TypeNameOffset);
 	}
 
-	if (CBVVarTypeNameOffsetIndices.size() > 0)
-	{
-		for (int32 CBVVarIndex = 0; CBVVarIndex < CBVVarTypeNameOffsetIndices.size(); CBVVarIndex++)
-		{
-			int32 CBVVarTypeNameOffsetIndex = CBVVarTypeNameOffsetIndices[CBVVarIndex];
-			WriteU32ToUCharVectorLE(OutData, OutData->size() - ChunkDataStartIndex, CBVVarTypeNameOffsetIndex);
-		}
+	ASSERT(Writer->Cursor - ChunkDataStart == Layout.TypeNameOffset);
 
-		WriteStringtoUCharVector(OutData, "float4");
-		// Uhhh...padding?
-		while (OutData->size() % 4 != 0)
-		{
-			OutData->push_back(0xAB);
-		}
+	if (Layout.NumVariables > 0)
+	{
+		Writer->WriteString("float4");
+		Writer->PadToFourBytes();
 	}
 
+	ASSERT(Writer->Cursor - ChunkDataStart == Layout.ResourceNamesOffset);
 
-	for (int32 ResIndex = 0; ResIndex < ResourceBindingNameOffsetIndices.size(); ResIndex++)
+	for (int32 ResIndex = 0; ResIndex < Layout.NumResources; ResIndex++)
 	{
-		int32 ResourceBindingNameOffsetIndex = ResourceBindingNameOffsetIndices[ResIndex];
-		WriteU32ToUCharVectorLE(OutData, OutData->size() - ChunkDataStartIndex, ResourceBindingNameOffsetIndex);
-
-		WriteStringtoUCharVector(OutData, StringStackBuffer<256>("res_%d", ResIndex).buffer);
-		// Uhhh...padding?
-		while (OutData->size() % 4 != 0)
-		{
-			OutData->push_back(0xAB);
-		}
+		Writer->WriteIndexedName("res_", ResIndex);
+		Writer->PadToFourBytes();
 	}
 
-	{
-		WriteU32ToUCharVectorLE(OutData, OutData->size() - ChunkDataStartIndex, CreatorNameOffsetIndex);
-
-		// I'm just gonna guess that maybe some driver detects non-MS compilers and does some different path,
-		// so for now let's just play it safe and pretend we're coming out of the official compiler
-		WriteStringtoUCharVector(OutData, "Microsoft (R) HLSL Shader Compiler 10.1");
-	}
+	ASSERT(Writer->Cursor - ChunkDataStart == Layout.CreatorOffset);
 
-	{
-		while (OutData->size() % 4 != 0)
-		{
-			OutData->push_back(0xAB);
-		}
-	}
+	// I'm just gonna guess that maybe some driver detects non-MS compilers and does some different path,
+	// so for now let's just play it safe and pretend we're coming out of the official compiler
+	Writer->WriteString(DXBCCreatorString);
+	Writer->PadToFourBytes();
 
-	// Now that we know the chunk size, go back and fix it up
-	WriteU32ToUCharVectorLE(OutData, OutData->size() - ChunkDataStartIndex, ChunkSizeIndex);
+	ASSERT(Writer->Cursor - ChunkDataStart == Layout.Size);
 }
 
-void GenerateIOSignatureChunk(D3DOpcodeState* Opcodes, std::vector<byte>* OutData, bool IsInput)
+void WriteIOSignatureChunk(const D3DOpcodeState* Opcodes, uint32 ChunkSize, bool IsInput, DXBCByteWriter* Writer)
 {
 	const uint32 ChunkMagic = IsInput ? 0x4E475349 : 0x4E47534F;
-	WriteU32ToUCharVectorLE(OutData, ChunkMagic);
+	Writer->WriteU32(ChunkMagic);
+	Writer->WriteU32(ChunkSize);
 
-	int32 ChunkSizeIndex = OutData->size();
-	// Placeholder for size, we will fix up later
-	WriteU32ToUCharVectorLE(OutData, 0);
-
-	int32 ChunkDataStartIndex = OutData->size();
+	const uint32 ChunkDataStart = Writer->Cursor;
 
 	const auto& Semantics = IsInput ? Opcodes->InputSemantics : Opcodes->OutputSemantics;
 
-	WriteU32ToUCharVectorLE(OutData, Semantics.size());
+	Writer->WriteU32(Semantics.size());
 
 	// ???
 	uint32 MaybeFlags = 0x08;
-	WriteU32ToUCharVectorLE(OutData, MaybeFlags);
-
-	std::vector<int32> ElementNameOffsetIndices;
-	ElementNameOffsetIndices.reserve(Semantics.size());
+	Writer->WriteU32(MaybeFlags);
 
+	uint32 NameOffset = 8 + 24 * Semantics.size();
 	for (int32 SignatureIndex = 0; SignatureIndex < Semantics.size(); SignatureIndex++)
 	{
-		ElementNameOffsetIndices.push_back(OutData->size());
-		// Placeholder for element name offset, we will fix up later
-		WriteU32ToUCharVectorLE(OutData, 0);
+		Writer->WriteU32(NameOffset);
+		NameOffset = AlignToFourBytes(NameOffset + strlen(GetSemanticNameFromSemantic(Semantics[SignatureIndex])) + 1);
 
 		// Semantic index (always 0, we never re-use semantics)
-		WriteU32ToUCharVectorLE(OutData, 0);
+		Writer->WriteU32(0);
 
 		// System semantic
-		WriteU32ToUCharVectorLE(OutData, ShaderSemanticToOperandSemantic(Semantics[SignatureIndex]));
+		Writer->WriteU32(ShaderSemanticToOperandSemantic(Semantics[SignatureIndex]));
 
 		// Type (3 = floating point)
-		WriteU32ToUCharVectorLE(OutData, 0x03);
+		Writer->WriteU32(0x03);
 
 		// Register
-		WriteU32ToUCharVectorLE(OutData, SignatureIndex);
+		Writer->WriteU32(SignatureIndex);
 
 		// Masks (first is declaration, second is read/write)
-		OutData->push_back(0x0F);
+		Writer->WriteByte(0x0F);
 		// TODO: ????????
 		if (IsInput)
 		{
-			OutData->push_back(0x0F);
+			Writer->WriteByte(0x0F);
 		}
 		else
 		{
-			OutData->push_back(0x00);
+			Writer->WriteByte(0x00);
 		}
 
 		// ??? Is this padding, or some new stuff in SM 5.0 ?
-		WriteU16ToUCharVectorLE(OutData, 0);
+		Writer->WriteU16(0);
 	}
 
 	for (int32 SignatureIndex = 0; SignatureIndex < Semantics.size(); SignatureIndex++)
 	{
-		int32 ElementNameOffsetIndex = ElementNameOffsetIndices[SignatureIndex];
-		WriteU32ToUCharVectorLE(OutData, OutData->size() - ChunkDataStartIndex, ElementNameOffsetIndex);
-
-		WriteStringtoUCharVector(OutData, GetSemanticNameFromSemantic(Semantics[SignatureIndex]));
-
-		// Uhhh...padding?
-		while (OutData->size() % 4 != 0)
-		{
-			OutData->push_back(0xAB);
-		}
+		Writer->WriteString(GetSemanticNameFromSemantic(Semantics[SignatureIndex]));
+		Writer->PadToFourBytes();
 	}
 
-	// Now that we know the chunk size, go back and fix it up
-	WriteU32ToUCharVectorLE(OutData, OutData->size() - ChunkDataStartIndex, ChunkSizeIndex);
+	ASSERT(Writer->Cursor - ChunkDataStart == ChunkSize);
 }
 
-void GenerateSHEXChunk(D3DOpcodeState* Opcodes, std::vector<byte>* OutData)
+void WriteSHEXChunk(const D3DOpcodeState* Opcodes, uint32 ChunkSize, DXBCByteWriter* Writer)
 {
-	int32 NumberOfBytes = Opcodes->Opcodes.size() * 4;
-
 	const uint32 ChunkMagic = 0x58454853;
-	WriteU32ToUCharVectorLE(OutData, ChunkMagic);
+	Writer->WriteU32(ChunkMagic);
 
 	// 8 bytes of the header
-	int32 ChunkSize = NumberOfBytes + 8;
-	WriteU32ToUCharVectorLE(OutData, ChunkSize);
+	Writer->WriteU32(ChunkSize);
 
 	// Version: major version is high nibble (5), minor version is low nibble (0)
-	OutData->push_back(0x50);
+	Writer->WriteByte(0x50);
 	// Uhhh....idk
-	OutData->push_back(0x00);
+	Writer->WriteByte(0x00);
 
 	if (Opcodes->ShaderType == D3DShaderType::Vertex)
 	{
-		WriteU16ToUCharVectorLE(OutData, 0x01);
+		Writer->WriteU16(0x01);
 	}
 	else if (Opcodes->ShaderType == D3DShaderType::Pixel)
 	{
-		WriteU16ToUCharVectorLE(OutData, 0x00);
+		Writer->WriteU16(0x00);
 	}
 	else
 	{
 		ASSERT(false);
 	}
 
-	WriteU32ToUCharVectorLE(OutData, Opcodes->Opcodes.size() + 2);
+	Writer->WriteU32(Opcodes->Opcodes.size() + 2);
 
-	int32 OpcodeStartIndex = OutData->size();
-	OutData->resize(OutData->size() + NumberOfBytes);
-	memcpy(OutData->data() + OpcodeStartIndex, Opcodes->Opcodes.data(), NumberOfBytes);
+	Writer->WriteBytes(Opcodes->Opcodes.data(), Opcodes->Opcodes.size() * 4);
 }
 
-void GenerateSTATChunk(D3DOpcodeState* Opcodes, std::vector<byte>* OutData)
+void WriteSTATChunk(const D3DOpcodeState* Opcodes, DXBCByteWriter* Writer)
 {
 	// TODO: Does this really matter?
 
 	// 53 54 41 54
 	const uint32 ChunkMagic = 0x54415453;
-	WriteU32ToUCharVectorLE(OutData, ChunkMagic);
+	Writer->WriteU32(ChunkMagic);
 
-	// 8 bytes of the header
-	int32 ChunkSize = 148;
-	WriteU32ToUCharVectorLE(OutData, ChunkSize);
+	Writer->WriteU32(DXBC_STAT_CHUNK_SIZE);
 
-	int32 StartOfChunkIndex = OutData->size();
+	// TODO: I...don't think this is used anywhere really? I'm still suspicious it'll be used
+	// (offsets 0x00 and 0x0C might want 2, 0x1C and 0x3C might want 1)
+	Writer->WriteZeros(DXBC_STAT_CHUNK_SIZE);
+}
 
-	OutData->resize(OutData->size() + ChunkSize);
+// Everything except SHEX only depends on a handful of parameters, and RandomiseShaderBytecodeParams
+// only has a few thousand combinations of them, so we build each of those chunks once and then just copy them in.
+// Entries are never removed, so pointers into the maps stay valid without holding the lock
+struct DXBCChunkTemplateCache
+{
+	std::mutex Mutex;
+	std::unordered_map<uint64, std::vector<byte>> RDEFChunks;
+	std::unordered_map<uint64, std::vector<byte>> SignatureChunks;
+};
 
-	// TODO: I...don't think this is used anywhere really? I'm still suspicious it'll be used
-	//WriteU32ToUCharVectorLE(OutData, 2, StartOfChunkIndex + 0x00);
-	//WriteU32ToUCharVectorLE(OutData, 2, StartOfChunkIndex + 0x0C);
-	//WriteU32ToUCharVectorLE(OutData, 1, StartOfChunkIndex + 0x1C);
-	//WriteU32ToUCharVectorLE(OutData, 1, StartOfChunkIndex + 0x3C);
+// Way more than we should ever need, but stops a change to the generator from eating all our memory
+#define DXBC_CHUNK_TEMPLATE_CACHE_MAX_ENTRIES 65536
+
+static DXBCChunkTemplateCache* GetChunkTemplateCache()
+{
+	static DXBCChunkTemplateCache Cache;
+	return &Cache;
+}
+
+// Packs everything the RDEF chunk depends on into 4 bits per field. Returns false if
+// something doesn't fit, in which case the chunk just gets written directly
+static bool GetRDEFChunkKey(const D3DOpcodeState* Opcodes, uint64* OutKey)
+{
+	if (Opcodes->NumSamplers < 0 || Opcodes->NumSamplers >= 16 || Opcodes->NumTextures < 0 || Opcodes->NumTextures >= 16 || Opcodes->CBVSizes.size() > 12)
+	{
+		return false;
+	}
+
+	uint64 Key = (uint64)Opcodes->ShaderType;
+	Key |= (uint64)Opcodes->NumSamplers << 4;
+	Key |= (uint64)Opcodes->NumTextures << 8;
+	Key |= (uint64)Opcodes->CBVSizes.size() << 12;
+
+	for (int32 i = 0; i < Opcodes->CBVSizes.size(); i++)
+	{
+		if (Opcodes->CBVSizes[i] < 0 || Opcodes->CBVSizes[i] >= 16)
+		{
+			return false;
+		}
+
+		Key |= (uint64)Opcodes->CBVSizes[i] << (16 + 4 * i);
+	}
+
+	*OutKey = Key;
+	return true;
+}
+
+// Same idea as GetRDEFChunkKey, but for the semantics in ISGN/OSGN
+static bool GetSignatureChunkKey(const D3DOpcodeState* Opcodes, bool IsInput, uint64* OutKey)
+{
+	const auto& Semantics = IsInput ? Opcodes->InputSemantics : Opcodes->OutputSemantics;
+	if (Semantics.size() > 14)
+	{
+		return false;
+	}
+
+	static_assert((int32)ShaderSemantic::Count <= 16, "Semantics need more than 4 bits in GetSignatureChunkKey");
+
+	uint64 Key = IsInput ? 1 : 0;
+	Key |= (uint64)Semantics.size() << 1;
+	for (int32 i = 0; i < Semantics.size(); i++)
+	{
+		Key |= (uint64)Semantics[i] << (5 + 4 * i);
+	}
+
+	*OutKey = Key;
+	return true;
 }
 
-void GenerateShaderBytecode(D3DOpcodeState* Opcodes, std::vector<byte>* OutBytecode)
+template<typename BuildFunc>
+static const std::vector<byte>* GetOrBuildChunkTemplate(std::unordered_map<uint64, std::vector<byte>>* Chunks, uint64 Key, BuildFunc Build)
+{
+	DXBCChunkTemplateCache* Cache = GetChunkTemplateCache();
+
+	{
+		std::lock_guard<std::mutex> Lock(Cache->Mutex);
+		auto Iter = Chunks->find(Key);
+		if (Iter != Chunks->end())
+		{
+			return &Iter->second;
+		}
+
+		if (Chunks->size() >= DXBC_CHUNK_TEMPLATE_CACHE_MAX_ENTRIES)
+		{
+			return nullptr;
+		}
+	}
+
+	// Build outside the lock, if another thread beats us to it we just use theirs
+	std::vector<byte> ChunkBytes;
+	Build(&ChunkBytes);
+
+	std::lock_guard<std::mutex> Lock(Cache->Mutex);
+	auto Inserted = Chunks->emplace(Key, std::move(ChunkBytes));
+	return &Inserted.first->second;
+}
+
+static const std::vector<byte>* GetRDEFChunkTemplate(const D3DOpcodeState* Opcodes)
+{
+	uint64 Key = 0;
+	if (!GetRDEFChunkKey(Opcodes, &Key))
+	{
+		return nullptr;
+	}
+
+	return GetOrBuildChunkTemplate(&GetChunkTemplateCache()->RDEFChunks, Key, [&](std::vector<byte>* OutBytes) {
+		DXBCRDEFLayout Layout;
+		ComputeRDEFLayout(Opcodes, &Layout);
+
+		// Chunk header is the magic + size
+		OutBytes->resize(8 + Layout.Size);
+
+		DXBCByteWriter Writer;
+		Writer.Data = OutBytes->data();
+		Writer.Capacity = OutBytes->size();
+		WriteRDEFChunk(Opcodes, Layout, &Writer);
+	});
+}
+
+static const std::vector<byte>* GetSignatureChunkTemplate(const D3DOpcodeState* Opcodes, bool IsInput)
+{
+	uint64 Key = 0;
+	if (!GetSignatureChunkKey(Opcodes, IsInput, &Key))
+	{
+		return nullptr;
+	}
+
+	return GetOrBuildChunkTemplate(&GetChunkTemplateCache()->SignatureChunks, Key, [&](std::vector<byte>* OutBytes) {
+		uint32 ChunkSize = GetIOSignatureChunkSize(Opcodes, IsInput);
+		OutBytes->resize(8 + ChunkSize);
+
+		DXBCByteWriter Writer;
+		Writer.Data = OutBytes->data();
+		Writer.Capacity = OutBytes->size();
+		WriteIOSignatureChunk(Opcodes, ChunkSize, IsInput, &Writer);
+	});
+}
+
+// STAT never changes, so there's only ever one of these
+static const std::vector<byte>* GetSTATChunkTemplate()
+{
+	static const std::vector<byte> STATChunk = []() {
+		std::vector<byte> ChunkBytes(8 + DXBC_STAT_CHUNK_SIZE);
+
+		DXBCByteWriter Writer;
+		Writer.Data = ChunkBytes.data();
+		Writer.Capacity = ChunkBytes.size();
+		WriteSTATChunk(nullptr, &Writer);
+
+		return ChunkBytes;
+	}();
+
+	return &STATChunk;
+}
+
+// Order of the chunks in the container
+enum DXBCChunkSlot
+{
+	DXBCChunkSlot_RDEF,
+	DXBCChunkSlot_ISGN,
+	DXBCChunkSlot_OSGN,
+	DXBCChunkSlot_SHEX,
+	DXBCChunkSlot_STAT,
+	DXBCChunkSlot_Count
+};
+
+static_assert(DXBCChunkSlot_Count == DXBC_CHUNK_COUNT, "Check DXBCChunkSlot");
+
+struct DXBCContainerLayout
+{
+	DXBCRDEFLayout RDEF;
+	// Pre-built chunk (header included) if there is one, otherwise it gets written in place
+	const std::vector<byte>* ChunkTemplates[DXBC_CHUNK_COUNT] = {};
+	uint32 ChunkOffsets[DXBC_CHUNK_COUNT] = {};
+	uint32 ChunkSizes[DXBC_CHUNK_COUNT] = {};
+	uint32 TotalSize = 0;
+};
+
+static void ComputeContainerLayout(const D3DOpcodeState* Opcodes, DXBCContainerLayout* OutLayout)
 {
+	OutLayout->ChunkTemplates[DXBCChunkSlot_RDEF] = GetRDEFChunkTemplate(Opcodes);
+	OutLayout->ChunkTemplates[DXBCChunkSlot_ISGN] = GetSignatureChunkTemplate(Opcodes, true);
+	OutLayout->ChunkTemplates[DXBCChunkSlot_OSGN] = GetSignatureChunkTemplate(Opcodes, false);
+	OutLayout->ChunkTemplates[DXBCChunkSlot_STAT] = GetSTATChunkTemplate();
+
+	if (OutLayout->ChunkTemplates[DXBCChunkSlot_RDEF] == nullptr)
+	{
+		ComputeRDEFLayout(Opcodes, &OutLayout->RDEF);
+		OutLayout->ChunkSizes[DXBCChunkSlot_RDEF] = OutLayout->RDEF.Size;
+	}
+
+	if (OutLayout->ChunkTemplates[DXBCChunkSlot_ISGN] == nullptr)
+	{
+		OutLayout->ChunkSizes[DXBCChunkSlot_ISGN] = GetIOSignatureChunkSize(Opcodes, true);
+	}
+
+	if (OutLayout->ChunkTemplates[DXBCChunkSlot_OSGN] == nullptr)
+	{
+		OutLayout->ChunkSizes[DXBCChunkSlot_OSGN] = GetIOSignatureChunkSize(Opcodes, false);
+	}
+
+	OutLayout->ChunkSizes[DXBCChunkSlot_SHEX] = GetSHEXChunkSize(Opcodes);
+
+	for (int32 i = 0; i < DXBC_CHUNK_COUNT; i++)
+	{
+		if (OutLayout->ChunkTemplates[i] != nullptr)
+		{
+			OutLayout->ChunkSizes[i] = OutLayout->ChunkTemplates[i]->size() - 8;
+		}
+	}
+
+	uint32 Offset = sizeof(DXBCFileHeader) + 4 * DXBC_CHUNK_COUNT;
+	for (int32 i = 0; i < DXBC_CHUNK_COUNT; i++)
+	{
+		OutLayout->ChunkOffsets[i] = Offset;
+		// 8 bytes of chunk header (magic + size)
+		Offset += 8 + OutLayout->ChunkSizes[i];
+	}
+
+	OutLayout->TotalSize = Offset;
+}
+
+void WriteShaderBytecodeWithAllocator(const D3DOpcodeState* Opcodes, byte* (*AllocateBuffer)(void* UserData, uint32 Size), void* UserData, bool WriteChecksum)
+{
+	// Only done once per shader, since it goes through the chunk template caches
+	DXBCContainerLayout Layout;
+	ComputeContainerLayout(Opcodes, &Layout);
+
+	const uint32 BufferSize = Layout.TotalSize;
+	byte* OutBuffer = AllocateBuffer(UserData, BufferSize);
+	ASSERT(OutBuffer != nullptr);
+
+	DXBCByteWriter Writer;
+	Writer.Data = OutBuffer;
+	Writer.Capacity = BufferSize;
+
+	// Everything after the checksum field gets hashed, we feed the hash each piece as soon as
+	// it's written so we don't have to go back over the whole thing at the end
+	DxbcHashContext HashContext;
+	dxbcHashInit(&HashContext);
+	const uint32 ChecksumOffset = 4;
+	const uint32 HashStartOffset = 20;
+	uint32 HashedUpTo = HashStartOffset;
+
+	auto HashNewBytes = [&]() {
+		if (WriteChecksum)
+		{
+			dxbcHashUpdate(&HashContext, OutBuffer + HashedUpTo, Writer.Cursor - HashedUpTo);
+			HashedUpTo = Writer.Cursor;
+		}
+	};
+
+	// The checksum goes in last, but the file size is known now since we did the layout first
 	DXBCFileHeader DXBCHeader = {};
 	DXBCHeader.MagicNumbers[0] = 'D';
 	DXBCHeader.MagicNumbers[1] = 'X';
 	DXBCHeader.MagicNumbers[2] = 'B';
 	DXBCHeader.MagicNumbers[3] = 'C';
-	DXBCHeader.ChunkCount = 5;
+	DXBCHeader.FileSizeInBytes = Layout.TotalSize;
+	DXBCHeader.ChunkCount = DXBC_CHUNK_COUNT;
+	Writer.WriteBytes(&DXBCHeader, sizeof(DXBCHeader));
 
-	// Write the header, and write each chunk
-	OutBytecode->resize(sizeof(DXBCFileHeader));
-	memcpy(OutBytecode->data(), &DXBCHeader, sizeof(DXBCFileHeader));
-
-	int32 ChunkOffsetsStartIndex = OutBytecode->size();
+	for (int32 i = 0; i < DXBC_CHUNK_COUNT; i++)
+	{
+		Writer.WriteU32(Layout.ChunkOffsets[i]);
+	}
+	HashNewBytes();
 
-	for (int32 i = 0; i < DXBCHeader.ChunkCount; i++)
+	for (int32 ChunkIdx = 0; ChunkIdx < DXBC_CHUNK_COUNT; ChunkIdx++)
 	{
-		// Write in a placeholder 0, we will come back later
-		WriteU32ToUCharVectorLE(OutBytecode, 0);
+		ASSERT(Writer.Cursor == Layout.ChunkOffsets[ChunkIdx]);
+
+		if (Layout.ChunkTemplates[ChunkIdx] != nullptr)
+		{
+			Writer.WriteBytes(Layout.ChunkTemplates[ChunkIdx]->data(), Layout.ChunkTemplates[ChunkIdx]->size());
+		}
+		else if (ChunkIdx == DXBCChunkSlot_RDEF)
+		{
+			WriteRDEFChunk(Opcodes, Layout.RDEF, &Writer);
+		}
+		else if (ChunkIdx == DXBCChunkSlot_ISGN || ChunkIdx == DXBCChunkSlot_OSGN)
+		{
+			WriteIOSignatureChunk(Opcodes, Layout.ChunkSizes[ChunkIdx], ChunkIdx == DXBCChunkSlot_ISGN, &Writer);
+		}
+		else if (ChunkIdx == DXBCChunkSlot_SHEX)
+		{
+			WriteSHEXChunk(Opcodes, Layout.ChunkSizes[ChunkIdx], &Writer);
+		}
+		else
+		{
+			ASSERT(false);
+		}
+
+		HashNewBytes();
 	}
 
-	// Write back the first chunk offset, since we're about to start the first chunk
-	WriteU32ToUCharVectorLE(OutBytecode, OutBytecode->size(), ChunkOffsetsStartIndex);
+	ASSERT(Writer.Cursor == Layout.TotalSize);
 
-	GenerateRDEFChunk(Opcodes, OutBytecode);
+	// Otherwise it stays zeroed from the header
+	if (WriteChecksum)
+	{
+		dxbcHashFinal(&HashContext, OutBuffer + ChecksumOffset);
+	}
+}
 
-	WriteU32ToUCharVectorLE(OutBytecode, OutBytecode->size(), ChunkOffsetsStartIndex + 4);
-	GenerateIOSignatureChunk(Opcodes, OutBytecode, true);
 
-	WriteU32ToUCharVectorLE(OutBytecode, OutBytecode->size(), ChunkOffsetsStartIndex + 8);
-	GenerateIOSignatureChunk(Opcodes, OutBytecode, false);
+void BuildShaderMetadataFromOpcodeState(const D3DOpcodeState* Opcodes, ShaderMetadata* OutMetadata)
+{
+	*OutMetadata = ShaderMetadata();
 
-	WriteU32ToUCharVectorLE(OutBytecode, OutBytecode->size(), ChunkOffsetsStartIndex + 12);
-	GenerateSHEXChunk(Opcodes, OutBytecode);
+	// Signature registers are assigned in order, see WriteIOSignatureChunk
+	ASSERT(Opcodes->InputSemantics.size() < MAX_INPUT_PARAM_COUNT);
+	for (int32 i = 0; i < Opcodes->InputSemantics.size(); i++)
+	{
+		ShaderInputParamMetadata ParamMeta = {};
+		ParamMeta.Semantic = Opcodes->InputSemantics[i];
+		ParamMeta.ParamIndex = i;
 
-	WriteU32ToUCharVectorLE(OutBytecode, OutBytecode->size(), ChunkOffsetsStartIndex + 16);
-	GenerateSTATChunk(Opcodes, OutBytecode);
+		OutMetadata->InputParamMetadata[OutMetadata->NumParams] = ParamMeta;
+		OutMetadata->NumParams++;
+	}
 
-	// Fix up the header now that we know the length/checksum, and also fix up offsets to each chunk
-	DXBCHeader.FileSizeInBytes = OutBytecode->size();
-	// NOTE: There's probably a better way of doing this, but the first memcpy replaces the length field,
-	// which is needed since the length is part of the hash, honestly I'd rather not debug weird offset thingys anymore
-	memcpy(OutBytecode->data(), &DXBCHeader, sizeof(DXBCFileHeader));
+	ASSERT(Opcodes->CBVSizes.size() <= MAX_CBV_COUNT);
+	OutMetadata->NumCBVs = Opcodes->CBVSizes.size();
+	for (int32 CBVIndex = 0; CBVIndex < OutMetadata->NumCBVs; CBVIndex++)
+	{
+		// CBVSizes is in float4 registers, the metadata is in bytes
+		OutMetadata->CBVSizes[CBVIndex] = Opcodes->CBVSizes[CBVIndex] * 16;
+	}
 
-	dxbcHash(&(*OutBytecode)[20], OutBytecode->size() - 20, DXBCHeader.CheckSum);
-	memcpy(OutBytecode->data(), &DXBCHeader, sizeof(DXBCFileHeader));
+	OutMetadata->NumSRVs = Opcodes->NumTextures;
+	OutMetadata->NumStaticSamplers = Opcodes->NumSamplers;
 }
 
-
-void GenerateShaderDXBC(FuzzDXBCState* DXBCState)
+void GenerateShaderDXBCOpcodes(FuzzDXBCState* DXBCState, D3DOpcodeState* VertShader, D3DOpcodeState* PixelShader)
 {
-	D3DOpcodeState VertShader;
-	VertShader.ShaderType = D3DShaderType::Vertex;
+	*VertShader = D3DOpcodeState();
+	VertShader->ShaderType = D3DShaderType::Vertex;
 
-	D3DOpcodeState PixelShader;
-	PixelShader.ShaderType = D3DShaderType::Pixel;
+	*PixelShader = D3DOpcodeState();
+	PixelShader->ShaderType = D3DShaderType::Pixel;
 
-	RandomiseShaderBytecodeParams(DXBCState, &VertShader, &PixelShader);
+	RandomiseShaderBytecodeParams(DXBCState, VertShader, PixelShader);
 
-	VertShader.NumTempRegisters = DXBCState->GetIntInRange(2,4);
-	VertShader.DataOpcodesToEmit = DXBCState->GetIntInRange(5, 9);
+	VertShader->NumTempRegisters = DXBCState->GetIntInRange(2,4);
+	VertShader->DataOpcodesToEmit = DXBCState->GetIntInRange(5, 9);
 
-	PixelShader.NumTempRegisters = DXBCState->GetIntInRange(4, 9);
-	PixelShader.DataOpcodesToEmit = DXBCState->GetIntInRange(10, 100);
+	PixelShader->NumTempRegisters = DXBCState->GetIntInRange(4, 9);
+	PixelShader->DataOpcodesToEmit = DXBCState->GetIntInRange(10, 100);
 
-	GenerateBytecodeOpcodes(DXBCState, &VertShader);
-	GenerateBytecodeOpcodes(DXBCState, &PixelShader);
+	GenerateBytecodeOpcodes(DXBCState, VertShader);
+	GenerateBytecodeOpcodes(DXBCState, PixelShader);
 
-	std::vector<byte> VSBytecode;
-	std::vector<byte> PSBytecode;
+	BuildShaderMetadataFromOpcodeState(VertShader, &DXBCState->VSMeta);
+	BuildShaderMetadataFromOpcodeState(PixelShader, &DXBCState->PSMeta);
+}
 
-	GenerateShaderBytecode(&VertShader, &VSBytecode);
-	GenerateShaderBytecode(&PixelShader, &PSBytecode);
+#if defined(_WIN32)
+void GenerateShaderDXBC(FuzzDXBCState* DXBCState)
+{
+	D3DOpcodeState VertShader;
+	D3DOpcodeState PixelShader;
+	GenerateShaderDXBCOpcodes(DXBCState, &VertShader, &PixelShader);
 
 	HRESULT hr;
 
-	//WriteDataToFile(StringStackBuffer<256>("manual_bytecode/gen_vs_seed_%llu.bin", DXBCState->InitialFuzzSeed).buffer, VSBytecode.data(), VSBytecode.size());
-	//WriteDataToFile(StringStackBuffer<256>("manual_bytecode/gen_ps_seed_%llu.bin", DXBCState->InitialFuzzSeed).buffer, PSBytecode.data(), PSBytecode.size());
+	// We know the sizes up front, so the bytecode gets written straight into the blobs
+	WriteShaderBytecode(&VertShader, [&](uint32 Size) {
+		hr = D3DCreateBlob(Size, &DXBCState->VSBlob);
+		ASSERT(SUCCEEDED(hr));
+		return (byte*)DXBCState->VSBlob->GetBufferPointer();
+	});
+
+	WriteShaderBytecode(&PixelShader, [&](uint32 Size) {
+		hr = D3DCreateBlob(Size, &DXBCState->PSBlob);
+		ASSERT(SUCCEEDED(hr));
+		return (byte*)DXBCState->PSBlob->GetBufferPointer();
+	});
+
+	//WriteDataToFile(StringStackBuffer<256>("manual_bytecode/gen_vs_seed_%llu.bin", DXBCState->InitialFuzzSeed).buffer, DXBCState->VSBlob->GetBufferPointer(), DXBCState->VSBlob->GetBufferSize());
+	//WriteDataToFile(StringStackBuffer<256>("manual_bytecode/gen_ps_seed_%llu.bin", DXBCState->InitialFuzzSeed).buffer, DXBCState->PSBlob->GetBufferPointer(), DXBCState->PSBlob->GetBufferSize());
 	
-	//ParseDXBCCode(VSBytecode.data(), VSBytecode.size());
-	//ParseDXBCCode(PSBytecode.data(), PSBytecode.size());
+	//ParseDXBCCode((byte*)DXBCState->VSBlob->GetBufferPointer(), DXBCState->VSBlob->GetBufferSize());
+	//ParseDXBCCode((byte*)DXBCState->PSBlob->GetBufferPointer(), DXBCState->PSBlob->GetBufferSize());
 	
 	//{
 	//	ID3DBlob* VSDisasmBlob = nullptr;
-	//	hr = D3DDisassemble(VSBytecode.data(), VSBytecode.size(), 0, nullptr, &VSDisasmBlob);
+	//	hr = D3DDisassemble(DXBCState->VSBlob->GetBufferPointer(), DXBCState->VSBlob->GetBufferSize(), 0, nullptr, &VSDisasmBlob);
 	//	ASSERT(SUCCEEDED(hr));
 	//
 	//	WriteDataToFile(StringStackBuffer<256>("manual_bytecode/gen_vs_seed_%llu_disasm.txt", DXBCState->InitialFuzzSeed).buffer, VSDisasmBlob->GetBufferPointer(), VSDisasmBlob->GetBufferSize());
 	//
 	//	ID3DBlob* PSDisasmBlob = nullptr;
-	//	hr = D3DDisassemble(PSBytecode.data(), PSBytecode.size(), 0, nullptr, &PSDisasmBlob);
+	//	hr = D3DDisassemble(DXBCState->PSBlob->GetBufferPointer(), DXBCState->PSBlob->GetBufferSize(), 0, nullptr, &PSDisasmBlob);
 	//	ASSERT(SUCCEEDED(hr));
 	//
 	//	WriteDataToFile(StringStackBuffer<256>("manual_bytecode/gen_ps_seed_%llu_disasm.txt", DXBCState->InitialFuzzSeed).buffer, PSDisasmBlob->GetBufferPointer(), PSDisasmBlob->GetBufferSize());
 	//}
-
-	hr = D3DCreateBlob(VSBytecode.size(), &DXBCState->VSBlob);
-	ASSERT(SUCCEEDED(hr));
-	memcpy(DXBCState->VSBlob->GetBufferPointer(), VSBytecode.data(), VSBytecode.size());
-
-	hr = D3DCreateBlob(PSBytecode.size(), &DXBCState->PSBlob);
-	ASSERT(SUCCEEDED(hr));
-	memcpy(DXBCState->PSBlob->GetBufferPointer(), PSBytecode.data(), PSBytecode.size());
 }
+#endif
 
 
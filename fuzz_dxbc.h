@@ -6,7 +6,14 @@
 
 #include "shader_meta.h"
 
-void ParseDXBCCode(byte* Code, int32 Length);
+#if !defined(_WIN32)
+// Only ever held as a pointer off Windows, the bytecode generation itself doesn't need D3D
+struct ID3D10Blob;
+typedef ID3D10Blob ID3DBlob;
+#endif
+
+// Walks the whole container, decoding every instruction. Returns false if anything's malformed (or is something we don't decode yet)
+bool ParseDXBCCode(const byte* Code, int32 Length);
 
 
 
@@ -34,9 +41,35 @@ struct FuzzDXBCState : FuzzBasicState
 	ID3DBlob* VSBlob = nullptr;
 	ID3DBlob* PSBlob = nullptr;
 
+	// Filled in alongside the blobs, since we already know everything reflection would tell us
+	ShaderMetadata VSMeta;
+	ShaderMetadata PSMeta;
+
 	// TODO: Config options
 };
 
 void GenerateBytecodeOpcodes(FuzzDXBCState* DXBCState, D3DOpcodeState* Bytecode);
 
+// Produces the same metadata that ReflectShaderIntoShaderMetadata would give for the generated bytecode
+void BuildShaderMetadataFromOpcodeState(const D3DOpcodeState* Opcodes, ShaderMetadata* OutMetadata);
+
+void WriteShaderBytecodeWithAllocator(const D3DOpcodeState* Opcodes, byte* (*AllocateBuffer)(void* UserData, uint32 Size), void* UserData, bool WriteChecksum);
+
+// Writes the full container, checksum included, into AllocateBuffer(uint32 Size), which gets called once with the exact size
+// before anything's written. The layout (which goes through the chunk template caches) is only worked out the once.
+// Without WriteChecksum the checksum's left zeroed, for callers that do a batch of containers at once with dxbcHashMany
+template<typename AllocateBufferType>
+void WriteShaderBytecode(const D3DOpcodeState* Opcodes, AllocateBufferType AllocateBuffer, bool WriteChecksum = true)
+{
+	WriteShaderBytecodeWithAllocator(Opcodes, [](void* UserData, uint32 Size) {
+		return (byte*)(*(AllocateBufferType*)UserData)(Size);
+	}, &AllocateBuffer, WriteChecksum);
+}
+
+// Everything GenerateShaderDXBC does short of writing the containers: picks the params, generates the opcodes for both shaders,
+// and fills in DXBCState->VSMeta/PSMeta. Draws the same random numbers in the same order, so it's safe to use in its place
+void GenerateShaderDXBCOpcodes(FuzzDXBCState* DXBCState, D3DOpcodeState* OutVertShader, D3DOpcodeState* OutPixelShader);
+
+#if defined(_WIN32)
 void GenerateShaderDXBC(FuzzDXBCState* Bytecode);
+#endif
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "basics.h"
+
+#include <atomic>
+
+// Where case seeds come from. Every case gets a 64-bit case id, made of which run it's from, which shard of that run
+// (i.e. process/machine, if we're splitting one run up), and its index in the shard:
+//
+//   [ run id : 24 ][ shard : 8 ][ index : 32 ]
+//
+// and its seed is a bijective mix of the case id. So different cases always get different seeds (no more seeds from
+// one thread running into another's, or into a different run's), and a logged seed can be turned back into the case id.
+//
+// Which thread runs which index doesn't matter, so threads can just take the next one whenever they're ready
+
+#define FUZZ_CASE_ID_RUN_BITS 24
+#define FUZZ_CASE_ID_SHARD_BITS 8
+#define FUZZ_CASE_ID_INDEX_BITS 32
+
+inline uint64 MakeFuzzCaseId(uint32 RunId, uint32 Shard, uint64 Index)
+{
+	ASSERT(RunId < (1U << FUZZ_CASE_ID_RUN_BITS));
+	ASSERT(Shard < (1U << FUZZ_CASE_ID_SHARD_BITS));
+	ASSERT(Index < (1LLU << FUZZ_CASE_ID_INDEX_BITS));
+
+	return ((uint64)RunId << (FUZZ_CASE_ID_SHARD_BITS + FUZZ_CASE_ID_INDEX_BITS)) | ((uint64)Shard << FUZZ_CASE_ID_INDEX_BITS) | Index;
+}
+
+inline void DecodeFuzzCaseId(uint64 CaseId, uint32* OutRunId, uint32* OutShard, uint64* OutIndex)
+{
+	*OutRunId = (uint32)(CaseId >> (FUZZ_CASE_ID_SHARD_BITS + FUZZ_CASE_ID_INDEX_BITS));
+	*OutShard = (uint32)(CaseId >> FUZZ_CASE_ID_INDEX_BITS) & ((1U << FUZZ_CASE_ID_SHARD_BITS) - 1);
+	*OutIndex = CaseId & ((1LLU << FUZZ_CASE_ID_INDEX_BITS) - 1);
+}
+
+// The splitmix64 finalizer, which is a bijection (every step is invertible), so distinct ids give distinct seeds.
+// Without the mixing, consecutive cases would get consecutive seeds, which is fine for the RNG but less so for anything hashing them
+inline uint64 GetFuzzCaseSeed(uint64 CaseId)
+{
+	uint64 Z = CaseId + 0x9E3779B97F4A7C15LLU;
+	Z = (Z ^ (Z >> 30)) * 0xBF58476D1CE4E5B9LLU;
+	Z = (Z ^ (Z >> 27)) * 0x94D049BB133111EBLLU;
+	return Z ^ (Z >> 31);
+}
+
+// Undoes X ^= (X >> Shift)
+inline uint64 UndoXorShiftRight(uint64 Value, int32 Shift)
+{
+	uint64 Result = Value;
+	for (int32 Covered = Shift; Covered < 64; Covered += Shift)
+	{
+		Result = Value ^ (Result >> Shift);
+	}
+
+	return Result;
+}
+
+// The other way, for going from a logged seed back to the run/shard/index
+inline uint64 GetFuzzCaseIdFromSeed(uint64 CaseSeed)
+{
+	uint64 Z = UndoXorShiftRight(CaseSeed, 31);
+	Z = UndoXorShiftRight(Z * 0x319642B2D24D8EC3LLU, 27);
+	Z = UndoXorShiftRight(Z * 0x96DE1B173F119089LLU, 30);
+	return Z - 0x9E3779B97F4A7C15LLU;
+}
+
+// One shard of one run. Cheap to copy around
+struct FuzzSeedStream
+{
+	uint32 RunId = 0;
+	uint32 Shard = 0;
+
+	// Run ids only have 24 bits, so this wraps every ~194 days, which is long enough for a run not to collide with another one
+	static uint32 GetRunIdFromTime(uint64 StartingTime)
+	{
+		return (uint32)(StartingTime & ((1U << FUZZ_CASE_ID_RUN_BITS) - 1));
+	}
+
+	uint64 GetCaseId(uint64 Index) const
+	{
+		return MakeFuzzCaseId(RunId, Shard, Index);
+	}
+
+	uint64 GetCaseSeed(uint64 Index) const
+	{
+		return GetFuzzCaseSeed(GetCaseId(Index));
+	}
+};
+
+// Hands out the cases [0, NumCases) of a stream to whichever thread asks next, so the faster threads just end up
+// running more of them. Doesn't change what any case is
+struct FuzzCaseDispenser
+{
+	FuzzSeedStream Stream;
+	uint64 NumCases = 0;
+
+	std::atomic<uint64> NextIndex;
+
+	FuzzCaseDispenser()
+	{
+		NextIndex.store(0);
+	}
+
+	// Not safe to call while anyone is taking cases
+	void Init(const FuzzSeedStream& InStream, uint64 InNumCases)
+	{
+		ASSERT(InNumCases <= (1LLU << FUZZ_CASE_ID_INDEX_BITS));
+
+		Stream = InStream;
+		NumCases = InNumCases;
+		NextIndex.store(0);
+	}
+
+	// Returns false once every case has been handed out
+	bool TakeNextCase(uint64* OutCaseSeed)
+	{
+		uint64 Index = NextIndex.fetch_add(1, std::memory_order_relaxed);
+		if (Index >= NumCases)
+		{
+			return false;
+		}
+
+		*OutCaseSeed = Stream.GetCaseSeed(Index);
+		return true;
+	}
+};
@@ -0,0 +1,600 @@
+#include "fuzz_shader_ast.h"
+
+#define FUZZ_SHADER_AST_ENCODING_MAGIC 0x50415346 // 'FSAP'
+
+// Magic, version, payload size, then the case seed
+#define FUZZ_SHADER_AST_ENCODING_HEADER_SIZE 20
+
+// Way deeper than anything the generator makes, it's just so bad data can't blow the stack
+#define FUZZ_SHADER_AST_MAX_DECODE_DEPTH 256
+
+// Child lists come out of the arena in one piece, so they can't be bigger than one of its blocks. The generator's are nowhere near
+#define FUZZ_SHADER_AST_MAX_CHILD_COUNT (FuzzShaderArena::BlockSize / sizeof(FuzzShaderASTNode*))
+
+// Longest prefix/suffix string we'll take, the ones the generator uses are all tiny
+#define FUZZ_SHADER_AST_MAX_STRING_LENGTH 256
+
+// Marks a missing node (i.e. an AST without a root)
+#define FUZZ_SHADER_AST_NULL_NODE 0xFF
+
+struct FuzzShaderASTWriter
+{
+	std::vector<byte>* Out = nullptr;
+
+	// Prefix/suffix strings, each one's written once and then referred to by index. Deduped by text, since the same literal
+	// can have a different address in each translation unit
+	std::vector<const char*> Strings;
+
+	void WriteByte(byte Value)
+	{
+		Out->push_back(Value);
+	}
+
+	void WriteVarint(uint64 Value)
+	{
+		while (Value >= 0x80)
+		{
+			Out->push_back((byte)(Value | 0x80));
+			Value >>= 7;
+		}
+		Out->push_back((byte)Value);
+	}
+
+	// Symbols are offset by one so InvalidShaderSymbol comes out as 0
+	void WriteSymbol(FuzzShaderSymbol Symbol)
+	{
+		WriteVarint(Symbol == InvalidShaderSymbol ? 0 : (uint64)Symbol + 1);
+	}
+
+	void WriteFloat(float Value)
+	{
+		byte Bytes[sizeof(float)];
+		memcpy(Bytes, &Value, sizeof(Value));
+		Out->insert(Out->end(), Bytes, Bytes + sizeof(Bytes));
+	}
+
+	uint32 GetStringIndex(const char* Text)
+	{
+		for (uint32 i = 0; i < Strings.size(); i++)
+		{
+			if (Strings[i] == Text || strcmp(Strings[i], Text) == 0)
+			{
+				return i;
+			}
+		}
+
+		Strings.push_back(Text);
+		return (uint32)(Strings.size() - 1);
+	}
+};
+
+// Bounds checked, and once anything's gone wrong everything after reads as 0 so callers only need to check Failed at the end
+// (or before using a count/index they read)
+struct FuzzShaderASTReader
+{
+	const byte* Data = nullptr;
+	const byte* End = nullptr;
+	bool Failed = false;
+
+	uint32 GetRemainingSize() const
+	{
+		return (uint32)(End - Data);
+	}
+
+	byte ReadByte()
+	{
+		if (Data >= End)
+		{
+			Failed = true;
+			return 0;
+		}
+
+		byte Value = *Data;
+		Data++;
+		return Value;
+	}
+
+	uint64 ReadVarint()
+	{
+		uint64 Value = 0;
+		for (int32 Shift = 0; Shift < 64; Shift += 7)
+		{
+			byte Byte = ReadByte();
+			Value |= (uint64)(Byte & 0x7F) << Shift;
+			if ((Byte & 0x80) == 0)
+			{
+				return Value;
+			}
+		}
+
+		Failed = true;
+		return 0;
+	}
+
+	// Anything over Max is an error
+	uint32 ReadVarintUpTo(uint64 Max)
+	{
+		uint64 Value = ReadVarint();
+		if (Value > Max)
+		{
+			Failed = true;
+			return 0;
+		}
+
+		return (uint32)Value;
+	}
+
+	// Each element takes at least a byte, so a count bigger than what's left is garbage (and we don't want to reserve for it)
+	uint32 ReadCount()
+	{
+		return ReadVarintUpTo(GetRemainingSize());
+	}
+
+	// For the lists of child nodes, which also have to fit in the arena
+	uint32 ReadChildCount()
+	{
+		return ReadVarintUpTo(GetRemainingSize() < FUZZ_SHADER_AST_MAX_CHILD_COUNT ? GetRemainingSize() : FUZZ_SHADER_AST_MAX_CHILD_COUNT);
+	}
+
+	// Only for Base, everything else has to name something
+	FuzzShaderSymbol ReadOptionalSymbol(uint32 NumSymbols)
+	{
+		uint32 Value = ReadVarintUpTo(NumSymbols);
+		return Value == 0 ? InvalidShaderSymbol : Value - 1;
+	}
+
+	FuzzShaderSymbol ReadSymbol(uint32 NumSymbols)
+	{
+		FuzzShaderSymbol Symbol = ReadOptionalSymbol(NumSymbols);
+		if (Symbol == InvalidShaderSymbol)
+		{
+			Failed = true;
+			return 0;
+		}
+
+		return Symbol;
+	}
+
+	const char* ReadStringIndex(const std::vector<const char*>& Strings)
+	{
+		uint32 Index = ReadVarintUpTo(Strings.size());
+		if (Index >= Strings.size())
+		{
+			Failed = true;
+			return "";
+		}
+
+		return Strings[Index];
+	}
+
+	float ReadFloat()
+	{
+		float Value = 0.0f;
+		if (GetRemainingSize() < sizeof(Value))
+		{
+			Failed = true;
+			Data = End;
+			return Value;
+		}
+
+		memcpy(&Value, Data, sizeof(Value));
+		Data += sizeof(Value);
+		return Value;
+	}
+};
+
+static void WriteSemanticVars(FuzzShaderASTWriter* Writer, const std::vector<FuzzShaderSemanticVar>& Vars)
+{
+	Writer->WriteVarint(Vars.size());
+	for (const auto& Var : Vars)
+	{
+		Writer->WriteVarint((uint64)Var.Semantic);
+		Writer->WriteSymbol(Var.VarName);
+		Writer->WriteVarint((uint32)Var.SemanticIdx);
+		Writer->WriteVarint((uint32)Var.ParamIdx);
+	}
+}
+
+static bool ReadSemanticVars(FuzzShaderASTReader* Reader, uint32 NumSymbols, std::vector<FuzzShaderSemanticVar>* OutVars)
+{
+	uint32 Count = Reader->ReadCount();
+	for (uint32 i = 0; i < Count && !Reader->Failed; i++)
+	{
+		FuzzShaderSemanticVar Var;
+		Var.Semantic = (ShaderSemantic)Reader->ReadVarintUpTo((uint64)ShaderSemantic::Count - 1);
+		Var.VarName = Reader->ReadSymbol(NumSymbols);
+		Var.SemanticIdx = (int32)Reader->ReadVarintUpTo(0xFFFFFFFF);
+		Var.ParamIdx = (int32)Reader->ReadVarintUpTo(0xFFFFFFFF);
+		OutVars->push_back(Var);
+	}
+
+	return !Reader->Failed;
+}
+
+static void WriteShaderASTNode(FuzzShaderASTWriter* Writer, const FuzzShaderASTNode* Node)
+{
+	if (Node == nullptr)
+	{
+		Writer->WriteByte(FUZZ_SHADER_AST_NULL_NODE);
+		return;
+	}
+
+	Writer->WriteByte((byte)Node->Type);
+
+	if (Node->Type == FuzzShaderASTNode::NodeType::Assignment)
+	{
+		auto* Assnmt = static_cast<const FuzzShaderAssignment*>(Node);
+		Writer->WriteSymbol(Assnmt->VariableName);
+		Writer->WriteByte(Assnmt->IsPredeclared ? 1 : 0);
+		WriteShaderASTNode(Writer, Assnmt->Value);
+	}
+	else if (Node->Type == FuzzShaderASTNode::NodeType::BinaryOperator)
+	{
+		auto* Bin = static_cast<const FuzzShaderBinaryOperator*>(Node);
+		Writer->WriteByte((byte)Bin->Op);
+		WriteShaderASTNode(Writer, Bin->LHS);
+		WriteShaderASTNode(Writer, Bin->RHS);
+	}
+	else if (Node->Type == FuzzShaderASTNode::NodeType::TextureAccess)
+	{
+		auto* Tex = static_cast<const FuzzShaderTextureAccess*>(Node);
+		Writer->WriteSymbol(Tex->TextureName);
+		Writer->WriteSymbol(Tex->SamplerName);
+		WriteShaderASTNode(Writer, Tex->UV);
+	}
+	else if (Node->Type == FuzzShaderASTNode::NodeType::ReadVariable)
+	{
+		auto* ReadVar = static_cast<const FuzzShaderReadVariable*>(Node);
+		Writer->WriteSymbol(ReadVar->VariableName);
+	}
+	else if (Node->Type == FuzzShaderASTNode::NodeType::Literal)
+	{
+		auto* Lit = static_cast<const FuzzShaderLiteral*>(Node);
+		for (float Value : Lit->Values)
+		{
+			Writer->WriteFloat(Value);
+		}
+	}
+	else if (Node->Type == FuzzShaderASTNode::NodeType::FuncCall)
+	{
+		auto* FuncCall = static_cast<const FuzzShaderFuncCall*>(Node);
+		Writer->WriteSymbol(FuncCall->FuncName);
+		Writer->WriteVarint((uint32)FuncCall->OutputSize);
+		Writer->WriteVarint(FuncCall->Arguments.Count);
+		for (auto* Arg : FuncCall->Arguments)
+		{
+			WriteShaderASTNode(Writer, Arg);
+		}
+	}
+	else if (Node->Type == FuzzShaderASTNode::NodeType::StatementBlock)
+	{
+		auto* Block = static_cast<const FuzzShaderStatementBlock*>(Node);
+		Writer->WriteVarint(Block->Statements.Count);
+		for (auto* Stmt : Block->Statements)
+		{
+			WriteShaderASTNode(Writer, Stmt);
+		}
+	}
+	else
+	{
+		ASSERT(false && "Don't know how to encode this node type");
+	}
+}
+
+// Statements only go in blocks, and everything else takes expressions, so whatever we decode can be emitted like a generated AST would be
+static FuzzShaderASTNode* ReadShaderASTNode(FuzzShaderASTReader* Reader, FuzzShaderAST* ShaderAST, uint32 NumSymbols, int32 Depth, bool ExpectStatement)
+{
+	if (Depth > FUZZ_SHADER_AST_MAX_DECODE_DEPTH)
+	{
+		Reader->Failed = true;
+	}
+
+	byte Type = Reader->ReadByte();
+	if (Reader->Failed || Type == FUZZ_SHADER_AST_NULL_NODE)
+	{
+		// Only the root's allowed to be missing
+		Reader->Failed |= (Depth > 0);
+		return nullptr;
+	}
+
+	FuzzShaderASTNode::NodeType NodeType = (FuzzShaderASTNode::NodeType)Type;
+
+	bool IsStatement = (Type >= (byte)FuzzShaderASTNode::NodeType::StatementFirst && Type <= (byte)FuzzShaderASTNode::NodeType::StatementLast);
+	if (IsStatement != ExpectStatement)
+	{
+		Reader->Failed = true;
+		return nullptr;
+	}
+
+	if (NodeType == FuzzShaderASTNode::NodeType::Assignment)
+	{
+		auto* Assnmt = ShaderAST->AllocateNode<FuzzShaderAssignment>();
+		Assnmt->VariableName = Reader->ReadSymbol(NumSymbols);
+		Assnmt->IsPredeclared = (Reader->ReadVarintUpTo(1) != 0);
+		Assnmt->Value = ReadShaderASTNode(Reader, ShaderAST, NumSymbols, Depth + 1, false);
+		return Assnmt;
+	}
+	else if (NodeType == FuzzShaderASTNode::NodeType::BinaryOperator)
+	{
+		auto* Bin = ShaderAST->AllocateNode<FuzzShaderBinaryOperator>();
+		Bin->Op = (FuzzShaderBinaryOperator::Operator)Reader->ReadVarintUpTo((uint64)FuzzShaderBinaryOperator::Operator::Count - 1);
+		Bin->LHS = ReadShaderASTNode(Reader, ShaderAST, NumSymbols, Depth + 1, false);
+		Bin->RHS = ReadShaderASTNode(Reader, ShaderAST, NumSymbols, Depth + 1, false);
+		return Bin;
+	}
+	else if (NodeType == FuzzShaderASTNode::NodeType::TextureAccess)
+	{
+		auto* Tex = ShaderAST->AllocateNode<FuzzShaderTextureAccess>();
+		Tex->TextureName = Reader->ReadSymbol(NumSymbols);
+		Tex->SamplerName = Reader->ReadSymbol(NumSymbols);
+		Tex->UV = ReadShaderASTNode(Reader, ShaderAST, NumSymbols, Depth + 1, false);
+		return Tex;
+	}
+	else if (NodeType == FuzzShaderASTNode::NodeType::ReadVariable)
+	{
+		auto* ReadVar = ShaderAST->AllocateNode<FuzzShaderReadVariable>();
+		ReadVar->VariableName = Reader->ReadSymbol(NumSymbols);
+		return ReadVar;
+	}
+	else if (NodeType == FuzzShaderASTNode::NodeType::Literal)
+	{
+		auto* Lit = ShaderAST->AllocateNode<FuzzShaderLiteral>();
+		for (float& Value : Lit->Values)
+		{
+			Value = Reader->ReadFloat();
+		}
+		return Lit;
+	}
+	else if (NodeType == FuzzShaderASTNode::NodeType::FuncCall)
+	{
+		auto* FuncCall = ShaderAST->AllocateNode<FuzzShaderFuncCall>();
+		FuncCall->FuncName = Reader->ReadSymbol(NumSymbols);
+		FuncCall->OutputSize = (int32)Reader->ReadVarintUpTo(4);
+
+		uint32 NumArguments = Reader->ReadChildCount();
+		FuncCall->Arguments = ShaderAST->AllocateNodeList((int32)NumArguments);
+		for (uint32 i = 0; i < NumArguments && !Reader->Failed; i++)
+		{
+			FuncCall->Arguments.Add(ReadShaderASTNode(Reader, ShaderAST, NumSymbols, Depth + 1, false));
+		}
+		return FuncCall;
+	}
+	else if (NodeType == FuzzShaderASTNode::NodeType::StatementBlock)
+	{
+		auto* Block = ShaderAST->AllocateNode<FuzzShaderStatementBlock>();
+
+		uint32 NumStatements = Reader->ReadChildCount();
+		Block->Statements = ShaderAST->AllocateNodeList((int32)NumStatements);
+		for (uint32 i = 0; i < NumStatements && !Reader->Failed; i++)
+		{
+			Block->Statements.Add(ReadShaderASTNode(Reader, ShaderAST, NumSymbols, Depth + 1, true));
+		}
+		return Block;
+	}
+
+	// Includes the node types the generator doesn't make yet
+	Reader->Failed = true;
+	return nullptr;
+}
+
+static void WriteShaderAST(FuzzShaderASTWriter* Writer, const FuzzShaderAST* ShaderAST)
+{
+	Writer->WriteByte((byte)ShaderAST->Type);
+
+	WriteSemanticVars(Writer, ShaderAST->IAVars);
+	WriteSemanticVars(Writer, ShaderAST->InterStageVars);
+
+	Writer->WriteVarint(ShaderAST->RootConstants.size());
+	for (const auto& RootConstant : ShaderAST->RootConstants)
+	{
+		Writer->WriteSymbol(RootConstant.VarName);
+		Writer->WriteVarint((uint32)RootConstant.ConstantCount);
+		Writer->WriteVarint((uint32)RootConstant.SlotIndex);
+	}
+
+	Writer->WriteVarint(ShaderAST->RootCBVs.size());
+	for (const auto& RootCBV : ShaderAST->RootCBVs)
+	{
+		Writer->WriteSymbol(RootCBV.VarName);
+		Writer->WriteVarint((uint32)RootCBV.ConstantCount);
+		Writer->WriteVarint((uint32)RootCBV.SlotIndex);
+	}
+
+	Writer->WriteVarint(ShaderAST->BoundTextures.size());
+	for (const auto& TextureBind : ShaderAST->BoundTextures)
+	{
+		Writer->WriteSymbol(TextureBind.SamplerName);
+		Writer->WriteSymbol(TextureBind.ResourceName);
+		Writer->WriteVarint((uint32)TextureBind.SlotIndex);
+	}
+
+	WriteShaderASTNode(Writer, ShaderAST->RootASTNode);
+}
+
+static bool ReadShaderAST(FuzzShaderASTReader* Reader, FuzzShaderAST* ShaderAST, uint32 NumSymbols)
+{
+	ShaderAST->Type = (D3DShaderType)Reader->ReadVarintUpTo((uint64)D3DShaderType::Pixel);
+
+	ReadSemanticVars(Reader, NumSymbols, &ShaderAST->IAVars);
+	ReadSemanticVars(Reader, NumSymbols, &ShaderAST->InterStageVars);
+
+	uint32 NumRootConstants = Reader->ReadCount();
+	for (uint32 i = 0; i < NumRootConstants && !Reader->Failed; i++)
+	{
+		FuzzShaderRootConstants RootConstant;
+		RootConstant.VarName = Reader->ReadSymbol(NumSymbols);
+		RootConstant.ConstantCount = (int32)Reader->ReadVarintUpTo(0xFFFFFFFF);
+		RootConstant.SlotIndex = (int32)Reader->ReadVarintUpTo(0xFFFFFFFF);
+		ShaderAST->RootConstants.push_back(RootConstant);
+	}
+
+	uint32 NumRootCBVs = Reader->ReadCount();
+	for (uint32 i = 0; i < NumRootCBVs && !Reader->Failed; i++)
+	{
+		FuzzShaderRootCBV RootCBV;
+		RootCBV.VarName = Reader->ReadSymbol(NumSymbols);
+		RootCBV.ConstantCount = (int32)Reader->ReadVarintUpTo(0xFFFFFFFF);
+		RootCBV.SlotIndex = (int32)Reader->ReadVarintUpTo(0xFFFFFFFF);
+		ShaderAST->RootCBVs.push_back(RootCBV);
+	}
+
+	uint32 NumBoundTextures = Reader->ReadCount();
+	for (uint32 i = 0; i < NumBoundTextures && !Reader->Failed; i++)
+	{
+		FuzzShaderTextureBinding TextureBind;
+		TextureBind.SamplerName = Reader->ReadSymbol(NumSymbols);
+		TextureBind.ResourceName = Reader->ReadSymbol(NumSymbols);
+		TextureBind.SlotIndex = (int32)Reader->ReadVarintUpTo(0xFFFFFFFF);
+		ShaderAST->BoundTextures.push_back(TextureBind);
+	}
+
+	ShaderAST->RootASTNode = ReadShaderASTNode(Reader, ShaderAST, NumSymbols, 0, true);
+
+	return !Reader->Failed;
+}
+
+void EncodeShaderASTPair(const FuzzShaderAST* VertexShader, const FuzzShaderAST* PixelShader, uint64 CaseSeed, std::vector<byte>* OutData)
+{
+	ASSERT(VertexShader->Symbols == PixelShader->Symbols);
+
+	const FuzzShaderSymbolTable* Symbols = VertexShader->Symbols;
+
+	// The payload goes off to the side first, since the string table at the front of it isn't known until we've been over the symbols
+	static thread_local std::vector<byte> SymbolData;
+	static thread_local std::vector<byte> ShaderData;
+	SymbolData.clear();
+	ShaderData.clear();
+
+	FuzzShaderASTWriter Writer;
+
+	Writer.Out = &SymbolData;
+	Writer.WriteVarint(Symbols->Symbols.size());
+	for (const auto& Entry : Symbols->Symbols)
+	{
+		Writer.WriteVarint(Writer.GetStringIndex(Entry.Prefix));
+		Writer.WriteSymbol(Entry.Base);
+		Writer.WriteVarint(Writer.GetStringIndex(Entry.Suffix));
+		Writer.WriteVarint((uint32)Entry.NumberCount);
+		for (int32 i = 0; i < Entry.NumberCount; i++)
+		{
+			Writer.WriteVarint((uint32)Entry.Numbers[i]);
+		}
+	}
+
+	Writer.Out = &ShaderData;
+	WriteShaderAST(&Writer, VertexShader);
+	WriteShaderAST(&Writer, PixelShader);
+
+	size_t HeaderOffset = OutData->size();
+	OutData->resize(HeaderOffset + FUZZ_SHADER_AST_ENCODING_HEADER_SIZE);
+
+	Writer.Out = OutData;
+	Writer.WriteVarint(Writer.Strings.size());
+	for (const char* Text : Writer.Strings)
+	{
+		OutData->insert(OutData->end(), Text, Text + strlen(Text) + 1);
+	}
+
+	OutData->insert(OutData->end(), SymbolData.begin(), SymbolData.end());
+	OutData->insert(OutData->end(), ShaderData.begin(), ShaderData.end());
+
+	uint32 Header[3] = { FUZZ_SHADER_AST_ENCODING_MAGIC, FUZZ_SHADER_AST_ENCODING_VERSION, (uint32)(OutData->size() - HeaderOffset - FUZZ_SHADER_AST_ENCODING_HEADER_SIZE) };
+	memcpy(OutData->data() + HeaderOffset, Header, sizeof(Header));
+	memcpy(OutData->data() + HeaderOffset + sizeof(Header), &CaseSeed, sizeof(CaseSeed));
+}
+
+bool DecodeShaderASTPair(const byte* Data, uint32 Size, FuzzShaderAST* OutVertexShader, FuzzShaderAST* OutPixelShader, uint64* OutCaseSeed, uint32* OutEncodedSize)
+{
+	ASSERT(OutVertexShader->Arena != nullptr && OutVertexShader->Arena == OutPixelShader->Arena);
+	ASSERT(OutVertexShader->Symbols != nullptr && OutVertexShader->Symbols == OutPixelShader->Symbols);
+
+	FuzzShaderArena* Arena = OutVertexShader->Arena;
+	FuzzShaderSymbolTable* Symbols = OutVertexShader->Symbols;
+
+	Arena->Reset();
+	Symbols->Reset();
+	OutVertexShader->Reset();
+	OutPixelShader->Reset();
+
+	if (Size < FUZZ_SHADER_AST_ENCODING_HEADER_SIZE)
+	{
+		return false;
+	}
+
+	uint32 Header[3] = {};
+	memcpy(Header, Data, sizeof(Header));
+	memcpy(OutCaseSeed, Data + sizeof(Header), sizeof(*OutCaseSeed));
+
+	uint32 PayloadSize = Header[2];
+	if (Header[0] != FUZZ_SHADER_AST_ENCODING_MAGIC || Header[1] != FUZZ_SHADER_AST_ENCODING_VERSION || PayloadSize > Size - FUZZ_SHADER_AST_ENCODING_HEADER_SIZE)
+	{
+		return false;
+	}
+
+	FuzzShaderASTReader Reader;
+	Reader.Data = Data + FUZZ_SHADER_AST_ENCODING_HEADER_SIZE;
+	Reader.End = Reader.Data + PayloadSize;
+
+	// The symbol table only keeps pointers to its strings, so they go in the arena (which gets reset along with it)
+	static thread_local std::vector<const char*> Strings;
+	Strings.clear();
+
+	uint32 NumStrings = Reader.ReadCount();
+	for (uint32 i = 0; i < NumStrings && !Reader.Failed; i++)
+	{
+		const byte* Terminator = (const byte*)memchr(Reader.Data, '\0', Reader.GetRemainingSize());
+		if (Terminator == nullptr || Terminator - Reader.Data >= FUZZ_SHADER_AST_MAX_STRING_LENGTH)
+		{
+			Reader.Failed = true;
+			break;
+		}
+
+		int32 Length = (int32)(Terminator - Reader.Data) + 1;
+		char* Text = (char*)Arena->Allocate(Length, 1);
+		memcpy(Text, Reader.Data, Length);
+		Strings.push_back(Text);
+
+		Reader.Data += Length;
+	}
+
+	uint32 NumSymbols = Reader.ReadCount();
+	for (uint32 i = 0; i < NumSymbols && !Reader.Failed; i++)
+	{
+		FuzzShaderSymbolTable::SymbolEntry Entry;
+		Entry.Prefix = Reader.ReadStringIndex(Strings);
+
+		// Bases always come before the symbols built on them, which also means WriteSymbolText can't loop forever
+		Entry.Base = Reader.ReadOptionalSymbol(i);
+		Entry.Suffix = Reader.ReadStringIndex(Strings);
+		Entry.NumberCount = (int32)Reader.ReadVarintUpTo(FuzzShaderSymbolTable::MaxNumbers);
+		for (int32 NumberIdx = 0; NumberIdx < Entry.NumberCount; NumberIdx++)
+		{
+			Entry.Numbers[NumberIdx] = (int32)Reader.ReadVarintUpTo(0xFFFFFFFF);
+		}
+
+		Symbols->AddSymbol(Entry);
+	}
+
+	bool Succeeded = !Reader.Failed
+		&& ReadShaderAST(&Reader, OutVertexShader, NumSymbols)
+		&& ReadShaderAST(&Reader, OutPixelShader, NumSymbols)
+		&& OutVertexShader->Type == D3DShaderType::Vertex
+		&& OutPixelShader->Type == D3DShaderType::Pixel
+		&& OutVertexShader->RootASTNode != nullptr
+		&& OutVertexShader->RootASTNode->Type == FuzzShaderASTNode::NodeType::StatementBlock
+		&& OutPixelShader->RootASTNode != nullptr
+		&& OutPixelShader->RootASTNode->Type == FuzzShaderASTNode::NodeType::StatementBlock
+		&& Reader.GetRemainingSize() == 0;
+
+	if (!Succeeded)
+	{
+		Arena->Reset();
+		Symbols->Reset();
+		OutVertexShader->Reset();
+		OutPixelShader->Reset();
+		return false;
+	}
+
+	*OutEncodedSize = FUZZ_SHADER_AST_ENCODING_HEADER_SIZE + PayloadSize;
+	return true;
+}
@@ -0,0 +1,811 @@
+#pragma once
+
+#include "basics.h"
+
+#include "shader_meta.h"
+
+#if !defined(_WIN32)
+// Only compiled shaders have one, and nothing compiles off Windows
+struct ID3D10Blob;
+typedef ID3D10Blob ID3DBlob;
+#endif
+
+#include <assert.h>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// The HLSL generator's AST: the symbols it names things with, the arena the nodes live in, and the nodes themselves.
+// Generation and emitting source are in fuzz_shader_compiler.cpp, the binary encoding is in fuzz_shader_ast.cpp
+
+typedef uint32 FuzzShaderSymbol;
+
+constexpr FuzzShaderSymbol InvalidShaderSymbol = 0xFFFFFFFF;
+
+// Every name in the generated shaders (variables, bindings, builtin funcs) goes through here. Nodes just carry the id,
+// and the text only gets put together when we write out the source. Generated names are "{Prefix}_{id}",
+// which can't collide since ids are never reused (until Reset)
+struct FuzzShaderSymbolTable
+{
+	enum { MaxNumbers = 3 };
+
+	struct SymbolEntry
+	{
+		// The text is Prefix, then Base's text (if there is one), then Suffix, then the numbers with '_' in between
+		const char* Prefix = "";
+		FuzzShaderSymbol Base = InvalidShaderSymbol;
+		const char* Suffix = "";
+		int32 NumberCount = 0;
+		int32 Numbers[MaxNumbers] = {};
+	};
+
+	std::vector<SymbolEntry> Symbols;
+
+	struct LiteralSymbol
+	{
+		const char* Text = nullptr;
+		FuzzShaderSymbol Symbol = InvalidShaderSymbol;
+	};
+
+	// String literals we've already interned, matched by pointer. There's only ever a dozen or so (builtin funcs, "result", etc.)
+	std::vector<LiteralSymbol> LiteralSymbols;
+
+	void Reset()
+	{
+		Symbols.clear();
+		LiteralSymbols.clear();
+	}
+
+	FuzzShaderSymbol AddSymbol(const SymbolEntry& Entry)
+	{
+		Symbols.push_back(Entry);
+		return (FuzzShaderSymbol)(Symbols.size() - 1);
+	}
+
+	// Text must outlive the table (it's not copied)
+	FuzzShaderSymbol InternLiteral(const char* Text)
+	{
+		for (const auto& Literal : LiteralSymbols)
+		{
+			if (Literal.Text == Text)
+			{
+				return Literal.Symbol;
+			}
+		}
+
+		SymbolEntry Entry;
+		Entry.Prefix = Text;
+
+		LiteralSymbol Literal;
+		Literal.Text = Text;
+		Literal.Symbol = AddSymbol(Entry);
+		LiteralSymbols.push_back(Literal);
+
+		return Literal.Symbol;
+	}
+
+	FuzzShaderSymbol MakeUniqueName(const char* Prefix)
+	{
+		SymbolEntry Entry;
+		Entry.Prefix = Prefix;
+		Entry.Suffix = "_";
+		Entry.NumberCount = 1;
+		Entry.Numbers[0] = (int32)Symbols.size();
+
+		return AddSymbol(Entry);
+	}
+
+	// e.g. MakeDerivedName("input.", Var) or MakeDerivedName("", CBV, "_var", 3)
+	FuzzShaderSymbol MakeDerivedName(const char* Prefix, FuzzShaderSymbol Base, const char* Suffix = "", int32 Number = -1)
+	{
+		SymbolEntry Entry;
+		Entry.Prefix = Prefix;
+		Entry.Base = Base;
+		Entry.Suffix = Suffix;
+		if (Number >= 0)
+		{
+			Entry.NumberCount = 1;
+			Entry.Numbers[0] = Number;
+		}
+
+		return AddSymbol(Entry);
+	}
+
+	// Returns the length of the text, which is truncated (but still null-terminated) if it doesn't fit
+	int32 WriteSymbolText(FuzzShaderSymbol Symbol, char* OutBuffer, int32 BufferSize) const
+	{
+		ASSERT(Symbol < Symbols.size());
+		ASSERT(BufferSize > 0);
+
+		const SymbolEntry& Entry = Symbols[Symbol];
+
+		int32 Length = 0;
+		auto AppendText = [&](const char* Text)
+		{
+			while (*Text != '\0' && Length < BufferSize - 1)
+			{
+				OutBuffer[Length] = *Text;
+				Length++;
+				Text++;
+			}
+		};
+
+		AppendText(Entry.Prefix);
+		if (Entry.Base != InvalidShaderSymbol)
+		{
+			Length += WriteSymbolText(Entry.Base, OutBuffer + Length, BufferSize - Length);
+		}
+		AppendText(Entry.Suffix);
+
+		for (int32 i = 0; i < Entry.NumberCount; i++)
+		{
+			if (i > 0)
+			{
+				AppendText("_");
+			}
+
+			// Digits come out backwards
+			char Digits[16];
+			int32 NumDigits = 0;
+			uint32 Value = (uint32)Entry.Numbers[i];
+			do
+			{
+				Digits[NumDigits] = (char)('0' + (Value % 10));
+				NumDigits++;
+				Value /= 10;
+			} while (Value != 0);
+
+			while (NumDigits > 0 && Length < BufferSize - 1)
+			{
+				NumDigits--;
+				OutBuffer[Length] = Digits[NumDigits];
+				Length++;
+			}
+		}
+
+		OutBuffer[Length] = '\0';
+		return Length;
+	}
+
+	// Different ids can still be the same name (e.g. deriving "input.pos" twice), so this compares the text
+	bool IsSameText(FuzzShaderSymbol A, FuzzShaderSymbol B) const
+	{
+		if (A == B)
+		{
+			return true;
+		}
+
+		char TextA[256];
+		char TextB[256];
+		WriteSymbolText(A, TextA, sizeof(TextA));
+		WriteSymbolText(B, TextB, sizeof(TextB));
+		return strcmp(TextA, TextB) == 0;
+	}
+
+	std::string GetSymbolString(FuzzShaderSymbol Symbol) const
+	{
+		char Buffer[256];
+		int32 Length = WriteSymbolText(Symbol, Buffer, sizeof(Buffer));
+		return std::string(Buffer, Length);
+	}
+};
+
+// Bump allocator the AST nodes (and their child lists) come out of. There's one per thread, and resetting it between cases
+// just rewinds it, so once it's grown to fit the biggest case so far it stops allocating
+struct FuzzShaderArena
+{
+	enum { BlockSize = 64 * 1024 };
+
+	std::vector<byte*> Blocks;
+	int32 CurrentBlock = -1;
+	byte* Stack = nullptr;
+	byte* StackEnd = nullptr;
+
+	void Reset()
+	{
+		CurrentBlock = -1;
+		Stack = nullptr;
+		StackEnd = nullptr;
+	}
+
+	byte* Allocate(int32 Size, int32 Alignment = sizeof(void*))
+	{
+		ASSERT(Size <= BlockSize);
+
+		byte* AlignedStart = (byte*)(((size_t)Stack + Alignment - 1) / Alignment * Alignment);
+		if (Stack == nullptr || AlignedStart + Size > StackEnd)
+		{
+			CurrentBlock++;
+			if ((uint32)CurrentBlock == (uint32)Blocks.size())
+			{
+				Blocks.push_back(new byte[BlockSize]);
+			}
+
+			// Blocks are new'd, so they're aligned enough for anything we put in them
+			AlignedStart = Blocks[CurrentBlock];
+			StackEnd = AlignedStart + BlockSize;
+		}
+
+		Stack = AlignedStart + Size;
+		return AlignedStart;
+	}
+
+	~FuzzShaderArena()
+	{
+		for (byte* Block : Blocks)
+		{
+			delete[] Block;
+		}
+	}
+};
+
+struct FuzzShaderASTNode;
+
+// Child nodes, with the storage in the arena. The capacity has to be known when it's allocated
+struct FuzzShaderNodeList
+{
+	FuzzShaderASTNode** Nodes = nullptr;
+	int32 Count = 0;
+	int32 Capacity = 0;
+
+	void Add(FuzzShaderASTNode* Node)
+	{
+		ASSERT(Count < Capacity);
+		Nodes[Count] = Node;
+		Count++;
+	}
+
+	FuzzShaderASTNode** begin() const { return Nodes; }
+	FuzzShaderASTNode** end() const { return Nodes + Count; }
+};
+
+struct FuzzShaderASTNode
+{
+	// ???
+	enum struct VariableType
+	{
+		Float4,
+		Int,
+		Bool
+	};
+
+	enum struct NodeType
+	{
+		BinaryOperator,
+		TextureAccess,
+		ReadConstant,
+		ReadVariable,
+		Literal,
+		FuncCall,
+
+		StatementFirst,
+		Assignment = StatementFirst,
+		RangeForLoop,
+		// TODO:
+		//IfBranch,
+		StatementBlock,
+		StatementLast = StatementBlock,
+
+		Count
+	};
+
+	NodeType Type;
+};
+
+struct FuzzShaderFuncCall : FuzzShaderASTNode
+{
+	static constexpr NodeType StaticType = NodeType::FuncCall;
+
+	FuzzShaderSymbol FuncName = InvalidShaderSymbol;
+	FuzzShaderNodeList Arguments;
+	int32 OutputSize = 0; // In 32-bit components, e.g. 1 = float 4 = float4
+};
+
+struct FuzzShaderBinaryOperator : FuzzShaderASTNode
+{
+	enum struct Operator
+	{
+		Add,
+		Subtract,
+		Multiply,
+		Divide,
+		Count
+	};
+
+
+	static constexpr NodeType StaticType = NodeType::BinaryOperator;
+
+	FuzzShaderASTNode* LHS = nullptr;
+	FuzzShaderASTNode* RHS = nullptr;
+	Operator Op;
+};
+
+struct FuzzShaderTextureAccess : FuzzShaderASTNode
+{
+	static constexpr NodeType StaticType = NodeType::TextureAccess;
+
+	FuzzShaderSymbol TextureName = InvalidShaderSymbol;
+	FuzzShaderSymbol SamplerName = InvalidShaderSymbol;
+	FuzzShaderASTNode* UV = nullptr;
+};
+
+struct FuzzShaderAssignment : FuzzShaderASTNode
+{
+	static constexpr NodeType StaticType = NodeType::Assignment;
+
+	FuzzShaderSymbol VariableName = InvalidShaderSymbol;
+	FuzzShaderASTNode* Value = nullptr;
+	bool IsPredeclared = false; // Really just used in a hack for the end of the vertex shader
+};
+
+struct FuzzShaderLiteral : FuzzShaderASTNode
+{
+	static constexpr NodeType StaticType = NodeType::Literal;
+
+	float Values[4] = {};
+};
+
+struct FuzzShaderReadVariable : FuzzShaderASTNode
+{
+	static constexpr NodeType StaticType = NodeType::ReadVariable;
+
+	FuzzShaderSymbol VariableName = InvalidShaderSymbol;
+};
+
+struct FuzzShaderStatementBlock : FuzzShaderASTNode
+{
+	static constexpr NodeType StaticType = NodeType::StatementBlock;
+
+	FuzzShaderNodeList Statements;
+};
+
+//struct FuzzShaderResourceBinding
+//{
+//	enum struct ResourceType
+//	{
+//		// Texture
+//		// Sampler
+//		// ????
+//	};
+//};
+
+struct FuzzShaderRootConstants
+{
+	FuzzShaderSymbol VarName = InvalidShaderSymbol;
+	int32 ConstantCount = 0; // In 4x32-bit constants, e.g. float4
+	int32 SlotIndex = 0;
+};
+
+struct FuzzShaderRootCBV
+{
+	FuzzShaderSymbol VarName = InvalidShaderSymbol;
+	int32 ConstantCount = 0;
+	int32 SlotIndex = 0;
+};
+
+//struct FuzzShaderRootCBVDescriptorTable
+//{
+//	std::string VarName;
+//	int32 ConstantCount = 0;
+//};
+
+
+struct FuzzShaderTextureBinding
+{
+	FuzzShaderSymbol SamplerName = InvalidShaderSymbol;
+	FuzzShaderSymbol ResourceName = InvalidShaderSymbol;
+	int32 SlotIndex = 0;
+};
+
+struct FuzzShaderSemanticVar
+{
+	ShaderSemantic Semantic = ShaderSemantic::POSITION;
+	FuzzShaderSymbol VarName = InvalidShaderSymbol;
+	int32 SemanticIdx = 0;
+	int32 ParamIdx = 0;
+};
+
+struct FuzzShaderAST
+{
+	D3DShaderType Type;
+	// ....
+
+	// Var names for the vertex stage input from Input Assembler
+	// (must be empty for pixel shader)
+	std::vector<FuzzShaderSemanticVar> IAVars;
+
+	// Var names for Vertex output and Pixel input
+	std::vector<FuzzShaderSemanticVar> InterStageVars;
+
+	std::vector<FuzzShaderRootConstants> RootConstants;
+	std::vector<FuzzShaderRootCBV> RootCBVs;
+	std::vector<FuzzShaderTextureBinding> BoundTextures;
+
+
+	FuzzShaderASTNode* RootASTNode = nullptr;
+
+	// Shared by the vertex and pixel shader of a case, since they have to agree on the inter-stage var names
+	FuzzShaderSymbolTable* Symbols = nullptr;
+	
+	// Where the nodes come from. Nodes are never destructed, they just get thrown away when the arena is reset
+	FuzzShaderArena* Arena = nullptr;
+
+	// If set, we track the variables in scope the old way (a map per scope, picking the Nth one by walking them),
+	// which is slow but needed to get the same shaders out of seeds from before the flat table.
+	// Set from ShaderFuzzConfig::UseLegacyHLSLGeneration when we start generating
+	bool UseLegacyScopeMaps = false;
+
+	// Keyed by the variable's text, since that's what the iteration order depended on
+	std::vector<std::unordered_map<std::string, FuzzShaderSymbol>> VariablesInScope;
+
+	// Every variable in scope, outermost scope first. ScopeWatermarks has the size ScopeVariables was when each scope was pushed,
+	// so popping a scope just truncates back to it
+	std::vector<FuzzShaderSymbol> ScopeVariables;
+	std::vector<int32> ScopeWatermarks;
+
+	void PushScope()
+	{
+		if (UseLegacyScopeMaps)
+		{
+			VariablesInScope.emplace_back();
+		}
+		else
+		{
+			ScopeWatermarks.push_back((int32)ScopeVariables.size());
+		}
+	}
+
+	void PopScope()
+	{
+		if (UseLegacyScopeMaps)
+		{
+			VariablesInScope.pop_back();
+		}
+		else
+		{
+			ScopeVariables.resize(ScopeWatermarks.back());
+			ScopeWatermarks.pop_back();
+		}
+	}
+
+	int GetNumScopes() const
+	{
+		return UseLegacyScopeMaps ? (int)VariablesInScope.size() : (int)ScopeWatermarks.size();
+	}
+
+	void AddVariableToScope(FuzzShaderSymbol Variable)
+	{
+		if (UseLegacyScopeMaps)
+		{
+			VariablesInScope.back().emplace(Symbols->GetSymbolString(Variable), Variable);
+		}
+		else
+		{
+			ASSERT(ScopeWatermarks.size() > 0);
+			ScopeVariables.push_back(Variable);
+		}
+	}
+
+	int GetNumVariablesInScope() const
+	{
+		if (!UseLegacyScopeMaps)
+		{
+			return (int)ScopeVariables.size();
+		}
+
+		int Total = 0;
+		for (const auto& VarMap : VariablesInScope)
+		{
+			Total += VarMap.size();
+		}
+
+		return Total;
+	}
+
+	FuzzShaderSymbol GetNthVariableInScope(int Index) const
+	{
+		if (!UseLegacyScopeMaps)
+		{
+			return ScopeVariables[Index];
+		}
+
+		for (const auto& VarMap : VariablesInScope)
+		{
+			if ((uint32)Index < (uint32)VarMap.size())
+			{
+				auto Iter = VarMap.begin();
+				std::advance(Iter, Index);
+				return Iter->second;
+			}
+			else
+			{
+				Index -= (int32)VarMap.size();
+			}
+		}
+
+		assert(false);
+		return InvalidShaderSymbol;
+	}
+
+	template<typename T>
+	T* AllocateNode()
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "AST nodes never get destructed");
+
+		T* NewNode = new (Arena->Allocate(sizeof(T), alignof(T))) T();
+		NewNode->Type = T::StaticType;
+
+		return NewNode;
+	}
+
+	FuzzShaderNodeList AllocateNodeList(int32 Capacity)
+	{
+		FuzzShaderNodeList List;
+		List.Nodes = (FuzzShaderASTNode**)Arena->Allocate(sizeof(FuzzShaderASTNode*) * Capacity, alignof(FuzzShaderASTNode*));
+		List.Capacity = Capacity;
+
+		return List;
+	}
+
+	// Constants
+	// Vertex Attribs
+	// Vertex->Pixel raster variables
+
+	std::string SourceCode;
+	ID3DBlob* ByteCodeBlob = nullptr;
+	ShaderMetadata ShaderMeta;
+
+	// Gets it ready for the next case, but keeps the memory. The arena and symbols are reset separately
+	void Reset()
+	{
+		// TODO: If we ever start drawing, this will need to be released after fence completes
+#if defined(_WIN32)
+		if (ByteCodeBlob != nullptr)
+		{
+			ByteCodeBlob->Release();
+			ByteCodeBlob = nullptr;
+		}
+#endif
+
+		IAVars.clear();
+		InterStageVars.clear();
+		RootConstants.clear();
+		RootCBVs.clear();
+		BoundTextures.clear();
+		RootASTNode = nullptr;
+
+		VariablesInScope.clear();
+		ScopeVariables.clear();
+		ScopeWatermarks.clear();
+
+		SourceCode.clear();
+		ShaderMeta = ShaderMetadata();
+	}
+
+	~FuzzShaderAST()
+	{
+#if defined(_WIN32)
+		if (ByteCodeBlob != nullptr)
+		{
+			ByteCodeBlob->Release();
+		}
+#endif
+	}
+};
+
+struct FuzzShaderBuiltinFuncInfo {
+	const char* Name = "";
+	int32 Arity = 0;
+	int32 OutputSize = 0;
+};
+
+// The HLSL intrinsics the generator calls (defined in fuzz_shader_compiler.cpp)
+#define NUM_BUILTIN_SHADER_FUNCS 11
+extern FuzzShaderBuiltinFuncInfo BuiltinShaderFuncInfo[NUM_BUILTIN_SHADER_FUNCS];
+
+// Growable buffer the source gets emitted into. There's one per thread that gets reused, so it stops allocating once
+// it's big enough for the biggest shader so far
+struct ShaderSourceBuffer
+{
+	char* Data = nullptr;
+	int32 Length = 0;
+	int32 Capacity = 0;
+
+	void Reset()
+	{
+		Length = 0;
+	}
+
+	void EnsureSpace(int32 NumBytes)
+	{
+		if (Length + NumBytes > Capacity)
+		{
+			int32 NewCapacity = (Capacity > 0 ? Capacity : 64 * 1024);
+			while (Length + NumBytes > NewCapacity)
+			{
+				NewCapacity *= 2;
+			}
+
+			char* NewData = (char*)malloc(NewCapacity);
+			ASSERT(NewData != nullptr);
+			if (Length > 0)
+			{
+				memcpy(NewData, Data, Length);
+			}
+			free(Data);
+
+			Data = NewData;
+			Capacity = NewCapacity;
+		}
+	}
+
+	void Append(const char* Text, int32 TextLength)
+	{
+		EnsureSpace(TextLength);
+		memcpy(Data + Length, Text, TextLength);
+		Length += TextLength;
+	}
+
+	// For string literals, so the length is known at compile time
+	template<int32 N>
+	void AppendLiteral(const char (&Text)[N])
+	{
+		Append(Text, N - 1);
+	}
+
+	void AppendString(const char* Text)
+	{
+		Append(Text, (int32)strlen(Text));
+	}
+
+	void AppendInt(int32 Value)
+	{
+		char Digits[16];
+		int32 NumDigits = 0;
+		uint32 AbsValue = (Value < 0 ? 0u - (uint32)Value : (uint32)Value);
+		do
+		{
+			Digits[NumDigits] = (char)('0' + (AbsValue % 10));
+			NumDigits++;
+			AbsValue /= 10;
+		} while (AbsValue != 0);
+
+		EnsureSpace(NumDigits + 1);
+		if (Value < 0)
+		{
+			Data[Length] = '-';
+			Length++;
+		}
+
+		while (NumDigits > 0)
+		{
+			NumDigits--;
+			Data[Length] = Digits[NumDigits];
+			Length++;
+		}
+	}
+
+	// Same text as "%f" (6 decimal places, round-half-even on the exact value), without going through printf
+	void AppendFloat(float Value)
+	{
+		uint32 Bits = 0;
+		memcpy(&Bits, &Value, sizeof(Bits));
+
+		bool IsNegative = (Bits >> 31) != 0;
+		int32 BiasedExponent = (Bits >> 23) & 0xFF;
+		uint64 Mantissa = Bits & 0x7FFFFF;
+
+		// The value is Mantissa * 2^Exponent
+		int32 Exponent = 0;
+		if (BiasedExponent == 0)
+		{
+			Exponent = 1 - 127 - 23;
+		}
+		else
+		{
+			Mantissa |= 0x800000;
+			Exponent = BiasedExponent - 127 - 23;
+		}
+
+		// Mantissa * 1000000 fits in 44 bits, so anything that would overflow 64 bits (or is inf/nan) goes to printf
+		if (BiasedExponent == 0xFF || Exponent >= 20)
+		{
+			char Buffer[64];
+			int32 BufferLength = snprintf(Buffer, sizeof(Buffer), "%f", Value);
+			Append(Buffer, BufferLength);
+			return;
+		}
+
+		// Value * 10^6, rounded to an integer
+		uint64 Scaled = Mantissa * 1000000;
+		if (Exponent >= 0)
+		{
+			Scaled <<= Exponent;
+		}
+		else if (Exponent > -64)
+		{
+			int32 Shift = -Exponent;
+			uint64 Remainder = Scaled & ((1ull << Shift) - 1);
+			uint64 Half = 1ull << (Shift - 1);
+			Scaled >>= Shift;
+
+			if (Remainder > Half || (Remainder == Half && (Scaled & 1) != 0))
+			{
+				Scaled++;
+			}
+		}
+		else
+		{
+			// Less than half of 10^-6
+			Scaled = 0;
+		}
+
+		uint64 IntegerPart = Scaled / 1000000;
+		uint32 FractionPart = (uint32)(Scaled % 1000000);
+
+		char Digits[32];
+		int32 NumDigits = 0;
+		for (int32 i = 0; i < 6; i++)
+		{
+			Digits[NumDigits] = (char)('0' + (FractionPart % 10));
+			NumDigits++;
+			FractionPart /= 10;
+		}
+
+		Digits[NumDigits] = '.';
+		NumDigits++;
+
+		do
+		{
+			Digits[NumDigits] = (char)('0' + (IntegerPart % 10));
+			NumDigits++;
+			IntegerPart /= 10;
+		} while (IntegerPart != 0);
+
+		EnsureSpace(NumDigits + 1);
+		if (IsNegative)
+		{
+			Data[Length] = '-';
+			Length++;
+		}
+
+		while (NumDigits > 0)
+		{
+			NumDigits--;
+			Data[Length] = Digits[NumDigits];
+			Length++;
+		}
+	}
+
+	void AppendSymbol(const FuzzShaderSymbolTable* Symbols, FuzzShaderSymbol Symbol)
+	{
+		// Same cap as AppendShaderSymbol
+		const int32 MaxSymbolLength = 256;
+		EnsureSpace(MaxSymbolLength);
+		Length += Symbols->WriteSymbolText(Symbol, Data + Length, MaxSymbolLength);
+	}
+
+	~ShaderSourceBuffer()
+	{
+		free(Data);
+	}
+};
+
+// Binary encoding of a VS/PS pair (plus the symbols they share), so cases can be kept in a corpus and replayed, mutated
+// or re-emitted without running the generator again. Everything's varints except the literal floats, so a case is a few KB.
+// Only the ASTs are in there, the source/bytecode/metadata get recreated from them.
+//
+// Encoded pairs are self-delimiting, so a corpus file is just one after another
+
+// Bump this whenever the encoding changes, older data then gets rejected instead of misread
+#define FUZZ_SHADER_AST_ENCODING_VERSION 1
+
+// Appends to OutData
+void EncodeShaderASTPair(const FuzzShaderAST* VertexShader, const FuzzShaderAST* PixelShader, uint64 CaseSeed, std::vector<byte>* OutData);
+
+// Decodes one pair from the start of Data. Both ASTs need their Arena and Symbols set (to the same ones), and those get reset
+// along with the ASTs. The nodes are built straight into the arena, nothing else gets allocated once the arena and symbol
+// table have grown big enough. Returns false if the data's truncated, malformed, or from another version
+bool DecodeShaderASTPair(const byte* Data, uint32 Size, FuzzShaderAST* OutVertexShader, FuzzShaderAST* OutPixelShader, uint64* OutCaseSeed, uint32* OutEncodedSize);
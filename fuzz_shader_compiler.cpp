@@ -18,6 +18,16 @@
 
 #include "shader_meta.h"
 
+#include "fuzz_shader_ast.h"
+
+#include "fuzz_shader_mutate.h"
+
+#include "shader_compile_pipeline.h"
+
+#include "shader_case_filter.h"
+
+#include "trace_log.h"
+
 #include "string_stack_buffer.h"
 
 #include "d3d_resource_mgr.h"
@@ -26,6 +36,8 @@
 
 #include <assert.h>
 #include <unordered_map>
+#include <type_traits>
+#include <chrono>
 
 
 // struct ShaderAST;
@@ -47,340 +59,6 @@ typedef unsigned char byte;
 //	Count
 //};
 
-struct FuzzShaderASTNode
-{
-	// ???
-	enum struct VariableType
-	{
-		Float4,
-		Int,
-		Bool
-	};
-
-	enum struct NodeType
-	{
-		BinaryOperator,
-		TextureAccess,
-		ReadConstant,
-		ReadVariable,
-		Literal,
-		FuncCall,
-
-		StatementFirst,
-		Assignment = StatementFirst,
-		RangeForLoop,
-		// TODO:
-		//IfBranch,
-		StatementBlock,
-		StatementLast = StatementBlock,
-
-		Count
-	};
-
-	NodeType Type;
-};
-
-struct FuzzShaderFuncCall : FuzzShaderASTNode
-{
-	static constexpr NodeType StaticType = NodeType::FuncCall;
-
-	std::string FuncName;
-	std::vector<FuzzShaderASTNode*> Arguments;
-	int32 OutputSize = 0; // In 32-bit components, e.g. 1 = float 4 = float4
-};
-
-struct FuzzShaderBinaryOperator : FuzzShaderASTNode
-{
-	enum struct Operator
-	{
-		Add,
-		Subtract,
-		Multiply,
-		Divide,
-		Count
-	};
-
-
-	static constexpr NodeType StaticType = NodeType::BinaryOperator;
-
-	FuzzShaderASTNode* LHS = nullptr;
-	FuzzShaderASTNode* RHS = nullptr;
-	Operator Op;
-};
-
-struct FuzzShaderTextureAccess : FuzzShaderASTNode
-{
-	static constexpr NodeType StaticType = NodeType::TextureAccess;
-
-	std::string TextureName;
-	std::string SamplerName;
-	FuzzShaderASTNode* UV = nullptr;
-};
-
-struct FuzzShaderAssignment : FuzzShaderASTNode
-{
-	static constexpr NodeType StaticType = NodeType::Assignment;
-
-	std::string VariableName;
-	FuzzShaderASTNode* Value = nullptr;
-	bool IsPredeclared = false; // Really just used in a hack for the end of the vertex shader
-};
-
-struct FuzzShaderLiteral : FuzzShaderASTNode
-{
-	static constexpr NodeType StaticType = NodeType::Literal;
-
-	float Values[4] = {};
-};
-
-struct FuzzShaderReadVariable : FuzzShaderASTNode
-{
-	static constexpr NodeType StaticType = NodeType::ReadVariable;
-
-	std::string VariableName;
-};
-
-struct FuzzShaderStatementBlock : FuzzShaderASTNode
-{
-	static constexpr NodeType StaticType = NodeType::StatementBlock;
-
-	std::vector<FuzzShaderASTNode*> Statements;
-};
-
-//struct FuzzShaderResourceBinding
-//{
-//	enum struct ResourceType
-//	{
-//		// Texture
-//		// Sampler
-//		// ????
-//	};
-//};
-
-struct FuzzShaderRootConstants
-{
-	std::string VarName;
-	int32 ConstantCount = 0; // In 4x32-bit constants, e.g. float4
-	int32 SlotIndex = 0;
-};
-
-struct FuzzShaderRootCBV
-{
-	std::string VarName;
-	int32 ConstantCount = 0;
-	int32 SlotIndex = 0;
-};
-
-//struct FuzzShaderRootCBVDescriptorTable
-//{
-//	std::string VarName;
-//	int32 ConstantCount = 0;
-//};
-
-
-struct FuzzShaderTextureBinding
-{
-	std::string SamplerName;
-	std::string ResourceName;
-	int32 SlotIndex = 0;
-};
-
-struct FuzzShaderSemanticVar
-{
-	ShaderSemantic Semantic = ShaderSemantic::POSITION;
-	std::string VarName;
-	int32 SemanticIdx = 0;
-	int32 ParamIdx = 0;
-};
-
-struct FuzzShaderAST
-{
-	D3DShaderType Type;
-	// ....
-
-	// Var names for the vertex stage input from Input Assembler
-	// (must be empty for pixel shader)
-	std::vector<FuzzShaderSemanticVar> IAVars;
-
-	// Var names for Vertex output and Pixel input
-	std::vector<FuzzShaderSemanticVar> InterStageVars;
-
-	std::vector<FuzzShaderRootConstants> RootConstants;
-	std::vector<FuzzShaderRootCBV> RootCBVs;
-	std::vector<FuzzShaderTextureBinding> BoundTextures;
-
-
-	FuzzShaderASTNode* RootASTNode = nullptr;
-	
-	struct BlockAllocation
-	{
-		enum { BlockSize = 64 * 1024 };
-
-		byte* Base = nullptr;
-		byte* Stack = nullptr;
-
-		byte* Allocate(int Size, int Alignment = sizeof(void*))
-		{
-			byte* AlignedStart = (byte*)(((size_t)Stack + Alignment - 1) / Alignment * Alignment);
-			if (AlignedStart + Size <= Base + BlockSize)
-			{
-				Stack = AlignedStart + Size;
-				return AlignedStart;
-			}
-			else
-			{
-				return nullptr;
-			}
-		}
-
-		BlockAllocation()
-		{
-			Base = (byte*)malloc(BlockSize);
-			Stack = Base;
-		}
-
-		~BlockAllocation()
-		{
-			free(Base);
-			Base = nullptr;
-			Stack = nullptr;
-		}
-	};
-	
-	std::vector<BlockAllocation*> BlockAllocations;
-	// TODO: Some of these will have virtual dtors...need to preserve type info or just make it virtual and suck it up
-	// Orrr.....we play very dirty and use the type info to cast it and call the right dtor
-	std::vector<FuzzShaderASTNode*> AllocatedNodes;
-
-	std::vector<std::unordered_map<std::string, FuzzShaderASTNode*>> VariablesInScope;
-
-	// TODO: Might be worth caching some of this info,
-	// depends on how much time it ends up taking
-	int GetNumVariablesInScope() const
-	{
-		int Total = 0;
-		for (const auto& VarMap : VariablesInScope)
-		{
-			Total += VarMap.size();
-		}
-
-		return Total;
-	}
-
-	std::string GetNthVariableInScope(int Index) const
-	{
-		for (const auto& VarMap : VariablesInScope)
-		{
-			if (Index < VarMap.size())
-			{
-				auto Iter = VarMap.begin();
-				std::advance(Iter, Index);
-				return Iter->first;
-			}
-			else
-			{
-				Index -= VarMap.size();
-			}
-		}
-
-		assert(false);
-		return "";
-	}
-
-	template<typename T>
-	T* AllocateNode()
-	{
-		if (BlockAllocations.size() == 0)
-		{
-			BlockAllocations.push_back(new BlockAllocation());
-		}
-
-		byte* MemoryToUse = nullptr;
-
-		if (byte* Memory = BlockAllocations.back()->Allocate(sizeof(T), alignof(T)))
-		{
-			MemoryToUse = Memory;
-		}
-		else
-		{
-			BlockAllocations.push_back(new BlockAllocation());
-
-			if (byte* MemoryTry2 = BlockAllocations.back()->Allocate(sizeof(T), alignof(T)))
-			{
-				MemoryToUse = MemoryTry2;
-			}
-			else
-			{
-				assert(false && "Enksjdgbse");
-			}
-		}
-
-		assert(MemoryToUse != nullptr);
-
-		T* NewNode = new (MemoryToUse) T();
-		NewNode->Type = T::StaticType;
-		AllocatedNodes.push_back(NewNode);
-
-		return NewNode;
-	}
-
-	// Constants
-	// Vertex Attribs
-	// Vertex->Pixel raster variables
-
-	std::string SourceCode;
-	ID3DBlob* ByteCodeBlob = nullptr;
-	ShaderMetadata ShaderMeta;
-
-	~FuzzShaderAST()
-	{
-		// TODO: If we ever start drawing, this will need to be released after fence completes
-		ByteCodeBlob->Release();
-
-		for (auto* Node : AllocatedNodes)
-		{
-			if (Node->Type == FuzzShaderASTNode::NodeType::StatementBlock)
-			{
-				auto* StmtBlock = (FuzzShaderStatementBlock*)Node;
-				StmtBlock->~FuzzShaderStatementBlock();
-			}
-			else if (Node->Type == FuzzShaderASTNode::NodeType::ReadVariable)
-			{
-				auto* ReadVar = (FuzzShaderReadVariable*)Node;
-				ReadVar->~FuzzShaderReadVariable();
-			}
-			else if (Node->Type == FuzzShaderASTNode::NodeType::Assignment)
-			{
-				auto* Assnmt = (FuzzShaderAssignment*)Node;
-				Assnmt->~FuzzShaderAssignment();
-			}
-			else if (Node->Type == FuzzShaderASTNode::NodeType::TextureAccess)
-			{
-				auto* Tex = (FuzzShaderTextureAccess*)Node;
-				Tex->~FuzzShaderTextureAccess();
-			}
-			else if (Node->Type == FuzzShaderASTNode::NodeType::FuncCall)
-			{
-				auto* Tex = (FuzzShaderFuncCall*)Node;
-				Tex->~FuzzShaderFuncCall();
-			}
-		}
-
-		for (const auto& Block : BlockAllocations)
-		{
-			delete Block;
-		}
-
-		BlockAllocations.clear();
-	}
-};
-
-struct FuzzShaderBuiltinFuncInfo {
-	const char* Name = "";
-	int32 Arity = 0;
-	int32 OutputSize = 0;
-};
-
 FuzzShaderBuiltinFuncInfo BuiltinShaderFuncInfo[] = {
 	{ "dot", 2, 1},
 	{ "dst", 2, 4},
@@ -399,7 +77,8 @@ FuzzShaderASTNode* GenerateFuzzingShaderValue(ShaderFuzzingState* Fuzzer, FuzzSh
 {
 	float Decider = Fuzzer->GetFloat01();
 
-	const int32 MaxDepth = 8;
+	// Past the end of a replay tape the decider is always 0, which would mean binary ops all the way down
+	const int32 MaxDepth = (Fuzzer->IsPastEndOfReplayTape() ? CurrentDepth : Fuzzer->HLSLSize.MaxExpressionDepth);
 
 	if (CurrentDepth < MaxDepth && Decider < 0.1)
 	{
@@ -420,11 +99,12 @@ FuzzShaderASTNode* GenerateFuzzingShaderValue(ShaderFuzzingState* Fuzzer, FuzzSh
 
 		FuzzShaderBuiltinFuncInfo* BuiltinInfo = &BuiltinShaderFuncInfo[Fuzzer->GetIntInRange(0, NumBuiltins - 1)];
 
-		FuncCall->FuncName = BuiltinInfo->Name;
+		FuncCall->FuncName = OutShaderAST->Symbols->InternLiteral(BuiltinInfo->Name);
 		FuncCall->OutputSize = BuiltinInfo->OutputSize;
+		FuncCall->Arguments = OutShaderAST->AllocateNodeList(BuiltinInfo->Arity);
 		for (int32 i = 0; i < BuiltinInfo->Arity; i++)
 		{
-			FuncCall->Arguments.push_back(GenerateFuzzingShaderValue(Fuzzer, OutShaderAST, CurrentDepth + 1));
+			FuncCall->Arguments.Add(GenerateFuzzingShaderValue(Fuzzer, OutShaderAST, CurrentDepth + 1));
 		}
 
 		return FuncCall;
@@ -463,27 +143,34 @@ FuzzShaderASTNode* GenerateFuzzingShaderValue(ShaderFuzzingState* Fuzzer, FuzzSh
 	}
 }
 
-std::string GetRandomShaderVariableName(ShaderFuzzingState* Fuzzer, const char* Prefix)
+FuzzShaderSymbol GetRandomShaderVariableName(ShaderFuzzingState* Fuzzer, FuzzShaderSymbolTable* Symbols, const char* Prefix)
 {
-	// TODO: We might want to add more bits just to avoid any birthday attacks...I mean it's not cryptography but still would
-	// be a false positive in fuzzing so yanno
-	char Buffer[256] = {};
-	int a = Fuzzer->GetIntInRange(0, 64 * 1024);
-	int b = Fuzzer->GetIntInRange(0, 64 * 1024);
-	int c = Fuzzer->GetIntInRange(0, 64 * 1024);
-	snprintf(Buffer, sizeof(Buffer), "%s_%d_%d_%d", Prefix, a, b, c);
-
-	return Buffer;
+	if (Fuzzer->Config->UseLegacyHLSLGeneration == 0)
+	{
+		return Symbols->MakeUniqueName(Prefix);
+	}
+
+	// The old names were "{Prefix}_{a}_{b}_{c}" with 3 random numbers, which could (rarely) collide. But the draws
+	// have to stay for old seeds to reproduce
+	FuzzShaderSymbolTable::SymbolEntry Entry;
+	Entry.Prefix = Prefix;
+	Entry.Suffix = "_";
+	Entry.NumberCount = 3;
+	Entry.Numbers[0] = Fuzzer->GetIntInRange(0, 64 * 1024);
+	Entry.Numbers[1] = Fuzzer->GetIntInRange(0, 64 * 1024);
+	Entry.Numbers[2] = Fuzzer->GetIntInRange(0, 64 * 1024);
+
+	return Symbols->AddSymbol(Entry);
 }
 
 FuzzShaderAssignment* GenerateFuzzingShaderAssignment(ShaderFuzzingState* Fuzzer, FuzzShaderAST* OutShaderAST)
 {
 	auto* NewStmt = OutShaderAST->AllocateNode<FuzzShaderAssignment>();
 
-	NewStmt->VariableName = GetRandomShaderVariableName(Fuzzer, "tempvar");
+	NewStmt->VariableName = GetRandomShaderVariableName(Fuzzer, OutShaderAST->Symbols, "tempvar");
 	NewStmt->Value = GenerateFuzzingShaderValue(Fuzzer, OutShaderAST, 0);
 
-	OutShaderAST->VariablesInScope.back().emplace(NewStmt->VariableName, NewStmt);
+	OutShaderAST->AddVariableToScope(NewStmt->VariableName);
 
 	return NewStmt;
 }
@@ -499,9 +186,9 @@ void GenerateResourceBindingForShader(ShaderFuzzingState* Fuzzer, FuzzShaderAST*
 		FuzzShaderRootConstants Constants;
 		Constants.ConstantCount = 1; // TODO:
 		Constants.SlotIndex = i;
-		Constants.VarName = GetRandomShaderVariableName(Fuzzer, "root_inline");
+		Constants.VarName = GetRandomShaderVariableName(Fuzzer, OutShaderAST->Symbols, "root_inline");
 
-		OutShaderAST->VariablesInScope.back().emplace(Constants.VarName, nullptr);
+		OutShaderAST->AddVariableToScope(Constants.VarName);
 
 		OutShaderAST->RootConstants.push_back(Constants);
 	}
@@ -511,13 +198,11 @@ void GenerateResourceBindingForShader(ShaderFuzzingState* Fuzzer, FuzzShaderAST*
 		FuzzShaderRootCBV CBVBind;
 		CBVBind.ConstantCount = Fuzzer->GetIntInRange(1, 6); // TODO:
 		CBVBind.SlotIndex = NumRootConstants + i;
-		CBVBind.VarName = GetRandomShaderVariableName(Fuzzer, "root_cbv");
+		CBVBind.VarName = GetRandomShaderVariableName(Fuzzer, OutShaderAST->Symbols, "root_cbv");
 
 		for (int32 VarIdx = 0; VarIdx < CBVBind.ConstantCount; VarIdx++)
 		{
-			char FinalName[1024];
-			snprintf(FinalName, sizeof(FinalName), "%s_var%d", CBVBind.VarName.c_str(), VarIdx);
-			OutShaderAST->VariablesInScope.back().emplace(FinalName, nullptr);
+			OutShaderAST->AddVariableToScope(OutShaderAST->Symbols->MakeDerivedName("", CBVBind.VarName, "_var", VarIdx));
 		}
 
 		OutShaderAST->RootCBVs.push_back(CBVBind);
@@ -526,8 +211,8 @@ void GenerateResourceBindingForShader(ShaderFuzzingState* Fuzzer, FuzzShaderAST*
 	for (int32 i = 0; i < NumBoundTextures; i++)
 	{
 		FuzzShaderTextureBinding TextureBinding;
-		TextureBinding.ResourceName = GetRandomShaderVariableName(Fuzzer, "tex");
-		TextureBinding.SamplerName = GetRandomShaderVariableName(Fuzzer, "sampler");
+		TextureBinding.ResourceName = GetRandomShaderVariableName(Fuzzer, OutShaderAST->Symbols, "tex");
+		TextureBinding.SamplerName = GetRandomShaderVariableName(Fuzzer, OutShaderAST->Symbols, "sampler");
 		TextureBinding.SlotIndex = i;
 
 		OutShaderAST->BoundTextures.push_back(TextureBinding);
@@ -536,7 +221,9 @@ void GenerateResourceBindingForShader(ShaderFuzzingState* Fuzzer, FuzzShaderAST*
 
 void GenerateFuzzingShader(ShaderFuzzingState* Fuzzer, FuzzShaderAST* OutShaderAST)
 {
-	OutShaderAST->VariablesInScope.emplace_back();
+	OutShaderAST->UseLegacyScopeMaps = (Fuzzer->Config->UseLegacyHLSLGeneration != 0);
+
+	OutShaderAST->PushScope();
 
 	GenerateResourceBindingForShader(Fuzzer, OutShaderAST);
 
@@ -545,7 +232,7 @@ void GenerateFuzzingShader(ShaderFuzzingState* Fuzzer, FuzzShaderAST* OutShaderA
 		for (const auto& Var : OutShaderAST->InterStageVars)
 		{
 			// HACK: Referencing the struct I guess
-			OutShaderAST->VariablesInScope.back().emplace(std::string("input.") + Var.VarName, nullptr);
+			OutShaderAST->AddVariableToScope(OutShaderAST->Symbols->MakeDerivedName("input.", Var.VarName));
 		}
 	}
 	else if (OutShaderAST->Type == D3DShaderType::Vertex)
@@ -553,7 +240,7 @@ void GenerateFuzzingShader(ShaderFuzzingState* Fuzzer, FuzzShaderAST* OutShaderA
 		for (const auto& Var : OutShaderAST->IAVars)
 		{
 			// HACK: Referencing the struct I guess
-			OutShaderAST->VariablesInScope.back().emplace(std::string("input.") + Var.VarName, nullptr);
+			OutShaderAST->AddVariableToScope(OutShaderAST->Symbols->MakeDerivedName("input.", Var.VarName));
 		}
 	}
 	// TODO: Compute...idk...
@@ -567,9 +254,15 @@ void GenerateFuzzingShader(ShaderFuzzingState* Fuzzer, FuzzShaderAST* OutShaderA
 
 	//----------------------------------------------------------
 
-	OutShaderAST->VariablesInScope.emplace_back();
+	OutShaderAST->PushScope();
 
+	// Always drawn from the full range, and then scaled down, so a smaller max doesn't change how many draws it takes
 	int NumRootStatements = Fuzzer->GetIntInRange(4, 200);
+	NumRootStatements = 4 + (NumRootStatements - 4) * (Fuzzer->HLSLSize.MaxRootStatements - 4) / (200 - 4);
+
+	// Plus the outputs at the end
+	int NumOutputStatements = (OutShaderAST->Type == D3DShaderType::Vertex ? (int)OutShaderAST->InterStageVars.size() : 1);
+	RootNode->Statements = OutShaderAST->AllocateNodeList(NumRootStatements + NumOutputStatements);
 
 	for (int i = 0; i < NumRootStatements; i++)
 	{
@@ -578,7 +271,7 @@ void GenerateFuzzingShader(ShaderFuzzingState* Fuzzer, FuzzShaderAST* OutShaderA
 		if (Decider < 0.8f || true)
 		{
 			auto* NewStmt = GenerateFuzzingShaderAssignment(Fuzzer, OutShaderAST);
-			RootNode->Statements.push_back(NewStmt);
+			RootNode->Statements.Add(NewStmt);
 		}
 		else
 		{
@@ -597,20 +290,20 @@ void GenerateFuzzingShader(ShaderFuzzingState* Fuzzer, FuzzShaderAST* OutShaderA
 		{
 			auto* NewStmt = GenerateFuzzingShaderAssignment(Fuzzer, OutShaderAST);
 			NewStmt->IsPredeclared = true;
-			NewStmt->VariableName = "result";
-			RootNode->Statements.push_back(NewStmt);
+			NewStmt->VariableName = OutShaderAST->Symbols->InternLiteral("result");
+			RootNode->Statements.Add(NewStmt);
 		}
 		else if (OutShaderAST->Type == D3DShaderType::Vertex)
 		{
 			for (const auto& Var : OutShaderAST->InterStageVars)
 			{
 				// HACK: Make sure the variable doesn't persist
-				OutShaderAST->VariablesInScope.emplace_back();
+				OutShaderAST->PushScope();
 				auto* NewStmt = GenerateFuzzingShaderAssignment(Fuzzer, OutShaderAST);
-				OutShaderAST->VariablesInScope.pop_back();
+				OutShaderAST->PopScope();
 
 				NewStmt->IsPredeclared = true;
-				NewStmt->VariableName = std::string("result.") + Var.VarName;
+				NewStmt->VariableName = OutShaderAST->Symbols->MakeDerivedName("result.", Var.VarName);
 
 				// If we want to ensure better pixel coverage
 				if (Fuzzer->Config->EnsureBetterPixelCoverage != 0 && Var.Semantic == ShaderSemantic::SV_POSITION)
@@ -623,7 +316,7 @@ void GenerateFuzzingShader(ShaderFuzzingState* Fuzzer, FuzzShaderAST* OutShaderA
 					OuterAdd->Op = FuzzShaderBinaryOperator::Operator::Add;
 
 					auto* IAVarRead = OutShaderAST->AllocateNode<FuzzShaderReadVariable>();
-					IAVarRead->VariableName = std::string("input.") + PositionIAVar.VarName;
+					IAVarRead->VariableName = OutShaderAST->Symbols->MakeDerivedName("input.", PositionIAVar.VarName);
 					OuterAdd->LHS = IAVarRead;
 
 					auto* InnerMul = OutShaderAST->AllocateNode<FuzzShaderBinaryOperator>();
@@ -642,32 +335,43 @@ void GenerateFuzzingShader(ShaderFuzzingState* Fuzzer, FuzzShaderAST* OutShaderA
 					NewStmt->Value = OuterAdd;
 				}
 
-				RootNode->Statements.push_back(NewStmt);
+				RootNode->Statements.Add(NewStmt);
 			}
 		}
 	}
 	//---
 
-	OutShaderAST->VariablesInScope.pop_back();
+	OutShaderAST->PopScope();
 
 	//--------------------------------------
 
-	OutShaderAST->VariablesInScope.pop_back();
+	OutShaderAST->PopScope();
 
-	assert(OutShaderAST->VariablesInScope.size() == 0);
+	assert(OutShaderAST->GetNumScopes() == 0);
 }
 
-#define AST_SOURCE_LIMIT (16 * 1024)
+// Biggest shader source we'll emit. The old emitter's fixed-size buffer silently truncated at this, now it's checked
+#define AST_SOURCE_LIMIT (1024 * 1024)
+
+// The old printf-based emitter. Not used for fuzzing anymore, just kept to benchmark and cross-check the one below against
+void AppendShaderSymbol(FuzzShaderAST* ShaderAST, FuzzShaderSymbol Symbol, StringBuffer* StrBuf)
+{
+	char SymbolText[256];
+	ShaderAST->Symbols->WriteSymbolText(Symbol, SymbolText, sizeof(SymbolText));
+	StrBuf->Append(SymbolText);
+}
 
-void ConvertShaderASTNodeToSourceCode(FuzzShaderAST* ShaderAST, FuzzShaderASTNode* Node, StringBuffer* StrBuf, ShaderFuzzConfig* Config)
+void ConvertShaderASTNodeToSourceCodeWithPrintf(FuzzShaderAST* ShaderAST, FuzzShaderASTNode* Node, StringBuffer* StrBuf, ShaderFuzzConfig* Config)
 {
 	// TODO: Do Maybe cast construction w/ templates or w/e? Since we have the static type stuff
 	if (Node->Type == FuzzShaderASTNode::NodeType::Assignment)
 	{
 		auto* Assnmt = static_cast<FuzzShaderAssignment*>(Node);
 
-		StrBuf->AppendFormat("\t%s%s = ", (Assnmt->IsPredeclared ? "" : "float4 "), Assnmt->VariableName.c_str());
-		ConvertShaderASTNodeToSourceCode(ShaderAST, Assnmt->Value, StrBuf, Config);
+		StrBuf->Append(Assnmt->IsPredeclared ? "\t" : "\tfloat4 ");
+		AppendShaderSymbol(ShaderAST, Assnmt->VariableName, StrBuf);
+		StrBuf->Append(" = ");
+		ConvertShaderASTNodeToSourceCodeWithPrintf(ShaderAST, Assnmt->Value, StrBuf, Config);
 		StrBuf->AppendFormat(";\n");
 	}
 	else if (Node->Type == FuzzShaderASTNode::NodeType::BinaryOperator)
@@ -675,7 +379,7 @@ void ConvertShaderASTNodeToSourceCode(FuzzShaderAST* ShaderAST, FuzzShaderASTNod
 		auto* Bin = static_cast<FuzzShaderBinaryOperator*>(Node);
 
 		StrBuf->AppendFormat("(");
-		ConvertShaderASTNodeToSourceCode(ShaderAST, Bin->LHS, StrBuf, Config);
+		ConvertShaderASTNodeToSourceCodeWithPrintf(ShaderAST, Bin->LHS, StrBuf, Config);
 
 		if (Bin->Op == FuzzShaderBinaryOperator::Operator::Add)
 		{
@@ -698,7 +402,7 @@ void ConvertShaderASTNodeToSourceCode(FuzzShaderAST* ShaderAST, FuzzShaderASTNod
 			assert(false && "skjdfjk");
 		}
 
-		ConvertShaderASTNodeToSourceCode(ShaderAST, Bin->RHS, StrBuf, Config);
+		ConvertShaderASTNodeToSourceCodeWithPrintf(ShaderAST, Bin->RHS, StrBuf, Config);
 		StrBuf->AppendFormat(")");
 	}
 	else if (Node->Type == FuzzShaderASTNode::NodeType::TextureAccess)
@@ -706,8 +410,12 @@ void ConvertShaderASTNodeToSourceCode(FuzzShaderAST* ShaderAST, FuzzShaderASTNod
 		auto* Tex = static_cast<FuzzShaderTextureAccess*>(Node);
 
 		// TODO: SampleLevel is required for vertex shader, but Sample() could be done in Pixel shaders
-		StrBuf->AppendFormat("(%s.SampleLevel(%s, (", Tex->TextureName.c_str(), Tex->SamplerName.c_str());
-		ConvertShaderASTNodeToSourceCode(ShaderAST, Tex->UV, StrBuf, Config);
+		StrBuf->Append("(");
+		AppendShaderSymbol(ShaderAST, Tex->TextureName, StrBuf);
+		StrBuf->Append(".SampleLevel(");
+		AppendShaderSymbol(ShaderAST, Tex->SamplerName, StrBuf);
+		StrBuf->Append(", (");
+		ConvertShaderASTNodeToSourceCodeWithPrintf(ShaderAST, Tex->UV, StrBuf, Config);
 		StrBuf->Append(").xy, 0))");
 
 		//MyTexture.Sample(MySampler, UV)
@@ -715,7 +423,7 @@ void ConvertShaderASTNodeToSourceCode(FuzzShaderAST* ShaderAST, FuzzShaderASTNod
 	else if (Node->Type == FuzzShaderASTNode::NodeType::ReadVariable)
 	{
 		auto* ReadVar = static_cast<FuzzShaderReadVariable*>(Node);
-		StrBuf->Append(ReadVar->VariableName.c_str());
+		AppendShaderSymbol(ShaderAST, ReadVar->VariableName, StrBuf);
 	}
 	else if (Node->Type == FuzzShaderASTNode::NodeType::Literal)
 	{
@@ -733,14 +441,15 @@ void ConvertShaderASTNodeToSourceCode(FuzzShaderAST* ShaderAST, FuzzShaderASTNod
 			StrBuf->Append("float4(");
 		}
 
-		StrBuf->AppendFormat("%s(", FuncCall->FuncName.c_str());
-		for (int32 i = 0; i < FuncCall->Arguments.size(); i++)
+		AppendShaderSymbol(ShaderAST, FuncCall->FuncName, StrBuf);
+		StrBuf->Append("(");
+		for (int32 i = 0; i < FuncCall->Arguments.Count; i++)
 		{
 			if (i > 0)
 			{
 				StrBuf->Append(", ");
 			}
-			ConvertShaderASTNodeToSourceCode(ShaderAST, FuncCall->Arguments[i], StrBuf, Config);
+			ConvertShaderASTNodeToSourceCodeWithPrintf(ShaderAST, FuncCall->Arguments.Nodes[i], StrBuf, Config);
 		}
 		StrBuf->Append(")");
 
@@ -774,7 +483,7 @@ void ConvertShaderASTNodeToSourceCode(FuzzShaderAST* ShaderAST, FuzzShaderASTNod
 
 		for (auto Stmt : Block->Statements)
 		{
-			ConvertShaderASTNodeToSourceCode(ShaderAST, Stmt, StrBuf, Config);
+			ConvertShaderASTNodeToSourceCodeWithPrintf(ShaderAST, Stmt, StrBuf, Config);
 		}
 
 		// TODO: Should be in AST generation, not here
@@ -798,30 +507,39 @@ void ConvertShaderASTNodeToSourceCode(FuzzShaderAST* ShaderAST, FuzzShaderASTNod
 	}
 }
 
-void ConvertShaderASTToSourceCode(FuzzShaderAST* ShaderAST, ShaderFuzzConfig* Config)
+void ConvertShaderASTToSourceCodeWithPrintf(FuzzShaderAST* ShaderAST, ShaderFuzzConfig* Config)
 {
 	// TODO: Maybe move this to heap and make it dynamic, idk
 	StringBuffer StrBuf(1024 * 1024);
 
 	for (const auto& RootConstant : ShaderAST->RootConstants)
 	{
-		StrBuf.AppendFormat("float4 %s;\n", RootConstant.VarName.c_str());
+		StrBuf.Append("float4 ");
+		AppendShaderSymbol(ShaderAST, RootConstant.VarName, &StrBuf);
+		StrBuf.Append(";\n");
 	}
 
 	for (const auto& RootCBV : ShaderAST->RootCBVs)
 	{
-		StrBuf.AppendFormat("cbuffer %s {\n", RootCBV.VarName.c_str());
+		StrBuf.Append("cbuffer ");
+		AppendShaderSymbol(ShaderAST, RootCBV.VarName, &StrBuf);
+		StrBuf.Append(" {\n");
 		for (int32 VarIdx = 0; VarIdx < RootCBV.ConstantCount; VarIdx++)
 		{
-			StrBuf.AppendFormat("\tfloat4 %s_var%d;\n", RootCBV.VarName.c_str(), VarIdx);
+			StrBuf.Append("\tfloat4 ");
+			AppendShaderSymbol(ShaderAST, RootCBV.VarName, &StrBuf);
+			StrBuf.AppendFormat("_var%d;\n", VarIdx);
 		}
 		StrBuf.Append("};\n");
 	}
 
 	for (const auto& TextureBind : ShaderAST->BoundTextures)
 	{
-		StrBuf.AppendFormat("Texture2D %s;\n", TextureBind.ResourceName.c_str());
-		StrBuf.AppendFormat("SamplerState %s;\n", TextureBind.SamplerName.c_str());
+		StrBuf.Append("Texture2D ");
+		AppendShaderSymbol(ShaderAST, TextureBind.ResourceName, &StrBuf);
+		StrBuf.Append(";\nSamplerState ");
+		AppendShaderSymbol(ShaderAST, TextureBind.SamplerName, &StrBuf);
+		StrBuf.Append(";\n");
 	}
 
 
@@ -830,40 +548,309 @@ void ConvertShaderASTToSourceCode(FuzzShaderAST* ShaderAST, ShaderFuzzConfig* Co
 		StrBuf.Append("struct VSInput {\n");
 		for (const auto& Var : ShaderAST->IAVars)
 		{
-			StrBuf.AppendFormat("float4 %s : %s;\n", Var.VarName.c_str(), GetSemanticNameFromSemantic(Var.Semantic));
+			StrBuf.Append("float4 ");
+			AppendShaderSymbol(ShaderAST, Var.VarName, &StrBuf);
+			StrBuf.AppendFormat(" : %s;\n", GetSemanticNameFromSemantic(Var.Semantic));
+		}
+		StrBuf.Append("};\n");
+	}
+
+	// VS and PS both need to know this
+	{
+		StrBuf.Append("struct PSInput {\n");
+		for (const auto& Var : ShaderAST->InterStageVars)
+		{
+			StrBuf.Append("float4 ");
+			AppendShaderSymbol(ShaderAST, Var.VarName, &StrBuf);
+			StrBuf.AppendFormat(" : %s;\n", GetSemanticNameFromSemantic(Var.Semantic));
 		}
 		StrBuf.Append("};\n");
 	}
 
+	if (ShaderAST->Type == D3DShaderType::Vertex)
+	{
+		StrBuf.Append("PSInput Main(VSInput input)\n");
+	}
+	else if (ShaderAST->Type == D3DShaderType::Pixel)
+	{
+		StrBuf.Append("float4 Main(PSInput input) : SV_TARGET\n");
+	}
+	else
+	{
+		assert(false && "afsdgf");
+	}
+
+	ConvertShaderASTNodeToSourceCodeWithPrintf(ShaderAST, ShaderAST->RootASTNode, &StrBuf, Config);
+
+	StrBuf.Append("\n");
+
+
+	ShaderAST->SourceCode = StrBuf.buffer;
+}
+
+static thread_local ShaderSourceBuffer ShaderSourceScratch;
+
+void ConvertShaderASTNodeToSourceCode(FuzzShaderAST* ShaderAST, FuzzShaderASTNode* Node, ShaderSourceBuffer* Out, ShaderFuzzConfig* Config)
+{
+	if (Node->Type == FuzzShaderASTNode::NodeType::Assignment)
+	{
+		auto* Assnmt = static_cast<FuzzShaderAssignment*>(Node);
+
+		if (Assnmt->IsPredeclared)
+		{
+			Out->AppendLiteral("\t");
+		}
+		else
+		{
+			Out->AppendLiteral("\tfloat4 ");
+		}
+
+		Out->AppendSymbol(ShaderAST->Symbols, Assnmt->VariableName);
+		Out->AppendLiteral(" = ");
+		ConvertShaderASTNodeToSourceCode(ShaderAST, Assnmt->Value, Out, Config);
+		Out->AppendLiteral(";\n");
+	}
+	else if (Node->Type == FuzzShaderASTNode::NodeType::BinaryOperator)
+	{
+		auto* Bin = static_cast<FuzzShaderBinaryOperator*>(Node);
+
+		Out->AppendLiteral("(");
+		ConvertShaderASTNodeToSourceCode(ShaderAST, Bin->LHS, Out, Config);
+
+		if (Bin->Op == FuzzShaderBinaryOperator::Operator::Add)
+		{
+			Out->AppendLiteral(" + ");
+		}
+		else if (Bin->Op == FuzzShaderBinaryOperator::Operator::Subtract)
+		{
+			Out->AppendLiteral(" - ");
+		}
+		else if (Bin->Op == FuzzShaderBinaryOperator::Operator::Multiply)
+		{
+			Out->AppendLiteral(" * ");
+		}
+		else if (Bin->Op == FuzzShaderBinaryOperator::Operator::Divide)
+		{
+			Out->AppendLiteral(" / ");
+		}
+		else
+		{
+			assert(false && "skjdfjk");
+		}
+
+		ConvertShaderASTNodeToSourceCode(ShaderAST, Bin->RHS, Out, Config);
+		Out->AppendLiteral(")");
+	}
+	else if (Node->Type == FuzzShaderASTNode::NodeType::TextureAccess)
+	{
+		auto* Tex = static_cast<FuzzShaderTextureAccess*>(Node);
+
+		// TODO: SampleLevel is required for vertex shader, but Sample() could be done in Pixel shaders
+		Out->AppendLiteral("(");
+		Out->AppendSymbol(ShaderAST->Symbols, Tex->TextureName);
+		Out->AppendLiteral(".SampleLevel(");
+		Out->AppendSymbol(ShaderAST->Symbols, Tex->SamplerName);
+		Out->AppendLiteral(", (");
+		ConvertShaderASTNodeToSourceCode(ShaderAST, Tex->UV, Out, Config);
+		Out->AppendLiteral(").xy, 0))");
+	}
+	else if (Node->Type == FuzzShaderASTNode::NodeType::ReadVariable)
+	{
+		auto* ReadVar = static_cast<FuzzShaderReadVariable*>(Node);
+		Out->AppendSymbol(ShaderAST->Symbols, ReadVar->VariableName);
+	}
+	else if (Node->Type == FuzzShaderASTNode::NodeType::Literal)
+	{
+		auto* Lit = static_cast<FuzzShaderLiteral*>(Node);
+		Out->AppendLiteral("float4(");
+		Out->AppendFloat(Lit->Values[0]);
+		Out->AppendLiteral(", ");
+		Out->AppendFloat(Lit->Values[1]);
+		Out->AppendLiteral(", ");
+		Out->AppendFloat(Lit->Values[2]);
+		Out->AppendLiteral(", ");
+		Out->AppendFloat(Lit->Values[3]);
+		Out->AppendLiteral(")");
+	}
+	else if (Node->Type == FuzzShaderASTNode::NodeType::FuncCall)
+	{
+		auto* FuncCall = static_cast<FuzzShaderFuncCall*>(Node);
+		int32 OutputSize = FuncCall->OutputSize;
+		ASSERT(OutputSize <= 4);
+
+		if (OutputSize < 4)
+		{
+			Out->AppendLiteral("float4(");
+		}
+
+		Out->AppendSymbol(ShaderAST->Symbols, FuncCall->FuncName);
+		Out->AppendLiteral("(");
+		for (int32 i = 0; i < FuncCall->Arguments.Count; i++)
+		{
+			if (i > 0)
+			{
+				Out->AppendLiteral(", ");
+			}
+			ConvertShaderASTNodeToSourceCode(ShaderAST, FuncCall->Arguments.Nodes[i], Out, Config);
+		}
+		Out->AppendLiteral(")");
+
+		if (OutputSize < 4)
+		{
+			for (int32 i = OutputSize; i < 4; i++)
+			{
+				Out->AppendLiteral(", 1.0");
+			}
+			Out->AppendLiteral(")");
+		}
+	}
+	else if (Node->Type == FuzzShaderASTNode::NodeType::StatementBlock)
+	{
+		// The root block's statements get emitted by ConvertShaderASTToSourceCode, between the prologue and epilogue
+		ASSERT(Node != ShaderAST->RootASTNode);
+
+		auto* Block = static_cast<FuzzShaderStatementBlock*>(Node);
+		Out->AppendLiteral("{\n");
+
+		for (auto Stmt : Block->Statements)
+		{
+			ConvertShaderASTNodeToSourceCode(ShaderAST, Stmt, Out, Config);
+		}
+
+		Out->AppendLiteral("}\n");
+	}
+	else
+	{
+		ASSERT(false && "sdfljbasgfdjk");
+	}
+}
+
+void ConvertShaderASTPrologueToSourceCode(FuzzShaderAST* ShaderAST, ShaderSourceBuffer* Out, ShaderFuzzConfig* Config)
+{
+	for (const auto& RootConstant : ShaderAST->RootConstants)
+	{
+		Out->AppendLiteral("float4 ");
+		Out->AppendSymbol(ShaderAST->Symbols, RootConstant.VarName);
+		Out->AppendLiteral(";\n");
+	}
+
+	for (const auto& RootCBV : ShaderAST->RootCBVs)
+	{
+		Out->AppendLiteral("cbuffer ");
+		Out->AppendSymbol(ShaderAST->Symbols, RootCBV.VarName);
+		Out->AppendLiteral(" {\n");
+		for (int32 VarIdx = 0; VarIdx < RootCBV.ConstantCount; VarIdx++)
+		{
+			Out->AppendLiteral("\tfloat4 ");
+			Out->AppendSymbol(ShaderAST->Symbols, RootCBV.VarName);
+			Out->AppendLiteral("_var");
+			Out->AppendInt(VarIdx);
+			Out->AppendLiteral(";\n");
+		}
+		Out->AppendLiteral("};\n");
+	}
+
+	for (const auto& TextureBind : ShaderAST->BoundTextures)
+	{
+		Out->AppendLiteral("Texture2D ");
+		Out->AppendSymbol(ShaderAST->Symbols, TextureBind.ResourceName);
+		Out->AppendLiteral(";\nSamplerState ");
+		Out->AppendSymbol(ShaderAST->Symbols, TextureBind.SamplerName);
+		Out->AppendLiteral(";\n");
+	}
+
+	if (ShaderAST->Type == D3DShaderType::Vertex)
+	{
+		Out->AppendLiteral("struct VSInput {\n");
+		for (const auto& Var : ShaderAST->IAVars)
+		{
+			Out->AppendLiteral("float4 ");
+			Out->AppendSymbol(ShaderAST->Symbols, Var.VarName);
+			Out->AppendLiteral(" : ");
+			Out->AppendString(GetSemanticNameFromSemantic(Var.Semantic));
+			Out->AppendLiteral(";\n");
+		}
+		Out->AppendLiteral("};\n");
+	}
+
 	// VS and PS both need to know this
 	{
-		StrBuf.Append("struct PSInput {\n");
-		for (const auto& Var : ShaderAST->InterStageVars)
-		{
-			StrBuf.AppendFormat("float4 %s : %s;\n", Var.VarName.c_str(), GetSemanticNameFromSemantic(Var.Semantic));
-		}
-		StrBuf.Append("};\n");
+		Out->AppendLiteral("struct PSInput {\n");
+		for (const auto& Var : ShaderAST->InterStageVars)
+		{
+			Out->AppendLiteral("float4 ");
+			Out->AppendSymbol(ShaderAST->Symbols, Var.VarName);
+			Out->AppendLiteral(" : ");
+			Out->AppendString(GetSemanticNameFromSemantic(Var.Semantic));
+			Out->AppendLiteral(";\n");
+		}
+		Out->AppendLiteral("};\n");
+	}
+
+	if (ShaderAST->Type == D3DShaderType::Vertex)
+	{
+		Out->AppendLiteral("PSInput Main(VSInput input)\n");
+	}
+	else if (ShaderAST->Type == D3DShaderType::Pixel)
+	{
+		Out->AppendLiteral("float4 Main(PSInput input) : SV_TARGET\n");
+	}
+	else
+	{
+		assert(false && "afsdgf");
 	}
 
+	Out->AppendLiteral("{\n");
+
+	// TODO: Should be in AST generation, not here
 	if (ShaderAST->Type == D3DShaderType::Vertex)
 	{
-		StrBuf.Append("PSInput Main(VSInput input)\n");
+		Out->AppendLiteral("\tPSInput result;\n");
 	}
 	else if (ShaderAST->Type == D3DShaderType::Pixel)
 	{
-		StrBuf.Append("float4 Main(PSInput input) : SV_TARGET\n");
+		Out->AppendLiteral("\tfloat4 result;\n");
 	}
-	else
+}
+
+void ConvertShaderASTEpilogueToSourceCode(FuzzShaderAST* ShaderAST, ShaderSourceBuffer* Out, ShaderFuzzConfig* Config)
+{
+	// TODO: This should really be in AST generation, though we can't handle non-float4 types
+	// I don't esp. like dragging the config in here... :/
+	if (ShaderAST->Type == D3DShaderType::Pixel && (Config->ForcePixelOutputAlphaToOne != 0))
 	{
-		assert(false && "afsdgf");
+		Out->AppendLiteral("\tresult.a = 1.0f;\n");
 	}
 
-	ConvertShaderASTNodeToSourceCode(ShaderAST, ShaderAST->RootASTNode, &StrBuf, Config);
+	Out->AppendLiteral("\treturn result;\n");
+	Out->AppendLiteral("}\n");
 
-	StrBuf.Append("\n");
+	Out->AppendLiteral("\n");
+}
 
+void ConvertShaderASTToSourceCode(FuzzShaderAST* ShaderAST, ShaderFuzzConfig* Config)
+{
+	ShaderSourceBuffer* Out = &ShaderSourceScratch;
+	Out->Reset();
 
-	ShaderAST->SourceCode = StrBuf.buffer;
+	ConvertShaderASTPrologueToSourceCode(ShaderAST, Out, Config);
+
+	ASSERT(ShaderAST->RootASTNode->Type == FuzzShaderASTNode::NodeType::StatementBlock);
+	for (auto Stmt : static_cast<FuzzShaderStatementBlock*>(ShaderAST->RootASTNode)->Statements)
+	{
+		ConvertShaderASTNodeToSourceCode(ShaderAST, Stmt, Out, Config);
+	}
+
+	ConvertShaderASTEpilogueToSourceCode(ShaderAST, Out, Config);
+
+	if (Out->Length > AST_SOURCE_LIMIT)
+	{
+		LOG("Generated shader source is %d bytes, over the limit of %d", Out->Length, AST_SOURCE_LIMIT);
+		ASSERT(false && "Shader source too big");
+	}
+
+	// Assigning keeps the string's memory around, since the ASTs get reused across cases
+	ShaderAST->SourceCode.assign(Out->Data, Out->Length);
 }
 
 void VerifyShaderCompilation(FuzzShaderAST* ShaderAST)
@@ -1410,7 +1397,7 @@ void CreateInterstageVarsForVertexAndPixelShaders(ShaderFuzzingState* Fuzzer, Fu
 		FuzzShaderSemanticVar PosVar;
 		PosVar.ParamIdx = 0;
 		PosVar.Semantic = ShaderSemantic::POSITION;
-		PosVar.VarName = GetRandomShaderVariableName(Fuzzer, "iaparam");
+		PosVar.VarName = GetRandomShaderVariableName(Fuzzer, VertexShader->Symbols, "iaparam");
 		SemanticVarCounts[(int32)PosVar.Semantic]++;
 		VertexShader->IAVars.push_back(PosVar);
 	}
@@ -1424,7 +1411,7 @@ void CreateInterstageVarsForVertexAndPixelShaders(ShaderFuzzingState* Fuzzer, Fu
 		// Cannot duplicate semantics in Input assembler vars
 		if (SemanticVarCounts[(int32)NewVar.Semantic] == 0)
 		{
-			NewVar.VarName = GetRandomShaderVariableName(Fuzzer, "iaparam");
+			NewVar.VarName = GetRandomShaderVariableName(Fuzzer, VertexShader->Symbols, "iaparam");
 			SemanticVarCounts[(int32)NewVar.Semantic]++;
 
 			VertexShader->IAVars.push_back(NewVar);
@@ -1441,7 +1428,7 @@ void CreateInterstageVarsForVertexAndPixelShaders(ShaderFuzzingState* Fuzzer, Fu
 		FuzzShaderSemanticVar SVPosVar;
 		SVPosVar.ParamIdx = 0;
 		SVPosVar.Semantic = ShaderSemantic::SV_POSITION;
-		SVPosVar.VarName = GetRandomShaderVariableName(Fuzzer, "param");
+		SVPosVar.VarName = GetRandomShaderVariableName(Fuzzer, VertexShader->Symbols, "param");
 		SemanticVarCounts[(int32)SVPosVar.Semantic]++;
 		VertexShader->InterStageVars.push_back(SVPosVar);
 		PixelShader->InterStageVars.push_back(SVPosVar);
@@ -1457,13 +1444,96 @@ void CreateInterstageVarsForVertexAndPixelShaders(ShaderFuzzingState* Fuzzer, Fu
 		if (SemanticVarCounts[(int32)NewVar.Semantic] == 0)
 		{
 			SemanticVarCounts[(int32)NewVar.Semantic]++;
-			NewVar.VarName = GetRandomShaderVariableName(Fuzzer, "param");
+			NewVar.VarName = GetRandomShaderVariableName(Fuzzer, VertexShader->Symbols, "param");
 			VertexShader->InterStageVars.push_back(NewVar);
 			PixelShader->InterStageVars.push_back(NewVar);
 		}
 	}
 }
 
+// Per-thread, and reset at the start of each case, so once they've warmed up generating the ASTs doesn't touch the heap
+static thread_local FuzzShaderArena ShaderNodeArena;
+static thread_local FuzzShaderSymbolTable ShaderSymbols;
+
+void GenerateHLSLShaderPair(ShaderFuzzingState* Fuzzer, FuzzShaderAST* VertexShader, FuzzShaderAST* PixelShader)
+{
+	ShaderNodeArena.Reset();
+	ShaderSymbols.Reset();
+
+	VertexShader->Reset();
+	VertexShader->Type = D3DShaderType::Vertex;
+	VertexShader->Arena = &ShaderNodeArena;
+	VertexShader->Symbols = &ShaderSymbols;
+
+	PixelShader->Reset();
+	PixelShader->Type = D3DShaderType::Pixel;
+	PixelShader->Arena = &ShaderNodeArena;
+	PixelShader->Symbols = &ShaderSymbols;
+
+	CreateInterstageVarsForVertexAndPixelShaders(Fuzzer, VertexShader, PixelShader);
+
+	GenerateFuzzingShader(Fuzzer, VertexShader);
+	GenerateFuzzingShader(Fuzzer, PixelShader);
+}
+
+bool DecodeHLSLShaderPair(const byte* Data, uint32 Size, FuzzShaderAST* VertexShader, FuzzShaderAST* PixelShader, uint64* OutCaseSeed, uint32* OutEncodedSize)
+{
+	VertexShader->Arena = &ShaderNodeArena;
+	VertexShader->Symbols = &ShaderSymbols;
+	PixelShader->Arena = &ShaderNodeArena;
+	PixelShader->Symbols = &ShaderSymbols;
+
+	return DecodeShaderASTPair(Data, Size, VertexShader, PixelShader, OutCaseSeed, OutEncodedSize);
+}
+
+static std::mutex HLSLCorpusMutex;
+
+void AppendHLSLCaseToCorpus(ShaderFuzzingState* Fuzzer, FuzzShaderAST* VertexShader, FuzzShaderAST* PixelShader)
+{
+	static thread_local std::vector<byte> EncodedCase;
+	EncodedCase.clear();
+	EncodeShaderASTPair(VertexShader, PixelShader, Fuzzer->InitialFuzzSeed, &EncodedCase);
+
+	// Opened and closed each time, so it's all on disk before the case runs (and maybe takes the process down with it)
+	std::lock_guard<std::mutex> Lock(HLSLCorpusMutex);
+
+	FILE* CorpusFile = nullptr;
+	fopen_s(&CorpusFile, Fuzzer->Config->HLSLCorpusFilename, "ab");
+	if (CorpusFile == nullptr)
+	{
+		LOG("Could not open HLSL corpus '%s'", Fuzzer->Config->HLSLCorpusFilename);
+		return;
+	}
+
+	fwrite(EncodedCase.data(), 1, EncodedCase.size(), CorpusFile);
+	fclose(CorpusFile);
+}
+
+int64 GenerateHLSLForBenchmark(ShaderFuzzingState* Fuzzer, HLSLBenchmarkMode Mode)
+{
+	static thread_local FuzzShaderAST VertShader;
+	static thread_local FuzzShaderAST PixelShader;
+
+	GenerateHLSLShaderPair(Fuzzer, &VertShader, &PixelShader);
+
+	if (Mode == HLSLBenchmarkMode::GenerateASTsOnly)
+	{
+		return 0;
+	}
+	else if (Mode == HLSLBenchmarkMode::EmitSourceWithPrintf)
+	{
+		ConvertShaderASTToSourceCodeWithPrintf(&VertShader, Fuzzer->Config);
+		ConvertShaderASTToSourceCodeWithPrintf(&PixelShader, Fuzzer->Config);
+	}
+	else
+	{
+		ConvertShaderASTToSourceCode(&VertShader, Fuzzer->Config);
+		ConvertShaderASTToSourceCode(&PixelShader, Fuzzer->Config);
+	}
+
+	return VertShader.SourceCode.size() + PixelShader.SourceCode.size();
+}
+
 void CopyTextureResource(ID3D12GraphicsCommandList* CommandList, ID3D12Resource* TextureUploadResource, ID3D12Resource* TextureResource, int32 Width, int32 Height, int32 Pitch)
 {
 	D3D12_TEXTURE_COPY_LOCATION CopyLocSrc = {}, CopyLocDst = {};
@@ -1624,7 +1694,7 @@ void GenerateDrawingCommandsOnCommandList(ShaderFuzzingState* Fuzzer, ID3D12Grap
 		HRESULT hr = TextureUploadResource->Map(0, &readRange, &pTexturePixelData);
 		ASSERT(SUCCEEDED(hr));
 
-		SetRandomBytes(Fuzzer, pTexturePixelData, BufferSize);
+		FillBytes(Fuzzer, pTexturePixelData, BufferSize);
 
 		TextureUploadResource->Unmap(0, nullptr);
 
@@ -1699,15 +1769,11 @@ void GenerateDrawingCommandsOnCommandList(ShaderFuzzingState* Fuzzer, ID3D12Grap
 
 		if (Fuzzer->Config->CBVUploadRandomFloatData != 0)
 		{
-			float* pFloatData = (float*)pBufferData;
-			for (int32 i = 0; i < CBVDesc.BufferSize / 4; i++)
-			{
-				pFloatData[i] = Fuzzer->GetFloatInRange(-100.0f, 100.0f);
-			}
+			FillFloatsUniform(Fuzzer, (float*)pBufferData, CBVDesc.BufferSize / 4, -100.0f, 100.0f);
 		}
 		else
 		{
-			SetRandomBytes(Fuzzer, pBufferData, CBVDesc.BufferSize);
+			FillBytes(Fuzzer, pBufferData, CBVDesc.BufferSize);
 		}
 
 		D3DResource->Unmap(0, nullptr);
@@ -1745,20 +1811,11 @@ void GenerateDrawingCommandsOnCommandList(ShaderFuzzingState* Fuzzer, ID3D12Grap
 		float* pFloatData = (float*)pVertData;
 		if (ParamMeta.Semantic == ShaderSemantic::POSITION)
 		{
-			for (int32 i = 0; i < 4 * VertexCount; i += 4)
-			{
-				pFloatData[i + 0] = Fuzzer->GetFloatInRange(-1.0f, 1.0f);
-				pFloatData[i + 1] = Fuzzer->GetFloatInRange(-1.0f, 1.0f);
-				pFloatData[i + 2] = Fuzzer->GetFloat01();
-				pFloatData[i + 3] = Fuzzer->GetFloat01();
-			}
+			FillPositionsClipSpace(Fuzzer, pFloatData, VertexCount);
 		}
 		else
 		{
-			for (int32 i = 0; i < 4 * VertexCount; i++)
-			{
-				pFloatData[i] = Fuzzer->GetFloatInRange(-100.0f, 100.0f);
-			}
+			FillFloatsUniform(Fuzzer, pFloatData, 4 * VertexCount, -100.0f, 100.0f);
 		}
 
 		VertResource->Unmap(0, nullptr);
@@ -1887,24 +1944,240 @@ void PostExecuteResourceTeardown(ShaderFuzzingState* Fuzzer, const std::vector<u
 	Fuzzer->D3DPersist->ResourceMgr.ResetAllHeapOffsets();
 }
 
+ID3DBlob* CreateBlobFromBytes(const void* Data, size_t Size)
+{
+	ID3DBlob* Blob = nullptr;
+	HRESULT hr = D3DCreateBlob(Size, &Blob);
+	ASSERT(SUCCEEDED(hr));
+	memcpy(Blob->GetBufferPointer(), Data, Size);
+
+	return Blob;
+}
+
+static int64 GetMicrosecondsSince(std::chrono::steady_clock::time_point StartTime)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - StartTime).count();
+}
+
+// Everything after the shaders are compiled: root signature/PSO creation, recording and executing the draws, and readback
+void ExecuteFuzzCaseWithShaders(ShaderFuzzingState* Fuzzer, FuzzShaderAST* VertShader, FuzzShaderAST* PixelShader)
+{
+	auto StartTime = std::chrono::steady_clock::now();
+
+	ID3D12RootSignature* RootSig = nullptr;
+	ID3D12PipelineState* PSO = nullptr;
+	RootSigResourceDesc RootSigDesc;
+
+	VerifyGraphicsPSOCompilation(Fuzzer, VertShader, PixelShader, &RootSig, &PSO, &RootSigDesc);
+
+	ASSERT(PSO != nullptr);
+
+	ID3D12CommandAllocator* CommandAllocator = Fuzzer->D3DPersist->CmdListMgr.GetOpenCommandAllocator();
+	if (CommandAllocator == nullptr)
+	{
+		ASSERT(SUCCEEDED(Fuzzer->D3DDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&CommandAllocator))));
+	}
+
+	ID3D12GraphicsCommandList* CommandList = Fuzzer->D3DPersist->CmdListMgr.GetOpenCommandList(CommandAllocator);
+	if (CommandList == nullptr)
+	{
+		ASSERT(SUCCEEDED(Fuzzer->D3DDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, CommandAllocator, 0, IID_PPV_ARGS(&CommandList))));
+	}
+
+	std::vector<uint64> AllResourcesInUse;
+	std::unordered_map<uint64, int32> AllHeapsInUseAndCounts;
+
+	std::vector<ID3D12DescriptorHeap*> SRVDescriptorHeaps;
+
+	GenerateDrawingCommandsOnCommandList(Fuzzer, CommandList, PSO, RootSig, RootSigDesc, VertShader->ShaderMeta, PixelShader->ShaderMeta, AllResourcesInUse, AllHeapsInUseAndCounts, SRVDescriptorHeaps);
+
+	PostExecuteResourceTeardown(Fuzzer, AllResourcesInUse, AllHeapsInUseAndCounts);
+
+	ID3D12CommandList* CommandLists[] = { CommandList };
+	if (Fuzzer->Config->LockMutexAroundExecCmdList != 0)
+	{
+		ASSERT(Fuzzer->D3DPersist->ExecuteCommandListMutex != nullptr);
+
+		std::lock_guard<std::mutex> Lock(*Fuzzer->D3DPersist->ExecuteCommandListMutex);
+
+		Fuzzer->D3DPersist->CmdQueue->ExecuteCommandLists(1, CommandLists);
+	}
+	else
+	{
+		Fuzzer->D3DPersist->CmdQueue->ExecuteCommandLists(1, CommandLists);
+	}
+	uint64 ValueSignaled = Fuzzer->D3DPersist->ExecFenceToSignal;
+	Fuzzer->D3DPersist->CmdQueue->Signal(Fuzzer->D3DPersist->ExecFence, ValueSignaled);
+
+	uint64 ExecCompletedValue = Fuzzer->D3DPersist->ExecFence->GetCompletedValue();
+	Fuzzer->D3DPersist->CmdListMgr.CheckIfFenceFinished(ExecCompletedValue);
+	if (Fuzzer->Config->LockMutexAroundSRVDescriptorHeapCreateDestroy)
+	{
+		ASSERT(Fuzzer->D3DPersist->SRVDescriptorHeapMutex);
+		Fuzzer->D3DPersist->ResourceMgr.CheckIfFenceFinished(ExecCompletedValue, Fuzzer->D3DPersist->SRVDescriptorHeapMutex);
+	}
+	else
+	{
+		Fuzzer->D3DPersist->ResourceMgr.CheckIfFenceFinished(ExecCompletedValue, nullptr);
+	}
+
+	Fuzzer->D3DPersist->CmdListMgr.NowDoneWithCommandList(CommandList);
+	Fuzzer->D3DPersist->CmdListMgr.NowDoneWithCommandAllocator(CommandAllocator);
+	Fuzzer->D3DPersist->CmdListMgr.OnFrameFenceSignaled(ValueSignaled);
+
+	Fuzzer->D3DPersist->ResourceMgr.OnFrameFenceSignaled(ValueSignaled);
+
+	Fuzzer->D3DPersist->ResourceMgr.DeferredDelete(PSO, ValueSignaled);
+	Fuzzer->D3DPersist->ResourceMgr.DeferredDelete(RootSig, ValueSignaled);
+
+	for (auto* DescriptorHeap : SRVDescriptorHeaps)
+	{
+		Fuzzer->D3DPersist->ResourceMgr.DeferredDelete(DescriptorHeap, ValueSignaled);
+	}
+
+#if defined(WITH_PIPELINE_STATS_QUERY)
+	// If we're synchronous
+	HANDLE hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+	Fuzzer->D3DPersist->ExecFence->SetEventOnCompletion(ValueSignaled, hEvent);
+	WaitForSingleObject(hEvent, INFINITE);
+	CloseHandle(hEvent);
+
+
+	D3D12_RANGE PipelineRange;
+	PipelineRange.Begin = 0;
+	PipelineRange.End = sizeof(D3D12_QUERY_DATA_PIPELINE_STATISTICS);
+	D3D12_QUERY_DATA_PIPELINE_STATISTICS* StatisticsPtr = nullptr;
+	DestBuffer->Map(0, &PipelineRange, reinterpret_cast<void**>(&StatisticsPtr));
+
+	D3D12_QUERY_DATA_PIPELINE_STATISTICS PipelineStats = *StatisticsPtr;
+
+	LOG("IA Verts: %llu VS calls: %llu PS calls: %llu", PipelineStats.IAVertices, PipelineStats.VSInvocations, PipelineStats.PSInvocations);
+
+	//uint64 PrevTotalPSCalls = InterlockedAdd64((volatile LONG64*)&TotalPSCalls, PipelineStats.PSInvocations);
+	//uint64 PrevTotalFuzzCases = InterlockedAdd64((volatile LONG64*)&TotalFuzzCases, 1);
+	//
+	//double PSCallsPerCase = PrevTotalPSCalls;
+	//PSCallsPerCase /= PrevTotalFuzzCases;
+	//LOG("Avg PS calls per fuzz case: %3.2f", PSCallsPerCase);
+#endif
+
+	const bool ShouldReadbackImage = Fuzzer->Config->ShouldReadbackImage;
+
+	if (ShouldReadbackImage)
+	{
+		// Have to wait for the GPU to finish before we can map the buffer that is filled w/ a copy of the render target
+		HANDLE hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+		Fuzzer->D3DPersist->ExecFence->SetEventOnCompletion(ValueSignaled, hEvent);
+		WaitForSingleObject(hEvent, INFINITE);
+		CloseHandle(hEvent);
+
+		auto* RTReadback = Fuzzer->D3DPersist->RTReadback;
+		ASSERT(RTReadback != nullptr);
+
+		void* pPixelData = nullptr;
+		HRESULT hr = RTReadback->Map(0, nullptr, &pPixelData);
+		ASSERT(SUCCEEDED(hr));
+
+		const int32 RTWidth = Fuzzer->Config->RTWidth;
+		const int32 RTHeight = Fuzzer->Config->RTHeight;
+
+		char filename[256] = {};
+		snprintf(filename, sizeof(filename), "render_output/%s%llu%s.png", Fuzzer->Config->ReadbackImageNamePrepend, Fuzzer->InitialFuzzSeed, Fuzzer->Config->ReadbackImageNameAppend);
+		stbi_write_png(filename, RTWidth, RTHeight, 4, pPixelData, 0);
+
+		RTReadback->Unmap(0, nullptr);
+	}
+
+
+	Fuzzer->D3DPersist->ExecFenceToSignal++;
+
+	if (Fuzzer->CaseFilter != nullptr)
+	{
+		Fuzzer->CaseFilter->RecordCaseTime(GetMicrosecondsSince(StartTime));
+	}
+
+
+	//LOG("==============\nShader source (vertex):----------");
+	//OutputDebugStringA(VertShader->SourceCode.c_str());
+	//LOG("---------\nShader source (pixel):---------");
+	//OutputDebugStringA(PixelShader->SourceCode.c_str());
+	//LOG("================");
+}
+
+// Gets the HLSL size params for the fuzzer's case from its size controller, or from the config if it doesn't have one
+static void PickHLSLSizeParams(ShaderFuzzingState* Fuzzer)
+{
+	if (Fuzzer->SizeController == nullptr)
+	{
+		Fuzzer->HLSLSize = Fuzzer->Config->HLSLSize;
+		return;
+	}
+
+	Fuzzer->HLSLSize = Fuzzer->SizeController->GetParamsForCase(Fuzzer->InitialFuzzSeed);
+
+	// Needed to reproduce the seed
+	if (!Fuzzer->HLSLSize.IsDefault())
+	{
+		TRACE_LOG(Info, "Seed %llu has HLSL size params: up to %d root statements at depth %d", Fuzzer->InitialFuzzSeed, Fuzzer->HLSLSize.MaxRootStatements, Fuzzer->HLSLSize.MaxExpressionDepth);
+	}
+}
+
+// Checks (and adds) the case's shaders against the fuzzer's case filter, if it has one. Returns true if we've run them before
+static bool IsDuplicateShaderCase(ShaderFuzzingState* Fuzzer, FuzzShaderAST* VertShader, FuzzShaderAST* PixelShader)
+{
+	if (Fuzzer->CaseFilter == nullptr)
+	{
+		return false;
+	}
+
+	// So HLSL and DXBC cases can share a filter
+	uint64 Hash = (uint64)Fuzzer->Config->FuzzMethod;
+
+	if (Fuzzer->Config->FuzzMethod == ShaderFuzzMethod::GeneratFullPipelineWithHLSL)
+	{
+		// The only config that changes the source
+		Hash = ComputeShaderASTPairStructuralHash(VertShader, PixelShader, Hash * 2 + Fuzzer->Config->ForcePixelOutputAlphaToOne);
+	}
+	else
+	{
+		Hash = ComputeDXBCShaderCodeHash(VertShader->ByteCodeBlob->GetBufferPointer(), (uint32)VertShader->ByteCodeBlob->GetBufferSize(), Hash);
+		Hash = ComputeDXBCShaderCodeHash(PixelShader->ByteCodeBlob->GetBufferPointer(), (uint32)PixelShader->ByteCodeBlob->GetBufferSize(), Hash);
+	}
+
+	return Fuzzer->CaseFilter->TestAndInsert(Hash);
+}
+
 void DoIterationsWithFuzzer(ShaderFuzzingState* Fuzzer, int32_t NumIterations)
 {
+	// Kept across iterations so they hold onto their memory
+	FuzzShaderAST VertShader, PixelShader;
+
 	for (int32_t Iteration = 0; Iteration < NumIterations; Iteration++)
 	{
 
-		FuzzShaderAST VertShader, PixelShader;
+		VertShader.Reset();
 		VertShader.Type = D3DShaderType::Vertex;
+		PixelShader.Reset();
 		PixelShader.Type = D3DShaderType::Pixel;
 
+		auto CaseStartTime = std::chrono::steady_clock::now();
+
 		// HLSL AST Fuzzer path
 		if (Fuzzer->Config->FuzzMethod == ShaderFuzzMethod::GeneratFullPipelineWithHLSL)
 		{
+			PickHLSLSizeParams(Fuzzer);
 
-			CreateInterstageVarsForVertexAndPixelShaders(Fuzzer, &VertShader, &PixelShader);
-			
-			// Set types
-			GenerateFuzzingShader(Fuzzer, &VertShader);
-			GenerateFuzzingShader(Fuzzer, &PixelShader);
+			GenerateHLSLShaderPair(Fuzzer, &VertShader, &PixelShader);
+
+			if (IsDuplicateShaderCase(Fuzzer, &VertShader, &PixelShader))
+			{
+				continue;
+			}
+
+			if (Fuzzer->Config->HLSLCorpusFilename != nullptr)
+			{
+				AppendHLSLCaseToCorpus(Fuzzer, &VertShader, &PixelShader);
+			}
 			
 			ConvertShaderASTToSourceCode(&VertShader, Fuzzer->Config);
 			ConvertShaderASTToSourceCode(&PixelShader, Fuzzer->Config);
@@ -1916,157 +2189,283 @@ void DoIterationsWithFuzzer(ShaderFuzzingState* Fuzzer, int32_t NumIterations)
 		else if (Fuzzer->Config->FuzzMethod == ShaderFuzzMethod::GeneratFullPipelineWithDXBC)
 		{
 
-			FuzzDXBCState DXBCState;
-			DXBCState.SetSeed(Fuzzer->GetSubSeed());
-			GenerateShaderDXBC(&DXBCState);
+			uint64 DXBCSeed = Fuzzer->GetSubSeed();
 
-			VertShader.ByteCodeBlob = DXBCState.VSBlob;
-			PixelShader.ByteCodeBlob = DXBCState.PSBlob;
+			if (Fuzzer->PregeneratedDXBC != nullptr)
+			{
+				DxbcBatchEntry* Pregenerated = Fuzzer->PregeneratedDXBC;
+				Fuzzer->PregeneratedDXBC = nullptr;
+
+				// If this fires, the entry was generated for some other case
+				ASSERT(Pregenerated->DXBCSeed == DXBCSeed);
+
+				VertShader.ByteCodeBlob = CreateBlobFromBytes(Pregenerated->VSBytecode.data(), Pregenerated->VSBytecode.size());
+				PixelShader.ByteCodeBlob = CreateBlobFromBytes(Pregenerated->PSBytecode.data(), Pregenerated->PSBytecode.size());
+
+				VertShader.ShaderMeta = Pregenerated->VSMeta;
+				PixelShader.ShaderMeta = Pregenerated->PSMeta;
+			}
+			else
+			{
+				// Shares our tapes, so the DXBC generator's choices are on the case's tape too
+				FuzzDXBCState DXBCState;
+				DXBCState.SetSeed(DXBCSeed);
+				DXBCState.RecordTape = Fuzzer->RecordTape;
+				DXBCState.ReplayTape = Fuzzer->ReplayTape;
+				GenerateShaderDXBC(&DXBCState);
+
+				VertShader.ByteCodeBlob = DXBCState.VSBlob;
+				PixelShader.ByteCodeBlob = DXBCState.PSBlob;
+
+				VertShader.ShaderMeta = DXBCState.VSMeta;
+				PixelShader.ShaderMeta = DXBCState.PSMeta;
+			}
 
-			ReflectShaderIntoShaderMetadata(VertShader.ByteCodeBlob, &VertShader.ShaderMeta);
-			ReflectShaderIntoShaderMetadata(PixelShader.ByteCodeBlob, &PixelShader.ShaderMeta);
+			if (Fuzzer->Config->CrossCheckDXBCMetadataWithReflection)
+			{
+				ShaderMetadata VSReflectedMeta, PSReflectedMeta;
+				ReflectShaderIntoShaderMetadata(VertShader.ByteCodeBlob, &VSReflectedMeta);
+				ReflectShaderIntoShaderMetadata(PixelShader.ByteCodeBlob, &PSReflectedMeta);
+
+				ASSERT(AreShaderMetadataEqual(VertShader.ShaderMeta, VSReflectedMeta));
+				ASSERT(AreShaderMetadataEqual(PixelShader.ShaderMeta, PSReflectedMeta));
+			}
+
+			if (IsDuplicateShaderCase(Fuzzer, &VertShader, &PixelShader))
+			{
+				continue;
+			}
 		}
 		else
 		{
 			ASSERT(false && "currently unsupported");
 		}
 
-		ID3D12RootSignature* RootSig = nullptr;
-		ID3D12PipelineState* PSO = nullptr;
-		RootSigResourceDesc RootSigDesc;
-
-		VerifyGraphicsPSOCompilation(Fuzzer, &VertShader, &PixelShader, &RootSig, &PSO, &RootSigDesc);
-
-		ASSERT(PSO != nullptr);
+		ExecuteFuzzCaseWithShaders(Fuzzer, &VertShader, &PixelShader);
 
-		ID3D12CommandAllocator* CommandAllocator = Fuzzer->D3DPersist->CmdListMgr.GetOpenCommandAllocator();
-		if (CommandAllocator == nullptr)
+		if (Fuzzer->SizeController != nullptr && Fuzzer->Config->FuzzMethod == ShaderFuzzMethod::GeneratFullPipelineWithHLSL)
 		{
-			ASSERT(SUCCEEDED(Fuzzer->D3DDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&CommandAllocator))));
+			Fuzzer->SizeController->RecordCase(Fuzzer->InitialFuzzSeed, GetMicrosecondsSince(CaseStartTime));
 		}
+	}
+}
+
+struct PipelinedHLSLCase
+{
+	// Each case keeps its own fuzzer, so its RNG carries on from generation to recording just like it does in DoIterationsWithFuzzer
+	ShaderFuzzingState Fuzzer;
+	FuzzShaderAST VertShader;
+	FuzzShaderAST PixelShader;
+	ShaderCompileJob VSJob;
+	ShaderCompileJob PSJob;
+
+	// How long generating the source took, for the size controller. The compiles and the rest of the case get added on
+	int64 GenerateMicroseconds = 0;
+};
+
+void DoPipelinedHLSLIterations(const ShaderFuzzingState* FuzzerTemplate, ShaderCompileWorkerPool* CompilePool, FuzzCaseDispenser* CaseDispenser)
+{
+	ASSERT(FuzzerTemplate->Config->FuzzMethod == ShaderFuzzMethod::GeneratFullPipelineWithHLSL);
+	ASSERT(CompilePool->IsRunning());
+
+	const int32 MaxCasesInFlight = (FuzzerTemplate->Config->HLSLCasesInFlight > 1 ? FuzzerTemplate->Config->HLSLCasesInFlight : 1);
 
-		ID3D12GraphicsCommandList* CommandList = Fuzzer->D3DPersist->CmdListMgr.GetOpenCommandList(CommandAllocator);
-		if (CommandList == nullptr)
+	// Ring of the cases in flight, oldest first
+	std::vector<PipelinedHLSLCase> Cases(MaxCasesInFlight);
+	int32 OldestCase = 0;
+	int32 NumCasesInFlight = 0;
+	bool bOutOfCases = false;
+
+	while (!bOutOfCases || NumCasesInFlight > 0)
+	{
+		// Top up the pipeline: generate the source here, and hand it to the pool to compile
+		while (NumCasesInFlight < MaxCasesInFlight && !bOutOfCases)
 		{
-			ASSERT(SUCCEEDED(Fuzzer->D3DDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, CommandAllocator, 0, IID_PPV_ARGS(&CommandList))));
-		}
+			uint64 CaseSeed = 0;
+			if (!CaseDispenser->TakeNextCase(&CaseSeed))
+			{
+				bOutOfCases = true;
+				break;
+			}
 
-		std::vector<uint64> AllResourcesInUse;
-		std::unordered_map<uint64, int32> AllHeapsInUseAndCounts;
+			PipelinedHLSLCase* Case = &Cases[(OldestCase + NumCasesInFlight) % MaxCasesInFlight];
 
-		std::vector<ID3D12DescriptorHeap*> SRVDescriptorHeaps;
+			TRACE_LOG(Info, "Fuzing with seed %llu (pipelined)", CaseSeed);
 
-		GenerateDrawingCommandsOnCommandList(Fuzzer, CommandList, PSO, RootSig, RootSigDesc, VertShader.ShaderMeta, PixelShader.ShaderMeta, AllResourcesInUse, AllHeapsInUseAndCounts, SRVDescriptorHeaps);
+			Case->Fuzzer = *FuzzerTemplate;
+			Case->Fuzzer.SetSeed(CaseSeed);
 
-		PostExecuteResourceTeardown(Fuzzer, AllResourcesInUse, AllHeapsInUseAndCounts);
+			auto GenerateStartTime = std::chrono::steady_clock::now();
 
-		ID3D12CommandList* CommandLists[] = { CommandList };
-		if (Fuzzer->Config->LockMutexAroundExecCmdList != 0)
-		{
-			ASSERT(Fuzzer->D3DPersist->ExecuteCommandListMutex != nullptr);
+			PickHLSLSizeParams(&Case->Fuzzer);
 
-			std::lock_guard<std::mutex> Lock(*Fuzzer->D3DPersist->ExecuteCommandListMutex);
+			GenerateHLSLShaderPair(&Case->Fuzzer, &Case->VertShader, &Case->PixelShader);
 
-			Fuzzer->D3DPersist->CmdQueue->ExecuteCommandLists(1, CommandLists);
-		}
-		else
-		{
-			Fuzzer->D3DPersist->CmdQueue->ExecuteCommandLists(1, CommandLists);
+			// Nothing to wait on, so it's done already
+			if (IsDuplicateShaderCase(&Case->Fuzzer, &Case->VertShader, &Case->PixelShader))
+			{
+				continue;
+			}
+
+			if (Case->Fuzzer.Config->HLSLCorpusFilename != nullptr)
+			{
+				AppendHLSLCaseToCorpus(&Case->Fuzzer, &Case->VertShader, &Case->PixelShader);
+			}
+
+			ConvertShaderASTToSourceCode(&Case->VertShader, Case->Fuzzer.Config);
+			ConvertShaderASTToSourceCode(&Case->PixelShader, Case->Fuzzer.Config);
+
+			Case->GenerateMicroseconds = GetMicrosecondsSince(GenerateStartTime);
+
+			Case->VSJob.Source = &Case->VertShader.SourceCode;
+			Case->VSJob.Type = D3DShaderType::Vertex;
+			CompilePool->Submit(&Case->VSJob);
+
+			Case->PSJob.Source = &Case->PixelShader.SourceCode;
+			Case->PSJob.Type = D3DShaderType::Pixel;
+			CompilePool->Submit(&Case->PSJob);
+
+			NumCasesInFlight++;
 		}
-		uint64 ValueSignaled = Fuzzer->D3DPersist->ExecFenceToSignal;
-		Fuzzer->D3DPersist->CmdQueue->Signal(Fuzzer->D3DPersist->ExecFence, ValueSignaled);
 
-		uint64 ExecCompletedValue = Fuzzer->D3DPersist->ExecFence->GetCompletedValue();
-		Fuzzer->D3DPersist->CmdListMgr.CheckIfFenceFinished(ExecCompletedValue);
-		if (Fuzzer->Config->LockMutexAroundSRVDescriptorHeapCreateDestroy)
+		// Can happen if the rest of the cases were all duplicates
+		if (NumCasesInFlight == 0)
 		{
-			ASSERT(Fuzzer->D3DPersist->SRVDescriptorHeapMutex);
-			Fuzzer->D3DPersist->ResourceMgr.CheckIfFenceFinished(ExecCompletedValue, Fuzzer->D3DPersist->SRVDescriptorHeapMutex);
+			continue;
 		}
-		else
+
+		// Then finish off the oldest one, so cases still hit the GPU in the order we took them
+		PipelinedHLSLCase* Case = &Cases[OldestCase];
+
+		CompilePool->WaitForJob(&Case->VSJob);
+		CompilePool->WaitForJob(&Case->PSJob);
+		ASSERT(Case->VSJob.Succeeded && Case->PSJob.Succeeded);
+
+		Case->VertShader.ByteCodeBlob = CreateBlobFromBytes(Case->VSJob.Bytecode.data(), Case->VSJob.Bytecode.size());
+		Case->VertShader.ShaderMeta = Case->VSJob.Meta;
+		Case->PixelShader.ByteCodeBlob = CreateBlobFromBytes(Case->PSJob.Bytecode.data(), Case->PSJob.Bytecode.size());
+		Case->PixelShader.ShaderMeta = Case->PSJob.Meta;
+
+		auto ExecuteStartTime = std::chrono::steady_clock::now();
+
+		ExecuteFuzzCaseWithShaders(&Case->Fuzzer, &Case->VertShader, &Case->PixelShader);
+
+		// Waiting on the pool doesn't count, just the work this case actually needed
+		if (Case->Fuzzer.SizeController != nullptr)
 		{
-			Fuzzer->D3DPersist->ResourceMgr.CheckIfFenceFinished(ExecCompletedValue, nullptr);
+			int64 CaseMicroseconds = Case->GenerateMicroseconds + Case->VSJob.CompileMicroseconds + Case->PSJob.CompileMicroseconds + GetMicrosecondsSince(ExecuteStartTime);
+			Case->Fuzzer.SizeController->RecordCase(Case->Fuzzer.InitialFuzzSeed, CaseMicroseconds);
 		}
 
-		Fuzzer->D3DPersist->CmdListMgr.NowDoneWithCommandList(CommandList);
-		Fuzzer->D3DPersist->CmdListMgr.NowDoneWithCommandAllocator(CommandAllocator);
-		Fuzzer->D3DPersist->CmdListMgr.OnFrameFenceSignaled(ValueSignaled);
+		OldestCase = (OldestCase + 1) % MaxCasesInFlight;
+		NumCasesInFlight--;
+	}
+}
 
-		Fuzzer->D3DPersist->ResourceMgr.OnFrameFenceSignaled(ValueSignaled);
+void ReplayHLSLCorpusFile(const ShaderFuzzingState* FuzzerTemplate, const char* Filename)
+{
+	void* FileData = nullptr;
+	int32 FileSize = 0;
+	ReadDataFromFile(Filename, &FileData, &FileSize);
 
-		Fuzzer->D3DPersist->ResourceMgr.DeferredDelete(PSO, ValueSignaled);
-		Fuzzer->D3DPersist->ResourceMgr.DeferredDelete(RootSig, ValueSignaled);
+	FuzzShaderAST VertShader, PixelShader;
 
-		for (auto* DescriptorHeap : SRVDescriptorHeaps)
+	uint32 Offset = 0;
+	int32 NumCasesReplayed = 0;
+	while (Offset < (uint32)FileSize)
+	{
+		uint64 CaseSeed = 0;
+		uint32 EncodedSize = 0;
+		if (!DecodeHLSLShaderPair((const byte*)FileData + Offset, (uint32)FileSize - Offset, &VertShader, &PixelShader, &CaseSeed, &EncodedSize))
 		{
-			Fuzzer->D3DPersist->ResourceMgr.DeferredDelete(DescriptorHeap, ValueSignaled);
+			LOG("HLSL corpus '%s' has a bad case at offset %u, stopping there", Filename, Offset);
+			break;
 		}
 
-#if defined(WITH_PIPELINE_STATS_QUERY)
-		// If we're synchronous
-		HANDLE hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-		Fuzzer->D3DPersist->ExecFence->SetEventOnCompletion(ValueSignaled, hEvent);
-		WaitForSingleObject(hEvent, INFINITE);
-		CloseHandle(hEvent);
+		LOG("Replaying seed %llu from HLSL corpus", CaseSeed);
 
+		ShaderFuzzingState Fuzzer = *FuzzerTemplate;
+		Fuzzer.SetSeed(CaseSeed);
 
-		D3D12_RANGE PipelineRange;
-		PipelineRange.Begin = 0;
-		PipelineRange.End = sizeof(D3D12_QUERY_DATA_PIPELINE_STATISTICS);
-		D3D12_QUERY_DATA_PIPELINE_STATISTICS* StatisticsPtr = nullptr;
-		DestBuffer->Map(0, &PipelineRange, reinterpret_cast<void**>(&StatisticsPtr));
+		ConvertShaderASTToSourceCode(&VertShader, Fuzzer.Config);
+		ConvertShaderASTToSourceCode(&PixelShader, Fuzzer.Config);
 
-		D3D12_QUERY_DATA_PIPELINE_STATISTICS PipelineStats = *StatisticsPtr;
+		VerifyShaderCompilation(&VertShader);
+		VerifyShaderCompilation(&PixelShader);
 
-		LOG("IA Verts: %llu VS calls: %llu PS calls: %llu", PipelineStats.IAVertices, PipelineStats.VSInvocations, PipelineStats.PSInvocations);
+		ExecuteFuzzCaseWithShaders(&Fuzzer, &VertShader, &PixelShader);
 
-		//uint64 PrevTotalPSCalls = InterlockedAdd64((volatile LONG64*)&TotalPSCalls, PipelineStats.PSInvocations);
-		//uint64 PrevTotalFuzzCases = InterlockedAdd64((volatile LONG64*)&TotalFuzzCases, 1);
-		//
-		//double PSCallsPerCase = PrevTotalPSCalls;
-		//PSCallsPerCase /= PrevTotalFuzzCases;
-		//LOG("Avg PS calls per fuzz case: %3.2f", PSCallsPerCase);
-#endif
+		Offset += EncodedSize;
+		NumCasesReplayed++;
+	}
+
+	LOG("Replayed %d cases from HLSL corpus '%s'", NumCasesReplayed, Filename);
+
+	free(FileData);
+}
+
+void MutateHLSLCorpusFile(const ShaderFuzzingState* FuzzerTemplate, const char* Filename, int32 MutantsPerCase)
+{
+	void* FileData = nullptr;
+	int32 FileSize = 0;
+	ReadDataFromFile(Filename, &FileData, &FileSize);
 
-		const bool ShouldReadbackImage = Fuzzer->Config->ShouldReadbackImage;
+	FuzzShaderAST VertShader, PixelShader;
+	FuzzShaderMutator VertMutator, PixelMutator;
 
-		if (ShouldReadbackImage)
+	uint32 Offset = 0;
+	int32 NumMutantsRun = 0;
+	while (Offset < (uint32)FileSize)
+	{
+		uint64 CaseSeed = 0;
+		uint32 EncodedSize = 0;
+		if (!DecodeHLSLShaderPair((const byte*)FileData + Offset, (uint32)FileSize - Offset, &VertShader, &PixelShader, &CaseSeed, &EncodedSize))
 		{
-			// Have to wait for the GPU to finish before we can map the buffer that is filled w/ a copy of the render target
-			HANDLE hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-			Fuzzer->D3DPersist->ExecFence->SetEventOnCompletion(ValueSignaled, hEvent);
-			WaitForSingleObject(hEvent, INFINITE);
-			CloseHandle(hEvent);
+			LOG("HLSL corpus '%s' has a bad case at offset %u, stopping there", Filename, Offset);
+			break;
+		}
+
+		VertMutator.Init(&VertShader, FuzzerTemplate->Config);
+		PixelMutator.Init(&PixelShader, FuzzerTemplate->Config);
 
-			auto* RTReadback = Fuzzer->D3DPersist->RTReadback;
-			ASSERT(RTReadback != nullptr);
+		for (int32 MutantIdx = 0; MutantIdx < MutantsPerCase; MutantIdx++)
+		{
+			LOG("Mutant %d of seed %llu from HLSL corpus", MutantIdx, CaseSeed);
 
-			void* pPixelData = nullptr;
-			HRESULT hr = RTReadback->Map(0, nullptr, &pPixelData);
-			ASSERT(SUCCEEDED(hr));
+			ShaderFuzzingState Fuzzer = *FuzzerTemplate;
+			Fuzzer.SetSeed(CaseSeed + MutantIdx);
 
-			const int32 RTWidth = Fuzzer->Config->RTWidth;
-			const int32 RTHeight = Fuzzer->Config->RTHeight;
+			VertMutator.Mutate(&Fuzzer, Fuzzer.GetIntInRange(1, 4));
+			PixelMutator.Mutate(&Fuzzer, Fuzzer.GetIntInRange(1, 4));
 
-			char filename[256] = {};
-			snprintf(filename, sizeof(filename), "render_output/%s%llu%s.png", Fuzzer->Config->ReadbackImageNamePrepend, Fuzzer->InitialFuzzSeed, Fuzzer->Config->ReadbackImageNameAppend);
-			stbi_write_png(filename, RTWidth, RTHeight, 4, pPixelData, 0);
+			VertMutator.WriteSourceCode(&VertShader.SourceCode);
+			PixelMutator.WriteSourceCode(&PixelShader.SourceCode);
 
-			RTReadback->Unmap(0, nullptr);
-		}
+			// Everything but the source is the same as the case we started from
+			FuzzShaderAST* Shaders[] = { &VertShader, &PixelShader };
+			for (FuzzShaderAST* Shader : Shaders)
+			{
+				if (Shader->ByteCodeBlob != nullptr)
+				{
+					Shader->ByteCodeBlob->Release();
+					Shader->ByteCodeBlob = nullptr;
+				}
 
+				VerifyShaderCompilation(Shader);
+			}
 
-		Fuzzer->D3DPersist->ExecFenceToSignal++;
+			ExecuteFuzzCaseWithShaders(&Fuzzer, &VertShader, &PixelShader);
 
+			NumMutantsRun++;
+		}
 
-		//LOG("==============\nShader source (vertex):----------");
-		//OutputDebugStringA(VertShader.SourceCode.c_str());
-		//LOG("---------\nShader source (pixel):---------");
-		//OutputDebugStringA(PixelShader.SourceCode.c_str());
-		//LOG("================");
+		Offset += EncodedSize;
 	}
-}
 
+	LOG("Ran %d mutants from HLSL corpus '%s'", NumMutantsRun, Filename);
+
+	free(FileData);
+}
 
 void SetupFuzzPersistState(D3DDrawingFuzzingPersistentState* Persist, ShaderFuzzConfig* Config, ID3D12Device* Device)
 {
@@ -9,7 +9,16 @@
 
 #include "d3d_resource_mgr.h"
 
+#include "dxbc_batch.h"
+
+#include "shader_size_controller.h"
+
 struct ID3D12Device;
+struct ShaderCompileWorkerPool;
+struct FuzzShaderAST;
+struct FuzzShaderASTNode;
+struct ShaderSourceBuffer;
+struct ShaderCaseFilter;
 
 struct D3DDrawingFuzzingPersistentState
 {
@@ -91,6 +100,57 @@ struct ShaderFuzzConfig
 
 	// Which method we use
 	ShaderFuzzMethod FuzzMethod = ShaderFuzzMethod::GeneratFullPipelineWithHLSL;
+
+	// The DXBC path builds shader metadata from what it generated instead of reflecting the bytecode.
+	// If true, we also run reflection and assert that they match (slower, but useful when changing the generator)
+	byte CrossCheckDXBCMetadataWithReflection = 0;
+
+	// If non-zero (and we're using the DXBC method), this many extra threads generate the shaders ahead of time
+	// and the fuzzing threads just pick them up. The shaders for a given seed are the same either way
+	int32 DXBCPregenerateThreadCount = 0;
+
+	// If true, the HLSL generator keeps its old (slower) bookkeeping, so seeds from before it was reworked
+	// still give the same shaders. The RNG draws are the same either way, but e.g. which variable a read picks can differ
+	byte UseLegacyHLSLGeneration = 0;
+
+	// If non-zero (and we're using the HLSL method), shaders get compiled on a pool of this many threads instead of on
+	// the fuzzing threads, and each fuzzing thread keeps HLSLCasesInFlight cases going at once (see DoPipelinedHLSLIterations)
+	int32 HLSLCompileThreadCount = 0;
+	int32 HLSLCasesInFlight = 4;
+
+	// If set (and we're using the HLSL method), compiled shaders get cached in this directory across runs,
+	// so replaying a seed doesn't need to compile anything. Oldest blobs get thrown out past the budget
+	const char* HLSLBlobCacheDirectory = nullptr;
+	uint64 HLSLBlobCacheSizeBudget = 512 * 1024 * 1024;
+
+	// If set (and we're using the HLSL method), every case's ASTs get appended to this file before it runs, so they can be
+	// replayed later with ReplayHLSLCorpusFile. Shared by all the threads
+	const char* HLSLCorpusFilename = nullptr;
+
+	// If set (and we're using the HLSL method), instead of fuzzing new cases we replay every case in this corpus file
+	// on one thread with ReplayHLSLCorpusFile, and then stop.
+	// If HLSLReplayCorpusMutantsPerCase is non-zero, each case is mutated that many times instead (see MutateHLSLCorpusFile)
+	const char* HLSLReplayCorpusFilename = nullptr;
+	int32 HLSLReplayCorpusMutantsPerCase = 0;
+
+	// If true, cases whose shaders are the same as one we've already run get skipped (see shader_case_filter.h).
+	// "Already run" is in this process, or in earlier ones too if ShaderCaseFilterFilename is set, which is loaded at the start
+	// and saved at the end. The filter is sized for ShaderCaseFilterExpectedCases at the given false positive rate,
+	// which is the chance that a new case gets skipped anyway
+	byte SkipDuplicateShaderCases = 0;
+	const char* ShaderCaseFilterFilename = nullptr;
+	int64 ShaderCaseFilterExpectedCases = 16 * 1024 * 1024;
+	float ShaderCaseFilterFalsePositiveRate = 0.001f;
+
+	// If non-zero (and we're using the HLSL method), shader sizes get scaled down while cases are taking longer than this
+	// on average (compile, PSO creation and recording/submitting the draws), and back up when they're quicker.
+	// HLSLLargeShaderChance of cases always get the full size. See HLSLSizeController
+	float HLSLTargetCaseMilliseconds = 0.0f;
+	float HLSLLargeShaderChance = 0.05f;
+
+	// How big the HLSL shaders get when HLSLTargetCaseMilliseconds is 0. To reproduce a seed from a run that had it on,
+	// set these to the size params that got logged for the seed
+	HLSLSizeParams HLSLSize;
 };
 
 struct ShaderFuzzingState : FuzzBasicState {
@@ -99,6 +159,18 @@ struct ShaderFuzzingState : FuzzBasicState {
 	D3DDrawingFuzzingPersistentState* D3DPersist = nullptr;
 
 	ShaderFuzzConfig* Config = nullptr;
+
+	// If set, the next DXBC case uses this instead of generating its shaders. It has to have been generated for this
+	// fuzzer's seed, and gets cleared once it's used
+	DxbcBatchEntry* PregeneratedDXBC = nullptr;
+
+	// Set if ShaderFuzzConfig::SkipDuplicateShaderCases is, shared by all the fuzzing threads
+	ShaderCaseFilter* CaseFilter = nullptr;
+
+	// How big the HLSL shaders get. If SizeController is set, it picks these for each case (and they get logged if they're not
+	// the defaults), otherwise they come from ShaderFuzzConfig::HLSLSize
+	HLSLSizeParams HLSLSize;
+	HLSLSizeController* SizeController = nullptr;
 };
 
 
@@ -106,3 +178,41 @@ void SetupFuzzPersistState(D3DDrawingFuzzingPersistentState* Persist, ShaderFuzz
 
 void DoIterationsWithFuzzer(ShaderFuzzingState* Fuzzer, int32_t NumIterations);
 
+// Runs the HLSL path for cases taken from CaseDispenser until it runs out, with up to Config->HLSLCasesInFlight of them in flight:
+// the source is generated on this thread, compiled on CompilePool, and then each case's PSO/draws are done in the order they were taken.
+// Each case does the same thing DoIterationsWithFuzzer would for that seed. FuzzerTemplate has everything but the seed set
+void DoPipelinedHLSLIterations(const ShaderFuzzingState* FuzzerTemplate, ShaderCompileWorkerPool* CompilePool, FuzzCaseDispenser* CaseDispenser);
+
+// Runs every case in a corpus file written with ShaderFuzzConfig::HLSLCorpusFilename set, without the generator.
+// The shaders are exactly the same as the first time around, but the rest of the case (root sig, draws, resources) gets
+// drawn fresh from the case's seed, so it won't match. Re-run the seed itself for that
+void ReplayHLSLCorpusFile(const ShaderFuzzingState* FuzzerTemplate, const char* Filename);
+
+// Like ReplayHLSLCorpusFile, but each case in the corpus is the starting point for MutantsPerCase mutants (see FuzzShaderMutator),
+// which get compiled and run instead of it. Mutant N of a case runs with the case's seed + N
+void MutateHLSLCorpusFile(const ShaderFuzzingState* FuzzerTemplate, const char* Filename, int32 MutantsPerCase);
+
+// Resets both ASTs (and this thread's arena/symbols) and generates the HLSL ASTs for the case the fuzzer is on
+void GenerateHLSLShaderPair(ShaderFuzzingState* Fuzzer, FuzzShaderAST* VertexShader, FuzzShaderAST* PixelShader);
+
+// Same as GenerateHLSLShaderPair, except the ASTs come from EncodeShaderASTPair's output instead of the generator
+bool DecodeHLSLShaderPair(const byte* Data, uint32 Size, FuzzShaderAST* VertexShader, FuzzShaderAST* PixelShader, uint64* OutCaseSeed, uint32* OutEncodedSize);
+
+// The pieces ConvertShaderASTToSourceCode puts together: the prologue (bindings, structs, and Main's signature),
+// then each of the root block's statements, then the epilogue. All append to Out
+void ConvertShaderASTPrologueToSourceCode(FuzzShaderAST* ShaderAST, ShaderSourceBuffer* Out, ShaderFuzzConfig* Config);
+void ConvertShaderASTNodeToSourceCode(FuzzShaderAST* ShaderAST, FuzzShaderASTNode* Node, ShaderSourceBuffer* Out, ShaderFuzzConfig* Config);
+void ConvertShaderASTEpilogueToSourceCode(FuzzShaderAST* ShaderAST, ShaderSourceBuffer* Out, ShaderFuzzConfig* Config);
+
+enum struct HLSLBenchmarkMode
+{
+	GenerateASTsOnly,
+	EmitSource,
+	// The old printf-based emitter, to compare against. Gives the same source
+	EmitSourceWithPrintf
+};
+
+// Just the CPU side of the HLSL path (no D3D) for the case the fuzzer is on, for the benchmarks in main.
+// Returns how many bytes of source it wrote for both shaders, or 0 if we're only generating the ASTs
+int64 GenerateHLSLForBenchmark(ShaderFuzzingState* Fuzzer, HLSLBenchmarkMode Mode);
+
@@ -0,0 +1,527 @@
+#include "fuzz_shader_mutate.h"
+
+#include "fuzz_shader_compiler.h"
+
+#include <float.h>
+#include <cmath>
+
+// How many root statements we'll look through for something to apply a mutation to before giving up on it
+static const int32 FuzzShaderMutatorMaxStatementAttempts = 8;
+
+const char* GetFuzzShaderMutationTypeName(FuzzShaderMutationType Type)
+{
+	switch (Type)
+	{
+	case FuzzShaderMutationType::SwapOperator: return "SwapOperator";
+	case FuzzShaderMutationType::ReplaceLiteral: return "ReplaceLiteral";
+	case FuzzShaderMutationType::RetargetVariable: return "RetargetVariable";
+	case FuzzShaderMutationType::WrapInBuiltinCall: return "WrapInBuiltinCall";
+	default: return "Unknown";
+	}
+}
+
+template<typename T>
+static T* AllocateMutantNode(FuzzShaderArena* Arena)
+{
+	static_assert(std::is_trivially_destructible<T>::value, "AST nodes never get destructed");
+
+	T* NewNode = new (Arena->Allocate(sizeof(T), alignof(T))) T();
+	NewNode->Type = T::StaticType;
+
+	return NewNode;
+}
+
+template<typename T>
+static T* CopyMutantNode(FuzzShaderArena* Arena, const FuzzShaderASTNode* Node)
+{
+	static_assert(std::is_trivially_destructible<T>::value, "AST nodes never get destructed");
+	ASSERT(Node->Type == T::StaticType);
+
+	return new (Arena->Allocate(sizeof(T), alignof(T))) T(*static_cast<const T*>(Node));
+}
+
+static FuzzShaderNodeList AllocateMutantNodeList(FuzzShaderArena* Arena, int32 Capacity)
+{
+	FuzzShaderNodeList List;
+	List.Nodes = (FuzzShaderASTNode**)Arena->Allocate(sizeof(FuzzShaderASTNode*) * Capacity, alignof(FuzzShaderASTNode*));
+	List.Capacity = Capacity;
+
+	return List;
+}
+
+// Shallow copy, the children are still shared with the original. Lists are copied too, so their slots can be changed
+static FuzzShaderASTNode* CopyMutantNodeOfAnyType(FuzzShaderArena* Arena, const FuzzShaderASTNode* Node)
+{
+	switch (Node->Type)
+	{
+	case FuzzShaderASTNode::NodeType::BinaryOperator: return CopyMutantNode<FuzzShaderBinaryOperator>(Arena, Node);
+	case FuzzShaderASTNode::NodeType::TextureAccess: return CopyMutantNode<FuzzShaderTextureAccess>(Arena, Node);
+	case FuzzShaderASTNode::NodeType::ReadVariable: return CopyMutantNode<FuzzShaderReadVariable>(Arena, Node);
+	case FuzzShaderASTNode::NodeType::Literal: return CopyMutantNode<FuzzShaderLiteral>(Arena, Node);
+	case FuzzShaderASTNode::NodeType::Assignment: return CopyMutantNode<FuzzShaderAssignment>(Arena, Node);
+	case FuzzShaderASTNode::NodeType::FuncCall:
+	case FuzzShaderASTNode::NodeType::StatementBlock:
+	{
+		FuzzShaderNodeList* List = nullptr;
+		FuzzShaderASTNode* NewNode = nullptr;
+		if (Node->Type == FuzzShaderASTNode::NodeType::FuncCall)
+		{
+			auto* FuncCall = CopyMutantNode<FuzzShaderFuncCall>(Arena, Node);
+			List = &FuncCall->Arguments;
+			NewNode = FuncCall;
+		}
+		else
+		{
+			auto* Block = CopyMutantNode<FuzzShaderStatementBlock>(Arena, Node);
+			List = &Block->Statements;
+			NewNode = Block;
+		}
+
+		FuzzShaderNodeList NewList = AllocateMutantNodeList(Arena, List->Capacity);
+		for (auto Child : *List)
+		{
+			NewList.Add(Child);
+		}
+		*List = NewList;
+
+		return NewNode;
+	}
+	default:
+		ASSERT(false && "Can't copy this node type");
+		return nullptr;
+	}
+}
+
+static int32 GetShaderNodeChildCount(const FuzzShaderASTNode* Node)
+{
+	switch (Node->Type)
+	{
+	case FuzzShaderASTNode::NodeType::BinaryOperator: return 2;
+	case FuzzShaderASTNode::NodeType::TextureAccess: return 1;
+	case FuzzShaderASTNode::NodeType::Assignment: return 1;
+	case FuzzShaderASTNode::NodeType::FuncCall: return static_cast<const FuzzShaderFuncCall*>(Node)->Arguments.Count;
+	case FuzzShaderASTNode::NodeType::StatementBlock: return static_cast<const FuzzShaderStatementBlock*>(Node)->Statements.Count;
+	default: return 0;
+	}
+}
+
+// Where the node keeps its Index'th child, in the order they're emitted
+static FuzzShaderASTNode** GetShaderNodeChildSlot(FuzzShaderASTNode* Node, int32 Index)
+{
+	ASSERT(Index >= 0 && Index < GetShaderNodeChildCount(Node));
+
+	switch (Node->Type)
+	{
+	case FuzzShaderASTNode::NodeType::BinaryOperator:
+	{
+		auto* Bin = static_cast<FuzzShaderBinaryOperator*>(Node);
+		return (Index == 0 ? &Bin->LHS : &Bin->RHS);
+	}
+	case FuzzShaderASTNode::NodeType::TextureAccess: return &static_cast<FuzzShaderTextureAccess*>(Node)->UV;
+	case FuzzShaderASTNode::NodeType::Assignment: return &static_cast<FuzzShaderAssignment*>(Node)->Value;
+	case FuzzShaderASTNode::NodeType::FuncCall: return &static_cast<FuzzShaderFuncCall*>(Node)->Arguments.Nodes[Index];
+	case FuzzShaderASTNode::NodeType::StatementBlock: return &static_cast<FuzzShaderStatementBlock*>(Node)->Statements.Nodes[Index];
+	default: return nullptr;
+	}
+}
+
+static bool IsCandidateForMutation(const FuzzShaderASTNode* Node, FuzzShaderMutationType Type)
+{
+	switch (Type)
+	{
+	case FuzzShaderMutationType::SwapOperator: return Node->Type == FuzzShaderASTNode::NodeType::BinaryOperator;
+	case FuzzShaderMutationType::ReplaceLiteral: return Node->Type == FuzzShaderASTNode::NodeType::Literal;
+	case FuzzShaderMutationType::RetargetVariable: return Node->Type == FuzzShaderASTNode::NodeType::ReadVariable;
+	// Any expression
+	case FuzzShaderMutationType::WrapInBuiltinCall: return Node->Type < FuzzShaderASTNode::NodeType::StatementFirst;
+	default: return false;
+	}
+}
+
+static void CollectCandidateNodes(FuzzShaderASTNode* Node, FuzzShaderMutationType Type, std::vector<FuzzShaderASTNode*>* OutCandidates)
+{
+	if (IsCandidateForMutation(Node, Type))
+	{
+		OutCandidates->push_back(Node);
+	}
+
+	int32 ChildCount = GetShaderNodeChildCount(Node);
+	for (int32 i = 0; i < ChildCount; i++)
+	{
+		CollectCandidateNodes(*GetShaderNodeChildSlot(Node, i), Type, OutCandidates);
+	}
+}
+
+static bool FindShaderNodePath(FuzzShaderASTNode* Node, FuzzShaderASTNode* Target, std::vector<FuzzShaderASTNode*>* OutPath)
+{
+	OutPath->push_back(Node);
+	if (Node == Target)
+	{
+		return true;
+	}
+
+	int32 ChildCount = GetShaderNodeChildCount(Node);
+	for (int32 i = 0; i < ChildCount; i++)
+	{
+		if (FindShaderNodePath(*GetShaderNodeChildSlot(Node, i), Target, OutPath))
+		{
+			return true;
+		}
+	}
+
+	OutPath->pop_back();
+	return false;
+}
+
+// Picks a random node the mutation can apply to, and fills out the path to it. Returns false if we couldn't find one
+static bool PickMutationTarget(FuzzShaderMutator* Mutator, FuzzBasicState* Fuzzer, FuzzShaderMutationType Type, int32* OutStatementIdx)
+{
+	if (Mutator->Statements.size() == 0)
+	{
+		return false;
+	}
+
+	for (int32 Attempt = 0; Attempt < FuzzShaderMutatorMaxStatementAttempts; Attempt++)
+	{
+		int32 StatementIdx = Fuzzer->GetIntInRange(0, (int32)Mutator->Statements.size() - 1);
+
+		// Need something else in scope to switch to
+		if (Type == FuzzShaderMutationType::RetargetVariable && Mutator->NumReadableVariables[StatementIdx] < 2)
+		{
+			continue;
+		}
+
+		Mutator->CandidateNodes.clear();
+		CollectCandidateNodes(Mutator->Statements[StatementIdx], Type, &Mutator->CandidateNodes);
+
+		if (Mutator->CandidateNodes.size() > 0)
+		{
+			FuzzShaderASTNode* Target = Mutator->CandidateNodes[Fuzzer->GetIntInRange(0, (int32)Mutator->CandidateNodes.size() - 1)];
+
+			Mutator->NodePath.clear();
+			ASSERT(FindShaderNodePath(Mutator->Statements[StatementIdx], Target, &Mutator->NodePath));
+
+			*OutStatementIdx = StatementIdx;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Puts NewNode where the end of NodePath was, copying each node above it on the path (since those can be shared with the original)
+static void ReplaceMutationTarget(FuzzShaderMutator* Mutator, int32 StatementIdx, FuzzShaderASTNode* NewNode)
+{
+	for (int32 PathIdx = (int32)Mutator->NodePath.size() - 2; PathIdx >= 0; PathIdx--)
+	{
+		FuzzShaderASTNode* OldChild = Mutator->NodePath[PathIdx + 1];
+		FuzzShaderASTNode* Parent = CopyMutantNodeOfAnyType(&Mutator->MutantArena, Mutator->NodePath[PathIdx]);
+
+		bool FoundChild = false;
+		int32 ChildCount = GetShaderNodeChildCount(Parent);
+		for (int32 i = 0; i < ChildCount; i++)
+		{
+			FuzzShaderASTNode** Slot = GetShaderNodeChildSlot(Parent, i);
+			if (*Slot == OldChild)
+			{
+				*Slot = NewNode;
+				FoundChild = true;
+				break;
+			}
+		}
+
+		ASSERT(FoundChild);
+		NewNode = Parent;
+	}
+
+	Mutator->Statements[StatementIdx] = NewNode;
+
+	if (Mutator->MutantTextOffsets[StatementIdx] != -2)
+	{
+		Mutator->MutantTextOffsets[StatementIdx] = -2;
+		Mutator->StatementsToEmit.push_back(StatementIdx);
+	}
+}
+
+static bool MutateSwapOperator(FuzzShaderMutator* Mutator, FuzzBasicState* Fuzzer)
+{
+	int32 StatementIdx = 0;
+	if (!PickMutationTarget(Mutator, Fuzzer, FuzzShaderMutationType::SwapOperator, &StatementIdx))
+	{
+		return false;
+	}
+
+	auto* Bin = CopyMutantNode<FuzzShaderBinaryOperator>(&Mutator->MutantArena, Mutator->NodePath.back());
+
+	// Any operator but the one it already has
+	int32 NewOp = Fuzzer->GetIntInRange(0, (int32)FuzzShaderBinaryOperator::Operator::Count - 2);
+	if (NewOp >= (int32)Bin->Op)
+	{
+		NewOp++;
+	}
+	Bin->Op = (FuzzShaderBinaryOperator::Operator)NewOp;
+
+	ReplaceMutationTarget(Mutator, StatementIdx, Bin);
+	return true;
+}
+
+static bool MutateReplaceLiteral(FuzzShaderMutator* Mutator, FuzzBasicState* Fuzzer)
+{
+	int32 StatementIdx = 0;
+	if (!PickMutationTarget(Mutator, Fuzzer, FuzzShaderMutationType::ReplaceLiteral, &StatementIdx))
+	{
+		return false;
+	}
+
+	auto* Lit = CopyMutantNode<FuzzShaderLiteral>(&Mutator->MutantArena, Mutator->NodePath.back());
+
+	int32 Decider = Fuzzer->GetIntInRange(0, 99);
+	if (Decider < 25)
+	{
+		// A whole new one, same as the generator would make
+		for (int32 i = 0; i < 4; i++)
+		{
+			Lit->Values[i] = Fuzzer->GetFloat01();
+		}
+	}
+	else
+	{
+		float* Value = &Lit->Values[Fuzzer->GetIntInRange(0, 3)];
+		if (Decider < 60)
+		{
+			*Value *= Fuzzer->GetFloatInRange(0.5f, 2.0f);
+		}
+		else if (Decider < 70)
+		{
+			*Value = -*Value;
+		}
+		else
+		{
+			// The source only has 6 decimal places, so nothing smaller than that. And no inf/NaN, since those don't have a literal
+			static const float InterestingValues[] = { 0.0f, -0.0f, 1.0f, -1.0f, 0.5f, 0.000001f, 65504.0f, 16777216.0f, FLT_MAX, -FLT_MAX };
+			*Value = InterestingValues[Fuzzer->GetIntInRange(0, ARRAY_COUNTOF(InterestingValues) - 1)];
+		}
+
+		// Scaling FLT_MAX up
+		if (!std::isfinite(*Value))
+		{
+			*Value = (*Value > 0.0f ? FLT_MAX : -FLT_MAX);
+		}
+	}
+
+	ReplaceMutationTarget(Mutator, StatementIdx, Lit);
+	return true;
+}
+
+static bool MutateRetargetVariable(FuzzShaderMutator* Mutator, FuzzBasicState* Fuzzer)
+{
+	int32 StatementIdx = 0;
+	if (!PickMutationTarget(Mutator, Fuzzer, FuzzShaderMutationType::RetargetVariable, &StatementIdx))
+	{
+		return false;
+	}
+
+	FuzzShaderSymbol OldName = static_cast<FuzzShaderReadVariable*>(Mutator->NodePath.back())->VariableName;
+
+	// Only the ones declared before this statement, and not one with the same name as what it reads now
+	// (which could be a different symbol, so it's the text we compare)
+	int32 NumReadable = Mutator->NumReadableVariables[StatementIdx];
+	int32 FirstVarIdx = Fuzzer->GetIntInRange(0, NumReadable - 1);
+	int32 VarIdx = -1;
+	for (int32 i = 0; i < NumReadable; i++)
+	{
+		int32 CandidateIdx = (FirstVarIdx + i) % NumReadable;
+		if (!Mutator->Original->Symbols->IsSameText(Mutator->ReadableVariables[CandidateIdx], OldName))
+		{
+			VarIdx = CandidateIdx;
+			break;
+		}
+	}
+
+	if (VarIdx < 0)
+	{
+		return false;
+	}
+
+	auto* ReadVar = CopyMutantNode<FuzzShaderReadVariable>(&Mutator->MutantArena, Mutator->NodePath.back());
+	ReadVar->VariableName = Mutator->ReadableVariables[VarIdx];
+
+	ReplaceMutationTarget(Mutator, StatementIdx, ReadVar);
+	return true;
+}
+
+static bool MutateWrapInBuiltinCall(FuzzShaderMutator* Mutator, FuzzBasicState* Fuzzer)
+{
+	int32 StatementIdx = 0;
+	if (!PickMutationTarget(Mutator, Fuzzer, FuzzShaderMutationType::WrapInBuiltinCall, &StatementIdx))
+	{
+		return false;
+	}
+
+	const FuzzShaderBuiltinFuncInfo* BuiltinInfo = &BuiltinShaderFuncInfo[Fuzzer->GetIntInRange(0, NUM_BUILTIN_SHADER_FUNCS - 1)];
+	ASSERT(BuiltinInfo->Arity > 0);
+
+	auto* FuncCall = AllocateMutantNode<FuzzShaderFuncCall>(&Mutator->MutantArena);
+	FuncCall->FuncName = Mutator->Original->Symbols->InternLiteral(BuiltinInfo->Name);
+	FuncCall->OutputSize = BuiltinInfo->OutputSize;
+	FuncCall->Arguments = AllocateMutantNodeList(&Mutator->MutantArena, BuiltinInfo->Arity);
+
+	// The node we're wrapping goes in as one of the arguments, and the rest are something in scope (or a literal if there isn't anything)
+	int32 WrappedArgIdx = Fuzzer->GetIntInRange(0, BuiltinInfo->Arity - 1);
+	int32 NumReadable = Mutator->NumReadableVariables[StatementIdx];
+	for (int32 i = 0; i < BuiltinInfo->Arity; i++)
+	{
+		if (i == WrappedArgIdx)
+		{
+			FuncCall->Arguments.Add(Mutator->NodePath.back());
+		}
+		else if (NumReadable > 0 && Fuzzer->GetFloat01() < 0.8f)
+		{
+			auto* ReadVar = AllocateMutantNode<FuzzShaderReadVariable>(&Mutator->MutantArena);
+			ReadVar->VariableName = Mutator->ReadableVariables[Fuzzer->GetIntInRange(0, NumReadable - 1)];
+			FuncCall->Arguments.Add(ReadVar);
+		}
+		else
+		{
+			auto* Lit = AllocateMutantNode<FuzzShaderLiteral>(&Mutator->MutantArena);
+			for (int32 j = 0; j < 4; j++)
+			{
+				Lit->Values[j] = Fuzzer->GetFloat01();
+			}
+			FuncCall->Arguments.Add(Lit);
+		}
+	}
+
+	ReplaceMutationTarget(Mutator, StatementIdx, FuncCall);
+	return true;
+}
+
+void FuzzShaderMutator::Init(FuzzShaderAST* InOriginal, ShaderFuzzConfig* InConfig)
+{
+	Original = InOriginal;
+	Config = InConfig;
+
+	ASSERT(Original->RootASTNode != nullptr && Original->RootASTNode->Type == FuzzShaderASTNode::NodeType::StatementBlock);
+	const FuzzShaderNodeList& RootStatements = static_cast<FuzzShaderStatementBlock*>(Original->RootASTNode)->Statements;
+
+	// Same order as GenerateFuzzingShader puts them in scope
+	ReadableVariables.clear();
+	for (const auto& RootConstant : Original->RootConstants)
+	{
+		ReadableVariables.push_back(RootConstant.VarName);
+	}
+
+	for (const auto& RootCBV : Original->RootCBVs)
+	{
+		for (int32 VarIdx = 0; VarIdx < RootCBV.ConstantCount; VarIdx++)
+		{
+			ReadableVariables.push_back(Original->Symbols->MakeDerivedName("", RootCBV.VarName, "_var", VarIdx));
+		}
+	}
+
+	const auto& InputVars = (Original->Type == D3DShaderType::Vertex ? Original->IAVars : Original->InterStageVars);
+	for (const auto& Var : InputVars)
+	{
+		ReadableVariables.push_back(Original->Symbols->MakeDerivedName("input.", Var.VarName));
+	}
+
+	// Outputs (result, result.xxx) aren't declared by their statement, and in the vertex shader can't be read afterwards anyway
+	NumReadableVariables.clear();
+	for (auto Stmt : RootStatements)
+	{
+		NumReadableVariables.push_back((int32)ReadableVariables.size());
+
+		if (Stmt->Type == FuzzShaderASTNode::NodeType::Assignment && !static_cast<FuzzShaderAssignment*>(Stmt)->IsPredeclared)
+		{
+			ReadableVariables.push_back(static_cast<FuzzShaderAssignment*>(Stmt)->VariableName);
+		}
+	}
+
+	OriginalText.Reset();
+	StatementTextOffsets.clear();
+
+	ConvertShaderASTPrologueToSourceCode(Original, &OriginalText, Config);
+	for (auto Stmt : RootStatements)
+	{
+		StatementTextOffsets.push_back(OriginalText.Length);
+		ConvertShaderASTNodeToSourceCode(Original, Stmt, &OriginalText, Config);
+	}
+	StatementTextOffsets.push_back(OriginalText.Length);
+	ConvertShaderASTEpilogueToSourceCode(Original, &OriginalText, Config);
+
+	MutantTextOffsets.resize(RootStatements.Count);
+	MutantTextLengths.resize(RootStatements.Count);
+
+	Reset();
+}
+
+void FuzzShaderMutator::Reset()
+{
+	const FuzzShaderNodeList& RootStatements = static_cast<FuzzShaderStatementBlock*>(Original->RootASTNode)->Statements;
+	Statements.assign(RootStatements.begin(), RootStatements.end());
+
+	for (int32 i = 0; i < RootStatements.Count; i++)
+	{
+		MutantTextOffsets[i] = -1;
+		MutantTextLengths[i] = 0;
+	}
+
+	StatementsToEmit.clear();
+	MutantText.Reset();
+	MutantArena.Reset();
+}
+
+bool FuzzShaderMutator::ApplyMutation(FuzzBasicState* Fuzzer, FuzzShaderMutationType Type)
+{
+	switch (Type)
+	{
+	case FuzzShaderMutationType::SwapOperator: return MutateSwapOperator(this, Fuzzer);
+	case FuzzShaderMutationType::ReplaceLiteral: return MutateReplaceLiteral(this, Fuzzer);
+	case FuzzShaderMutationType::RetargetVariable: return MutateRetargetVariable(this, Fuzzer);
+	case FuzzShaderMutationType::WrapInBuiltinCall: return MutateWrapInBuiltinCall(this, Fuzzer);
+	default: ASSERT(false); return false;
+	}
+}
+
+int32 FuzzShaderMutator::Mutate(FuzzBasicState* Fuzzer, int32 NumMutations)
+{
+	Reset();
+
+	int32 NumApplied = 0;
+	for (int32 i = 0; i < NumMutations; i++)
+	{
+		auto Type = (FuzzShaderMutationType)Fuzzer->GetIntInRange(0, (int32)FuzzShaderMutationType::Count - 1);
+		if (ApplyMutation(Fuzzer, Type))
+		{
+			NumApplied++;
+		}
+	}
+
+	return NumApplied;
+}
+
+void FuzzShaderMutator::WriteSourceCode(std::string* OutSource)
+{
+	for (int32 StatementIdx : StatementsToEmit)
+	{
+		MutantTextOffsets[StatementIdx] = MutantText.Length;
+		ConvertShaderASTNodeToSourceCode(Original, Statements[StatementIdx], &MutantText, Config);
+		MutantTextLengths[StatementIdx] = MutantText.Length - MutantTextOffsets[StatementIdx];
+	}
+	StatementsToEmit.clear();
+
+	// Runs of statements that are still the original's get copied in one go
+	OutSource->clear();
+	int32 OriginalRunStart = 0;
+	for (int32 i = 0; i < (int32)Statements.size(); i++)
+	{
+		if (MutantTextOffsets[i] >= 0)
+		{
+			OutSource->append(OriginalText.Data + OriginalRunStart, StatementTextOffsets[i] - OriginalRunStart);
+			OutSource->append(MutantText.Data + MutantTextOffsets[i], MutantTextLengths[i]);
+			OriginalRunStart = StatementTextOffsets[i + 1];
+		}
+	}
+
+	OutSource->append(OriginalText.Data + OriginalRunStart, OriginalText.Length - OriginalRunStart);
+}
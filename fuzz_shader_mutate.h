@@ -0,0 +1,78 @@
+#pragma once
+
+#include "basics.h"
+
+#include "fuzz_basic.h"
+
+#include "fuzz_shader_ast.h"
+
+#include <string>
+#include <vector>
+
+struct ShaderFuzzConfig;
+
+// Mutates an existing HLSL AST (e.g. one decoded from a corpus) one subtree at a time, instead of generating a new one.
+// The original is never touched: a mutation copies the nodes on the path from the root statement down to the one it
+// changes, into the mutator's own arena, and everything else stays shared with the original.
+//
+// The source for the original is emitted once, split up by root statement. A mutant's source is that with just the
+// statements that changed re-emitted and spliced in, so a mutant costs a few microseconds instead of a full
+// generate + emit. The result is the same text ConvertShaderASTToSourceCode would give for the mutated tree
+
+enum struct FuzzShaderMutationType
+{
+	SwapOperator,
+	ReplaceLiteral,
+	RetargetVariable,
+	WrapInBuiltinCall,
+	Count
+};
+
+const char* GetFuzzShaderMutationTypeName(FuzzShaderMutationType Type);
+
+struct FuzzShaderMutator
+{
+	// Has to stay alive (and unchanged) while we're using it. Mutations can add symbols to its symbol table, but never change existing ones
+	FuzzShaderAST* Original = nullptr;
+	ShaderFuzzConfig* Config = nullptr;
+
+	// The original's source: OriginalText[0, StatementTextOffsets[0]) is everything before the root statements,
+	// then statement i is [StatementTextOffsets[i], StatementTextOffsets[i + 1]), and the rest is everything after them
+	ShaderSourceBuffer OriginalText;
+	std::vector<int32> StatementTextOffsets;
+
+	// Variables a statement can read: the ones declared outside Main (inputs, root constants, CBV vars), then each non-output
+	// statement's variable in order. Statement i can read the first NumReadableVariables[i]
+	std::vector<FuzzShaderSymbol> ReadableVariables;
+	std::vector<int32> NumReadableVariables;
+
+	// The current mutant. Root statement i is Statements[i], which is the original's until something under it is mutated
+	FuzzShaderArena MutantArena;
+	std::vector<FuzzShaderASTNode*> Statements;
+
+	// Re-emitted text for the mutated statements. Statement i's is at MutantTextOffsets[i], or that's -1 if it's still the original's
+	// (and -2 if it's been mutated since it was last emitted, those are in StatementsToEmit)
+	ShaderSourceBuffer MutantText;
+	std::vector<int32> MutantTextOffsets;
+	std::vector<int32> MutantTextLengths;
+	std::vector<int32> StatementsToEmit;
+
+	// Scratch for picking a node to mutate, and then for the nodes from its root statement down to it
+	std::vector<FuzzShaderASTNode*> CandidateNodes;
+	std::vector<FuzzShaderASTNode*> NodePath;
+
+	// Emits the original's source and works out what's in scope where. Original's root has to be a statement block
+	void Init(FuzzShaderAST* InOriginal, ShaderFuzzConfig* InConfig);
+
+	// Throws away any mutations, back to the original
+	void Reset();
+
+	// Returns false (and leaves the mutant alone) if there was nothing to apply it to, e.g. no binary operators to swap
+	bool ApplyMutation(FuzzBasicState* Fuzzer, FuzzShaderMutationType Type);
+
+	// Reset, then apply NumMutations random mutations. Returns how many actually applied
+	int32 Mutate(FuzzBasicState* Fuzzer, int32 NumMutations);
+
+	// The mutant's full source. Only the statements mutated since the last call get emitted again
+	void WriteSourceCode(std::string* OutSource);
+};
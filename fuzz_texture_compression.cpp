@@ -261,7 +261,7 @@ void DoIterationsWithTextureCompressionFuzzer(TextureCompressionFuzzingState* Fu
 			HRESULT hr = UploadBuffer->Map(0, &readRange, &pPixelData);
 			ASSERT(SUCCEEDED(hr));
 
-			SetRandomBytes(Fuzzer, pPixelData, BufferSize);
+			FillBytes(Fuzzer, pPixelData, BufferSize);
 
 			UploadBuffer->Unmap(0, nullptr);
 		}
@@ -6,6 +6,8 @@
 #include <vector>
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <new>
 
 #include <Windows.h>
 
@@ -29,16 +31,134 @@
 #include "fuzz_texture_compression.h"
 #include "fuzz_shader_compiler.h"
 #include "fuzz_dxbc.h"
+#include "dxbc_batch.h"
+#include "fuzz_seed_stream.h"
+#include "fuzz_decision_tape.h"
+#include "dxbc_mutate.h"
+#include "fuzz_shader_mutate.h"
+#include "shader_compile_pipeline.h"
+#include "shader_blob_cache.h"
+#include "shader_case_filter.h"
+#include "trace_log.h"
+#include "self_checks.h"
 #include "d3d_resource_mgr.h"
 
 #include "re_dxbc.h"
 
+#include "string_stack_buffer.h"
+
 #pragma comment(lib, "D3D11.lib")
 #pragma comment(lib, "D3D12.lib")
 #pragma comment(lib, "d3dcompiler.lib")
 
+// Uncomment this to count heap allocations (anything going through operator new) in the CPU-only benchmarks
+//#define WITH_ALLOCATION_COUNTER
+
+#if defined(WITH_ALLOCATION_COUNTER)
+std::atomic<int64> NumHeapAllocations;
+
+void* operator new(size_t Size)
+{
+	NumHeapAllocations++;
+	void* Ptr = malloc(Size > 0 ? Size : 1);
+	if (Ptr == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+
+	return Ptr;
+}
+
+void operator delete(void* Ptr) noexcept
+{
+	free(Ptr);
+}
+#endif
+
+// Looks for "-Name <number>" on the command line, returns false if it's not there
+static bool GetCommandLineNumber(const char* CmdLine, const char* Name, uint32* OutValue)
+{
+	const size_t NameLength = strlen(Name);
+	for (const char* Cursor = strstr(CmdLine, Name); Cursor != nullptr; Cursor = strstr(Cursor + 1, Name))
+	{
+		// Only whole args, so e.g. -run doesn't match -runs
+		bool IsStartOfArg = (Cursor == CmdLine || Cursor[-1] == ' ');
+		bool IsEndOfArg = (Cursor[NameLength] == ' ' || Cursor[NameLength] == '=');
+		if (IsStartOfArg && IsEndOfArg)
+		{
+			char* NumberEnd = nullptr;
+			uint32 Value = (uint32)strtoul(Cursor + NameLength + 1, &NumberEnd, 0);
+			if (NumberEnd != Cursor + NameLength + 1)
+			{
+				*OutValue = Value;
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+// Splitting up one run between processes/machines: give them all the same "-run <id>" and each a different "-shard <n>",
+// so they don't run the same cases. Re-running with the same run id and shard gives the same cases again.
+// Without -run, the run id comes from the starting time, and the shard defaults to 0
+static FuzzSeedStream GetSeedStreamForRun(uint64 StartingTime, const char* CmdLine)
+{
+	FuzzSeedStream SeedStream;
+	if (!GetCommandLineNumber(CmdLine, "-run", &SeedStream.RunId))
+	{
+		SeedStream.RunId = FuzzSeedStream::GetRunIdFromTime(StartingTime);
+	}
+
+	GetCommandLineNumber(CmdLine, "-shard", &SeedStream.Shard);
+
+	if (SeedStream.RunId >= (1U << FUZZ_CASE_ID_RUN_BITS) || SeedStream.Shard >= (1U << FUZZ_CASE_ID_SHARD_BITS))
+	{
+		LOG("Run id %u/shard %u is out of range (run ids have %d bits, shards %d), wrapping them", SeedStream.RunId, SeedStream.Shard,
+			FUZZ_CASE_ID_RUN_BITS, FUZZ_CASE_ID_SHARD_BITS);
+		SeedStream.RunId &= (1U << FUZZ_CASE_ID_RUN_BITS) - 1;
+		SeedStream.Shard &= (1U << FUZZ_CASE_ID_SHARD_BITS) - 1;
+	}
+
+	LOG("Run id %u, shard %u", SeedStream.RunId, SeedStream.Shard);
+
+	return SeedStream;
+}
+
+// The per-seed logging goes through the trace logger (see trace_log.h), into fuzz_trace_<starting time>.log.
+// Anything at TraceEchoSeverity or above still shows up in the debugger output. The seeds are Info, so they stay out of it
+// (set it to Info to see them there too)
+static const TraceSeverity TraceMinSeverity = TraceSeverity::Info;
+static const TraceSeverity TraceEchoSeverity = TraceSeverity::Warning;
+
+static LONG WINAPI FlushTraceLogOnCrash(EXCEPTION_POINTERS* ExceptionInfo)
+{
+	// So the seeds we were on make it into the file
+	FlushTraceLogAfterCrash();
+	return EXCEPTION_CONTINUE_SEARCH;
+}
+
+static void StartTraceLogForRun(TraceLogger* Logger, uint64 StartingTime)
+{
+	char Filename[256] = {};
+	snprintf(Filename, sizeof(Filename), "fuzz_trace_%llu.log", StartingTime);
+
+	// If it can't start, TRACE_LOG just goes to LOG
+	if (Logger->Start(Filename, TraceMinSeverity, TraceEchoSeverity))
+	{
+		SetTraceLogger(Logger);
+		SetUnhandledExceptionFilter(FlushTraceLogOnCrash);
+	}
+}
+
 int WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR cmdLine, int showCommand) {
 
+	// Doesn't need a device, see self_checks.h
+	if (strstr(cmdLine, "-selfcheck") != nullptr)
+	{
+		return (RunSelfChecks() == 0 ? 0 : 1);
+	}
+
 	ID3D12Debug1* D3D12DebugLayer = nullptr;
 	D3D12GetDebugInterface(IID_PPV_ARGS(&D3D12DebugLayer));
 	D3D12DebugLayer->EnableDebugLayer();
@@ -120,6 +240,381 @@ int WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR cmdLine, int showC
 	}
 
 
+	// CPU-only DXBC generation throughput, doesn't need a device
+	if (0)
+	{
+		const int32 GeneratorThreadCount = 8;
+		const uint64 CaseCount = 100 * 1000;
+
+		LARGE_INTEGER PerfFreq;
+		QueryPerformanceFrequency(&PerfFreq);
+
+		LARGE_INTEGER PerfStart;
+		QueryPerformanceCounter(&PerfStart);
+
+		DxbcBatchGenerator Generator;
+		Generator.Start(FuzzSeedStream(), CaseCount, GeneratorThreadCount);
+
+		uint64 TotalBytes = 0;
+		DxbcBatchEntry Entry;
+		while (Generator.Dequeue(&Entry))
+		{
+			TotalBytes += Entry.VSBytecode.size() + Entry.PSBytecode.size();
+		}
+
+		LARGE_INTEGER PerfEnd;
+		QueryPerformanceCounter(&PerfEnd);
+
+		double ElapsedTimeSeconds = (PerfEnd.QuadPart - PerfStart.QuadPart);
+		ElapsedTimeSeconds = ElapsedTimeSeconds / PerfFreq.QuadPart;
+		LOG("Generated %llu shader pairs (%llu bytes) on %d threads in %3.2f seconds, or %3.2f pairs/sec",
+			CaseCount, TotalBytes, GeneratorThreadCount, ElapsedTimeSeconds, CaseCount / ElapsedTimeSeconds);
+
+		return 0;
+	}
+
+	// Fuzzer RNG throughput, and how long it takes to seed a new one (we do that every case). The raw mt19937_64 numbers
+	// are what FUZZ_RNG_LEGACY_MT19937 gets you
+	if (0)
+	{
+		const int32 DrawCount = 100 * 1000 * 1000;
+		const int32 SeedCount = 1000 * 1000;
+
+		LARGE_INTEGER PerfFreq;
+		QueryPerformanceFrequency(&PerfFreq);
+
+		LARGE_INTEGER PerfStart;
+		LARGE_INTEGER PerfEnd;
+
+		auto GetElapsedSeconds = [&]() {
+			return (double)(PerfEnd.QuadPart - PerfStart.QuadPart) / PerfFreq.QuadPart;
+		};
+
+		// So the loops don't get optimized out
+		uint64 Checksum = 0;
+
+		FuzzBasicState Fuzzer;
+		Fuzzer.SetSeed(0);
+
+		QueryPerformanceCounter(&PerfStart);
+		for (int32 i = 0; i < DrawCount; i++)
+		{
+			Checksum += Fuzzer.GetIntInRange(0, 255);
+		}
+		QueryPerformanceCounter(&PerfEnd);
+		LOG("FuzzBasicState::GetIntInRange: %3.2f M draws/sec", DrawCount / GetElapsedSeconds() / 1000000.0);
+
+		QueryPerformanceCounter(&PerfStart);
+		for (int32 i = 0; i < DrawCount; i++)
+		{
+			Checksum += (uint64)(Fuzzer.GetFloatInRange(-1.0f, 1.0f) * 1000.0f);
+		}
+		QueryPerformanceCounter(&PerfEnd);
+		LOG("FuzzBasicState::GetFloatInRange: %3.2f M draws/sec", DrawCount / GetElapsedSeconds() / 1000000.0);
+
+		QueryPerformanceCounter(&PerfStart);
+		for (int32 i = 0; i < SeedCount; i++)
+		{
+			FuzzBasicState CaseFuzzer;
+			CaseFuzzer.SetSeed(i);
+			Checksum += CaseFuzzer.GetSubSeed();
+		}
+		QueryPerformanceCounter(&PerfEnd);
+		LOG("FuzzBasicState construct + seed + draw: %3.2f ns (%d bytes of RNG state)", GetElapsedSeconds() / SeedCount * 1000000000.0, (int32)sizeof(FuzzRNGEngine));
+
+		// Same size as the 256x256 RGBA8 textures we upload
+		{
+			const int32 FillCount = 1000;
+			std::vector<byte> FillBuffer(256 * 256 * 4);
+
+			QueryPerformanceCounter(&PerfStart);
+			for (int32 i = 0; i < FillCount; i++)
+			{
+				FillBytes(&Fuzzer, FillBuffer.data(), FillBuffer.size());
+				Checksum += FillBuffer[i];
+			}
+			QueryPerformanceCounter(&PerfEnd);
+			LOG("FillBytes (256 KB): %3.2f us", GetElapsedSeconds() / FillCount * 1000000.0);
+
+			QueryPerformanceCounter(&PerfStart);
+			for (int32 i = 0; i < FillCount; i++)
+			{
+				FillFloatsUniform(&Fuzzer, (float*)FillBuffer.data(), FillBuffer.size() / 4, -100.0f, 100.0f);
+				Checksum += FillBuffer[i];
+			}
+			QueryPerformanceCounter(&PerfEnd);
+			LOG("FillFloatsUniform (256 KB): %3.2f us", GetElapsedSeconds() / FillCount * 1000000.0);
+		}
+
+		std::mt19937_64 MTState;
+		MTState.seed(0);
+
+		QueryPerformanceCounter(&PerfStart);
+		for (int32 i = 0; i < DrawCount; i++)
+		{
+			std::uniform_int_distribution<int> Dist(0, 255);
+			Checksum += Dist(MTState);
+		}
+		QueryPerformanceCounter(&PerfEnd);
+		LOG("mt19937_64 + uniform_int_distribution: %3.2f M draws/sec", DrawCount / GetElapsedSeconds() / 1000000.0);
+
+		QueryPerformanceCounter(&PerfStart);
+		for (int32 i = 0; i < SeedCount; i++)
+		{
+			std::mt19937_64 CaseMTState;
+			CaseMTState.seed(i);
+			Checksum += CaseMTState();
+		}
+		QueryPerformanceCounter(&PerfEnd);
+		LOG("mt19937_64 construct + seed + draw: %3.2f ns", GetElapsedSeconds() / SeedCount * 1000000000.0);
+
+		LOG("(checksum %llu)", Checksum);
+
+		return 0;
+	}
+
+	// Per-seed logging cost: TRACE_LOG vs. LOG, from as many threads as the shader fuzzing uses. Each thread logs in bursts
+	// that fit in its ring, since the drain thread only has to keep up with the rate we actually fuzz at
+	if (0)
+	{
+		const int32 ThreadCount = 20;
+		const int32 BurstCount = 100;
+		const int32 LogsPerBurst = 2000;
+
+		for (int32 bUseTraceLog = 0; bUseTraceLog <= 1; bUseTraceLog++)
+		{
+			TraceLogger BenchmarkTraceLog;
+			if (bUseTraceLog)
+			{
+				BenchmarkTraceLog.Start("trace_log_benchmark.log", TraceSeverity::Info, TraceSeverity::Warning);
+				SetTraceLogger(&BenchmarkTraceLog);
+			}
+
+			std::atomic<int64> TotalTicks;
+			TotalTicks.store(0);
+
+			std::vector<std::thread> LogThreads;
+			for (int32 ThreadIdx = 0; ThreadIdx < ThreadCount; ThreadIdx++)
+			{
+				LogThreads.emplace_back([TIdx = ThreadIdx, bUseTraceLog = bUseTraceLog, TotalTicksPtr = &TotalTicks, BurstCount, LogsPerBurst]() {
+					int64 Ticks = 0;
+					for (int32 Burst = 0; Burst < BurstCount; Burst++)
+					{
+						LARGE_INTEGER BurstStart;
+						QueryPerformanceCounter(&BurstStart);
+						for (int32 i = 0; i < LogsPerBurst; i++)
+						{
+							uint64 Seed = (uint64)Burst * LogsPerBurst + i;
+							if (bUseTraceLog)
+							{
+								TRACE_LOG(Info, "Fuzing with seed %llu (TIdx:%d)", Seed, TIdx);
+							}
+							else
+							{
+								LOG("Fuzing with seed %llu (TIdx:%d)", Seed, TIdx);
+							}
+						}
+
+						LARGE_INTEGER BurstEnd;
+						QueryPerformanceCounter(&BurstEnd);
+						Ticks += BurstEnd.QuadPart - BurstStart.QuadPart;
+
+						std::this_thread::sleep_for(std::chrono::milliseconds(10));
+					}
+
+					*TotalTicksPtr += Ticks;
+				});
+			}
+
+			for (auto& Thread : LogThreads)
+			{
+				Thread.join();
+			}
+
+			BenchmarkTraceLog.Stop();
+
+			LARGE_INTEGER PerfFreq;
+			QueryPerformanceFrequency(&PerfFreq);
+			LOG("%s: %3.2f ns per seed log on %d threads", (bUseTraceLog ? "TRACE_LOG" : "LOG"),
+				TotalTicks.load() * 1000000000.0 / PerfFreq.QuadPart / ((double)ThreadCount * BurstCount * LogsPerBurst), ThreadCount);
+		}
+
+		return 0;
+	}
+
+	// CPU-only HLSL generation, doesn't need a device. Runs the same cases just generating the ASTs, then also emitting
+	// the source with the new and old emitters. With WITH_ALLOCATION_COUNTER, this also shows whether we still touch the heap
+	// once the per-thread buffers have warmed up
+	if (0)
+	{
+		const int32 WarmupCaseCount = 1000;
+		const int32 CaseCount = 100 * 1000;
+
+		const HLSLBenchmarkMode Modes[] = { HLSLBenchmarkMode::GenerateASTsOnly, HLSLBenchmarkMode::EmitSource, HLSLBenchmarkMode::EmitSourceWithPrintf };
+		const char* ModeNames[] = { "ASTs only", "ASTs + source", "ASTs + source (printf emitter)" };
+
+		ShaderFuzzConfig BenchConfig;
+		ShaderFuzzingState BenchFuzzer;
+		BenchFuzzer.Config = &BenchConfig;
+
+		LARGE_INTEGER PerfFreq;
+		QueryPerformanceFrequency(&PerfFreq);
+
+		for (int32 ModeIdx = 0; ModeIdx < ARRAY_COUNTOF(Modes); ModeIdx++)
+		{
+			for (int32 i = 0; i < WarmupCaseCount; i++)
+			{
+				BenchFuzzer.SetSeed(i);
+				GenerateHLSLForBenchmark(&BenchFuzzer, Modes[ModeIdx]);
+			}
+
+#if defined(WITH_ALLOCATION_COUNTER)
+			int64 AllocationsBefore = NumHeapAllocations.load();
+#endif
+
+			LARGE_INTEGER PerfStart;
+			QueryPerformanceCounter(&PerfStart);
+
+			int64 TotalBytes = 0;
+			for (int32 i = 0; i < CaseCount; i++)
+			{
+				BenchFuzzer.SetSeed(WarmupCaseCount + i);
+				TotalBytes += GenerateHLSLForBenchmark(&BenchFuzzer, Modes[ModeIdx]);
+			}
+
+			LARGE_INTEGER PerfEnd;
+			QueryPerformanceCounter(&PerfEnd);
+
+			double ElapsedTimeSeconds = (PerfEnd.QuadPart - PerfStart.QuadPart);
+			ElapsedTimeSeconds = ElapsedTimeSeconds / PerfFreq.QuadPart;
+			LOG("%s: %d HLSL shader pairs in %3.2f seconds, or %3.2f pairs/sec, %3.2f MB of source/sec", ModeNames[ModeIdx],
+				CaseCount, ElapsedTimeSeconds, CaseCount / ElapsedTimeSeconds, TotalBytes / ElapsedTimeSeconds / (1024.0 * 1024.0));
+
+#if defined(WITH_ALLOCATION_COUNTER)
+			LOG("%s: %lld heap allocations after warmup", ModeNames[ModeIdx], NumHeapAllocations.load() - AllocationsBefore);
+#endif
+		}
+
+		return 0;
+	}
+
+	// CPU-only HLSL mutation: mutants of one generated case, re-emitting just the statements that changed each time.
+	// Compare against the generation benchmark above for what a fresh case costs
+	if (0)
+	{
+		const int32 MutantCount = 1000 * 1000;
+
+		ShaderFuzzConfig BenchConfig;
+		ShaderFuzzingState BenchFuzzer;
+		BenchFuzzer.Config = &BenchConfig;
+		BenchFuzzer.SetSeed(0);
+
+		FuzzShaderAST VertShader, PixelShader;
+		GenerateHLSLShaderPair(&BenchFuzzer, &VertShader, &PixelShader);
+
+		FuzzShaderMutator VertMutator, PixelMutator;
+		VertMutator.Init(&VertShader, &BenchConfig);
+		PixelMutator.Init(&PixelShader, &BenchConfig);
+
+		FuzzBasicState MutationFuzzer;
+		MutationFuzzer.SetSeed(0);
+
+		LARGE_INTEGER PerfFreq;
+		QueryPerformanceFrequency(&PerfFreq);
+
+		LARGE_INTEGER PerfStart;
+		QueryPerformanceCounter(&PerfStart);
+
+		std::string VertSource, PixelSource;
+		int64 TotalBytes = 0;
+		for (int32 i = 0; i < MutantCount; i++)
+		{
+			VertMutator.Mutate(&MutationFuzzer, MutationFuzzer.GetIntInRange(1, 4));
+			PixelMutator.Mutate(&MutationFuzzer, MutationFuzzer.GetIntInRange(1, 4));
+			VertMutator.WriteSourceCode(&VertSource);
+			PixelMutator.WriteSourceCode(&PixelSource);
+
+			TotalBytes += VertSource.size() + PixelSource.size();
+		}
+
+		LARGE_INTEGER PerfEnd;
+		QueryPerformanceCounter(&PerfEnd);
+
+		double ElapsedTimeSeconds = (PerfEnd.QuadPart - PerfStart.QuadPart);
+		ElapsedTimeSeconds = ElapsedTimeSeconds / PerfFreq.QuadPart;
+		LOG("Made %d HLSL mutant pairs in %3.2f seconds, or %3.2f pairs/sec, %3.2f MB of source/sec",
+			MutantCount, ElapsedTimeSeconds, MutantCount / ElapsedTimeSeconds, TotalBytes / ElapsedTimeSeconds / (1024.0 * 1024.0));
+
+		return 0;
+	}
+
+	// CPU-only triage: shrinks the HLSL for a seed whose shaders don't compile (so either the generator or the compiler is wrong),
+	// by recording the case's decision tape and cutting it down while D3DCompile still rejects one of them. Swap out
+	// DoesCaseReproduce for whatever the bug needs
+	if (0)
+	{
+		const uint64 FailingSeed = 0;
+		const char* ShrunkTapeFilename = "shrunk_case.tape";
+
+		ShaderFuzzConfig TriageConfig;
+		FuzzShaderAST VertShader, PixelShader;
+
+		auto DoesShaderCompile = [](const std::string& Source, D3DShaderType Type) {
+			ID3DBlob* ByteCode = nullptr;
+			ID3DBlob* ErrorMsg = nullptr;
+			HRESULT hr = D3DCompile(Source.c_str(), Source.size(), "<triage>", nullptr, nullptr, "Main", GetTargetForShaderType(Type), 0, 0, &ByteCode, &ErrorMsg);
+
+			if (ByteCode != nullptr) { ByteCode->Release(); }
+			if (ErrorMsg != nullptr) { ErrorMsg->Release(); }
+
+			return SUCCEEDED(hr);
+		};
+
+		auto DoesCaseReproduce = [&](FuzzDecisionTape* Tape) {
+			ShaderFuzzingState TriageFuzzer;
+			TriageFuzzer.Config = &TriageConfig;
+			StartReplayingDecisionTape(&TriageFuzzer, Tape);
+
+			GenerateHLSLShaderPair(&TriageFuzzer, &VertShader, &PixelShader);
+			ConvertShaderASTToSourceCode(&VertShader, &TriageConfig);
+			ConvertShaderASTToSourceCode(&PixelShader, &TriageConfig);
+
+			return !DoesShaderCompile(VertShader.SourceCode, D3DShaderType::Vertex) || !DoesShaderCompile(PixelShader.SourceCode, D3DShaderType::Pixel);
+		};
+
+		FuzzDecisionTape Tape;
+		Tape.CaseSeed = FailingSeed;
+		{
+			ShaderFuzzingState RecordingFuzzer;
+			RecordingFuzzer.Config = &TriageConfig;
+			RecordingFuzzer.SetSeed(FailingSeed);
+			RecordingFuzzer.RecordTape = &Tape;
+			GenerateHLSLShaderPair(&RecordingFuzzer, &VertShader, &PixelShader);
+		}
+
+		int32 OriginalTapeSize = (int32)Tape.Entries.size();
+		if (!DoesCaseReproduce(&Tape))
+		{
+			LOG("Seed %llu compiles fine, nothing to shrink", FailingSeed);
+			return 0;
+		}
+
+		int32 NumAttempts = ShrinkDecisionTape(&Tape, DoesCaseReproduce);
+
+		// Leave the shrunk case in VertShader/PixelShader to dump out
+		DoesCaseReproduce(&Tape);
+		LOG("Shrunk seed %llu from %d decisions to %d in %d attempts, shaders are now %d + %d bytes", FailingSeed, OriginalTapeSize, (int32)Tape.Entries.size(),
+			NumAttempts, (int32)VertShader.SourceCode.size(), (int32)PixelShader.SourceCode.size());
+
+		WriteStringToFile(StringStackBuffer<256>("shrunk_case_%llu_vs.hlsl", FailingSeed).buffer, VertShader.SourceCode.c_str());
+		WriteStringToFile(StringStackBuffer<256>("shrunk_case_%llu_ps.hlsl", FailingSeed).buffer, PixelShader.SourceCode.c_str());
+		LOG("Wrote the shrunk shaders to shrunk_case_%llu_vs.hlsl/shrunk_case_%llu_ps.hlsl, and the tape to %s", FailingSeed, FailingSeed, ShrunkTapeFilename);
+
+		Tape.Save(ShrunkTapeFilename);
+
+		return 0;
+	}
+
 	ID3D12Device* Device = nullptr;
 	ASSERT(SUCCEEDED(D3D12CreateDevice(ChosenAdapter, D3D_FEATURE_LEVEL_12_1, IID_PPV_ARGS(&Device))));
 
@@ -152,24 +647,22 @@ int WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR cmdLine, int showC
 			uint64 StartingTime = time(NULL);
 			LOG("Starting time: %llu", StartingTime);
 
+			TraceLogger FuzzTraceLog;
+			StartTraceLogForRun(&FuzzTraceLog, StartingTime);
+
+			FuzzCaseDispenser CaseDispenser;
+			CaseDispenser.Init(GetSeedStreamForRun(StartingTime, cmdLine), ThreadCount * 1024LLU * 1024LLU);
+
 			for (int32 ThreadIdx = 0; ThreadIdx < ThreadCount; ThreadIdx++)
 			{
-				FuzzThreads.emplace_back([Device = Device, TIdx = ThreadIdx, StartingTime = StartingTime]() {
+				FuzzThreads.emplace_back([Device = Device, CaseDispenserPtr = &CaseDispenser]() {
 					D3DTextureCompressionFuzzingPersistentState Persistent;
 					SetupPersistentOnTextureCompressionFuzzer(&Persistent, Device);
 
-					for (int32 i = 0; i < 1024 * 1024; i++)
+					uint64 InitialFuzzSeed = 0;
+					while (CaseDispenserPtr->TakeNextCase(&InitialFuzzSeed))
 					{
-						uint64 InitialFuzzSeed = 0;
-
-						// If we want to have different fuzzing each process run. Good once a fuzzer is established.
-						InitialFuzzSeed += StartingTime * 0x8FD3F77LLU;
-
-						InitialFuzzSeed += (TIdx * 1024LLU * 1024LLU);
-						InitialFuzzSeed += i;
-
-						// In theory can cause contention maybe or slow things down? Idk, can remove this
-						LOG("Fuzing with seed %llu", InitialFuzzSeed);
+						TRACE_LOG(Info, "Fuzing with seed %llu", InitialFuzzSeed);
 
 						TextureCompressionFuzzingState Fuzzer;
 						Fuzzer.Persistent = &Persistent;
@@ -184,6 +677,8 @@ int WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR cmdLine, int showC
 			{
 				Thread.join();
 			}
+
+			FuzzTraceLog.Stop();
 		}
 
 		return 0;
@@ -217,28 +712,26 @@ int WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR cmdLine, int showC
 			uint64 StartingTime = time(NULL);
 			LOG("Starting time: %llu", StartingTime);
 
+			TraceLogger FuzzTraceLog;
+			StartTraceLogForRun(&FuzzTraceLog, StartingTime);
+
+			FuzzCaseDispenser CaseDispenser;
+			CaseDispenser.Init(GetSeedStreamForRun(StartingTime, cmdLine), ThreadCount * 128LLU * 1000LLU);
+
 			for (int32 ThreadIdx = 0; ThreadIdx < ThreadCount; ThreadIdx++)
 			{
-				FuzzThreads.emplace_back([Device = Device, TIdx = ThreadIdx, StartingTime = StartingTime]() {
+				FuzzThreads.emplace_back([Device = Device, CaseDispenserPtr = &CaseDispenser]() {
 					D3DReservedResourceFuzzingPersistentState PersistState;
 					SetupPersistentOnReservedResourceFuzzer(&PersistState, Device);
 
-					for (int32 i = 0; i < 128 * 1000; i++)
+					uint64 InitialFuzzSeed = 0;
+					while (CaseDispenserPtr->TakeNextCase(&InitialFuzzSeed))
 					{
 						ReservedResourceFuzzingState Fuzzer;
 						Fuzzer.D3DDevice = Device;
 						Fuzzer.Persistent = &PersistState;
 
-						uint64 InitialFuzzSeed = 0;
-
-						// If we want to have different fuzzing each process run. Good once a fuzzer is established.
-						InitialFuzzSeed += StartingTime * 0x8D3F77LLU;
-
-						InitialFuzzSeed += (TIdx * 1024LLU * 1024LLU);
-						InitialFuzzSeed += i;
-
-						// In theory can cause contention maybe or slow things down? Idk, can remove this
-						LOG("Fuzing with seed %llu", InitialFuzzSeed);
+						TRACE_LOG(Info, "Fuzing with seed %llu", InitialFuzzSeed);
 
 						SetSeedOnReservedResourceFuzzer(&Fuzzer, InitialFuzzSeed);
 						DoIterationsWithReservedResourceFuzzer(&Fuzzer, 1);
@@ -256,6 +749,8 @@ int WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR cmdLine, int showC
 			{
 				Thread.join();
 			}
+
+			FuzzTraceLog.Stop();
 		}
 
 		return 0;
@@ -289,7 +784,10 @@ int WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR cmdLine, int showC
 		int32 FileSize = 0;
 		ReadDataFromFile(ExampleShaderFilename, &FileData, &FileSize);
 		
-		ParseDXBCCode((byte*)FileData, FileSize);
+		if (!ParseDXBCCode((byte*)FileData, FileSize))
+		{
+			LOG("Could not parse '%s'", ExampleShaderFilename);
+		}
 
 		//ID3DBlob* Disasm = nullptr;
 		//HRESULT hr = D3DDisassemble(FileData, FileSize, 0, nullptr, &Disasm);
@@ -301,6 +799,51 @@ int WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR cmdLine, int showC
 		return 0;
 	}
 
+	// Mutating known-good compiler output instead of generating from scratch
+	if (0)
+	{
+		const char* BaseShaderFilename = "dxbc_re/ps_plain_sample_bytecode.bin";
+		const int32 MutantCount = 1000 * 1000;
+
+		void* FileData = nullptr;
+		int32 FileSize = 0;
+		ReadDataFromFile(BaseShaderFilename, &FileData, &FileSize);
+
+		DxbcMutator Mutator;
+		ASSERT(Mutator.Init(FileData, FileSize));
+
+		FuzzBasicState MutationFuzzer;
+		MutationFuzzer.SetSeed(0);
+
+		LARGE_INTEGER PerfFreq;
+		QueryPerformanceFrequency(&PerfFreq);
+
+		LARGE_INTEGER PerfStart;
+		QueryPerformanceCounter(&PerfStart);
+
+		std::vector<byte> Mutant;
+		for (int32 i = 0; i < MutantCount; i++)
+		{
+			Mutator.Mutate(&MutationFuzzer, MutationFuzzer.GetIntInRange(1, 4));
+			Mutator.WriteBytecode(&Mutant);
+
+			// Keep a few around to look at
+			if (i < 16)
+			{
+				WriteDataToFile(StringStackBuffer<256>("manual_bytecode/mutant_%d.bin", i).buffer, Mutant.data(), Mutant.size());
+			}
+		}
+
+		LARGE_INTEGER PerfEnd;
+		QueryPerformanceCounter(&PerfEnd);
+
+		double ElapsedTimeSeconds = (PerfEnd.QuadPart - PerfStart.QuadPart);
+		ElapsedTimeSeconds = ElapsedTimeSeconds / PerfFreq.QuadPart;
+		LOG("Made %d mutants in %3.2f seconds, or %3.2f mutants/sec", MutantCount, ElapsedTimeSeconds, MutantCount / ElapsedTimeSeconds);
+
+		return 0;
+	}
+
 	if (0)
 	{
 		
@@ -358,7 +901,58 @@ int WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR cmdLine, int showC
 			ShaderConfig.LockMutexAroundSRVDescriptorHeapCreateDestroy = (Desc.VendorId == 0x10DE && Desc.DeviceId == 0x1E82 && !bIsSingleThreaded);
 		}
 
-		if (bIsSingleThreaded)
+		// Mostly helps when replaying seeds, since those were all compiled the first time around
+		ShaderBlobCache HLSLBlobCache;
+		if (ShaderConfig.FuzzMethod == ShaderFuzzMethod::GeneratFullPipelineWithHLSL && ShaderConfig.HLSLBlobCacheDirectory != nullptr)
+		{
+			if (HLSLBlobCache.Open(ShaderConfig.HLSLBlobCacheDirectory, ShaderConfig.HLSLBlobCacheSizeBudget))
+			{
+				SetShaderBlobCache(&HLSLBlobCache);
+			}
+		}
+
+		ShaderCaseFilter CaseFilter;
+		ShaderCaseFilter* CaseFilterPtr = nullptr;
+		if (ShaderConfig.SkipDuplicateShaderCases != 0)
+		{
+			if (ShaderConfig.ShaderCaseFilterFilename == nullptr || !CaseFilter.Load(ShaderConfig.ShaderCaseFilterFilename))
+			{
+				CaseFilter.Init(ShaderConfig.ShaderCaseFilterExpectedCases, ShaderConfig.ShaderCaseFilterFalsePositiveRate);
+			}
+
+			CaseFilterPtr = &CaseFilter;
+		}
+
+		HLSLSizeController SizeController;
+		HLSLSizeController* SizeControllerPtr = nullptr;
+		if (ShaderConfig.FuzzMethod == ShaderFuzzMethod::GeneratFullPipelineWithHLSL && ShaderConfig.HLSLTargetCaseMilliseconds > 0.0f)
+		{
+			SizeController.Init(ShaderConfig.HLSLTargetCaseMilliseconds, ShaderConfig.HLSLLargeShaderChance);
+			SizeControllerPtr = &SizeController;
+		}
+
+		if (ShaderConfig.FuzzMethod == ShaderFuzzMethod::GeneratFullPipelineWithHLSL && ShaderConfig.HLSLReplayCorpusFilename != nullptr)
+		{
+			D3DDrawingFuzzingPersistentState PersistState;
+			PersistState.ResourceMgr.D3DDevice = Device;
+			SetupFuzzPersistState(&PersistState, &ShaderConfig, Device);
+
+			// The shaders come from the corpus, so the case filter and size controller have nothing to do
+			ShaderFuzzingState FuzzerTemplate;
+			FuzzerTemplate.D3DDevice = Device;
+			FuzzerTemplate.D3DPersist = &PersistState;
+			FuzzerTemplate.Config = &ShaderConfig;
+
+			if (ShaderConfig.HLSLReplayCorpusMutantsPerCase > 0)
+			{
+				MutateHLSLCorpusFile(&FuzzerTemplate, ShaderConfig.HLSLReplayCorpusFilename, ShaderConfig.HLSLReplayCorpusMutantsPerCase);
+			}
+			else
+			{
+				ReplayHLSLCorpusFile(&FuzzerTemplate, ShaderConfig.HLSLReplayCorpusFilename);
+			}
+		}
+		else if (bIsSingleThreaded)
 		{
 			LARGE_INTEGER PerfFreq;
 			QueryPerformanceFrequency(&PerfFreq);
@@ -379,6 +973,8 @@ int WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR cmdLine, int showC
 				Fuzzer.D3DDevice = Device;
 				Fuzzer.D3DPersist = &PersistState;
 				Fuzzer.Config = &ShaderConfig;
+				Fuzzer.CaseFilter = CaseFilterPtr;
+				Fuzzer.SizeController = SizeControllerPtr;
 
 				LOG("Doing round %d of fuzzing...", i);
 				Fuzzer.SetSeed(239231183503600360LLU);
@@ -403,36 +999,88 @@ int WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR cmdLine, int showC
 			uint64 StartingTime = time(NULL);
 			LOG("Starting time: %llu", StartingTime);
 
+			const int32 IterationsPerThread = 1024 * 1024;
+
+			TraceLogger FuzzTraceLog;
+			StartTraceLogForRun(&FuzzTraceLog, StartingTime);
+
+			// The fuzzing threads take cases from here as they go, so a slow thread doesn't hold up its share
+			FuzzCaseDispenser CaseDispenser;
+			CaseDispenser.Init(GetSeedStreamForRun(StartingTime, cmdLine), (uint64)ThreadCount * IterationsPerThread);
+
+			// Covers the same cases the fuzzing threads would have taken themselves, just not in the same order
+			DxbcBatchGenerator DXBCGenerator;
+			if (ShaderConfig.FuzzMethod == ShaderFuzzMethod::GeneratFullPipelineWithDXBC && ShaderConfig.DXBCPregenerateThreadCount > 0)
+			{
+				DXBCGenerator.Start(CaseDispenser.Stream, CaseDispenser.NumCases, ShaderConfig.DXBCPregenerateThreadCount);
+			}
+
+			// Shared by all the fuzzing threads, which each keep a few cases in flight on it
+			D3DShaderCompiler HLSLCompiler;
+			ShaderCompileWorkerPool HLSLCompilePool;
+			if (ShaderConfig.FuzzMethod == ShaderFuzzMethod::GeneratFullPipelineWithHLSL && ShaderConfig.HLSLCompileThreadCount > 0)
+			{
+				HLSLCompilePool.Start(&HLSLCompiler, ShaderConfig.HLSLCompileThreadCount);
+			}
+
 			for (int32 ThreadIdx = 0; ThreadIdx < ThreadCount; ThreadIdx++)
 			{
-				FuzzThreads.emplace_back([Device = Device, TIdx = ThreadIdx, ConfigPtr = &ShaderConfig, StartingTime = StartingTime,
+				FuzzThreads.emplace_back([Device = Device, TIdx = ThreadIdx, ConfigPtr = &ShaderConfig,
 						ExecCmdMutexPtr = &DebugMutexExecCmdList,
-						SRVHeapMutexPtr = &DebugMutexSRVDescriptorHeap]() {
+						SRVHeapMutexPtr = &DebugMutexSRVDescriptorHeap,
+						DXBCGeneratorPtr = &DXBCGenerator,
+						HLSLCompilePoolPtr = &HLSLCompilePool,
+						CaseFilterPtr = CaseFilterPtr,
+						SizeControllerPtr = SizeControllerPtr,
+						CaseDispenserPtr = &CaseDispenser]() {
 					D3DDrawingFuzzingPersistentState PersistState;
 					PersistState.ResourceMgr.D3DDevice = Device;
 					PersistState.ExecuteCommandListMutex = ExecCmdMutexPtr;
 					PersistState.SRVDescriptorHeapMutex = SRVHeapMutexPtr;
 					SetupFuzzPersistState(&PersistState, ConfigPtr, Device);
 
-					const int32 IterationsPerThread = 1024 * 1024;
+					if (HLSLCompilePoolPtr->IsRunning())
+					{
+						ShaderFuzzingState FuzzerTemplate;
+						FuzzerTemplate.D3DDevice = Device;
+						FuzzerTemplate.D3DPersist = &PersistState;
+						FuzzerTemplate.Config = ConfigPtr;
+						FuzzerTemplate.CaseFilter = CaseFilterPtr;
+						FuzzerTemplate.SizeController = SizeControllerPtr;
+
+						DoPipelinedHLSLIterations(&FuzzerTemplate, HLSLCompilePoolPtr, CaseDispenserPtr);
+						return;
+					}
 
-					for (int32 i = 0; i < IterationsPerThread; i++)
+					DxbcBatchEntry PregeneratedDXBC;
+
+					while (true)
 					{
 						ShaderFuzzingState Fuzzer;
 						Fuzzer.D3DDevice = Device;
 						Fuzzer.D3DPersist = &PersistState;
 						Fuzzer.Config = ConfigPtr;
+						Fuzzer.CaseFilter = CaseFilterPtr;
+						Fuzzer.SizeController = SizeControllerPtr;
 		
 						uint64 InitialFuzzSeed = 0;
 		
-						// If we want to have different fuzzing each process run. Good once a fuzzer is established.
-						InitialFuzzSeed += StartingTime * 0x8D3F277LLU;
-		
-						InitialFuzzSeed += (TIdx * IterationsPerThread);
-						InitialFuzzSeed += i;
+						if (DXBCGeneratorPtr->IsRunning())
+						{
+							if (!DXBCGeneratorPtr->Dequeue(&PregeneratedDXBC))
+							{
+								break;
+							}
+
+							InitialFuzzSeed = PregeneratedDXBC.CaseSeed;
+							Fuzzer.PregeneratedDXBC = &PregeneratedDXBC;
+						}
+						else if (!CaseDispenserPtr->TakeNextCase(&InitialFuzzSeed))
+						{
+							break;
+						}
 		
-						// In theory can cause contention maybe or slow things down? Idk, can remove this
-						LOG("Fuzing with seed %llu (TIdx:%d)", InitialFuzzSeed, TIdx);
+						TRACE_LOG(Info, "Fuzing with seed %llu (TIdx:%d)", InitialFuzzSeed, TIdx);
 					
 						Fuzzer.SetSeed(InitialFuzzSeed);
 						DoIterationsWithFuzzer(&Fuzzer, 1);
@@ -450,6 +1098,37 @@ int WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR cmdLine, int showC
 			{
 				Thread.join();
 			}
+
+			FuzzTraceLog.Stop();
+		}
+
+		if (HLSLBlobCache.IsOpen())
+		{
+			SetShaderBlobCache(nullptr);
+			LOG("Shader blob cache: %lld hits, %lld misses, %lld inserts, %lld trims", HLSLBlobCache.NumHits.load(), HLSLBlobCache.NumMisses.load(), HLSLBlobCache.NumInserts.load(), HLSLBlobCache.NumTrims.load());
+		}
+
+		if (CaseFilterPtr != nullptr)
+		{
+			int64 NumChecked = CaseFilter.NumCasesChecked.load();
+			int64 NumSkipped = CaseFilter.NumCasesSkipped.load();
+			int64 NumTimed = CaseFilter.NumCasesTimed.load();
+			double AverageCaseSeconds = (NumTimed > 0 ? CaseFilter.TotalCaseMicroseconds.load() / (NumTimed * 1000000.0) : 0.0);
+			LOG("Skipped %lld of %lld cases as duplicates (%3.2f%%), saving about %3.2f seconds of PSO creation/draws at %3.2f ms/case",
+				NumSkipped, NumChecked, (NumChecked > 0 ? NumSkipped * 100.0 / NumChecked : 0.0), NumSkipped * AverageCaseSeconds, AverageCaseSeconds * 1000.0);
+
+			if (ShaderConfig.ShaderCaseFilterFilename != nullptr)
+			{
+				CaseFilter.Save(ShaderConfig.ShaderCaseFilterFilename);
+			}
+		}
+
+		if (SizeControllerPtr != nullptr && SizeController.NumCases > 0)
+		{
+			HLSLSizeParams FinalParams = HLSLSizeController::GetParamsForScale(SizeController.Scale);
+			LOG("HLSL size controller: %lld cases (%lld full size) at %3.2f ms/case, changed size %d times, ended up at %d root statements and depth %d",
+				SizeController.NumCases, SizeController.NumLargeCases, SizeController.TotalMilliseconds / SizeController.NumCases,
+				SizeController.NumScaleChanges, FinalParams.MaxRootStatements, FinalParams.MaxExpressionDepth);
 		}
 	
 		return 0;
@@ -0,0 +1,649 @@
+#include "self_checks.h"
+
+#include "dxbc_batch.h"
+#include "dxbc_hash.h"
+#include "dxbc_reflect.h"
+#include "fuzz_dxbc.h"
+#include "fuzz_basic.h"
+#include "fuzz_seed_stream.h"
+#include "shader_blob_cache.h"
+#include "shader_compile_pipeline.h"
+#include "shader_meta.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <unordered_map>
+
+static double GetSecondsSince(std::chrono::steady_clock::time_point Start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+}
+
+bool CheckGeneratedDXBCMetadata(int32 CaseCount)
+{
+	auto Start = std::chrono::steady_clock::now();
+
+	FuzzSeedStream SeedStream;
+	DxbcBatchEntry Entry;
+
+	int32 NumMismatches = 0;
+	for (int32 i = 0; i < CaseCount; i++)
+	{
+		GenerateDxbcBatchEntry(SeedStream.GetCaseSeed(i), &Entry);
+
+		const std::vector<byte>* Bytecodes[2] = { &Entry.VSBytecode, &Entry.PSBytecode };
+		const ShaderMetadata* GeneratedMetas[2] = { &Entry.VSMeta, &Entry.PSMeta };
+		for (int32 ShaderIdx = 0; ShaderIdx < 2; ShaderIdx++)
+		{
+			ShaderMetadata ReflectedMeta;
+			if (!ReflectDXBCIntoShaderMetadata(Bytecodes[ShaderIdx]->data(), (uint32)Bytecodes[ShaderIdx]->size(), &ReflectedMeta))
+			{
+				LOG("Could not reflect case %d's generated %s shader", i, (ShaderIdx == 0 ? "vertex" : "pixel"));
+				NumMismatches++;
+			}
+			else if (!AreShaderMetadataEqual(ReflectedMeta, *GeneratedMetas[ShaderIdx]))
+			{
+				LOG("Reflecting case %d's generated %s shader doesn't give the metadata it was generated with", i, (ShaderIdx == 0 ? "vertex" : "pixel"));
+				NumMismatches++;
+			}
+		}
+	}
+
+	LOG("Generated DXBC metadata check: %d cases in %3.2f seconds, %d mismatches", CaseCount, GetSecondsSince(Start), NumMismatches);
+	return (NumMismatches == 0);
+}
+
+bool CheckDXBCReflectionOnMalformedBytecode(int32 CaseCount)
+{
+	const int32 CorruptionsPerShader = 64;
+
+	auto Start = std::chrono::steady_clock::now();
+
+	FuzzSeedStream SeedStream;
+	DxbcBatchEntry Entry;
+
+	FuzzBasicState Fuzzer;
+	Fuzzer.SetSeed(0);
+
+	// Exactly sized, so ASan can see an overread
+	std::vector<byte> Malformed;
+
+	// Reflection's memoized by the checksum, so every malformed copy gets a new one to make sure it actually gets looked at
+	auto ScrambleChecksum = [&]() {
+		for (int32 i = 4; i < 20 && i < (int32)Malformed.size(); i++)
+		{
+			Malformed[i] = (byte)Fuzzer.GetIntInRange(0, 255);
+		}
+	};
+
+	int32 NumAttempts = 0;
+	int32 NumAccepted = 0;
+	int32 NumMismatches = 0;
+	for (int32 i = 0; i < CaseCount; i++)
+	{
+		GenerateDxbcBatchEntry(SeedStream.GetCaseSeed(i), &Entry);
+
+		const std::vector<byte>* Bytecodes[2] = { &Entry.VSBytecode, &Entry.PSBytecode };
+		for (int32 ShaderIdx = 0; ShaderIdx < 2; ShaderIdx++)
+		{
+			const std::vector<byte>& Bytecode = *Bytecodes[ShaderIdx];
+
+			for (size_t Length = 0; Length < Bytecode.size(); Length += 4)
+			{
+				Malformed.assign(Bytecode.begin(), Bytecode.begin() + Length);
+				ScrambleChecksum();
+
+				ShaderMetadata Meta;
+				NumAttempts++;
+				if (ReflectDXBCIntoShaderMetadata(Malformed.data(), (uint32)Malformed.size(), &Meta))
+				{
+					LOG("Reflection accepted case %d's %s shader cut down to %d of its %d bytes", i, (ShaderIdx == 0 ? "vertex" : "pixel"),
+						(int32)Length, (int32)Bytecode.size());
+					NumMismatches++;
+				}
+			}
+
+			// Whether these get accepted depends on what got hit, so all we're checking is that they don't blow up
+			for (int32 CorruptionIdx = 0; CorruptionIdx < CorruptionsPerShader; CorruptionIdx++)
+			{
+				Malformed = Bytecode;
+				ScrambleChecksum();
+
+				int32 NumCorruptedBytes = Fuzzer.GetIntInRange(1, 4);
+				for (int32 ByteIdx = 0; ByteIdx < NumCorruptedBytes; ByteIdx++)
+				{
+					Malformed[Fuzzer.GetIntInRange(20, (int32)Malformed.size() - 1)] = (byte)Fuzzer.GetIntInRange(0, 255);
+				}
+
+				ShaderMetadata Meta;
+				NumAttempts++;
+				if (ReflectDXBCIntoShaderMetadata(Malformed.data(), (uint32)Malformed.size(), &Meta))
+				{
+					NumAccepted++;
+				}
+			}
+		}
+	}
+
+	LOG("Malformed DXBC reflection check: %d attempts in %3.2f seconds, %d corrupted ones accepted, %d truncated ones accepted",
+		NumAttempts, GetSecondsSince(Start), NumAccepted, NumMismatches);
+	return (NumMismatches == 0);
+}
+
+bool CheckParseDXBCCode(int32 CaseCount)
+{
+	const int32 CorruptionsPerShader = 64;
+
+	auto Start = std::chrono::steady_clock::now();
+
+	FuzzSeedStream SeedStream;
+	DxbcBatchEntry Entry;
+
+	FuzzBasicState Fuzzer;
+	Fuzzer.SetSeed(1);
+
+	std::vector<byte> Malformed;
+
+	int32 NumAttempts = 0;
+	int32 NumAccepted = 0;
+	int32 NumMismatches = 0;
+	for (int32 i = 0; i < CaseCount; i++)
+	{
+		GenerateDxbcBatchEntry(SeedStream.GetCaseSeed(i), &Entry);
+
+		const std::vector<byte>* Bytecodes[2] = { &Entry.VSBytecode, &Entry.PSBytecode };
+		for (int32 ShaderIdx = 0; ShaderIdx < 2; ShaderIdx++)
+		{
+			const std::vector<byte>& Bytecode = *Bytecodes[ShaderIdx];
+
+			NumAttempts++;
+			if (!ParseDXBCCode(Bytecode.data(), (int32)Bytecode.size()))
+			{
+				LOG("Could not parse case %d's generated %s shader", i, (ShaderIdx == 0 ? "vertex" : "pixel"));
+				NumMismatches++;
+			}
+
+			// The checksum gets fixed up afterwards, so these make it past that and into the chunks and instructions
+			for (int32 CorruptionIdx = 0; CorruptionIdx < CorruptionsPerShader; CorruptionIdx++)
+			{
+				Malformed = Bytecode;
+
+				int32 NumCorruptedBytes = Fuzzer.GetIntInRange(1, 4);
+				for (int32 ByteIdx = 0; ByteIdx < NumCorruptedBytes; ByteIdx++)
+				{
+					Malformed[Fuzzer.GetIntInRange(20, (int32)Malformed.size() - 1)] = (byte)Fuzzer.GetIntInRange(0, 255);
+				}
+
+				dxbcHash(Malformed.data() + 20, (uint32)Malformed.size() - 20, Malformed.data() + 4);
+
+				NumAttempts++;
+				if (ParseDXBCCode(Malformed.data(), (int32)Malformed.size()))
+				{
+					NumAccepted++;
+				}
+			}
+		}
+	}
+
+	LOG("DXBC parse check: %d attempts in %3.2f seconds, %d corrupted ones accepted, %d generated ones rejected",
+		NumAttempts, GetSecondsSince(Start), NumAccepted, NumMismatches);
+	return (NumMismatches == 0);
+}
+
+bool CheckDXBCHashMany(int32 RoundCount)
+{
+	const int32 MaxBuffersPerRound = 40;
+	const int32 MaxBufferSize = 300;
+
+	auto Start = std::chrono::steady_clock::now();
+
+	FuzzBasicState Fuzzer;
+	Fuzzer.SetSeed(0);
+
+	int32 NumMismatches = 0;
+
+	std::vector<std::vector<byte>> Buffers(MaxBuffersPerRound);
+	const void* BufferData[MaxBuffersPerRound];
+	uint32_t BufferSizes[MaxBuffersPerRound];
+	byte Digests[MaxBuffersPerRound][16];
+
+	for (int32 Round = 0; Round < RoundCount; Round++)
+	{
+		int32 NumBuffers = Fuzzer.GetIntInRange(1, MaxBuffersPerRound);
+		for (int32 i = 0; i < NumBuffers; i++)
+		{
+			// Exactly sized, so ASan can see an overread. Also covers the sizes that need an extra tail block (56-63 past a block)
+			Buffers[i].resize(Fuzzer.GetIntInRange(0, MaxBufferSize));
+			FillBytes(&Fuzzer, Buffers[i].data(), Buffers[i].size());
+
+			BufferData[i] = Buffers[i].data();
+			BufferSizes[i] = (uint32_t)Buffers[i].size();
+		}
+
+		dxbcHashMany(BufferData, BufferSizes, NumBuffers, Digests);
+
+		for (int32 i = 0; i < NumBuffers; i++)
+		{
+			byte ExpectedDigest[16];
+			dxbcHash(BufferData[i], BufferSizes[i], ExpectedDigest);
+			if (memcmp(Digests[i], ExpectedDigest, sizeof(ExpectedDigest)) != 0)
+			{
+				LOG("dxbcHashMany doesn't match dxbcHash for a %u byte buffer (%d of %d)", BufferSizes[i], i, NumBuffers);
+				NumMismatches++;
+			}
+		}
+	}
+
+	// The batch generator's path, which is where dxbcHashMany actually gets used
+	FuzzSeedStream SeedStream;
+	uint64 CaseSeeds[DXBC_BATCH_CASES_PER_CLAIM * 3 + 1];
+	for (int32 i = 0; i < ARRAY_COUNTOF(CaseSeeds); i++)
+	{
+		CaseSeeds[i] = SeedStream.GetCaseSeed(i);
+	}
+
+	std::vector<DxbcBatchEntry> BatchEntries(ARRAY_COUNTOF(CaseSeeds));
+	GenerateDxbcBatchEntries(CaseSeeds, ARRAY_COUNTOF(CaseSeeds), BatchEntries.data());
+
+	DxbcBatchEntry SingleEntry;
+	for (int32 i = 0; i < ARRAY_COUNTOF(CaseSeeds); i++)
+	{
+		GenerateDxbcBatchEntry(CaseSeeds[i], &SingleEntry);
+		if (BatchEntries[i].VSBytecode != SingleEntry.VSBytecode || BatchEntries[i].PSBytecode != SingleEntry.PSBytecode)
+		{
+			LOG("Case %d's containers come out different when they're checksummed in a batch", i);
+			NumMismatches++;
+		}
+	}
+
+	LOG("dxbcHashMany check: %d rounds in %3.2f seconds, %d mismatches", RoundCount, GetSecondsSince(Start), NumMismatches);
+	return (NumMismatches == 0);
+}
+
+// The fuzzer's own single-threaded path for a case's DXBC, to hold the batch generator up against
+static void GenerateReferenceDXBC(uint64 CaseSeed, DxbcBatchEntry* OutEntry)
+{
+	FuzzBasicState CaseState;
+	CaseState.SetSeed(CaseSeed);
+
+	OutEntry->CaseSeed = CaseSeed;
+	OutEntry->DXBCSeed = CaseState.GetSubSeed();
+
+	FuzzDXBCState DXBCState;
+	DXBCState.SetSeed(OutEntry->DXBCSeed);
+
+#if defined(_WIN32)
+	GenerateShaderDXBC(&DXBCState);
+
+	const byte* VSBytes = (const byte*)DXBCState.VSBlob->GetBufferPointer();
+	const byte* PSBytes = (const byte*)DXBCState.PSBlob->GetBufferPointer();
+	OutEntry->VSBytecode.assign(VSBytes, VSBytes + DXBCState.VSBlob->GetBufferSize());
+	OutEntry->PSBytecode.assign(PSBytes, PSBytes + DXBCState.PSBlob->GetBufferSize());
+
+	DXBCState.VSBlob->Release();
+	DXBCState.PSBlob->Release();
+#else
+	// What GenerateShaderDXBC does, just without the blobs
+	D3DOpcodeState VertShader;
+	D3DOpcodeState PixelShader;
+	GenerateShaderDXBCOpcodes(&DXBCState, &VertShader, &PixelShader);
+
+	WriteShaderBytecode(&VertShader, [&](uint32 Size) {
+		OutEntry->VSBytecode.resize(Size);
+		return OutEntry->VSBytecode.data();
+	});
+
+	WriteShaderBytecode(&PixelShader, [&](uint32 Size) {
+		OutEntry->PSBytecode.resize(Size);
+		return OutEntry->PSBytecode.data();
+	});
+#endif
+
+	OutEntry->VSMeta = DXBCState.VSMeta;
+	OutEntry->PSMeta = DXBCState.PSMeta;
+}
+
+bool CheckDXBCBatchMatchesGenerator(int32 CaseCount, int32 ThreadCount)
+{
+	auto Start = std::chrono::steady_clock::now();
+
+	FuzzSeedStream SeedStream;
+
+	// Case seed -> index, the batch hands them out roughly but not exactly in order
+	std::unordered_map<uint64, int32> CaseIndices;
+	for (int32 i = 0; i < CaseCount; i++)
+	{
+		CaseIndices[SeedStream.GetCaseSeed(i)] = i;
+	}
+
+	std::vector<bool> WasDequeued(CaseCount, false);
+
+	DxbcBatchGenerator Generator;
+	Generator.Start(SeedStream, CaseCount, ThreadCount);
+
+	int32 NumMismatches = 0;
+	int32 NumDequeued = 0;
+	DxbcBatchEntry Entry;
+	DxbcBatchEntry ReferenceEntry;
+	while (Generator.Dequeue(&Entry))
+	{
+		NumDequeued++;
+
+		auto Iter = CaseIndices.find(Entry.CaseSeed);
+		if (Iter == CaseIndices.end() || WasDequeued[Iter->second])
+		{
+			LOG("Batch generator gave a case with seed %llu that wasn't asked for, or was already given", Entry.CaseSeed);
+			NumMismatches++;
+			continue;
+		}
+
+		WasDequeued[Iter->second] = true;
+
+		GenerateReferenceDXBC(Entry.CaseSeed, &ReferenceEntry);
+		if (Entry.DXBCSeed != ReferenceEntry.DXBCSeed
+			|| Entry.VSBytecode != ReferenceEntry.VSBytecode || Entry.PSBytecode != ReferenceEntry.PSBytecode
+			|| !AreShaderMetadataEqual(Entry.VSMeta, ReferenceEntry.VSMeta) || !AreShaderMetadataEqual(Entry.PSMeta, ReferenceEntry.PSMeta))
+		{
+			LOG("Batch generator's case %d (seed %llu) doesn't match generating it on its own", Iter->second, Entry.CaseSeed);
+			NumMismatches++;
+		}
+	}
+
+	Generator.Stop();
+
+	if (NumDequeued != CaseCount)
+	{
+		LOG("Batch generator gave %d cases, expected %d", NumDequeued, CaseCount);
+		NumMismatches++;
+	}
+
+	LOG("DXBC batch check: %d cases on %d threads in %3.2f seconds, %d mismatches", CaseCount, ThreadCount, GetSecondsSince(Start), NumMismatches);
+	return (NumMismatches == 0);
+}
+
+// Blob i's key and contents, the contents are different sizes and depend on the key
+static ShaderBlobCacheKey GetSelfCheckBlob(int32 BlobIdx, std::vector<byte>* OutBlob)
+{
+	char Source[64] = {};
+	snprintf(Source, sizeof(Source), "// Self check blob %d", BlobIdx);
+
+	ShaderBlobCacheKey Key = ComputeShaderBlobCacheKey(Source, (uint32)strlen(Source), "Main", "vs_5_0", 0);
+
+	OutBlob->resize(64 + (BlobIdx * 37) % 1000);
+	for (size_t i = 0; i < OutBlob->size(); i++)
+	{
+		(*OutBlob)[i] = Key.Digest[i % SHADER_BLOB_CACHE_KEY_SIZE] ^ (byte)i;
+	}
+
+	return Key;
+}
+
+bool CheckShaderBlobCache(const char* Directory)
+{
+	const int32 BlobCount = 200;
+	const int32 RecentBlobCount = 50;
+	const uint64 LargeBudget = 64 * 1024 * 1024;
+
+	const int32 StressThreadCount = 6;
+	const int32 StressBlobCount = 2000;
+	const int32 StressLookupsPerThread = 20 * 1000;
+	const uint64 StressBudget = 256 * 1024;
+
+	auto Start = std::chrono::steady_clock::now();
+
+	int32 NumMismatches = 0;
+	std::vector<byte> Blob;
+	std::vector<byte> CachedBlob;
+
+	// Returns how many of [FirstBlob, EndBlob) were hits, any hits that came back wrong count as mismatches
+	auto LookupBlobs = [&](ShaderBlobCache* Cache, int32 FirstBlob, int32 EndBlob, const char* Stage) {
+		int32 NumHits = 0;
+		for (int32 i = FirstBlob; i < EndBlob; i++)
+		{
+			ShaderBlobCacheKey Key = GetSelfCheckBlob(i, &Blob);
+			if (Cache->Lookup(Key, &CachedBlob))
+			{
+				NumHits++;
+				if (CachedBlob != Blob)
+				{
+					LOG("Shader blob cache gave back the wrong contents for blob %d (%s)", i, Stage);
+					NumMismatches++;
+				}
+			}
+		}
+
+		return NumHits;
+	};
+
+	auto ExpectHits = [&](int32 NumHits, int32 ExpectedHits, const char* Stage) {
+		if (NumHits != ExpectedHits)
+		{
+			LOG("Shader blob cache had %d hits %s, expected %d", NumHits, Stage, ExpectedHits);
+			NumMismatches++;
+		}
+	};
+
+	{
+		ShaderBlobCache Cache;
+		if (!Cache.Open(Directory, LargeBudget))
+		{
+			LOG("Could not open a shader blob cache in '%s' to check", Directory);
+			return false;
+		}
+
+		// Whatever's left over from last time
+		Cache.TrimToSize(0);
+		ExpectHits(LookupBlobs(&Cache, 0, BlobCount, "after emptying it"), 0, "after emptying it");
+
+		for (int32 i = 0; i < BlobCount; i++)
+		{
+			ShaderBlobCacheKey Key = GetSelfCheckBlob(i, &Blob);
+			Cache.Insert(Key, Blob.data(), (uint32)Blob.size());
+		}
+
+		// Already in there, so these shouldn't add anything
+		int64 NumInsertsBefore = Cache.NumInserts.load();
+		for (int32 i = 0; i < BlobCount; i++)
+		{
+			ShaderBlobCacheKey Key = GetSelfCheckBlob(i, &Blob);
+			Cache.Insert(Key, Blob.data(), (uint32)Blob.size());
+		}
+		ExpectHits((int32)(Cache.NumInserts.load() - NumInsertsBefore), 0, "(as inserts) when putting the same blobs in again");
+
+		ExpectHits(LookupBlobs(&Cache, 0, BlobCount, "after inserting them"), BlobCount, "after inserting them");
+		ExpectHits(LookupBlobs(&Cache, BlobCount, BlobCount * 2, "that were never inserted"), 0, "for blobs that were never inserted");
+	}
+
+	{
+		ShaderBlobCache Cache;
+		Cache.Open(Directory, LargeBudget);
+		ExpectHits(LookupBlobs(&Cache, 0, BlobCount, "after reopening"), BlobCount, "after reopening");
+
+		std::string IndexFilename = Cache.IndexFilename;
+		Cache.Close();
+		remove(IndexFilename.c_str());
+
+		Cache.Open(Directory, LargeBudget);
+		ExpectHits(LookupBlobs(&Cache, 0, BlobCount, "after rebuilding the index"), BlobCount, "after rebuilding the index");
+
+		// Looking them up makes these the most recently used, trimming to exactly their size should keep just them
+		uint64 RecentSize = 0;
+		for (int32 i = BlobCount - RecentBlobCount; i < BlobCount; i++)
+		{
+			GetSelfCheckBlob(i, &Blob);
+			RecentSize += sizeof(ShaderBlobCachePackRecordHeader) + Blob.size();
+		}
+
+		LookupBlobs(&Cache, BlobCount - RecentBlobCount, BlobCount, "before trimming");
+		Cache.TrimToSize(RecentSize);
+
+		ExpectHits(LookupBlobs(&Cache, BlobCount - RecentBlobCount, BlobCount, "after trimming"), RecentBlobCount, "for the recent blobs after trimming");
+		ExpectHits(LookupBlobs(&Cache, 0, BlobCount - RecentBlobCount, "after trimming"), 0, "for the older blobs after trimming");
+
+		if (Cache.GetIndexHeader()->PackSize > RecentSize)
+		{
+			LOG("Shader blob cache pack is %llu bytes after trimming to %llu", Cache.GetIndexHeader()->PackSize, RecentSize);
+			NumMismatches++;
+		}
+	}
+
+	// Small enough budget that it keeps trimming itself while the threads are going. Anything can be a miss by then,
+	// but the hits still have to be right
+	{
+		ShaderBlobCache Cache;
+		Cache.Open(Directory, StressBudget);
+
+		std::atomic<int32> NumStressMismatches;
+		NumStressMismatches.store(0);
+
+		std::vector<std::thread> Threads;
+		for (int32 ThreadIdx = 0; ThreadIdx < StressThreadCount; ThreadIdx++)
+		{
+			Threads.emplace_back([&Cache, &NumStressMismatches, ThreadIdx, StressBlobCount, StressLookupsPerThread]() {
+				FuzzBasicState Fuzzer;
+				Fuzzer.SetSeed(ThreadIdx);
+
+				std::vector<byte> ThreadBlob;
+				std::vector<byte> ThreadCachedBlob;
+				for (int32 i = 0; i < StressLookupsPerThread; i++)
+				{
+					ShaderBlobCacheKey Key = GetSelfCheckBlob(Fuzzer.GetIntInRange(0, StressBlobCount - 1), &ThreadBlob);
+					if (!Cache.Lookup(Key, &ThreadCachedBlob))
+					{
+						Cache.Insert(Key, ThreadBlob.data(), (uint32)ThreadBlob.size());
+					}
+					else if (ThreadCachedBlob != ThreadBlob)
+					{
+						NumStressMismatches++;
+					}
+				}
+			});
+		}
+
+		for (auto& Thread : Threads)
+		{
+			Thread.join();
+		}
+
+		if (NumStressMismatches.load() > 0)
+		{
+			LOG("Shader blob cache gave back the wrong contents %d times with %d threads using it", NumStressMismatches.load(), StressThreadCount);
+			NumMismatches++;
+		}
+
+		LOG("Shader blob cache stress: %lld hits, %lld misses, %lld inserts, %lld trims", Cache.NumHits.load(), Cache.NumMisses.load(),
+			Cache.NumInserts.load(), Cache.NumTrims.load());
+
+		// Don't leave a load of self check blobs in there
+		Cache.Close();
+		Cache.Open(Directory, StressBudget);
+		Cache.TrimToSize(0);
+	}
+
+	LOG("Shader blob cache check: %3.2f seconds, %d mismatches", GetSecondsSince(Start), NumMismatches);
+	return (NumMismatches == 0);
+}
+
+bool CheckShaderCompilePool(int32 SubmitThreadCount, int32 CompileThreadCount, int32 JobsPerThread)
+{
+	const int32 MaxPendingJobs = 8;
+	const int32 MaxJobsInFlightPerThread = 24;
+
+	auto Start = std::chrono::steady_clock::now();
+
+	// No latency, so the jobs finish while their submitters are just getting to WaitForJob, which is where the races would be
+	StubShaderCompiler Compiler;
+
+	ShaderCompileWorkerPool CompilePool;
+	CompilePool.Start(&Compiler, CompileThreadCount, MaxPendingJobs);
+
+	std::atomic<int32> NumMismatches;
+	NumMismatches.store(0);
+
+	std::vector<std::thread> SubmitThreads;
+	for (int32 ThreadIdx = 0; ThreadIdx < SubmitThreadCount; ThreadIdx++)
+	{
+		SubmitThreads.emplace_back([&CompilePool, &Compiler, &NumMismatches, ThreadIdx, JobsPerThread, MaxJobsInFlightPerThread]() {
+			FuzzBasicState Fuzzer;
+			Fuzzer.SetSeed(ThreadIdx);
+
+			std::vector<std::string> Sources(MaxJobsInFlightPerThread);
+			std::vector<ShaderCompileJob*> Jobs(MaxJobsInFlightPerThread);
+
+			for (int32 BatchStart = 0; BatchStart < JobsPerThread; BatchStart += MaxJobsInFlightPerThread)
+			{
+				// A different number in flight each time, so the threads don't end up in lockstep
+				int32 BatchSize = Fuzzer.GetIntInRange(1, MaxJobsInFlightPerThread);
+				if (BatchSize > JobsPerThread - BatchStart)
+				{
+					BatchSize = JobsPerThread - BatchStart;
+				}
+
+				for (int32 i = 0; i < BatchSize; i++)
+				{
+					char Source[128] = {};
+					snprintf(Source, sizeof(Source), "float4 Main() : SV_Target { return %d.0 + %d.0; }", ThreadIdx, BatchStart + i);
+					Sources[i] = Source;
+
+					// Fresh off the heap, so if anything still touches a job after WaitForJob it's touching freed memory
+					Jobs[i] = new ShaderCompileJob();
+					Jobs[i]->Source = &Sources[i];
+					Jobs[i]->Type = (i % 2 == 0 ? D3DShaderType::Vertex : D3DShaderType::Pixel);
+					CompilePool.Submit(Jobs[i]);
+				}
+
+				// Mostly in reverse, so we're waiting on jobs that aren't done yet as well as ones that are
+				for (int32 i = BatchSize - 1; i >= 0; i--)
+				{
+					CompilePool.WaitForJob(Jobs[i]);
+
+					std::vector<byte> ExpectedBytecode;
+					ShaderMetadata ExpectedMeta;
+					bool ExpectedSucceeded = Compiler.CompileShader(*Jobs[i]->Source, Jobs[i]->Type, Jobs[i]->EntryPoint, &ExpectedBytecode, &ExpectedMeta);
+					if (!Jobs[i]->IsDone.load() || Jobs[i]->Succeeded != ExpectedSucceeded || Jobs[i]->Bytecode != ExpectedBytecode)
+					{
+						NumMismatches++;
+					}
+
+					delete Jobs[i];
+					Jobs[i] = nullptr;
+				}
+			}
+		});
+	}
+
+	for (auto& Thread : SubmitThreads)
+	{
+		Thread.join();
+	}
+
+	CompilePool.Stop();
+
+	LOG("Compile pool check: %d jobs from %d threads on %d compile threads in %3.2f seconds, %d mismatches", SubmitThreadCount * JobsPerThread,
+		SubmitThreadCount, CompileThreadCount, GetSecondsSince(Start), NumMismatches.load());
+	return (NumMismatches.load() == 0);
+}
+
+int32 RunSelfChecks()
+{
+	int32 NumFailed = 0;
+
+	if (!CheckGeneratedDXBCMetadata(10 * 1000)) { NumFailed++; }
+	if (!CheckDXBCReflectionOnMalformedBytecode(200)) { NumFailed++; }
+	if (!CheckParseDXBCCode(200)) { NumFailed++; }
+	if (!CheckDXBCHashMany(10 * 1000)) { NumFailed++; }
+	if (!CheckDXBCBatchMatchesGenerator(10 * 1000, 8)) { NumFailed++; }
+	if (!CheckShaderBlobCache("self_check_blob_cache")) { NumFailed++; }
+	if (!CheckShaderCompilePool(8, 8, 20 * 1000)) { NumFailed++; }
+
+	LOG("Self checks: %d failed", NumFailed);
+	return NumFailed;
+}
+
+#if defined(SELF_CHECKS_MAIN)
+int main()
+{
+	return (RunSelfChecks() == 0 ? 0 : 1);
+}
+#endif
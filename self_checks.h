@@ -0,0 +1,44 @@
+#pragma once
+
+#include "basics.h"
+
+// Checks for the parts that don't need D3D (DXBC generation and reflection, the compile pool, the blob cache),
+// so they can be run anywhere. On Windows they're run with -selfcheck. Elsewhere, build this file with SELF_CHECKS_MAIN
+// defined along with the .cpp files it needs:
+//
+//   g++ -std=c++14 -O2 -pthread -DSELF_CHECKS_MAIN self_checks.cpp dxbc_batch.cpp dxbc_hash.cpp dxbc_reflect.cpp dxbc_view.cpp fuzz_decision_tape.cpp
+//       fuzz_dxbc.cpp shader_meta.cpp shader_blob_cache.cpp shader_compile_pipeline.cpp -o self_checks
+//
+// Each check LOGs whatever went wrong and returns false if anything did
+
+// Generates DXBC cases and checks that reflecting the bytecode (ReflectDXBCIntoShaderMetadata) gives back the metadata
+// the generator built from the opcode state
+bool CheckGeneratedDXBCMetadata(int32 CaseCount);
+
+// Feeds ReflectDXBCIntoShaderMetadata truncated and corrupted copies of generated bytecode. Truncated ones have to be rejected,
+// and nothing can read past the end or trip an ASSERT (which is the part worth running under ASan)
+bool CheckDXBCReflectionOnMalformedBytecode(int32 CaseCount);
+
+// ParseDXBCCode has to accept every generated shader, and not read outside the bytecode or trip an ASSERT on corrupted
+// copies of them (with the checksum fixed up, so the corruption actually gets decoded)
+bool CheckParseDXBCCode(int32 CaseCount);
+
+// dxbcHashMany against dxbcHash on each buffer, for random buffers (every size up to a few blocks, any number at once)
+// and for a batch of generated containers written without checksums, which should come out the same as with them
+bool CheckDXBCHashMany(int32 RoundCount);
+
+// Runs the cases through DxbcBatchGenerator on ThreadCount threads, and checks each case comes out exactly once, with the
+// same bytecode and metadata as generating it on its own the way the fuzzer does (GenerateShaderDXBC, on Windows)
+bool CheckDXBCBatchMatchesGenerator(int32 CaseCount, int32 ThreadCount);
+
+// Puts blobs in a cache in Directory (emptying out whatever was there) and gets them back: after reopening it, after
+// rebuilding the index from the pack, after trimming it, and with several threads inserting and looking up while it
+// trims itself in the background
+bool CheckShaderBlobCache(const char* Directory);
+
+// Several threads submitting jobs to a ShaderCompileWorkerPool with the stub compiler, more than the queue holds, each
+// freeing its jobs as soon as it's waited for them. Every job has to come back with what compiling it directly gives
+bool CheckShaderCompilePool(int32 SubmitThreadCount, int32 CompileThreadCount, int32 JobsPerThread);
+
+// Runs every check, returns how many failed
+int32 RunSelfChecks();
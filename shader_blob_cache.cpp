@@ -0,0 +1,768 @@
+#include "shader_blob_cache.h"
+
+#include "dxbc_hash.h"
+
+#include <algorithm>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#include <share.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define SHADER_BLOB_CACHE_PACK_MAGIC 0x52434253 // 'SBCR'
+#define SHADER_BLOB_CACHE_INDEX_MAGIC 0x49434253 // 'SBCI'
+
+// Bump this if the key derivation or either file layout changes, old caches just get thrown out
+#define SHADER_BLOB_CACHE_VERSION 1
+
+#define SHADER_BLOB_CACHE_INITIAL_CAPACITY 1024
+
+static_assert(sizeof(ShaderBlobCacheIndexHeader) == 32, "Index header layout changed, bump SHADER_BLOB_CACHE_VERSION");
+static_assert(sizeof(ShaderBlobCacheIndexEntry) == 40, "Index entry layout changed, bump SHADER_BLOB_CACHE_VERSION");
+static_assert(sizeof(ShaderBlobCachePackRecordHeader) == 24, "Pack record layout changed, bump SHADER_BLOB_CACHE_VERSION");
+
+ShaderBlobCacheKey ComputeShaderBlobCacheKey(const char* Source, uint32 SourceLength, const char* EntryPoint, const char* Target, uint32 CompilerFlags)
+{
+	// The nul terminators go in too, so that e.g. moving a character from the end of the source to the start of the entry point changes the key
+	DxbcHashContext Context;
+	dxbcHashInit(&Context);
+	dxbcHashUpdate(&Context, Source, SourceLength);
+	dxbcHashUpdate(&Context, "", 1);
+	dxbcHashUpdate(&Context, EntryPoint, (uint32)strlen(EntryPoint) + 1);
+	dxbcHashUpdate(&Context, Target, (uint32)strlen(Target) + 1);
+	dxbcHashUpdate(&Context, &CompilerFlags, sizeof(CompilerFlags));
+
+	ShaderBlobCacheKey Key;
+	dxbcHashFinal(&Context, Key.Digest);
+	return Key;
+}
+
+static bool AreShaderBlobCacheKeysEqual(const ShaderBlobCacheKey& A, const ShaderBlobCacheKey& B)
+{
+	return memcmp(A.Digest, B.Digest, SHADER_BLOB_CACHE_KEY_SIZE) == 0;
+}
+
+// ftell/fseek are only 32-bit on Windows
+static bool SeekShaderBlobCacheFile(FILE* File, uint64 Offset)
+{
+#if defined(_WIN32)
+	return _fseeki64(File, (int64)Offset, SEEK_SET) == 0;
+#else
+	return fseeko(File, (off_t)Offset, SEEK_SET) == 0;
+#endif
+}
+
+static uint64 GetShaderBlobCacheFileSize(FILE* File)
+{
+#if defined(_WIN32)
+	_fseeki64(File, 0, SEEK_END);
+	return (uint64)_ftelli64(File);
+#else
+	fseeko(File, 0, SEEK_END);
+	return (uint64)ftello(File);
+#endif
+}
+
+// The pack readers have to be able to open it while we've got it open to append, which fopen_s doesn't allow on Windows
+static FILE* OpenShaderBlobCachePackForAppend(const char* Filename, const char* Mode)
+{
+	FILE* File = nullptr;
+#if defined(_WIN32)
+	File = _fsopen(Filename, Mode, _SH_DENYNO);
+#else
+	fopen_s(&File, Filename, Mode);
+#endif
+	return File;
+}
+
+// Swaps NewFilename in for Filename. Any readers of the old one keep reading the old one
+static bool ReplaceShaderBlobCacheFile(const char* NewFilename, const char* Filename)
+{
+#if defined(_WIN32)
+	// Works with the old pack still open, since the readers open it with FILE_SHARE_DELETE
+	return MoveFileExA(NewFilename, Filename, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return rename(NewFilename, Filename) == 0;
+#endif
+}
+
+bool ShaderBlobCachePackReader::Open(const char* Filename)
+{
+#if defined(_WIN32)
+	HANDLE File = CreateFileA(Filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (File == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	FileHandle = File;
+#else
+	FileDescriptor = open(Filename, O_RDONLY);
+	if (FileDescriptor < 0)
+	{
+		return false;
+	}
+#endif
+
+	return true;
+}
+
+void ShaderBlobCachePackReader::Close()
+{
+#if defined(_WIN32)
+	if (FileHandle != nullptr)
+	{
+		CloseHandle((HANDLE)FileHandle);
+		FileHandle = nullptr;
+	}
+#else
+	if (FileDescriptor >= 0)
+	{
+		close(FileDescriptor);
+		FileDescriptor = -1;
+	}
+#endif
+}
+
+bool ShaderBlobCachePackReader::Read(uint64 Offset, void* OutData, uint32 Size) const
+{
+#if defined(_WIN32)
+	// The offset's given with each read, so threads don't fight over the file pointer
+	OVERLAPPED Overlapped = {};
+	Overlapped.Offset = (DWORD)Offset;
+	Overlapped.OffsetHigh = (DWORD)(Offset >> 32);
+
+	DWORD BytesRead = 0;
+	return Size == 0 || (ReadFile((HANDLE)FileHandle, OutData, Size, &BytesRead, &Overlapped) && BytesRead == Size);
+#else
+	uint32 TotalRead = 0;
+	while (TotalRead < Size)
+	{
+		ssize_t BytesRead = pread(FileDescriptor, (byte*)OutData + TotalRead, Size - TotalRead, (off_t)(Offset + TotalRead));
+		if (BytesRead <= 0)
+		{
+			return false;
+		}
+
+		TotalRead += (uint32)BytesRead;
+	}
+
+	return true;
+#endif
+}
+
+bool ShaderBlobCacheMappedFile::Open(const char* Filename, uint64 MinSize)
+{
+	ASSERT(Data == nullptr);
+
+#if defined(_WIN32)
+	HANDLE File = CreateFileA(Filename, GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (File == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER FileSize = {};
+	GetFileSizeEx(File, &FileSize);
+	uint64 MappedSize = std::max<uint64>((uint64)FileSize.QuadPart, MinSize);
+
+	// Mapping more than the file's size grows the file to match
+	HANDLE Mapping = CreateFileMappingA(File, nullptr, PAGE_READWRITE, (DWORD)(MappedSize >> 32), (DWORD)MappedSize, nullptr);
+	if (Mapping == nullptr)
+	{
+		CloseHandle(File);
+		return false;
+	}
+
+	void* View = MapViewOfFile(Mapping, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)MappedSize);
+	if (View == nullptr)
+	{
+		CloseHandle(Mapping);
+		CloseHandle(File);
+		return false;
+	}
+
+	FileHandle = File;
+	MappingHandle = Mapping;
+#else
+	int File = open(Filename, O_RDWR | O_CREAT, 0644);
+	if (File < 0)
+	{
+		return false;
+	}
+
+	struct stat FileStat = {};
+	fstat(File, &FileStat);
+	uint64 MappedSize = std::max<uint64>((uint64)FileStat.st_size, MinSize);
+
+	if ((uint64)FileStat.st_size < MappedSize && ftruncate(File, (off_t)MappedSize) != 0)
+	{
+		close(File);
+		return false;
+	}
+
+	void* View = mmap(nullptr, (size_t)MappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, File, 0);
+	if (View == MAP_FAILED)
+	{
+		close(File);
+		return false;
+	}
+
+	FileDescriptor = File;
+#endif
+
+	Data = (byte*)View;
+	Size = MappedSize;
+
+	return true;
+}
+
+void ShaderBlobCacheMappedFile::Close()
+{
+	if (Data == nullptr)
+	{
+		return;
+	}
+
+#if defined(_WIN32)
+	FlushViewOfFile(Data, 0);
+	UnmapViewOfFile(Data);
+	CloseHandle((HANDLE)MappingHandle);
+	CloseHandle((HANDLE)FileHandle);
+	FileHandle = nullptr;
+	MappingHandle = nullptr;
+#else
+	msync(Data, (size_t)Size, MS_SYNC);
+	munmap(Data, (size_t)Size);
+	close(FileDescriptor);
+	FileDescriptor = -1;
+#endif
+
+	Data = nullptr;
+	Size = 0;
+}
+
+ShaderBlobCache::~ShaderBlobCache()
+{
+	Close();
+}
+
+bool ShaderBlobCache::Open(const char* Directory, uint64 InSizeBudget)
+{
+	ASSERT(!IsOpen());
+
+	// Fails if it's already there, which is fine
+#if defined(_WIN32)
+	CreateDirectoryA(Directory, nullptr);
+#else
+	mkdir(Directory, 0755);
+#endif
+
+	PackFilename = std::string(Directory) + "/shader_blobs.pack";
+	IndexFilename = std::string(Directory) + "/shader_blobs.index";
+	SizeBudget = InSizeBudget;
+
+	PackFile = OpenShaderBlobCachePackForAppend(PackFilename.c_str(), "r+b");
+	if (PackFile == nullptr)
+	{
+		PackFile = OpenShaderBlobCachePackForAppend(PackFilename.c_str(), "w+b");
+	}
+
+	PackReader = std::make_shared<ShaderBlobCachePackReader>();
+	if (PackFile == nullptr || !PackReader->Open(PackFilename.c_str()))
+	{
+		LOG("Could not open shader blob cache pack '%s'", PackFilename.c_str());
+		Close();
+		return false;
+	}
+
+	if (!IndexFile.Open(IndexFilename.c_str(), sizeof(ShaderBlobCacheIndexHeader)))
+	{
+		LOG("Could not open shader blob cache index '%s'", IndexFilename.c_str());
+		Close();
+		return false;
+	}
+
+	// Anything that doesn't look right (including a brand new, zeroed index) means we go off of the pack instead
+	ShaderBlobCacheIndexHeader* Header = GetIndexHeader();
+	uint64 PackFileSize = GetShaderBlobCacheFileSize(PackFile);
+
+	bool IsIndexValid = Header->Magic == SHADER_BLOB_CACHE_INDEX_MAGIC
+		&& Header->Version == SHADER_BLOB_CACHE_VERSION
+		&& Header->Capacity > 0
+		&& (Header->Capacity & (Header->Capacity - 1)) == 0
+		&& sizeof(ShaderBlobCacheIndexHeader) + (uint64)Header->Capacity * sizeof(ShaderBlobCacheIndexEntry) <= IndexFile.Size
+		&& Header->NumEntries * 2 <= Header->Capacity
+		&& Header->PackSize <= PackFileSize;
+
+	if (!IsIndexValid && !RebuildIndexFromPack())
+	{
+		Close();
+		return false;
+	}
+
+	if (GetIndexHeader()->PackSize > SizeBudget)
+	{
+		TrimToSize(SizeBudget / 4 * 3);
+	}
+
+	return IsOpen();
+}
+
+void ShaderBlobCache::Close()
+{
+	if (TrimThread.joinable())
+	{
+		TrimThread.join();
+	}
+
+	std::lock_guard<std::mutex> AppendLock(AppendMutex);
+	std::lock_guard<std::mutex> Lock(CacheMutex);
+	CloseFiles();
+}
+
+void ShaderBlobCache::CloseFiles()
+{
+	if (PackFile != nullptr)
+	{
+		fclose(PackFile);
+		PackFile = nullptr;
+	}
+
+	PackReader = nullptr;
+	IndexFile.Close();
+}
+
+bool ShaderBlobCache::Lookup(const ShaderBlobCacheKey& Key, std::vector<byte>* OutBytecode)
+{
+	std::shared_ptr<ShaderBlobCachePackReader> Reader;
+	uint64 PackOffset = 0;
+	uint32 BytecodeSize = 0;
+
+	{
+		std::lock_guard<std::mutex> Lock(CacheMutex);
+
+		if (!IsOpen())
+		{
+			return false;
+		}
+
+		ShaderBlobCacheIndexEntry* Entry = FindIndexSlot(Key);
+		if (!Entry->IsUsed)
+		{
+			NumMisses++;
+			return false;
+		}
+
+		// Bumped before we've read it, if the read fails the cache is in a bad way anyway
+		Entry->LastUsed = ++GetIndexHeader()->UseCounter;
+
+		Reader = PackReader;
+		PackOffset = Entry->PackOffset;
+		BytecodeSize = Entry->BytecodeSize;
+	}
+
+	// Records never change once they're written, and if a trim swaps the pack out we've still got the one the index pointed into.
+	// Check the record header too, in case the pack got changed out from under the index
+	ShaderBlobCachePackRecordHeader RecordHeader;
+	bool ReadSucceeded = Reader->Read(PackOffset - sizeof(RecordHeader), &RecordHeader, sizeof(RecordHeader))
+		&& RecordHeader.Magic == SHADER_BLOB_CACHE_PACK_MAGIC
+		&& RecordHeader.BytecodeSize == BytecodeSize
+		&& AreShaderBlobCacheKeysEqual(RecordHeader.Key, Key);
+
+	if (ReadSucceeded)
+	{
+		OutBytecode->resize(BytecodeSize);
+		ReadSucceeded = Reader->Read(PackOffset, OutBytecode->data(), BytecodeSize);
+	}
+
+	if (!ReadSucceeded)
+	{
+		LOG("Shader blob cache pack doesn't match its index, treating it as a miss");
+		NumMisses++;
+		return false;
+	}
+
+	NumHits++;
+
+	return true;
+}
+
+void ShaderBlobCache::Insert(const ShaderBlobCacheKey& Key, const void* Bytecode, uint32 BytecodeSize)
+{
+	// It's only a cache, so rather than wait for the trim we just don't keep this one
+	if (IsTrimming.load())
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> AppendLock(AppendMutex);
+
+	// Nobody else can append until we're done, so this is still the end of the pack when we come to update the index
+	uint64 RecordOffset = 0;
+	{
+		std::lock_guard<std::mutex> Lock(CacheMutex);
+
+		if (!IsOpen() || FindIndexSlot(Key)->IsUsed)
+		{
+			return;
+		}
+
+		RecordOffset = GetIndexHeader()->PackSize;
+	}
+
+	ShaderBlobCachePackRecordHeader RecordHeader;
+	RecordHeader.Magic = SHADER_BLOB_CACHE_PACK_MAGIC;
+	RecordHeader.BytecodeSize = BytecodeSize;
+	RecordHeader.Key = Key;
+
+	// Appends go at the end of what the index knows about, not the end of the file, so a half-written record gets overwritten
+	bool WriteSucceeded = SeekShaderBlobCacheFile(PackFile, RecordOffset)
+		&& fwrite(&RecordHeader, sizeof(RecordHeader), 1, PackFile) == 1
+		&& fwrite(Bytecode, 1, BytecodeSize, PackFile) == BytecodeSize
+		&& fflush(PackFile) == 0;
+
+	if (!WriteSucceeded)
+	{
+		LOG("Could not append to shader blob cache pack '%s'", PackFilename.c_str());
+		return;
+	}
+
+	bool ShouldTrim = false;
+	{
+		std::lock_guard<std::mutex> Lock(CacheMutex);
+
+		if (!ReserveIndexEntry())
+		{
+			return;
+		}
+
+		ShaderBlobCacheIndexHeader* Header = GetIndexHeader();
+
+		// Rehashing in ReserveIndexEntry can move things around, so this has to come after it
+		ShaderBlobCacheIndexEntry* Entry = FindIndexSlot(Key);
+		Entry->Key = Key;
+		Entry->PackOffset = RecordOffset + sizeof(RecordHeader);
+		Entry->BytecodeSize = BytecodeSize;
+		Entry->IsUsed = 1;
+		Entry->LastUsed = ++Header->UseCounter;
+
+		Header->NumEntries++;
+		Header->PackSize = RecordOffset + sizeof(RecordHeader) + BytecodeSize;
+		NumInserts++;
+
+		ShouldTrim = (Header->PackSize > SizeBudget);
+	}
+
+	if (ShouldTrim && !IsTrimming.exchange(true))
+	{
+		// Only we start them (under AppendMutex), and IsTrimming was clear, so the last one's finished if there was one
+		if (TrimThread.joinable())
+		{
+			TrimThread.join();
+		}
+
+		// Trim down past the budget, so we aren't rewriting the pack on every insert once it's full
+		TrimThread = std::thread([this]() {
+			TrimToSize(SizeBudget / 4 * 3);
+			IsTrimming.store(false);
+		});
+	}
+}
+
+ShaderBlobCacheIndexEntry* ShaderBlobCache::FindIndexSlot(const ShaderBlobCacheKey& Key)
+{
+	ShaderBlobCacheIndexHeader* Header = GetIndexHeader();
+	ShaderBlobCacheIndexEntry* Entries = GetIndexEntries();
+
+	uint32 Hash = 0;
+	memcpy(&Hash, Key.Digest, sizeof(Hash));
+
+	// We keep it at most half full, so this always finds either the key or an empty slot
+	uint32 Mask = Header->Capacity - 1;
+	for (uint32 Slot = Hash & Mask; ; Slot = (Slot + 1) & Mask)
+	{
+		if (!Entries[Slot].IsUsed || AreShaderBlobCacheKeysEqual(Entries[Slot].Key, Key))
+		{
+			return &Entries[Slot];
+		}
+	}
+}
+
+bool ShaderBlobCache::ResetIndex(uint32 Capacity)
+{
+	uint64 NeededSize = sizeof(ShaderBlobCacheIndexHeader) + (uint64)Capacity * sizeof(ShaderBlobCacheIndexEntry);
+	if (IndexFile.Size < NeededSize)
+	{
+		IndexFile.Close();
+		if (!IndexFile.Open(IndexFilename.c_str(), NeededSize))
+		{
+			LOG("Could not grow shader blob cache index '%s'", IndexFilename.c_str());
+			return false;
+		}
+	}
+
+	memset(IndexFile.Data, 0, (size_t)NeededSize);
+
+	ShaderBlobCacheIndexHeader* Header = GetIndexHeader();
+	Header->Magic = SHADER_BLOB_CACHE_INDEX_MAGIC;
+	Header->Version = SHADER_BLOB_CACHE_VERSION;
+	Header->Capacity = Capacity;
+
+	return true;
+}
+
+bool ShaderBlobCache::ReserveIndexEntry()
+{
+	ShaderBlobCacheIndexHeader* Header = GetIndexHeader();
+	if ((Header->NumEntries + 1) * 2 <= Header->Capacity)
+	{
+		return true;
+	}
+
+	std::vector<ShaderBlobCacheIndexEntry> OldEntries;
+	OldEntries.reserve(Header->NumEntries);
+	for (uint32 i = 0; i < Header->Capacity; i++)
+	{
+		if (GetIndexEntries()[i].IsUsed)
+		{
+			OldEntries.push_back(GetIndexEntries()[i]);
+		}
+	}
+
+	ShaderBlobCacheIndexHeader OldHeader = *Header;
+	if (!ResetIndex(OldHeader.Capacity * 2))
+	{
+		// The old mapping's gone by now, so there's nothing to fall back on
+		CloseFiles();
+		return false;
+	}
+
+	Header = GetIndexHeader();
+	Header->PackSize = OldHeader.PackSize;
+	Header->UseCounter = OldHeader.UseCounter;
+
+	for (const auto& Entry : OldEntries)
+	{
+		*FindIndexSlot(Entry.Key) = Entry;
+	}
+	Header->NumEntries = (uint32)OldEntries.size();
+
+	return true;
+}
+
+bool ShaderBlobCache::RebuildIndexFromPack()
+{
+	std::vector<ShaderBlobCacheIndexEntry> FoundEntries;
+
+	uint64 PackFileSize = GetShaderBlobCacheFileSize(PackFile);
+	uint64 Offset = 0;
+
+	// Stop at the first thing that doesn't look like a whole record, it's either the end or an append we didn't finish
+	while (Offset + sizeof(ShaderBlobCachePackRecordHeader) <= PackFileSize)
+	{
+		ShaderBlobCachePackRecordHeader RecordHeader;
+		if (!SeekShaderBlobCacheFile(PackFile, Offset) || fread(&RecordHeader, sizeof(RecordHeader), 1, PackFile) != 1)
+		{
+			break;
+		}
+
+		uint64 RecordEnd = Offset + sizeof(RecordHeader) + RecordHeader.BytecodeSize;
+		if (RecordHeader.Magic != SHADER_BLOB_CACHE_PACK_MAGIC || RecordEnd > PackFileSize)
+		{
+			break;
+		}
+
+		ShaderBlobCacheIndexEntry Entry;
+		Entry.Key = RecordHeader.Key;
+		Entry.PackOffset = Offset + sizeof(RecordHeader);
+		Entry.BytecodeSize = RecordHeader.BytecodeSize;
+		Entry.IsUsed = 1;
+
+		// We don't know when they were last used, but later in the pack is at least later to be inserted
+		Entry.LastUsed = FoundEntries.size() + 1;
+
+		FoundEntries.push_back(Entry);
+		Offset = RecordEnd;
+	}
+
+	uint32 Capacity = SHADER_BLOB_CACHE_INITIAL_CAPACITY;
+	while (Capacity < FoundEntries.size() * 2)
+	{
+		Capacity *= 2;
+	}
+
+	if (!ResetIndex(Capacity))
+	{
+		return false;
+	}
+
+	ShaderBlobCacheIndexHeader* Header = GetIndexHeader();
+	for (const auto& Entry : FoundEntries)
+	{
+		// The same key could be in there twice if the index got lost after it was inserted, just keep the first one
+		ShaderBlobCacheIndexEntry* Slot = FindIndexSlot(Entry.Key);
+		if (!Slot->IsUsed)
+		{
+			*Slot = Entry;
+			Header->NumEntries++;
+		}
+	}
+
+	Header->PackSize = Offset;
+	Header->UseCounter = FoundEntries.size();
+
+	if (FoundEntries.size() > 0)
+	{
+		LOG("Rebuilt shader blob cache index from the pack, found %d blobs", (int32)FoundEntries.size());
+	}
+
+	return true;
+}
+
+void ShaderBlobCache::TrimToSize(uint64 TargetSize)
+{
+	// Keeps appends out until we're done, lookups carry on with the old pack
+	std::lock_guard<std::mutex> AppendLock(AppendMutex);
+
+	std::vector<ShaderBlobCacheIndexEntry> Entries;
+	std::shared_ptr<ShaderBlobCachePackReader> OldPackReader;
+	uint32 Capacity = 0;
+
+	{
+		std::lock_guard<std::mutex> Lock(CacheMutex);
+
+		if (!IsOpen())
+		{
+			return;
+		}
+
+		ShaderBlobCacheIndexHeader* Header = GetIndexHeader();
+		Entries.reserve(Header->NumEntries);
+		for (uint32 i = 0; i < Header->Capacity; i++)
+		{
+			if (GetIndexEntries()[i].IsUsed)
+			{
+				Entries.push_back(GetIndexEntries()[i]);
+			}
+		}
+
+		OldPackReader = PackReader;
+		Capacity = Header->Capacity;
+	}
+
+	std::sort(Entries.begin(), Entries.end(), [](const ShaderBlobCacheIndexEntry& A, const ShaderBlobCacheIndexEntry& B) {
+		return A.LastUsed > B.LastUsed;
+	});
+
+	// Most recently used first, until we run out of room
+	uint64 KeptSize = 0;
+	size_t NumKept = 0;
+	while (NumKept < Entries.size())
+	{
+		uint64 RecordSize = sizeof(ShaderBlobCachePackRecordHeader) + Entries[NumKept].BytecodeSize;
+		if (KeptSize + RecordSize > TargetSize)
+		{
+			break;
+		}
+
+		KeptSize += RecordSize;
+		NumKept++;
+	}
+
+	Entries.resize(NumKept);
+
+	// Write the new pack off to the side, and only swap it in once it's all there
+	std::string NewPackFilename = PackFilename + ".tmp";
+	FILE* NewPackFile = nullptr;
+	fopen_s(&NewPackFile, NewPackFilename.c_str(), "wb");
+	if (NewPackFile == nullptr)
+	{
+		LOG("Could not open '%s' to trim the shader blob cache", NewPackFilename.c_str());
+		return;
+	}
+
+	std::vector<byte> RecordData;
+	uint64 NewPackSize = 0;
+	bool CopySucceeded = true;
+	for (auto& Entry : Entries)
+	{
+		uint32 RecordSize = sizeof(ShaderBlobCachePackRecordHeader) + Entry.BytecodeSize;
+		RecordData.resize(RecordSize);
+
+		CopySucceeded = OldPackReader->Read(Entry.PackOffset - sizeof(ShaderBlobCachePackRecordHeader), RecordData.data(), RecordSize)
+			&& fwrite(RecordData.data(), 1, RecordData.size(), NewPackFile) == RecordData.size();
+
+		if (!CopySucceeded)
+		{
+			break;
+		}
+
+		Entry.PackOffset = NewPackSize + sizeof(ShaderBlobCachePackRecordHeader);
+		NewPackSize += RecordSize;
+	}
+
+	fclose(NewPackFile);
+
+	if (!CopySucceeded)
+	{
+		LOG("Could not trim the shader blob cache, leaving it as is");
+		remove(NewPackFilename.c_str());
+		return;
+	}
+
+	// Lookups still have the old pack open, they keep reading it until we swap the index over.
+	// If we die between this and the index, the index won't match on the next Open and gets rebuilt
+	fclose(PackFile);
+	PackFile = nullptr;
+
+	std::shared_ptr<ShaderBlobCachePackReader> NewPackReader = std::make_shared<ShaderBlobCachePackReader>();
+	bool SwapSucceeded = ReplaceShaderBlobCacheFile(NewPackFilename.c_str(), PackFilename.c_str());
+	if (SwapSucceeded)
+	{
+		PackFile = OpenShaderBlobCachePackForAppend(PackFilename.c_str(), "r+b");
+		SwapSucceeded = (PackFile != nullptr && NewPackReader->Open(PackFilename.c_str()));
+	}
+
+	std::lock_guard<std::mutex> Lock(CacheMutex);
+
+	if (!SwapSucceeded)
+	{
+		LOG("Could not swap in the trimmed shader blob cache pack '%s'", PackFilename.c_str());
+		CloseFiles();
+		return;
+	}
+
+	// Lookups could have used them while we were copying
+	for (auto& Entry : Entries)
+	{
+		Entry.LastUsed = FindIndexSlot(Entry.Key)->LastUsed;
+	}
+
+	uint64 UseCounter = GetIndexHeader()->UseCounter;
+	if (!ResetIndex(Capacity))
+	{
+		CloseFiles();
+		return;
+	}
+
+	ShaderBlobCacheIndexHeader* Header = GetIndexHeader();
+	for (const auto& Entry : Entries)
+	{
+		*FindIndexSlot(Entry.Key) = Entry;
+	}
+
+	Header->NumEntries = (uint32)Entries.size();
+	Header->PackSize = NewPackSize;
+	Header->UseCounter = UseCounter;
+
+	PackReader = NewPackReader;
+
+	NumTrims++;
+	LOG("Trimmed shader blob cache down to %d blobs (%llu bytes)", (int32)Entries.size(), NewPackSize);
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include "basics.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Persistent cache of compiled shader bytecode, so replaying a seed (or re-running a batch of them) doesn't have to
+// go through D3DCompile again. Keyed by a hash of everything that goes into the compile: the source, entry point,
+// target and compiler flags.
+//
+// On disk it's two files in one directory:
+//  - the pack, which is append-only: each record is a ShaderBlobCachePackRecordHeader followed by the bytecode
+//  - the index, an open-addressing hash table of ShaderBlobCacheIndexEntry that we keep memory mapped, so lookups
+//    and the LRU bookkeeping on a hit don't do any file I/O
+//
+// The pack is written before the index, so if we die in between the record just gets overwritten next time.
+// If the index is missing or doesn't match the pack, it's rebuilt by scanning the pack.
+//
+// Thread safe, but only one process should have a given directory open at a time. CacheMutex is only held while looking
+// at/changing the index: a lookup reads its blob after letting go of it, since records in the pack never change once
+// they're written. Appends take AppendMutex instead, and when the pack's over budget it's trimmed on TrimThread, which
+// writes a trimmed copy and swaps it in. Lookups carry on against the old pack meanwhile, and inserts are skipped
+
+#define SHADER_BLOB_CACHE_KEY_SIZE 16
+
+struct ShaderBlobCacheKey
+{
+	byte Digest[SHADER_BLOB_CACHE_KEY_SIZE] = {};
+};
+
+ShaderBlobCacheKey ComputeShaderBlobCacheKey(const char* Source, uint32 SourceLength, const char* EntryPoint, const char* Target, uint32 CompilerFlags);
+
+struct ShaderBlobCachePackRecordHeader
+{
+	uint32 Magic = 0;
+	uint32 BytecodeSize = 0;
+	ShaderBlobCacheKey Key;
+};
+
+struct ShaderBlobCacheIndexHeader
+{
+	uint32 Magic = 0;
+	uint32 Version = 0;
+
+	// Power of two
+	uint32 Capacity = 0;
+	uint32 NumEntries = 0;
+
+	// How much of the pack is valid, anything after this is from an append that didn't make it into the index
+	uint64 PackSize = 0;
+
+	// Bumped on every hit/insert, an entry's LastUsed is the value it had at the time
+	uint64 UseCounter = 0;
+};
+
+struct ShaderBlobCacheIndexEntry
+{
+	ShaderBlobCacheKey Key;
+
+	// Where the bytecode is in the pack (after the record header)
+	uint64 PackOffset = 0;
+	uint32 BytecodeSize = 0;
+	uint32 IsUsed = 0;
+
+	uint64 LastUsed = 0;
+};
+
+// Positional reads of the pack, so any number of threads can read it at once (and while it's being appended to).
+// A trim swaps in a new one, and lookups that are still reading from the old one keep it alive until they're done
+struct ShaderBlobCachePackReader
+{
+#if defined(_WIN32)
+	void* FileHandle = nullptr;
+#else
+	int FileDescriptor = -1;
+#endif
+
+	~ShaderBlobCachePackReader()
+	{
+		Close();
+	}
+
+	bool Open(const char* Filename);
+	void Close();
+
+	// False if it couldn't read all of it
+	bool Read(uint64 Offset, void* OutData, uint32 Size) const;
+};
+
+// A read/write memory mapping of a whole file
+struct ShaderBlobCacheMappedFile
+{
+	byte* Data = nullptr;
+	uint64 Size = 0;
+
+#if defined(_WIN32)
+	void* FileHandle = nullptr;
+	void* MappingHandle = nullptr;
+#else
+	int FileDescriptor = -1;
+#endif
+
+	// Creates the file if it doesn't exist, and grows it to at least MinSize
+	bool Open(const char* Filename, uint64 MinSize);
+	void Close();
+};
+
+struct ShaderBlobCache
+{
+	std::string PackFilename;
+	std::string IndexFilename;
+
+	// Once the pack is bigger than this, the least recently used blobs get thrown out until it's down to 3/4 of it
+	uint64 SizeBudget = 0;
+
+	// Only for appending, under AppendMutex
+	FILE* PackFile = nullptr;
+
+	// Swapped out under CacheMutex, lookups take a reference to it and then read without the lock
+	std::shared_ptr<ShaderBlobCachePackReader> PackReader;
+
+	ShaderBlobCacheMappedFile IndexFile;
+
+	std::mutex CacheMutex;
+
+	// Held for the whole of an append, and while a trim copies the pack. If both are needed, this one's taken first
+	std::mutex AppendMutex;
+
+	std::thread TrimThread;
+	std::atomic<bool> IsTrimming;
+
+	// Just for logging
+	std::atomic<int64> NumHits;
+	std::atomic<int64> NumMisses;
+	std::atomic<int64> NumInserts;
+	std::atomic<int64> NumTrims;
+
+	ShaderBlobCache()
+	{
+		IsTrimming.store(false);
+		NumHits.store(0);
+		NumMisses.store(0);
+		NumInserts.store(0);
+		NumTrims.store(0);
+	}
+
+	~ShaderBlobCache();
+
+	// Creates the directory and files if needed. Returns false if they couldn't be opened, in which case the cache is left closed
+	bool Open(const char* Directory, uint64 InSizeBudget);
+
+	// Waits for a trim if there's one going. Nobody else can be using the cache by now
+	void Close();
+
+	// Only safe to call without CacheMutex when nobody else is using the cache
+	bool IsOpen() const { return PackReader != nullptr; }
+
+	// Returns false on a miss
+	bool Lookup(const ShaderBlobCacheKey& Key, std::vector<byte>* OutBytecode);
+
+	// Does nothing if the key's already in there, or if we're in the middle of trimming
+	void Insert(const ShaderBlobCacheKey& Key, const void* Bytecode, uint32 BytecodeSize);
+
+	// Rewrites the pack with only the most recently used blobs that fit in TargetSize, and swaps it in.
+	// Takes the locks itself, only holding CacheMutex to look at the index at the start and to swap at the end
+	void TrimToSize(uint64 TargetSize);
+
+	// The rest are internal, and expect CacheMutex to be held (or for us to not be shared yet)
+
+	// Closes everything without waiting for TrimThread. Needs AppendMutex held too
+	void CloseFiles();
+
+	ShaderBlobCacheIndexHeader* GetIndexHeader() { return (ShaderBlobCacheIndexHeader*)IndexFile.Data; }
+	ShaderBlobCacheIndexEntry* GetIndexEntries() { return (ShaderBlobCacheIndexEntry*)(IndexFile.Data + sizeof(ShaderBlobCacheIndexHeader)); }
+
+	// Either the entry with that key, or the empty slot it would go in
+	ShaderBlobCacheIndexEntry* FindIndexSlot(const ShaderBlobCacheKey& Key);
+
+	// Remaps the index with room for Capacity entries, emptied out
+	bool ResetIndex(uint32 Capacity);
+
+	// Makes sure there's room for one more entry, rehashing into a bigger table if not
+	bool ReserveIndexEntry();
+
+	// Throws away the index and builds a new one from the records in the pack
+	bool RebuildIndexFromPack();
+};
@@ -0,0 +1,472 @@
+#include "shader_case_filter.h"
+
+#include "fuzz_shader_ast.h"
+#include "dxbc_view.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include <vector>
+
+#define SHADER_CASE_FILTER_MAGIC DXBC_FOURCC('S', 'C', 'F', 'L')
+// Bumped whenever what goes into a hash changes, since the old hashes won't match anything any more
+#define SHADER_CASE_FILTER_VERSION 2
+
+// Not cryptographic, just needs to mix well enough that structurally different cases don't collide (in 64 bits)
+struct ShaderCaseHasher
+{
+	uint64 State = 0;
+
+	void Add(uint64 Value)
+	{
+		State ^= Value * 0x9E3779B97F4A7C15ULL;
+		State = ((State << 31) | (State >> 33)) * 0xC2B2AE3D27D4EB4FULL;
+	}
+
+	void AddString(const char* Text)
+	{
+		uint64 Length = 0;
+		for (; *Text != '\0'; Text++, Length++)
+		{
+			Add((byte)*Text);
+		}
+		Add(Length);
+	}
+
+	void AddBytes(const byte* Data, uint32 Size)
+	{
+		uint32 i = 0;
+		for (; i + 8 <= Size; i += 8)
+		{
+			uint64 Value = 0;
+			memcpy(&Value, Data + i, sizeof(Value));
+			Add(Value);
+		}
+
+		uint64 Tail = 0;
+		memcpy(&Tail, Data + i, Size - i);
+		Add(Tail);
+		Add(Size);
+	}
+
+	uint64 Finish() const
+	{
+		// fmix64 from MurmurHash3
+		uint64 Hash = State;
+		Hash ^= Hash >> 33;
+		Hash *= 0xFF51AFD7ED558CCDULL;
+		Hash ^= Hash >> 33;
+		Hash *= 0xC4CEB9FE1A85EC53ULL;
+		Hash ^= Hash >> 33;
+		return Hash;
+	}
+};
+
+// Generated names ("tempvar_123") are replaced by the order they're first seen in, so two cases that only differ
+// in their names hash the same. Everything else about a symbol (builtin func names, "input." etc. on derived names) counts
+struct ShaderASTStructuralHasher
+{
+	ShaderCaseHasher Hasher;
+	const FuzzShaderSymbolTable* Symbols = nullptr;
+
+	// What each symbol hashes to, indexed by symbol. 0 if we haven't seen it yet this case (so it gets worked out once, not per use)
+	std::vector<uint64> SymbolValues;
+	int32 NumCanonicalNames = 0;
+
+	uint64 GetSymbolValue(FuzzShaderSymbol Symbol)
+	{
+		if (Symbol == InvalidShaderSymbol || Symbol >= Symbols->Symbols.size())
+		{
+			return 0xFFFFFFFF;
+		}
+
+		if (SymbolValues[Symbol] != 0)
+		{
+			return SymbolValues[Symbol];
+		}
+
+		const FuzzShaderSymbolTable::SymbolEntry& Entry = Symbols->Symbols[Symbol];
+
+		ShaderCaseHasher SymbolHasher;
+		SymbolHasher.AddString(Entry.Prefix);
+		if (Entry.Base != InvalidShaderSymbol)
+		{
+			SymbolHasher.Add(1);
+			SymbolHasher.Add(GetSymbolValue(Entry.Base));
+			SymbolHasher.AddString(Entry.Suffix);
+			for (int32 i = 0; i < Entry.NumberCount; i++)
+			{
+				SymbolHasher.Add((uint32)Entry.Numbers[i]);
+			}
+		}
+		else if (Entry.NumberCount == 0)
+		{
+			SymbolHasher.Add(2);
+		}
+		else
+		{
+			SymbolHasher.Add(3);
+			SymbolHasher.Add(NumCanonicalNames);
+			NumCanonicalNames++;
+		}
+
+		// Never 0, since that means we haven't worked it out yet
+		SymbolValues[Symbol] = SymbolHasher.Finish() | 1;
+		return SymbolValues[Symbol];
+	}
+
+	void AddSymbol(FuzzShaderSymbol Symbol)
+	{
+		Hasher.Add(GetSymbolValue(Symbol));
+	}
+
+	void AddSemanticVars(const std::vector<FuzzShaderSemanticVar>& Vars)
+	{
+		Hasher.Add(Vars.size());
+		for (const auto& Var : Vars)
+		{
+			Hasher.Add((uint32)Var.Semantic);
+			Hasher.Add((uint32)Var.SemanticIdx);
+			Hasher.Add((uint32)Var.ParamIdx);
+			AddSymbol(Var.VarName);
+		}
+	}
+
+	void AddNode(const FuzzShaderASTNode* Node)
+	{
+		if (Node == nullptr)
+		{
+			Hasher.Add(0xFF);
+			return;
+		}
+
+		Hasher.Add((uint32)Node->Type);
+
+		if (Node->Type == FuzzShaderASTNode::NodeType::Assignment)
+		{
+			auto* Assnmt = static_cast<const FuzzShaderAssignment*>(Node);
+			AddSymbol(Assnmt->VariableName);
+			Hasher.Add(Assnmt->IsPredeclared ? 1 : 0);
+			AddNode(Assnmt->Value);
+		}
+		else if (Node->Type == FuzzShaderASTNode::NodeType::BinaryOperator)
+		{
+			auto* Bin = static_cast<const FuzzShaderBinaryOperator*>(Node);
+			Hasher.Add((uint32)Bin->Op);
+			AddNode(Bin->LHS);
+			AddNode(Bin->RHS);
+		}
+		else if (Node->Type == FuzzShaderASTNode::NodeType::TextureAccess)
+		{
+			auto* Tex = static_cast<const FuzzShaderTextureAccess*>(Node);
+			AddSymbol(Tex->TextureName);
+			AddSymbol(Tex->SamplerName);
+			AddNode(Tex->UV);
+		}
+		else if (Node->Type == FuzzShaderASTNode::NodeType::ReadVariable)
+		{
+			AddSymbol(static_cast<const FuzzShaderReadVariable*>(Node)->VariableName);
+		}
+		else if (Node->Type == FuzzShaderASTNode::NodeType::Literal)
+		{
+			auto* Lit = static_cast<const FuzzShaderLiteral*>(Node);
+			for (int32 i = 0; i < 4; i++)
+			{
+				uint32 Bits = 0;
+				memcpy(&Bits, &Lit->Values[i], sizeof(Bits));
+				Hasher.Add(Bits);
+			}
+		}
+		else if (Node->Type == FuzzShaderASTNode::NodeType::FuncCall)
+		{
+			auto* FuncCall = static_cast<const FuzzShaderFuncCall*>(Node);
+			AddSymbol(FuncCall->FuncName);
+			Hasher.Add((uint32)FuncCall->OutputSize);
+			Hasher.Add((uint32)FuncCall->Arguments.Count);
+			for (auto Arg : FuncCall->Arguments)
+			{
+				AddNode(Arg);
+			}
+		}
+		else if (Node->Type == FuzzShaderASTNode::NodeType::StatementBlock)
+		{
+			auto* Block = static_cast<const FuzzShaderStatementBlock*>(Node);
+			Hasher.Add((uint32)Block->Statements.Count);
+			for (auto Stmt : Block->Statements)
+			{
+				AddNode(Stmt);
+			}
+		}
+	}
+
+	void AddShader(const FuzzShaderAST* Shader)
+	{
+		Hasher.Add((uint32)Shader->Type);
+
+		AddSemanticVars(Shader->IAVars);
+		AddSemanticVars(Shader->InterStageVars);
+
+		Hasher.Add(Shader->RootConstants.size());
+		for (const auto& RootConstant : Shader->RootConstants)
+		{
+			Hasher.Add((uint32)RootConstant.ConstantCount);
+			Hasher.Add((uint32)RootConstant.SlotIndex);
+			AddSymbol(RootConstant.VarName);
+		}
+
+		Hasher.Add(Shader->RootCBVs.size());
+		for (const auto& RootCBV : Shader->RootCBVs)
+		{
+			Hasher.Add((uint32)RootCBV.ConstantCount);
+			Hasher.Add((uint32)RootCBV.SlotIndex);
+			AddSymbol(RootCBV.VarName);
+		}
+
+		Hasher.Add(Shader->BoundTextures.size());
+		for (const auto& TextureBind : Shader->BoundTextures)
+		{
+			Hasher.Add((uint32)TextureBind.SlotIndex);
+			AddSymbol(TextureBind.ResourceName);
+			AddSymbol(TextureBind.SamplerName);
+		}
+
+		AddNode(Shader->RootASTNode);
+	}
+};
+
+uint64 ComputeShaderASTPairStructuralHash(const FuzzShaderAST* VertexShader, const FuzzShaderAST* PixelShader, uint64 Seed)
+{
+	ASSERT(VertexShader->Symbols == PixelShader->Symbols);
+
+	// Kept around so SymbolValues doesn't get reallocated every case
+	static thread_local ShaderASTStructuralHasher StructuralHasher;
+	StructuralHasher.Hasher.State = Seed;
+	StructuralHasher.Symbols = VertexShader->Symbols;
+	StructuralHasher.SymbolValues.assign(VertexShader->Symbols->Symbols.size(), 0);
+	StructuralHasher.NumCanonicalNames = 0;
+
+	// Both together, since the inter-stage vars are shared
+	StructuralHasher.AddShader(VertexShader);
+	StructuralHasher.AddShader(PixelShader);
+
+	return StructuralHasher.Hasher.Finish();
+}
+
+uint64 ComputeDXBCShaderCodeHash(const void* Bytecode, uint32 BytecodeSize, uint64 Seed)
+{
+	ShaderCaseHasher Hasher;
+	Hasher.State = Seed;
+
+	// The signatures count as well as the code, since they change how the stages link up (and what the IA feeds in).
+	// The rest of the container (checksum, RDEF names, STAT) can differ for the same code
+	const DxbcChunkKind HashedChunks[] = { DxbcChunkKind::ISGN, DxbcChunkKind::OSGN, DxbcChunkKind::SHEX };
+
+	DxbcView View;
+	if (View.Init(Bytecode, BytecodeSize) && View.GetChunk(DxbcChunkKind::SHEX).IsValid())
+	{
+		for (DxbcChunkKind Kind : HashedChunks)
+		{
+			// Sizes go in too, so bytes can't move from the end of one chunk to the start of the next. A missing one is just empty
+			DxbcChunk Chunk = View.GetChunk(Kind);
+			Hasher.Add(Chunk.Size);
+			if (Chunk.IsValid())
+			{
+				Hasher.AddBytes(Chunk.Data, Chunk.Size);
+			}
+		}
+	}
+	else
+	{
+		Hasher.AddBytes((const byte*)Bytecode, BytecodeSize);
+	}
+
+	return Hasher.Finish();
+}
+
+struct ShaderCaseFilterFileHeader
+{
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	int32 BitsPerHash = 0;
+	uint32 Padding = 0;
+	uint64 NumBlocks = 0;
+};
+
+ShaderCaseFilter::ShaderCaseFilter()
+{
+	NumCasesChecked = 0;
+	NumCasesSkipped = 0;
+	NumCasesTimed = 0;
+	TotalCaseMicroseconds = 0;
+}
+
+ShaderCaseFilter::~ShaderCaseFilter()
+{
+	delete[] Words;
+}
+
+void ShaderCaseFilter::Init(int64 ExpectedNumHashes, double FalsePositiveRate)
+{
+	ASSERT(ExpectedNumHashes > 0);
+	ASSERT(FalsePositiveRate > 0.0 && FalsePositiveRate < 1.0);
+
+	// The usual Bloom filter sizing
+	double BitsPerEntry = -log(FalsePositiveRate) / (log(2.0) * log(2.0));
+	BitsPerHash = (int32)(BitsPerEntry * log(2.0) + 0.5);
+	BitsPerHash = (BitsPerHash < 1 ? 1 : (BitsPerHash > 16 ? 16 : BitsPerHash));
+
+	// Plus 20%, since keeping each hash in one block costs a bit in false positives
+	const uint64 BitsPerBlock = WordsPerBlock * 64;
+	NumBlocks = (uint64)(ExpectedNumHashes * BitsPerEntry * 1.2 / BitsPerBlock) + 1;
+
+	delete[] Words;
+	Words = new std::atomic<uint64>[NumBlocks * WordsPerBlock];
+	for (uint64 i = 0; i < NumBlocks * WordsPerBlock; i++)
+	{
+		Words[i] = 0;
+	}
+}
+
+bool ShaderCaseFilter::Load(const char* Filename)
+{
+	FILE* File = nullptr;
+	fopen_s(&File, Filename, "rb");
+	if (File == nullptr)
+	{
+		return false;
+	}
+
+	ShaderCaseFilterFileHeader Header;
+	if (fread(&Header, sizeof(Header), 1, File) != 1 || Header.Magic != SHADER_CASE_FILTER_MAGIC || Header.Version != SHADER_CASE_FILTER_VERSION
+		|| Header.BitsPerHash < 1 || Header.BitsPerHash > 16 || Header.NumBlocks == 0 || Header.NumBlocks > (1ull << 32))
+	{
+		LOG("Shader case filter '%s' isn't one we can read, ignoring it", Filename);
+		fclose(File);
+		return false;
+	}
+
+	const uint64 NumWords = Header.NumBlocks * WordsPerBlock;
+	std::atomic<uint64>* NewWords = new std::atomic<uint64>[NumWords];
+
+	uint64 Chunk[1024];
+	uint64 WordsRead = 0;
+	while (WordsRead < NumWords)
+	{
+		uint64 ChunkSize = (NumWords - WordsRead < ARRAY_COUNTOF(Chunk) ? NumWords - WordsRead : ARRAY_COUNTOF(Chunk));
+		if (fread(Chunk, sizeof(uint64), (size_t)ChunkSize, File) != ChunkSize)
+		{
+			break;
+		}
+
+		for (uint64 i = 0; i < ChunkSize; i++)
+		{
+			NewWords[WordsRead + i] = Chunk[i];
+		}
+		WordsRead += ChunkSize;
+	}
+
+	fclose(File);
+
+	if (WordsRead != NumWords)
+	{
+		LOG("Shader case filter '%s' is truncated, ignoring it", Filename);
+		delete[] NewWords;
+		return false;
+	}
+
+	delete[] Words;
+	Words = NewWords;
+	NumBlocks = Header.NumBlocks;
+	BitsPerHash = Header.BitsPerHash;
+
+	return true;
+}
+
+bool ShaderCaseFilter::Save(const char* Filename) const
+{
+	ASSERT(IsInitialized());
+
+	FILE* File = nullptr;
+	fopen_s(&File, Filename, "wb");
+	if (File == nullptr)
+	{
+		LOG("Could not open shader case filter '%s' for writing", Filename);
+		return false;
+	}
+
+	ShaderCaseFilterFileHeader Header;
+	Header.Magic = SHADER_CASE_FILTER_MAGIC;
+	Header.Version = SHADER_CASE_FILTER_VERSION;
+	Header.BitsPerHash = BitsPerHash;
+	Header.NumBlocks = NumBlocks;
+
+	bool Succeeded = (fwrite(&Header, sizeof(Header), 1, File) == 1);
+
+	const uint64 NumWords = NumBlocks * WordsPerBlock;
+	uint64 Chunk[1024];
+	for (uint64 WordsWritten = 0; Succeeded && WordsWritten < NumWords; WordsWritten += ARRAY_COUNTOF(Chunk))
+	{
+		uint64 ChunkSize = (NumWords - WordsWritten < ARRAY_COUNTOF(Chunk) ? NumWords - WordsWritten : ARRAY_COUNTOF(Chunk));
+		for (uint64 i = 0; i < ChunkSize; i++)
+		{
+			Chunk[i] = Words[WordsWritten + i].load(std::memory_order_relaxed);
+		}
+
+		Succeeded = (fwrite(Chunk, sizeof(uint64), (size_t)ChunkSize, File) == ChunkSize);
+	}
+
+	fclose(File);
+
+	if (!Succeeded)
+	{
+		LOG("Could not write shader case filter '%s'", Filename);
+	}
+
+	return Succeeded;
+}
+
+bool ShaderCaseFilter::TestAndInsert(uint64 Hash)
+{
+	ASSERT(IsInitialized());
+
+	NumCasesChecked++;
+
+	// Top half picks the block, and the bits in it come from remixing the whole thing
+	std::atomic<uint64>* Block = &Words[((Hash >> 32) * NumBlocks >> 32) * WordsPerBlock];
+
+	uint64 BitMasks[WordsPerBlock] = {};
+	uint64 BitSource = Hash;
+	for (int32 i = 0; i < BitsPerHash; i++)
+	{
+		// splitmix64's output step
+		BitSource += 0x9E3779B97F4A7C15ULL;
+		uint64 Mixed = BitSource;
+		Mixed = (Mixed ^ (Mixed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		Mixed = (Mixed ^ (Mixed >> 27)) * 0x94D049BB133111EBULL;
+		Mixed ^= Mixed >> 31;
+
+		// 512 bits in a block
+		uint32 BitIndex = (uint32)(Mixed >> 55);
+		BitMasks[BitIndex / 64] |= 1ull << (BitIndex % 64);
+	}
+
+	bool WasPresent = true;
+	for (int32 i = 0; i < WordsPerBlock; i++)
+	{
+		if (BitMasks[i] != 0)
+		{
+			uint64 Previous = Block[i].fetch_or(BitMasks[i], std::memory_order_relaxed);
+			if ((Previous & BitMasks[i]) != BitMasks[i])
+			{
+				WasPresent = false;
+			}
+		}
+	}
+
+	if (WasPresent)
+	{
+		NumCasesSkipped++;
+	}
+
+	return WasPresent;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "basics.h"
+
+#include <atomic>
+
+struct FuzzShaderAST;
+
+// Lets us skip a case if we've already run one with the same shaders, which happens a lot more than you'd think
+// (small vertex shaders especially). "The same" is by a structural hash, so for HLSL the generated names don't matter,
+// just what's declared/read where. For DXBC it's the shader code tokens and the signatures
+//
+// Anything else that changes the shaders (e.g. config flags that change the source) should go in Seed
+
+uint64 ComputeShaderASTPairStructuralHash(const FuzzShaderAST* VertexShader, const FuzzShaderAST* PixelShader, uint64 Seed);
+
+// Hashes the ISGN, OSGN and SHEX chunks, or all of it if there's no SHEX (or it doesn't parse)
+uint64 ComputeDXBCShaderCodeHash(const void* Bytecode, uint32 BytecodeSize, uint64 Seed);
+
+// Blocked Bloom filter of the hashes of cases we've run: each hash only touches one cache line's worth of bits.
+// Lock-free, so all the fuzzing threads can share one. Can be saved and loaded, to skip cases from earlier runs too.
+//
+// False positives mean a new case gets skipped now and then, which is the price for it being fixed size
+struct ShaderCaseFilter
+{
+	enum { WordsPerBlock = 8 };
+
+	std::atomic<uint64>* Words = nullptr;
+	uint64 NumBlocks = 0;
+	int32 BitsPerHash = 0;
+
+	// Just for logging
+	std::atomic<int64> NumCasesChecked;
+	std::atomic<int64> NumCasesSkipped;
+
+	// How long the cases we did run took (PSO creation through submitting the draws), to get an idea of what the skips saved
+	std::atomic<int64> NumCasesTimed;
+	std::atomic<int64> TotalCaseMicroseconds;
+
+	ShaderCaseFilter();
+	~ShaderCaseFilter();
+
+	// Sized to hold ExpectedNumHashes at FalsePositiveRate, and empty
+	void Init(int64 ExpectedNumHashes, double FalsePositiveRate);
+
+	// Loads one saved by Save, which keeps the size it was saved with. Returns false (and leaves it alone) if it's not there or doesn't make sense
+	bool Load(const char* Filename);
+	bool Save(const char* Filename) const;
+
+	bool IsInitialized() const { return Words != nullptr; }
+
+	// Adds the hash, and returns true if it was (probably) already in there
+	bool TestAndInsert(uint64 Hash);
+
+	void RecordCaseTime(int64 Microseconds)
+	{
+		NumCasesTimed++;
+		TotalCaseMicroseconds += Microseconds;
+	}
+};
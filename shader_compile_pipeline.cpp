@@ -0,0 +1,151 @@
+#include "shader_compile_pipeline.h"
+
+#include <chrono>
+
+#if defined(_WIN32)
+bool D3DShaderCompiler::CompileShader(const std::string& Source, D3DShaderType Type, const char* EntryPoint, std::vector<byte>* OutBytecode, ShaderMetadata* OutMeta)
+{
+	ID3DBlob* ByteCode = CompileShaderCode(Source.c_str(), Type, "<SHADER_FUZZ_FILE>", EntryPoint, OutMeta);
+	if (ByteCode == nullptr)
+	{
+		return false;
+	}
+
+	const byte* ByteCodeData = (const byte*)ByteCode->GetBufferPointer();
+	OutBytecode->assign(ByteCodeData, ByteCodeData + ByteCode->GetBufferSize());
+	ByteCode->Release();
+
+	return true;
+}
+#endif
+
+bool StubShaderCompiler::CompileShader(const std::string& Source, D3DShaderType Type, const char* EntryPoint, std::vector<byte>* OutBytecode, ShaderMetadata* OutMeta)
+{
+	if (SimulatedLatencyMicroseconds > 0)
+	{
+		std::this_thread::sleep_for(std::chrono::microseconds(SimulatedLatencyMicroseconds));
+	}
+
+	ASSERT(EntryPoint != nullptr);
+
+	// FNV-1a, just so different sources give different "bytecode"
+	uint64 Hash = 0xCBF29CE484222325ULL;
+	for (char C : Source)
+	{
+		Hash = (Hash ^ (byte)C) * 0x100000001B3ULL;
+	}
+
+	// D3DCompile would give different bytecode (or fail) for a different entry point, so it counts too
+	for (const char* C = EntryPoint; *C != '\0'; C++)
+	{
+		Hash = (Hash ^ (byte)*C) * 0x100000001B3ULL;
+	}
+
+	OutBytecode->resize(sizeof(Hash) + sizeof(uint32));
+	uint32 TypeValue = (uint32)Type;
+	memcpy(OutBytecode->data(), &Hash, sizeof(Hash));
+	memcpy(OutBytecode->data() + sizeof(Hash), &TypeValue, sizeof(TypeValue));
+
+	*OutMeta = ShaderMetadata();
+
+	return true;
+}
+
+ShaderCompileWorkerPool::~ShaderCompileWorkerPool()
+{
+	Stop();
+}
+
+void ShaderCompileWorkerPool::Start(ShaderCompilerInterface* InCompiler, int32 ThreadCount, int32 MaxPendingJobs)
+{
+	ASSERT(!IsRunning());
+	ASSERT(InCompiler != nullptr);
+	ASSERT(ThreadCount > 0);
+	ASSERT(MaxPendingJobs > 0);
+
+	Compiler = InCompiler;
+	ShouldStop = false;
+
+	PendingJobs.assign(MaxPendingJobs, nullptr);
+	FirstPendingJob = 0;
+	NumPendingJobs = 0;
+
+	for (int32 ThreadIdx = 0; ThreadIdx < ThreadCount; ThreadIdx++)
+	{
+		Threads.emplace_back([this]() {
+			while (true)
+			{
+				ShaderCompileJob* Job = nullptr;
+
+				{
+					std::unique_lock<std::mutex> Lock(QueueMutex);
+					JobQueued.wait(Lock, [this]() { return ShouldStop || NumPendingJobs > 0; });
+
+					if (NumPendingJobs == 0)
+					{
+						// Only get here if we're stopping and everything's been handed out
+						return;
+					}
+
+					Job = PendingJobs[FirstPendingJob];
+					FirstPendingJob = (FirstPendingJob + 1) % (int32)PendingJobs.size();
+					NumPendingJobs--;
+				}
+				QueueHasRoom.notify_one();
+
+				auto CompileStartTime = std::chrono::steady_clock::now();
+				Job->Succeeded = Compiler->CompileShader(*Job->Source, Job->Type, Job->EntryPoint, &Job->Bytecode, &Job->Meta);
+				Job->CompileMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - CompileStartTime).count();
+
+				{
+					// Set under the lock, otherwise a waiter could check IsDone, miss the notify, and sleep forever.
+					// And notified under it too, since once the waiter sees IsDone it can go ahead and free the job
+					std::lock_guard<std::mutex> Lock(QueueMutex);
+					Job->IsDone.store(true);
+					Job->Finished.notify_one();
+				}
+			}
+		});
+	}
+}
+
+void ShaderCompileWorkerPool::Submit(ShaderCompileJob* Job)
+{
+	ASSERT(IsRunning());
+
+	Job->IsDone.store(false);
+	Job->Succeeded = false;
+
+	{
+		std::unique_lock<std::mutex> Lock(QueueMutex);
+		QueueHasRoom.wait(Lock, [this]() { return NumPendingJobs < (int32)PendingJobs.size(); });
+
+		PendingJobs[(FirstPendingJob + NumPendingJobs) % (int32)PendingJobs.size()] = Job;
+		NumPendingJobs++;
+	}
+	JobQueued.notify_one();
+}
+
+void ShaderCompileWorkerPool::WaitForJob(ShaderCompileJob* Job)
+{
+	// No looking at IsDone before we have the lock: the worker sets it and then notifies under the lock, so seeing it
+	// without the lock could mean returning (and the job getting freed) while the notify's still going
+	std::unique_lock<std::mutex> Lock(QueueMutex);
+	Job->Finished.wait(Lock, [Job]() { return Job->IsDone.load(); });
+}
+
+void ShaderCompileWorkerPool::Stop()
+{
+	{
+		std::lock_guard<std::mutex> Lock(QueueMutex);
+		ShouldStop = true;
+	}
+	JobQueued.notify_all();
+
+	for (auto& Thread : Threads)
+	{
+		Thread.join();
+	}
+
+	Threads.clear();
+}
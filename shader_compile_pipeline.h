@@ -0,0 +1,99 @@
+#pragma once
+
+#include "basics.h"
+
+#include "shader_meta.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Lets the HLSL path compile shaders on a pool of threads while the fuzzing threads get on with generating the next
+// cases and recording commands for the previous ones. Nothing in here touches D3D directly, the compiler is behind
+// an interface so the pool can be run with the stub compiler on machines without d3dcompiler
+
+struct ShaderCompilerInterface
+{
+	virtual ~ShaderCompilerInterface() {}
+
+	// Gets called from several threads at once. Returns false if the shader didn't compile
+	virtual bool CompileShader(const std::string& Source, D3DShaderType Type, const char* EntryPoint, std::vector<byte>* OutBytecode, ShaderMetadata* OutMeta) = 0;
+};
+
+#if defined(_WIN32)
+// D3DCompile + reflection, same as CompileShaderCode (so a failed compile still asserts)
+struct D3DShaderCompiler : ShaderCompilerInterface
+{
+	bool CompileShader(const std::string& Source, D3DShaderType Type, const char* EntryPoint, std::vector<byte>* OutBytecode, ShaderMetadata* OutMeta) override;
+};
+#endif
+
+// Doesn't actually compile anything, the "bytecode" is just a hash of the source and entry point (plus the type),
+// and the metadata is left empty. For exercising the pool/pipeline without a compiler
+struct StubShaderCompiler : ShaderCompilerInterface
+{
+	// Sleeps this long per shader, to pretend to be D3DCompile
+	int32 SimulatedLatencyMicroseconds = 0;
+
+	bool CompileShader(const std::string& Source, D3DShaderType Type, const char* EntryPoint, std::vector<byte>* OutBytecode, ShaderMetadata* OutMeta) override;
+};
+
+struct ShaderCompileJob
+{
+	// The source has to stay alive (and unchanged) until the job is done
+	const std::string* Source = nullptr;
+	D3DShaderType Type = D3DShaderType::Vertex;
+	const char* EntryPoint = "Main";
+
+	// Only valid once IsDone
+	std::vector<byte> Bytecode;
+	ShaderMetadata Meta;
+	bool Succeeded = false;
+
+	// Just how long the compile itself took, not counting time in the queue
+	int64 CompileMicroseconds = 0;
+
+	std::atomic<bool> IsDone;
+
+	// Only whoever's waiting for this job gets woken up for it, instead of every thread waiting on the pool
+	std::condition_variable Finished;
+
+	ShaderCompileJob()
+	{
+		IsDone.store(false);
+	}
+};
+
+struct ShaderCompileWorkerPool
+{
+	ShaderCompilerInterface* Compiler = nullptr;
+	std::vector<std::thread> Threads;
+
+	std::mutex QueueMutex;
+	std::condition_variable JobQueued;
+	std::condition_variable QueueHasRoom;
+	bool ShouldStop = false;
+
+	// Ring buffer of the jobs that haven't been picked up yet, sized in Start. Submit waits while it's full,
+	// so the fuzzing threads can't get further ahead of the compiler than that
+	std::vector<ShaderCompileJob*> PendingJobs;
+	int32 FirstPendingJob = 0;
+	int32 NumPendingJobs = 0;
+
+	~ShaderCompileWorkerPool();
+
+	void Start(ShaderCompilerInterface* InCompiler, int32 ThreadCount, int32 MaxPendingJobs = 64);
+
+	// The job has to stay alive until WaitForJob returns for it. Waits if there's already MaxPendingJobs in the queue
+	void Submit(ShaderCompileJob* Job);
+
+	void WaitForJob(ShaderCompileJob* Job);
+
+	// Waits for the threads, after they've finished off whatever was already submitted
+	void Stop();
+
+	bool IsRunning() const { return Threads.size() > 0; }
+};
@@ -2,6 +2,9 @@
 
 #include "basics.h"
 
+#include "dxbc_reflect.h"
+#include "shader_blob_cache.h"
+
 #include <string.h>
 #include <assert.h>
 
@@ -17,18 +20,66 @@ static const char* ShaderSemanticNames[] = {
 static_assert(ARRAY_COUNTOF(ShaderSemanticNames) == (int32)ShaderSemantic::Count, "sadfassdgf");
 
 
-ShaderSemantic GetSemanticFromSemanticName(const char* Name)
+// Length, first and last character are enough to tell all of the names above apart,
+// so we only need a single strcmp to confirm the match
+#define SEMANTIC_NAME_HASH_TABLE_SIZE 8
+
+static uint32 HashSemanticName(const char* Name, size_t Length)
+{
+	return (uint32)(Length * 4 + (byte)Name[0] + (byte)Name[Length - 1]) & (SEMANTIC_NAME_HASH_TABLE_SIZE - 1);
+}
+
+struct SemanticNameHashTable
 {
-	for (int32 i = 0; i < (int32)ShaderSemantic::Count; i++)
+	int32 Slots[SEMANTIC_NAME_HASH_TABLE_SIZE];
+
+	SemanticNameHashTable()
 	{
-		if (strcmp(Name, ShaderSemanticNames[i]) == 0)
+		for (int32 i = 0; i < SEMANTIC_NAME_HASH_TABLE_SIZE; i++)
 		{
-			return (ShaderSemantic)i;
+			Slots[i] = -1;
 		}
+
+		for (int32 i = 0; i < (int32)ShaderSemantic::Count; i++)
+		{
+			uint32 Slot = HashSemanticName(ShaderSemanticNames[i], strlen(ShaderSemanticNames[i]));
+
+			// If this fires, a new semantic was added and HashSemanticName needs tweaking
+			ASSERT(Slots[Slot] == -1);
+			Slots[Slot] = i;
+		}
+	}
+};
+
+bool TryGetSemanticFromSemanticName(const char* Name, ShaderSemantic* OutSemantic)
+{
+	static const SemanticNameHashTable HashTable;
+
+	size_t Length = strlen(Name);
+	if (Length == 0)
+	{
+		return false;
+	}
+
+	int32 Index = HashTable.Slots[HashSemanticName(Name, Length)];
+	if (Index < 0 || strcmp(Name, ShaderSemanticNames[Index]) != 0)
+	{
+		return false;
 	}
 
-	assert(false);
-	return ShaderSemantic::POSITION;
+	*OutSemantic = (ShaderSemantic)Index;
+	return true;
+}
+
+ShaderSemantic GetSemanticFromSemanticName(const char* Name)
+{
+	ShaderSemantic Semantic = ShaderSemantic::POSITION;
+	if (!TryGetSemanticFromSemanticName(Name, &Semantic))
+	{
+		assert(false);
+	}
+
+	return Semantic;
 }
 
 const char* GetSemanticNameFromSemantic(ShaderSemantic Value)
@@ -36,6 +87,34 @@ const char* GetSemanticNameFromSemantic(ShaderSemantic Value)
 	return ShaderSemanticNames[(int32)Value];
 }
 
+bool AreShaderMetadataEqual(const ShaderMetadata& A, const ShaderMetadata& B)
+{
+	if (A.NumCBVs != B.NumCBVs || A.NumSRVs != B.NumSRVs || A.NumStaticSamplers != B.NumStaticSamplers || A.NumParams != B.NumParams)
+	{
+		return false;
+	}
+
+	for (int32 i = 0; i < A.NumCBVs; i++)
+	{
+		if (A.CBVSizes[i] != B.CBVSizes[i])
+		{
+			return false;
+		}
+	}
+
+	for (int32 i = 0; i < A.NumParams; i++)
+	{
+		const ShaderInputParamMetadata& ParamA = A.InputParamMetadata[i];
+		const ShaderInputParamMetadata& ParamB = B.InputParamMetadata[i];
+		if (ParamA.Semantic != ParamB.Semantic || ParamA.SemanticIndex != ParamB.SemanticIndex || ParamA.ParamIndex != ParamB.ParamIndex)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
 
 const char* GetTargetForShaderType(D3DShaderType Type) {
 	if (Type == D3DShaderType::Vertex) {
@@ -49,6 +128,15 @@ const char* GetTargetForShaderType(D3DShaderType Type) {
 	}
 }
 
+#if defined(_WIN32)
+
+static ShaderBlobCache* GlobalShaderBlobCache = nullptr;
+
+void SetShaderBlobCache(ShaderBlobCache* Cache)
+{
+	GlobalShaderBlobCache = Cache;
+}
+
 void ReflectShaderIntoShaderMetadata(ID3DBlob* ByteCode, ShaderMetadata* OutMetadata)
 {
 	HRESULT hr;
@@ -119,9 +207,36 @@ ID3DBlob* CompileShaderCode(const char* ShaderCode, D3DShaderType ShaderType, co
 	ID3DBlob* ByteCode = nullptr;
 	ID3DBlob* ErrorMsg = nullptr;
 	UINT CompilerFlags = 0;// D3DCOMPILE_DEBUG;
+
+	ShaderBlobCacheKey CacheKey;
+	if (GlobalShaderBlobCache != nullptr)
+	{
+		static thread_local std::vector<byte> CachedByteCode;
+
+		CacheKey = ComputeShaderBlobCacheKey(ShaderCode, (uint32)strlen(ShaderCode), EntryPoint, GetTargetForShaderType(ShaderType), CompilerFlags);
+		if (GlobalShaderBlobCache->Lookup(CacheKey, &CachedByteCode))
+		{
+			HRESULT hr = D3DCreateBlob(CachedByteCode.size(), &ByteCode);
+			ASSERT(SUCCEEDED(hr));
+			memcpy(ByteCode->GetBufferPointer(), CachedByteCode.data(), CachedByteCode.size());
+
+			// Reflection's cheap compared to the compile, so we don't bother caching the metadata
+			bool ReflectSucceeded = ReflectDXBCIntoShaderMetadata(ByteCode->GetBufferPointer(), ByteCode->GetBufferSize(), OutMetadata);
+			ASSERT(ReflectSucceeded);
+
+			return ByteCode;
+		}
+	}
+
 	HRESULT hr = D3DCompile(ShaderCode, strlen(ShaderCode), ShaderSourceName, nullptr, nullptr, EntryPoint, GetTargetForShaderType(ShaderType), CompilerFlags, 0, &ByteCode, &ErrorMsg);
 	if (SUCCEEDED(hr)) {
-		ReflectShaderIntoShaderMetadata(ByteCode, OutMetadata);
+		bool ReflectSucceeded = ReflectDXBCIntoShaderMetadata(ByteCode->GetBufferPointer(), ByteCode->GetBufferSize(), OutMetadata);
+		ASSERT(ReflectSucceeded);
+
+		if (GlobalShaderBlobCache != nullptr)
+		{
+			GlobalShaderBlobCache->Insert(CacheKey, ByteCode->GetBufferPointer(), (uint32)ByteCode->GetBufferSize());
+		}
 
 		return ByteCode;
 	}
@@ -134,3 +249,4 @@ ID3DBlob* CompileShaderCode(const char* ShaderCode, D3DShaderType ShaderType, co
 	}
 }
 
+#endif
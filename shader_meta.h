@@ -1,7 +1,9 @@
 #pragma once
 
+#if defined(_WIN32)
 #include <d3dcompiler.h>
 #include <d3d12.h>
+#endif
 
 #include "basics.h"
 
@@ -33,6 +35,8 @@ enum struct ShaderSemantic
 };
 
 ShaderSemantic GetSemanticFromSemanticName(const char* Name);
+// Same as above, but returns false for names we don't know about instead of asserting
+bool TryGetSemanticFromSemanticName(const char* Name, ShaderSemantic* OutSemantic);
 const char* GetSemanticNameFromSemantic(ShaderSemantic Value);
 
 struct ShaderInputParamMetadata
@@ -55,6 +59,9 @@ struct ShaderMetadata
 	ShaderInputParamMetadata InputParamMetadata[MAX_INPUT_PARAM_COUNT] = {};
 };
 
+// Only compares the parts that are in use (e.g. the first NumParams input params)
+bool AreShaderMetadataEqual(const ShaderMetadata& A, const ShaderMetadata& B);
+
 enum struct D3DShaderType {
 	Vertex,
 	Pixel
@@ -63,5 +70,12 @@ enum struct D3DShaderType {
 const char* GetTargetForShaderType(D3DShaderType Type);
 
 
+#if defined(_WIN32)
+struct ShaderBlobCache;
+
+// If set, CompileShaderCode checks the cache before compiling and adds anything it does compile. Pass nullptr to stop using it
+void SetShaderBlobCache(ShaderBlobCache* Cache);
+
 void ReflectShaderIntoShaderMetadata(ID3DBlob* ByteCode, ShaderMetadata* OutMetadata);
 ID3DBlob* CompileShaderCode(const char* ShaderCode, D3DShaderType ShaderType, const char* ShaderSourceName, const char* EntryPoint, ShaderMetadata* OutMetadata);
+#endif
@@ -0,0 +1,106 @@
+#include "shader_size_controller.h"
+
+#include <math.h>
+
+// How many cases we average over before adjusting the scale
+static const int32 HLSLSizeControllerWindowSize = 32;
+
+// Down to depth 3 and ~10 root statements, below that the shaders are too small to be worth much
+static const double HLSLSizeControllerMinScale = 1.0 / 32.0;
+
+void HLSLSizeController::Init(double InTargetCaseMilliseconds, double InLargeShaderChance)
+{
+	ASSERT(InTargetCaseMilliseconds > 0.0);
+
+	TargetCaseMilliseconds = InTargetCaseMilliseconds;
+	LargeShaderChance = InLargeShaderChance;
+	Scale = 1.0;
+	WindowMilliseconds = 0.0;
+	WindowCaseCount = 0;
+}
+
+bool HLSLSizeController::IsLargeCase(uint64 CaseSeed) const
+{
+	// Mixed (splitmix64's finaliser) since seeds are usually sequential
+	uint64 Mixed = CaseSeed;
+	Mixed = (Mixed ^ (Mixed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	Mixed = (Mixed ^ (Mixed >> 27)) * 0x94D049BB133111EBULL;
+	Mixed ^= Mixed >> 31;
+
+	return (Mixed >> 11) * (1.0 / 9007199254740992.0) < LargeShaderChance;
+}
+
+HLSLSizeParams HLSLSizeController::GetParamsForScale(double InScale)
+{
+	HLSLSizeParams Defaults;
+	HLSLSizeParams Params;
+
+	// Statements scale linearly, but each level of depth can roughly double an expression, so that comes off a level at a time
+	Params.MaxRootStatements = 4 + (int32)((Defaults.MaxRootStatements - 4) * InScale + 0.5);
+	Params.MaxExpressionDepth = Defaults.MaxExpressionDepth + (int32)floor(log2(InScale) + 0.5);
+
+	Params.MaxRootStatements = (Params.MaxRootStatements > Defaults.MaxRootStatements ? Defaults.MaxRootStatements : Params.MaxRootStatements);
+	Params.MaxExpressionDepth = (Params.MaxExpressionDepth < 3 ? 3 : (Params.MaxExpressionDepth > Defaults.MaxExpressionDepth ? Defaults.MaxExpressionDepth : Params.MaxExpressionDepth));
+
+	return Params;
+}
+
+HLSLSizeParams HLSLSizeController::GetParamsForCase(uint64 CaseSeed)
+{
+	if (IsLargeCase(CaseSeed))
+	{
+		return HLSLSizeParams();
+	}
+
+	std::lock_guard<std::mutex> Lock(ControllerMutex);
+	return GetParamsForScale(Scale);
+}
+
+void HLSLSizeController::RecordCase(uint64 CaseSeed, int64 Microseconds)
+{
+	double Milliseconds = Microseconds / 1000.0;
+	bool IsLarge = IsLargeCase(CaseSeed);
+
+	std::lock_guard<std::mutex> Lock(ControllerMutex);
+
+	NumCases++;
+	TotalMilliseconds += Milliseconds;
+
+	// The full size ones would just drag the scale down for everything else
+	if (IsLarge)
+	{
+		NumLargeCases++;
+		return;
+	}
+
+	WindowMilliseconds += Milliseconds;
+	WindowCaseCount++;
+
+	if (WindowCaseCount < HLSLSizeControllerWindowSize)
+	{
+		return;
+	}
+
+	double AverageMilliseconds = WindowMilliseconds / WindowCaseCount;
+	WindowMilliseconds = 0.0;
+	WindowCaseCount = 0;
+
+	// Cost goes roughly with the square of the scale (longer shaders, and deeper expressions in them).
+	// Only moved part of the way each time, since a window of cases is pretty noisy
+	double Adjustment = sqrt(TargetCaseMilliseconds / (AverageMilliseconds > 0.001 ? AverageMilliseconds : 0.001));
+	Adjustment = (Adjustment < 0.5 ? 0.5 : (Adjustment > 1.5 ? 1.5 : Adjustment));
+
+	double NewScale = Scale * Adjustment;
+	NewScale = (NewScale < HLSLSizeControllerMinScale ? HLSLSizeControllerMinScale : (NewScale > 1.0 ? 1.0 : NewScale));
+
+	HLSLSizeParams OldParams = GetParamsForScale(Scale);
+	HLSLSizeParams NewParams = GetParamsForScale(NewScale);
+	Scale = NewScale;
+
+	if (OldParams.MaxRootStatements != NewParams.MaxRootStatements || OldParams.MaxExpressionDepth != NewParams.MaxExpressionDepth)
+	{
+		NumScaleChanges++;
+		LOG("HLSL size controller: %3.2f ms/case over the last %d cases (target %3.2f), now up to %d root statements at depth %d",
+			AverageMilliseconds, HLSLSizeControllerWindowSize, TargetCaseMilliseconds, NewParams.MaxRootStatements, NewParams.MaxExpressionDepth);
+	}
+}
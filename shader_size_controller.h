@@ -0,0 +1,61 @@
+#pragma once
+
+#include "basics.h"
+
+#include <mutex>
+
+// How big the HLSL generator makes things. The defaults are what it's always done
+struct HLSLSizeParams
+{
+	// The root statement count is drawn from [4, 200] either way, and scaled down to [4, MaxRootStatements]
+	int32 MaxRootStatements = 200;
+
+	// How deep an expression can nest
+	int32 MaxExpressionDepth = 8;
+
+	bool IsDefault() const
+	{
+		return MaxRootStatements == HLSLSizeParams().MaxRootStatements && MaxExpressionDepth == HLSLSizeParams().MaxExpressionDepth;
+	}
+};
+
+// Without this, a case's cost varies by orders of magnitude depending on how big its shaders come out, and the odd
+// monster shader holds a thread up for ages. This watches how long cases take (compile, PSO creation and recording/submitting
+// the draws) and scales the shader sizes down when they're over budget, and back up when they're under.
+// A fraction of cases always get the full size, so we still get big shaders, just not so many of them.
+//
+// Picking the params for a case doesn't draw anything from the fuzzer, so the case only depends on its seed and its params.
+// Shared by all the fuzzing threads
+struct HLSLSizeController
+{
+	double TargetCaseMilliseconds = 50.0;
+	double LargeShaderChance = 0.05;
+
+	std::mutex ControllerMutex;
+
+	// Fraction of the default sizes we're using now
+	double Scale = 1.0;
+
+	// Cases since we last adjusted the scale, not counting the full size ones
+	double WindowMilliseconds = 0.0;
+	int32 WindowCaseCount = 0;
+
+	// Just for logging
+	int64 NumCases = 0;
+	int64 NumLargeCases = 0;
+	double TotalMilliseconds = 0.0;
+	int32 NumScaleChanges = 0;
+
+	void Init(double InTargetCaseMilliseconds, double InLargeShaderChance);
+
+	HLSLSizeParams GetParamsForCase(uint64 CaseSeed);
+
+	// Microseconds is everything from generating the shaders to submitting the draws
+	void RecordCase(uint64 CaseSeed, int64 Microseconds);
+
+	// Whether the case gets the full size no matter what
+	bool IsLargeCase(uint64 CaseSeed) const;
+
+	// The params for a given scale (without the large shader chance)
+	static HLSLSizeParams GetParamsForScale(double InScale);
+};
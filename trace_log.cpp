@@ -0,0 +1,326 @@
+#include "trace_log.h"
+
+#if defined(_WIN32)
+#include <Windows.h>
+#endif
+
+#include <algorithm>
+
+TraceLogger* GlobalTraceLogger = nullptr;
+
+void SetTraceLogger(TraceLogger* Logger)
+{
+	GlobalTraceLogger = Logger;
+}
+
+void FlushTraceLogAfterCrash()
+{
+	if (GlobalTraceLogger != nullptr)
+	{
+		GlobalTraceLogger->DrainAfterCrash();
+	}
+}
+
+bool TraceLogRing::Push(const TraceLogRecord& Record)
+{
+	const uint64 Index = WriteIndex.load(std::memory_order_relaxed);
+	if (Index - CachedReadIndex >= Capacity)
+	{
+		CachedReadIndex = ReadIndex.load(std::memory_order_acquire);
+		if (Index - CachedReadIndex >= Capacity)
+		{
+			// Only we write it, so no need for a fetch_add
+			NumDropped.store(NumDropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			return false;
+		}
+	}
+
+	Records[Index % Capacity] = Record;
+	WriteIndex.store(Index + 1, std::memory_order_release);
+	return true;
+}
+
+// Which ring this thread pushes to, and which logger/Start it's from
+struct TraceLogThreadRing
+{
+	TraceLogger* Logger = nullptr;
+	uint32 Generation = 0;
+	TraceLogRing* Ring = nullptr;
+};
+
+static thread_local TraceLogThreadRing ThisThreadRing;
+
+TraceLogRing* TraceLogger::GetRingForThisThread()
+{
+	if (ThisThreadRing.Logger == this && ThisThreadRing.Generation == Generation)
+	{
+		return ThisThreadRing.Ring;
+	}
+
+	TraceLogRing* Ring = new TraceLogRing();
+
+	{
+		std::lock_guard<std::mutex> Lock(RingsMutex);
+		Ring->ThreadIndex = (uint32)Rings.size();
+		Rings.push_back(Ring);
+	}
+
+	ThisThreadRing.Logger = this;
+	ThisThreadRing.Generation = Generation;
+	ThisThreadRing.Ring = Ring;
+
+	return Ring;
+}
+
+void TraceLogger::Push(const TraceLogRecord& Record)
+{
+	if (!bRunning.load(std::memory_order_relaxed))
+	{
+		return;
+	}
+
+	GetRingForThisThread()->Push(Record);
+}
+
+bool TraceLogger::Start(const char* Filename, TraceSeverity InMinSeverity, TraceSeverity InEchoSeverity)
+{
+	ASSERT(!bRunning.load());
+
+	fopen_s(&LogFile, Filename, "wb");
+	if (LogFile == nullptr)
+	{
+		LOG("Could not open trace log '%s'", Filename);
+		return false;
+	}
+
+	MinSeverity.store((int32)InMinSeverity);
+	EchoSeverity = InEchoSeverity;
+	StartTimestamp = GetTraceLogTimestamp();
+	StartTime = std::chrono::steady_clock::now();
+
+	bRunning.store(true);
+	DrainThread = std::thread([this]() {
+		while (bRunning.load())
+		{
+			// Nothing to do: back off a bit, it's fine for the file to be a millisecond or two behind
+			if (Drain() == 0)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+	});
+
+	return true;
+}
+
+void TraceLogger::Stop()
+{
+	if (!bRunning.load())
+	{
+		return;
+	}
+
+	bRunning.store(false);
+	DrainThread.join();
+
+	// Anything that went in after the drain thread's last look
+	Drain();
+
+	if (GlobalTraceLogger == this)
+	{
+		SetTraceLogger(nullptr);
+	}
+
+	fclose(LogFile);
+	LogFile = nullptr;
+
+	// Everything's been written out, and nobody's logging to us any more. Bumping the generation means a thread that
+	// logs to us after the next Start gets a new ring, instead of the one it had
+	{
+		std::lock_guard<std::mutex> Lock(RingsMutex);
+		for (TraceLogRing* Ring : Rings)
+		{
+			delete Ring;
+		}
+		Rings.clear();
+		RingsToDrain.clear();
+		Generation++;
+	}
+}
+
+int32 TraceLogger::Drain()
+{
+	std::lock_guard<std::timed_mutex> DrainLock(DrainMutex);
+
+	DrainBatch.clear();
+	FileText.clear();
+	EchoText.clear();
+
+	{
+		std::lock_guard<std::mutex> Lock(RingsMutex);
+		RingsToDrain = Rings;
+	}
+
+	for (TraceLogRing* Ring : RingsToDrain)
+	{
+		const uint64 ReadIndex = Ring->ReadIndex.load(std::memory_order_relaxed);
+		const uint64 WriteIndex = Ring->WriteIndex.load(std::memory_order_acquire);
+		for (uint64 Index = ReadIndex; Index < WriteIndex; Index++)
+		{
+			DrainBatch.push_back(Ring->Records[Index % TraceLogRing::Capacity]);
+			DrainBatch.back().ThreadIndex = (uint16)Ring->ThreadIndex;
+		}
+
+		Ring->ReadIndex.store(WriteIndex, std::memory_order_release);
+
+		const uint64 NumDropped = Ring->NumDropped.load(std::memory_order_relaxed);
+		if (NumDropped != Ring->NumDroppedReported)
+		{
+			char DroppedLine[128] = {};
+			snprintf(DroppedLine, sizeof(DroppedLine), "[trace log] Thread %u's ring was full, dropped %llu records\n",
+				Ring->ThreadIndex, NumDropped - Ring->NumDroppedReported);
+			FileText += DroppedLine;
+			EchoText += DroppedLine;
+			Ring->NumDroppedReported = NumDropped;
+		}
+	}
+
+	// Each ring is in order already, but this gets them all interleaved the way they happened
+	std::stable_sort(DrainBatch.begin(), DrainBatch.end(), [](const TraceLogRecord& A, const TraceLogRecord& B) {
+		return A.Timestamp < B.Timestamp;
+	});
+
+	static const char* SeverityNames[] = { "Verbose", "Info", "Warning", "Error" };
+
+	double MillisecondsPerTick = 0.0;
+	if (DrainBatch.size() > 0)
+	{
+		const double ElapsedMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - StartTime).count();
+		const uint64 ElapsedTicks = GetTraceLogTimestamp() - StartTimestamp;
+		MillisecondsPerTick = (ElapsedTicks > 0 ? ElapsedMilliseconds / ElapsedTicks : 0.0);
+	}
+
+	for (const TraceLogRecord& Record : DrainBatch)
+	{
+		char Prefix[64] = {};
+		snprintf(Prefix, sizeof(Prefix), "[%10.3f ms][T%02u][%s] ", (Record.Timestamp - StartTimestamp) * MillisecondsPerTick, (uint32)Record.ThreadIndex,
+			SeverityNames[(int32)Record.Site->Severity]);
+
+		const size_t LineStart = FileText.size();
+		FileText += Prefix;
+		FormatTraceLogRecord(Record, &FileText);
+		FileText += '\n';
+
+		if (Record.Site->Severity >= EchoSeverity)
+		{
+			EchoText.append(FileText, LineStart, std::string::npos);
+		}
+	}
+
+	if (FileText.size() > 0)
+	{
+		fwrite(FileText.data(), 1, FileText.size(), LogFile);
+		fflush(LogFile);
+	}
+
+	if (EchoText.size() > 0)
+	{
+		OutputDebugStringA(EchoText.c_str());
+	}
+
+	return (int32)DrainBatch.size();
+}
+
+void TraceLogger::DrainAfterCrash()
+{
+	if (!bRunning.load())
+	{
+		return;
+	}
+
+	// If the drain thread has it, it'll most likely finish (it's not the one that crashed), and then we go again for what's left
+	if (DrainMutex.try_lock_for(std::chrono::milliseconds(200)))
+	{
+		DrainMutex.unlock();
+		Drain();
+	}
+}
+
+void FormatTraceLogRecord(const TraceLogRecord& Record, std::string* Out)
+{
+	const char* Cursor = Record.Site->Format;
+	int32 ArgIndex = 0;
+
+	while (*Cursor != '\0')
+	{
+		if (*Cursor != '%')
+		{
+			const char* LiteralEnd = strchr(Cursor, '%');
+			if (LiteralEnd == nullptr)
+			{
+				LiteralEnd = Cursor + strlen(Cursor);
+			}
+
+			Out->append(Cursor, LiteralEnd - Cursor);
+			Cursor = LiteralEnd;
+			continue;
+		}
+
+		if (Cursor[1] == '%')
+		{
+			*Out += '%';
+			Cursor += 2;
+			continue;
+		}
+
+		// The whole conversion spec (flags, width, precision, length), so snprintf can do the actual formatting
+		char Spec[32] = {};
+		int32 SpecLength = 0;
+		Spec[SpecLength++] = *Cursor++;
+		while (*Cursor != '\0' && strchr("diouxXeEfFgGaAcsp", *Cursor) == nullptr && SpecLength < (int32)sizeof(Spec) - 2)
+		{
+			Spec[SpecLength++] = *Cursor++;
+		}
+
+		if (*Cursor == '\0')
+		{
+			Out->append(Spec);
+			break;
+		}
+
+		Spec[SpecLength++] = *Cursor++;
+
+		if (ArgIndex >= Record.NumArgs)
+		{
+			*Out += "<missing arg>";
+			continue;
+		}
+
+		const uint64 Arg = Record.Args[ArgIndex];
+		char Formatted[512] = {};
+
+		// Passed back as the same type they were given to TRACE_LOG as, so it's the same as if LOG had formatted them
+		switch (Record.ArgTypes[ArgIndex])
+		{
+		case TraceLogArgType::Int32: snprintf(Formatted, sizeof(Formatted), Spec, (int32)Arg); break;
+		case TraceLogArgType::UInt32: snprintf(Formatted, sizeof(Formatted), Spec, (uint32)Arg); break;
+		case TraceLogArgType::Int64: snprintf(Formatted, sizeof(Formatted), Spec, (int64)Arg); break;
+		case TraceLogArgType::UInt64: snprintf(Formatted, sizeof(Formatted), Spec, (uint64)Arg); break;
+		case TraceLogArgType::Double:
+		{
+			double Value = 0.0;
+			memcpy(&Value, &Arg, sizeof(Value));
+			snprintf(Formatted, sizeof(Formatted), Spec, Value);
+		} break;
+		case TraceLogArgType::String:
+		{
+			const char* Value = (const char*)(uintptr_t)Arg;
+			snprintf(Formatted, sizeof(Formatted), Spec, (Value != nullptr ? Value : "(null)"));
+		} break;
+		case TraceLogArgType::Pointer: snprintf(Formatted, sizeof(Formatted), Spec, (const void*)(uintptr_t)Arg); break;
+		}
+
+		*Out += Formatted;
+		ArgIndex++;
+	}
+}
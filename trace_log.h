@@ -0,0 +1,274 @@
+#pragma once
+
+#include "basics.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#if defined(_WIN32)
+#include <intrin.h>
+#include <malloc.h>
+#else
+#include <x86intrin.h>
+#endif
+
+// Logging for the hot paths (like every fuzzing thread logging every seed), where LOG's snprintf + OutputDebugStringA
+// per call adds up, and OutputDebugStringA serialises every thread on the debugger's output.
+//
+// TRACE_LOG doesn't format anything: it copies the args as they are into a fixed size record, with a pointer to its
+// call site (the format string, severity, file/line), and pushes that onto a ring buffer that only its thread writes to.
+// A drain thread pulls the records off every thread's ring, formats them, and writes them to the log file (and to
+// OutputDebugStringA, for the ones at or above the echo severity). If a ring is full the record is dropped and counted,
+// the drain thread says how many went missing, so logging never waits on anything.
+//
+// Because the args aren't formatted until later, %s args have to be strings that stay around (literals, interned names).
+//
+// Without a logger set (see SetTraceLogger), TRACE_LOG is just LOG
+
+enum struct TraceSeverity : uint8
+{
+	Verbose,
+	Info,
+	Warning,
+	Error,
+};
+
+#define TRACE_LOG_MAX_ARGS 5
+
+// One per TRACE_LOG, the record points to it instead of copying the format string
+struct TraceLogSite
+{
+	const char* Format;
+	TraceSeverity Severity;
+	const char* File;
+	int32 Line;
+};
+
+enum struct TraceLogArgType : uint8
+{
+	Int32,
+	UInt32,
+	Int64,
+	UInt64,
+	Double,
+	String,
+	Pointer,
+};
+
+// 64 bytes, and the ring's array is aligned to 64, so they stay on their own cache lines in the ring
+struct TraceLogRecord
+{
+	const TraceLogSite* Site;
+
+	// From GetTraceLogTimestamp
+	uint64 Timestamp;
+
+	// The args as they were passed, the types say how to pass them back to snprintf
+	uint64 Args[TRACE_LOG_MAX_ARGS];
+	TraceLogArgType ArgTypes[TRACE_LOG_MAX_ARGS];
+	uint8 NumArgs;
+
+	// Filled in by the drain thread, from the ring it came off
+	uint16 ThreadIndex;
+};
+
+static_assert(sizeof(TraceLogRecord) == 64, "TraceLogRecord should be a cache line");
+
+// Single producer (the thread it belongs to), single consumer (the drain thread)
+struct TraceLogRing
+{
+	static const int32 Capacity = 4096;
+
+	alignas(64) TraceLogRecord Records[Capacity];
+
+	// Which thread it belongs to, in the order they first logged
+	uint32 ThreadIndex = 0;
+
+	// Written by the producer. Counts up forever, the slot is Index % Capacity
+	std::atomic<uint64> WriteIndex;
+
+	// Only the producer looks at these, so it doesn't have to read ReadIndex (which the drain thread keeps writing) every time
+	uint64 CachedReadIndex = 0;
+	std::atomic<uint64> NumDropped;
+
+	// Keeps the consumer's side off the producer's cache line
+	byte ConsumerPadding[64];
+
+	// Written by the drain thread
+	std::atomic<uint64> ReadIndex;
+	uint64 NumDroppedReported = 0;
+
+	TraceLogRing()
+	{
+		WriteIndex.store(0);
+		NumDropped.store(0);
+		ReadIndex.store(0);
+	}
+
+	// Producer only. False (and counts it) if it's full
+	bool Push(const TraceLogRecord& Record);
+
+	// Plain new doesn't have to respect the alignas (not until C++17)
+	static void* operator new(size_t Size) { return _aligned_malloc(Size, 64); }
+	static void operator delete(void* Ptr) { _aligned_free(Ptr); }
+};
+
+struct TraceLogger
+{
+	// Anything below this isn't recorded at all
+	std::atomic<int32> MinSeverity;
+
+	// What gets written to OutputDebugStringA as well as the file
+	TraceSeverity EchoSeverity = TraceSeverity::Warning;
+
+	FILE* LogFile = nullptr;
+
+	// For turning timestamps into milliseconds since Start: the rate is measured against steady_clock since Start
+	uint64 StartTimestamp = 0;
+	std::chrono::steady_clock::time_point StartTime;
+
+	std::mutex RingsMutex;
+	std::vector<TraceLogRing*> Rings;
+
+	// Bumped on every Start, so threads don't keep using a ring from the last time
+	uint32 Generation = 0;
+
+	std::atomic<bool> bRunning;
+	std::thread DrainThread;
+
+	// Held while draining, timed so the crash handler doesn't wait forever on a drain thread that's stuck
+	std::timed_mutex DrainMutex;
+
+	// The drain thread's, reused between drains
+	std::vector<TraceLogRing*> RingsToDrain;
+	std::vector<TraceLogRecord> DrainBatch;
+	std::string FileText;
+	std::string EchoText;
+
+	TraceLogger()
+	{
+		MinSeverity.store((int32)TraceSeverity::Info);
+		bRunning.store(false);
+	}
+
+	~TraceLogger()
+	{
+		Stop();
+	}
+
+	// Creates/truncates the file. Returns false if it couldn't open it
+	bool Start(const char* Filename, TraceSeverity InMinSeverity, TraceSeverity InEchoSeverity);
+
+	// Drains what's left, closes the file and frees the rings. Only call it once the threads that log are done with it,
+	// a thread that's in the middle of a TRACE_LOG could still be writing to its ring
+	void Stop();
+
+	// Only pushes onto the calling thread's ring, and the first time a thread logs it gets one (under RingsMutex)
+	void Push(const TraceLogRecord& Record);
+
+	// Pulls everything off the rings and writes it. Returns how many records there were
+	int32 Drain();
+
+	// From a crash handler: drains whatever's there if the drain thread isn't in the middle of it, and flushes the file
+	void DrainAfterCrash();
+
+	TraceLogRing* GetRingForThisThread();
+};
+
+// Null unless there's a logger running. Set it before the threads that log start, and clear it after they're done
+extern TraceLogger* GlobalTraceLogger;
+
+void SetTraceLogger(TraceLogger* Logger);
+
+// For an unhandled exception filter, so the last seeds before a crash make it to the file
+void FlushTraceLogAfterCrash();
+
+// Formats one record the way LOG would have (without the newline), appending to Out
+void FormatTraceLogRecord(const TraceLogRecord& Record, std::string* Out);
+
+// The TSC, since going through steady_clock (QueryPerformanceCounter) was most of what a TRACE_LOG cost.
+// Only used for ordering and the relative times in the file
+inline uint64 GetTraceLogTimestamp()
+{
+	return __rdtsc();
+}
+
+// Integers, as whatever printf would have gotten them as (anything smaller than an int gets promoted to int)
+template<typename ArgType>
+typename std::enable_if<std::is_integral<ArgType>::value>::type SetTraceLogArg(TraceLogRecord* Record, int32 Index, ArgType Value)
+{
+	Record->Args[Index] = (uint64)(int64)Value;
+	if (sizeof(ArgType) > 4)
+	{
+		Record->ArgTypes[Index] = (std::is_signed<ArgType>::value ? TraceLogArgType::Int64 : TraceLogArgType::UInt64);
+	}
+	else if (sizeof(ArgType) == 4)
+	{
+		Record->ArgTypes[Index] = (std::is_signed<ArgType>::value ? TraceLogArgType::Int32 : TraceLogArgType::UInt32);
+	}
+	else
+	{
+		Record->ArgTypes[Index] = TraceLogArgType::Int32;
+	}
+}
+
+inline void SetTraceLogArg(TraceLogRecord* Record, int32 Index, double Value)
+{
+	memcpy(&Record->Args[Index], &Value, sizeof(Value));
+	Record->ArgTypes[Index] = TraceLogArgType::Double;
+}
+
+inline void SetTraceLogArg(TraceLogRecord* Record, int32 Index, const char* Value)
+{
+	Record->Args[Index] = (uint64)(uintptr_t)Value;
+	Record->ArgTypes[Index] = TraceLogArgType::String;
+}
+
+inline void SetTraceLogArg(TraceLogRecord* Record, int32 Index, const void* Value)
+{
+	Record->Args[Index] = (uint64)(uintptr_t)Value;
+	Record->ArgTypes[Index] = TraceLogArgType::Pointer;
+}
+
+inline void SetTraceLogArgs(TraceLogRecord* Record, int32 Index)
+{
+}
+
+template<typename FirstArgType, typename... ArgTypes>
+void SetTraceLogArgs(TraceLogRecord* Record, int32 Index, FirstArgType FirstArg, ArgTypes... Args)
+{
+	SetTraceLogArg(Record, Index, FirstArg);
+	SetTraceLogArgs(Record, Index + 1, Args...);
+}
+
+template<typename... ArgTypes>
+void WriteTraceLog(TraceLogger* Logger, const TraceLogSite* Site, ArgTypes... Args)
+{
+	static_assert(sizeof...(Args) <= TRACE_LOG_MAX_ARGS, "Too many args for TRACE_LOG, bump TRACE_LOG_MAX_ARGS");
+
+	TraceLogRecord Record;
+	Record.Site = Site;
+	Record.Timestamp = GetTraceLogTimestamp();
+	Record.NumArgs = (uint8)sizeof...(Args);
+	SetTraceLogArgs(&Record, 0, Args...);
+
+	Logger->Push(Record);
+}
+
+#define TRACE_LOG(severity, fmt, ...) do { \
+		static const TraceLogSite TraceLogSiteForCall = { fmt, TraceSeverity::severity, __FILE__, __LINE__ }; \
+		TraceLogger* TraceLoggerForCall = GlobalTraceLogger; \
+		if (TraceLoggerForCall == nullptr) { LOG(fmt, ## __VA_ARGS__); } \
+		else if ((int32)TraceSeverity::severity >= TraceLoggerForCall->MinSeverity.load(std::memory_order_relaxed)) { WriteTraceLog(TraceLoggerForCall, &TraceLogSiteForCall, ## __VA_ARGS__); } \
+	} while(0)
+
+// Only logs one in every oneIn times this line is hit on each thread, for when we just want to know it's still going
+#define TRACE_LOG_SAMPLED(severity, oneIn, fmt, ...) do { \
+		static thread_local uint32 TraceLogSampleCounter = 0; \
+		if (TraceLogSampleCounter++ % (oneIn) == 0) { TRACE_LOG(severity, fmt, ## __VA_ARGS__); } \
+	} while(0)